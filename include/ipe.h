@@ -23,13 +23,12 @@
 #ifndef __IPE_IPE_H
 #define __IPE_IPE_H              1
 
+#include "ipeNetlink.h"
 
 #define IPE_ARGS_COUNT           3
 
-#define NETLINK_USER            31 /* this port than used kernel module */
 #define MAX_PATH_LEN            256
 #define NETNS_RUN_DIR           "/var/run/netns"
-#define IPE_BUFF_SIZE           128
 
 
 enum {
@@ -39,48 +38,70 @@ enum {
 };
 
 
-/* This structure for Netlink message into ipe */
+struct net;
+struct net_device;
+
+/* Device before operation, for IPE_CMD_EVENT */
+typedef struct {
+        char            ifname[IFNAMSIZ];
+        int             parent;         /* 0 if it isn't VLAN */
+        unsigned short  vid;
+        unsigned short  proto;          /* host order */
+} ipe_link_state_t;
+
+/* Operation parsed from Netlink attributes */
 typedef struct nl_message {
         int   ifindex [IPE_DEV_COUNT];     
         int   nsfd    [IPE_DEV_COUNT];
+        int   nsid    [IPE_DEV_COUNT];   /* IPE_NO_NSID if nsfd is used */
+        /* resolved once by ipe_resolve_net, holds reference */
+        struct net *net[IPE_DEV_COUNT];
+        /* pinned before rtnl_lock by ipe_resolve_names (given by name)
+         * or ipe_op_pin, holds reference */
+        struct net_device *dev[IPE_DEV_COUNT];
+        /* instead of ifindex, resolved by ipe_resolve_names */
+        char  devname [IPE_DEV_COUNT][IFNAMSIZ];
         char  ifname  [IFNAMSIZ];
         int   value;
-        char  command;
+        char  command;          /* IPE_CMD_* */
+        /* saved under rtnl_lock before handler */
+        ipe_link_state_t old;
 } ipe_nlmsg_t;
 
 
+/* 
+ * Batched request (IPE_CMD_BATCH): all operations is validated first and
+ * applied into one rtnl_lock critical section. With IPE_BATCH_ATOMIC the
+ * first failure rolls back whole batch.
+ */
+typedef struct {
+        int          count;
+        int          flags;
+        ipe_nlmsg_t  ops[];
+} ipe_batch_t;
+
+
+typedef struct ipe_vid_pair ipe_vid_pair_t;
+
+
+struct ipe_txn;
+
 /* For map handlers */
 typedef struct {
         int (*handler)(const ipe_nlmsg_t *msg);
         char *name;
-        /* check value for current handler */
+        /* check value for current handler: called under RCU
+         * without rtnl_lock, devices are pinned already */
         int (*checker)(const ipe_nlmsg_t *msg);
+        /* instead of handler: called under rtnl_lock with undo log, 
+         * can be batched */
+        int (*txn_handler)(const ipe_nlmsg_t *msg, struct ipe_txn *txn);
+        /* required IPE_ATTR_* (bit mask) */
+        unsigned long attrs;
 } ipe_tool_t;
 
 
 
-typedef struct {
-        int     retcode;
-        char    report[IPE_BUFF_SIZE];
-        int     reserve;
-} ipe_reply_t;
-
-/* Functions that extend usage netlink */
-enum {
-        IPE_SET_VID    = 0,
-        IPE_SET_ETH, 
-#ifdef IPE_DEBUG
-        /* debug: */
-        IPE_PRINT_ADDR,
-        IPE_LIST,
-#endif
-        IPE_SET_NAME,
-        IPE_SET_PARENT,
-
-        IPE_COMMAND_COUNT,
-};
-
-
 #ifdef IPE_DEBUG
         #define LOG_RTNL_LOCK()    printk(KERN_ERR "%s: rtnl_lock (%d)\n", \
                                                 __FUNCTION__, __LINE__)
@@ -91,25 +112,7 @@ enum {
 
 /* Invalid descriptor for case global netns */
 #define IPE_GLOBAL_NS   (-1)
-
-
-/* Error's code: */
-enum {
-        IPE_OK             = 0,
-        IPE_BAD_ARG,
-        IPE_BAD_VID,
-        IPE_BAD_PTR,
-        IPE_BAD_DEV,
-        IPE_BAD_IF_IDX,
-        IPE_UNKNOWN_COMMAND,
-        IPE_FAIL_NS,
-        IPE_FAIL_CR_SOC,
-        IPE_FEW_ARG,
-        IPE_NULLPTR,
-        IPE_BAD_SOC,
-        IPE_BAD_ALLOC,
-        IPE_DEFAULT_FAIL,
-};
+#define IPE_NO_NSID     (-1)
 
 
 #endif // __IPE_IPE_H
@@ -0,0 +1,19 @@
+#ifndef __IPE_ASYNC_H
+#define __IPE_ASYNC_H   1
+
+#include <net/genetlink.h>
+
+/* Operations that are queued and not applied yet, for all senders */
+#define IPE_ASYNC_MAX_OPS       (4 * IPE_BATCH_MAX)
+
+int  ipe_async_init     (void);
+void ipe_async_exit     (void);
+int  ipe_async_submit   (ipe_batch_t *batch, int *retcode,
+                         struct genl_info *info, const u64 start);
+
+/* ipeDrv.c: */
+size_t ipe_results_size (const ipe_batch_t *batch);
+int  ipe_put_results    (struct sk_buff *skb, const ipe_batch_t *batch,
+                         const int *retcode);
+
+#endif // __IPE_ASYNC_H
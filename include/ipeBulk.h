@@ -0,0 +1,46 @@
+#ifndef __IPE_BULK_H
+#define __IPE_BULK_H   1
+
+int renumber_vids(const ipe_nlmsg_t *msg, const ipe_vid_pair_t *map,
+                                   const int count, int *moved);
+
+
+/* VLAN child that isn't moved by failover */
+typedef struct {
+        int     ifindex;
+        int     retcode;
+} ipe_failed_t;
+
+typedef struct {
+        int             moved;
+        int             nr_failed;
+        ipe_failed_t    failed[];
+} ipe_failover_t;
+
+/* On success *@result is set, it must be freed by kvfree */
+int failover_vlans(const ipe_nlmsg_t *msg, ipe_failover_t **result);
+
+
+/* Children of parent by IPE_ATTR_FILTER: ethertype and VID range */
+typedef struct {
+        __be16          proto;          /* 0 is any */
+        u16             vid_min;
+        u16             vid_max;
+} ipe_match_t;
+
+/* Children of parent that are converted by IPE_CMD_CONVERT */
+typedef struct {
+        __be16          proto;          /* new ethertype */
+        ipe_match_t     match;
+} ipe_convert_t;
+
+int convert_vlans(const ipe_nlmsg_t *msg, const ipe_convert_t *conv,
+                                          int *converted);
+
+/* IPE_CMD_RENAME: "%d" of @pattern is VID of child */
+int rename_vlans(const ipe_nlmsg_t *msg, const char *pattern,
+                 const ipe_match_t *match, int *renamed);
+/* IPE_CMD_RENAME by list: IPE_CMD_SET_NAME operations of checked batch */
+int rename_list (const ipe_batch_t *batch, int *renamed);
+
+#endif // __IPE_BULK_H
@@ -0,0 +1,23 @@
+#ifndef __IPE_CMD_H
+#define __IPE_CMD_H   1
+
+#include "ipeTxn.h"
+#include "ipeName.h"
+
+#define IPE_ATTR_BIT(attr)      (1UL << (attr))
+
+int  ipe_check_command  (const ipe_nlmsg_t *msg);
+const ipe_tool_t *ipe_tool (const int command);
+
+/* Single operation: prepare without rtnl_lock, exec under it */
+int  ipe_prepare_op     (ipe_nlmsg_t *msg, ipe_name_cache_t *cache);
+int  ipe_exec_txn       (ipe_nlmsg_t *msg, ipe_txn_t *txn);
+
+int  ipe_check_batch    (ipe_batch_t *batch, int *retcode,
+                         ipe_name_cache_t *cache);
+int  ipe_apply_batch    (ipe_batch_t *batch, int *retcode);
+void ipe_release_batch  (ipe_batch_t *batch);
+void ipe_op_status      (const ipe_nlmsg_t *msg, const int index, const int code,
+                         struct ipe_op_status *status);
+
+#endif // __IPE_CMD_H
@@ -3,7 +3,6 @@
 
 #ifdef IPE_DEBUG
         int show_vlan_info (const ipe_nlmsg_t *msg);
-        void printk_msg    (const ipe_nlmsg_t *msg);
 #endif
 
 
@@ -0,0 +1,17 @@
+#ifndef __IPE_DUMP_H
+#define __IPE_DUMP_H   1
+
+#include <net/genetlink.h>
+
+extern struct genl_family ipe_genl_family;
+extern const struct nla_policy ipe_dump_policy[IPE_ATTR_MAX + 1];
+
+int ipe_dump_start (struct netlink_callback *cb);
+int ipe_dump_links (struct sk_buff *skb, struct netlink_callback *cb);
+int ipe_dump_done  (struct netlink_callback *cb);
+
+size_t ipe_get_size (void);
+int ipe_get_link   (struct sk_buff *skb, const ipe_nlmsg_t *msg,
+                    struct net *src_net);
+
+#endif // __IPE_DUMP_H
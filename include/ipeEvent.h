@@ -0,0 +1,16 @@
+#ifndef __IPE_EVENT_H
+#define __IPE_EVENT_H   1
+
+#include <net/genetlink.h>
+
+/* Index into mcgrps of ipe_genl_family */
+enum {
+        IPE_MCGRP_EVENTS,
+};
+
+void ipe_event_save     (const struct net_device *dev, ipe_link_state_t *state);
+void ipe_event_notify   (const struct net_device *dev, 
+                         const ipe_link_state_t *old, const int change);
+void ipe_event_op       (const ipe_nlmsg_t *msg);
+
+#endif // __IPE_EVENT_H
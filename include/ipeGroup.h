@@ -0,0 +1,19 @@
+#ifndef __IPE_GROUP_H
+#define __IPE_GROUP_H   1
+
+#include "vlan.h"
+
+/* Mask of parts for ipe_group_compact: bit of part of slot (@pidx, @vid) */
+#define IPE_GROUP_PART(pidx, vid)                                       \
+        (1UL << ((pidx) * VLAN_GROUP_ARRAY_SPLIT_PARTS +                \
+                 (vid) / VLAN_GROUP_ARRAY_PART_LEN))
+#define IPE_GROUP_ALL                                                   \
+        ((1UL << (IPE_GROUP_PROTOS * VLAN_GROUP_ARRAY_SPLIT_PARTS)) - 1)
+
+void ipe_group_reclaim  (struct vlan_group *grp, __be16 proto, u16 vid);
+int  ipe_group_compact  (struct vlan_group *grp, const unsigned long parts);
+int  compact_group      (const ipe_nlmsg_t *msg, int *freed);
+bool ipe_group_holds    (const struct net_device *dev);
+void ipe_group_exit     (void);
+
+#endif // __IPE_GROUP_H
@@ -0,0 +1,28 @@
+#ifndef __IPE_NAME_H
+#define __IPE_NAME_H   1
+
+#include <linux/hashtable.h>
+
+#define IPE_NAME_HASH_BITS      6
+
+typedef struct {
+        struct hlist_node       node;
+        struct net             *net;
+        struct net_device      *dev;    /* holds reference */
+        char                    name[IFNAMSIZ];
+} ipe_name_entry_t;
+
+/* Names resolved for one request: (netns, name) -> pinned device */
+typedef struct {
+        DECLARE_HASHTABLE(table, IPE_NAME_HASH_BITS);
+        ipe_name_entry_t       *entry;
+        int                     count;
+        int                     size;
+} ipe_name_cache_t;
+
+
+int  ipe_name_cache_init    (ipe_name_cache_t *cache, const int size);
+void ipe_name_cache_destroy (ipe_name_cache_t *cache);
+int  ipe_resolve_names      (ipe_nlmsg_t *msg, ipe_name_cache_t *cache);
+
+#endif // __IPE_NAME_H
@@ -0,0 +1,14 @@
+#ifndef __IPE_NET_H
+#define __IPE_NET_H   1
+
+struct net;
+
+int  ipe_net_cache_init  (void);
+void ipe_net_cache_exit  (void);
+
+struct net *ipe_get_net_by_id (const int nsid);
+
+int  ipe_resolve_net     (ipe_nlmsg_t *msg);
+void ipe_release_net     (ipe_nlmsg_t *msg);
+
+#endif // __IPE_NET_H
@@ -0,0 +1,244 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Description:
+*     Generic Netlink protocol of ipe, shared by kernel module and userspace.
+* Family "ipe" is resolved through nlctrl. Requests carry TLV attributes,
+* so new attributes can be added without breaking old peers: kernel ignores
+* unknown attributes, userspace compares its IPE_GENL_VERSION with version
+* of registered family before using new features.
+*
+* Errors are returned through the standard netlink ACK: negative errno from
+* ipe_code_to_errno() and extended ACK message. Without NLM_F_ACK only
+* failed requests get reply.
+*
+*                           FOR KERNEL AND USERSPACE
+******************************************************************************/
+
+#ifndef __IPE_NETLINK_H
+#define __IPE_NETLINK_H         1
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+#define IPE_GENL_NAME           "ipe"
+#define IPE_GENL_VERSION        1
+#define IPE_GENL_MCGRP_EVENTS   "events"  /* IPE_CMD_EVENT of applied changes */
+
+#define IPE_BATCH_MAX           4096
+
+/* Children into IPE_ATTR_FAILED of IPE_CMD_FAILOVER, the rest isn't reported */
+#define IPE_FAILED_MAX          1024
+
+/* IPE_ATTR_FLAGS of IPE_CMD_BATCH: */
+#define IPE_BATCH_ATOMIC        0x1     /* all or nothing */
+#define IPE_BATCH_ASYNC         0x2     /* queued, RESULTS are sent later
+                                         * with nlmsg_seq of request */
+#define IPE_BATCH_STATUS        0x4     /* STATUS instead of RESULTS */
+
+
+/* Commands (genlmsghdr.cmd) */
+enum {
+        IPE_CMD_UNSPEC,
+        IPE_CMD_SET_VID,        /* SRC, VALUE (VID) */
+        IPE_CMD_SET_ETH,        /* SRC, VALUE (ethertype) */
+        IPE_CMD_SET_NAME,       /* SRC, IFNAME */
+        IPE_CMD_SET_PARENT,     /* SRC, DST */
+        IPE_CMD_SHOW,           /* SRC, debug only */
+        IPE_CMD_LIST,           /* debug only */
+        IPE_CMD_BATCH,          /* OPS, [FLAGS] -> RESULTS or STATUS */
+        IPE_CMD_RENUMBER,       /* SRC (parent), VID_MAP -> COUNT */
+        IPE_CMD_DUMP,           /* [FILTER] -> IPE_LINK_ATTR_* for each VLAN */
+        IPE_CMD_EVENT,          /* multicast only: IPE_LINK_ATTR_* of device */
+        IPE_CMD_COMPACT,        /* SRC (parent) -> COUNT of freed parts */
+        IPE_CMD_FAILOVER,       /* SRC (old parent), DST (new parent) ->
+                                 * COUNT of moved VLANs, FAILED */
+        IPE_CMD_CONVERT,        /* SRC (parent), VALUE (new ethertype),
+                                 * [FILTER] -> COUNT of converted VLANs */
+        IPE_CMD_RENAME,         /* SRC (parent), IFNAME (pattern with %d
+                                 * of VID), [FILTER] or OPS of SET_NAME ->
+                                 * COUNT of renamed devices */
+        IPE_CMD_GET,            /* SRC -> IPE_LINK_ATTR_* and SLOT of VLAN
+                                 * device, read under RCU only */
+
+        __IPE_CMD_MAX,
+};
+#define IPE_CMD_MAX             (__IPE_CMD_MAX - 1)
+
+
+/* Attributes of commands */
+enum {
+        IPE_ATTR_UNSPEC,
+        IPE_ATTR_SRC,           /* nested IPE_DEV_ATTR_* */
+        IPE_ATTR_DST,           /* nested IPE_DEV_ATTR_* */
+        IPE_ATTR_VALUE,         /* u32 */
+        IPE_ATTR_IFNAME,        /* string */
+        IPE_ATTR_CMD,           /* u8, IPE_CMD_* of IPE_ATTR_OP */
+        IPE_ATTR_OP,            /* nested: IPE_ATTR_CMD and it's attributes */
+        IPE_ATTR_OPS,           /* nested: array of IPE_ATTR_OP */
+        IPE_ATTR_FLAGS,         /* u32 */
+        IPE_ATTR_RESULTS,       /* nested: IPE_ATTR_RETCODE for each op */
+        IPE_ATTR_RETCODE,       /* u32, IPE_* code */
+        IPE_ATTR_VID_MAP,       /* binary: array of struct ipe_vid_pair */
+        IPE_ATTR_COUNT,         /* u32 */
+        IPE_ATTR_FILTER,        /* nested IPE_FILTER_ATTR_* */
+        IPE_ATTR_FAILED,        /* nested: IPE_ATTR_OP of each VLAN that
+                                 * isn't moved, with SRC and RETCODE */
+        IPE_ATTR_STATUS,        /* binary: array of struct ipe_op_status */
+
+        __IPE_ATTR_MAX,
+};
+#define IPE_ATTR_MAX            (__IPE_ATTR_MAX - 1)
+
+
+/* Attributes of device (IPE_ATTR_SRC, IPE_ATTR_DST) */
+enum {
+        IPE_DEV_ATTR_UNSPEC,
+        IPE_DEV_ATTR_IFINDEX,   /* u32 */
+        IPE_DEV_ATTR_NSFD,      /* u32, descriptor of netns into sender */
+        IPE_DEV_ATTR_IFNAME,    /* string, if IFINDEX is absent */
+        IPE_DEV_ATTR_NSID,      /* s32, netnsid instead of NSFD */
+
+        __IPE_DEV_ATTR_MAX,
+};
+#define IPE_DEV_ATTR_MAX        (__IPE_DEV_ATTR_MAX - 1)
+
+
+/*
+ * Filter of IPE_CMD_DUMP (IPE_ATTR_FILTER), absent attribute matches all.
+ * IPE_CMD_CONVERT and IPE_CMD_RENAME take PROTO (ethertype of children)
+ * and VID range only.
+ */
+enum {
+        IPE_FILTER_ATTR_UNSPEC,
+        IPE_FILTER_ATTR_PARENT,         /* u32, ifindex of real_dev */
+        IPE_FILTER_ATTR_PROTO,          /* u16, ethertype in host order */
+        IPE_FILTER_ATTR_VID_MIN,        /* u16 */
+        IPE_FILTER_ATTR_VID_MAX,        /* u16 */
+        IPE_FILTER_ATTR_NSFD,           /* u32, only this netns */
+        IPE_FILTER_ATTR_NSID,           /* s32, the same by netnsid */
+
+        __IPE_FILTER_ATTR_MAX,
+};
+#define IPE_FILTER_ATTR_MAX     (__IPE_FILTER_ATTR_MAX - 1)
+
+
+/* 
+ * One message of IPE_CMD_DUMP for each VLAN device. Without filter of 
+ * netns all namespaces are dumped. NETNSID is nsid of netns of device for
+ * sender, it's absent if device is into netns of sender. IPE_CMD_EVENT
+ * has the same attributes, NETNSID is for init_net there.
+ */
+enum {
+        IPE_LINK_ATTR_UNSPEC,
+        IPE_LINK_ATTR_IFINDEX,          /* u32 */
+        IPE_LINK_ATTR_IFNAME,           /* string */
+        IPE_LINK_ATTR_VID,              /* u16 */
+        IPE_LINK_ATTR_PROTO,            /* u16, ethertype in host order */
+        IPE_LINK_ATTR_PARENT,           /* u32, ifindex of real_dev */
+        IPE_LINK_ATTR_PARENT_NAME,      /* string */
+        IPE_LINK_ATTR_NETNSID,          /* s32, -1 if nsid isn't assigned */
+        IPE_LINK_ATTR_PARENT_NETNSID,   /* s32 */
+        IPE_LINK_ATTR_NEST_LEVEL,       /* u32 */
+        /* IPE_CMD_EVENT: state after change, OLD_* only for changed fields */
+        IPE_LINK_ATTR_CHANGE,           /* u8, IPE_CMD_* that made change */
+        IPE_LINK_ATTR_GENERATION,       /* u32, +1 for each event */
+        IPE_LINK_ATTR_OLD_VID,          /* u16 */
+        IPE_LINK_ATTR_OLD_PROTO,        /* u16 */
+        IPE_LINK_ATTR_OLD_PARENT,       /* u32 */
+        IPE_LINK_ATTR_OLD_IFNAME,       /* string */
+        /* IPE_CMD_GET: */
+        IPE_LINK_ATTR_SLOT,             /* u8, 1 if device is into its slot
+                                         * of vlan_group of parent */
+
+        __IPE_LINK_ATTR_MAX,
+};
+#define IPE_LINK_ATTR_MAX       (__IPE_LINK_ATTR_MAX - 1)
+
+
+/* Element of IPE_ATTR_VID_MAP */
+struct ipe_vid_pair {
+        __u16   old_vid;
+        __u16   new_vid;
+};
+
+
+/*
+ * Element of IPE_ATTR_STATUS, one for each operation of batch. Values are
+ * VID, ethertype (host order) or ifindex of parent, 0 for other commands.
+ * new_value is old_value if operation isn't applied; they are 0 both if
+ * device wasn't checked.
+ */
+struct ipe_op_status {
+        __u16   index;          /* of operation into batch */
+        __s16   code;           /* IPE_*, IPE_BAD_VLAN_PROTO is negative */
+        __u32   ifindex;        /* IPE_SRC */
+        __u32   old_value;
+        __u32   new_value;
+};
+
+
+/* Error's code: */
+enum {
+        IPE_OK             = 0,
+        IPE_BAD_ARG,
+        IPE_BAD_VID,
+        IPE_BAD_PTR,
+        IPE_BAD_DEV,
+        IPE_BAD_IF_IDX,
+        IPE_UNKNOWN_COMMAND,
+        IPE_FAIL_NS,
+        IPE_FAIL_CR_SOC,
+        IPE_FEW_ARG,
+        IPE_NULLPTR,
+        IPE_BAD_SOC,
+        IPE_BAD_ALLOC,
+        IPE_DEFAULT_FAIL,
+        IPE_SKIPPED,
+        IPE_ROLLED_BACK,
+        IPE_ERR_COUNT,
+};
+
+
+/* errno of netlink ACK for IPE_* code */
+static inline int ipe_code_to_errno(const int code)
+{
+        switch (code) {
+        case IPE_OK:                return 0;
+        case IPE_BAD_ARG:           return EINVAL;
+        case IPE_BAD_VID:           return ERANGE;
+        case IPE_BAD_PTR:           return ENODEV;
+        case IPE_BAD_DEV:           return EMEDIUMTYPE;
+        case IPE_BAD_IF_IDX:        return ENXIO;
+        case IPE_UNKNOWN_COMMAND:   return EBADRQC;
+        case IPE_FAIL_NS:           return EBADF;
+        case IPE_BAD_ALLOC:         return ENOMEM;
+        case IPE_SKIPPED:           return ECANCELED;
+        default:                    return EIO;
+        }
+}
+
+static inline int ipe_errno_to_code(const int err)
+{
+        int code;
+
+        if (err == EIO)
+                return IPE_DEFAULT_FAIL;
+
+        for (code = IPE_OK; code < IPE_ERR_COUNT; ++code) {
+                if (ipe_code_to_errno(code) == err)
+                        return code;
+        }
+
+        return IPE_DEFAULT_FAIL;
+}
+
+#endif // __IPE_NETLINK_H
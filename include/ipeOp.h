@@ -0,0 +1,11 @@
+#ifndef __IPE_OP_H
+#define __IPE_OP_H   1
+
+int  ipe_op_pin          (ipe_nlmsg_t *msg);
+int  ipe_op_verify       (const ipe_nlmsg_t *msg);
+void ipe_op_release      (ipe_nlmsg_t *msg);
+
+void ipe_rtnl_lock       (const int command);
+void ipe_rtnl_unlock     (const int ops);
+
+#endif // __IPE_OP_H
@@ -0,0 +1,19 @@
+#ifndef __IPE_STATS_H
+#define __IPE_STATS_H   1
+
+#include <linux/types.h>
+
+/* log2 of nanoseconds: bucket i is [2^(i-1), 2^i), the last is the rest */
+#define IPE_STATS_BUCKETS       32
+
+int  ipe_stats_init     (void);
+void ipe_stats_exit     (void);
+
+void ipe_stats_op       (const int command, const int res, const u64 start);
+void ipe_stats_count    (const int command, const int res);
+void ipe_stats_batch    (const ipe_batch_t *batch, const int *retcode,
+                         const int res, const u64 start);
+void ipe_stats_wait     (const int command, const u64 ns);
+void ipe_stats_hold     (const int command, const u64 ns);
+
+#endif // __IPE_STATS_H
@@ -0,0 +1,266 @@
+/*
+ * Tracepoints of ipe, instead of debug printk: disabled tracepoint is a
+ * static key (nop into code), so they are built always and are enabled
+ * into runtime by tracefs, e.g. events/ipe/enable.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ipe
+
+#if !defined(__IPE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __IPE_TRACE_H   1
+
+#include <linux/tracepoint.h>
+#include <linux/netdevice.h>
+
+#include "ipe.h"
+#include "vlan.h"
+
+TRACE_DEFINE_ENUM(IPE_CMD_SET_VID);
+TRACE_DEFINE_ENUM(IPE_CMD_SET_ETH);
+TRACE_DEFINE_ENUM(IPE_CMD_SET_NAME);
+TRACE_DEFINE_ENUM(IPE_CMD_SET_PARENT);
+TRACE_DEFINE_ENUM(IPE_CMD_SHOW);
+TRACE_DEFINE_ENUM(IPE_CMD_LIST);
+TRACE_DEFINE_ENUM(IPE_CMD_BATCH);
+TRACE_DEFINE_ENUM(IPE_CMD_RENUMBER);
+TRACE_DEFINE_ENUM(IPE_CMD_COMPACT);
+TRACE_DEFINE_ENUM(IPE_CMD_FAILOVER);
+TRACE_DEFINE_ENUM(IPE_CMD_CONVERT);
+TRACE_DEFINE_ENUM(IPE_CMD_RENAME);
+TRACE_DEFINE_ENUM(IPE_CMD_GET);
+
+#define show_ipe_cmd(cmd)                                       \
+        __print_symbolic(cmd,                                   \
+                { IPE_CMD_SET_VID,      "set_vid" },            \
+                { IPE_CMD_SET_ETH,      "set_eth" },            \
+                { IPE_CMD_SET_NAME,     "set_name" },           \
+                { IPE_CMD_SET_PARENT,   "set_parent" },         \
+                { IPE_CMD_SHOW,         "show_vlan_info" },     \
+                { IPE_CMD_LIST,         "print_list_ndev" },    \
+                { IPE_CMD_BATCH,        "batch" },              \
+                { IPE_CMD_RENUMBER,     "renumber" },           \
+                { IPE_CMD_COMPACT,      "compact" },            \
+                { IPE_CMD_FAILOVER,     "failover" },           \
+                { IPE_CMD_CONVERT,      "convert" },            \
+                { IPE_CMD_RENAME,       "rename" },             \
+                { IPE_CMD_GET,          "get" })
+
+
+/* Operation is parsed, devices given by name have ifindex 0 here */
+TRACE_EVENT(ipe_op_start,
+        TP_PROTO(const ipe_nlmsg_t *msg),
+        TP_ARGS(msg),
+
+        TP_STRUCT__entry(
+                __field(int,    command)
+                __field(int,    src)
+                __field(int,    dst)
+                __field(int,    value)
+                __array(char,   ifname, IFNAMSIZ)
+        ),
+
+        TP_fast_assign(
+                __entry->command = msg->command;
+                __entry->src     = msg->ifindex[IPE_SRC];
+                __entry->dst     = msg->ifindex[IPE_DST];
+                __entry->value   = msg->value;
+                memcpy(__entry->ifname, msg->ifname, IFNAMSIZ);
+        ),
+
+        TP_printk("cmd=%s src=%d dst=%d value=%d ifname=%s",
+                  show_ipe_cmd(__entry->command), __entry->src,
+                  __entry->dst, __entry->value, __entry->ifname)
+);
+
+
+/* Operation failed its check or was executed under rtnl_lock */
+TRACE_EVENT(ipe_op_end,
+        TP_PROTO(const ipe_nlmsg_t *msg, const int res),
+        TP_ARGS(msg, res),
+
+        TP_STRUCT__entry(
+                __field(int,    command)
+                __field(int,    src)
+                __field(int,    res)
+        ),
+
+        TP_fast_assign(
+                __entry->command = msg->command;
+                __entry->src     = msg->ifindex[IPE_SRC];
+                __entry->res     = res;
+        ),
+
+        TP_printk("cmd=%s src=%d res=%d", show_ipe_cmd(__entry->command),
+                  __entry->src, __entry->res)
+);
+
+
+/* Device of operation is pinned, @dev is NULL if it isn't found */
+TRACE_EVENT(ipe_dev_resolve,
+        TP_PROTO(const int id, const int ifindex, const struct net_device *dev),
+        TP_ARGS(id, ifindex, dev),
+
+        TP_STRUCT__entry(
+                __field(int,    id)
+                __field(int,    ifindex)
+                __string(name,  dev ? dev->name : "")
+        ),
+
+        TP_fast_assign(
+                __entry->id      = id;
+                __entry->ifindex = ifindex;
+                __assign_str(name, dev ? dev->name : "");
+        ),
+
+        TP_printk("%s ifindex=%d name=%s", __entry->id ? "dst" : "src",
+                  __entry->ifindex, __get_str(name))
+);
+
+
+/* Slot of vlan_group is changed, by operation or by rollback */
+TRACE_EVENT(ipe_slot_change,
+        TP_PROTO(const struct vlan_group *grp, const __be16 proto, const u16 vid,
+                 const struct net_device *old, const struct net_device *dev),
+        TP_ARGS(grp, proto, vid, old, dev),
+
+        TP_STRUCT__entry(
+                __field(int,    parent)
+                __field(u16,    proto)
+                __field(u16,    vid)
+                __field(int,    old)
+                __field(int,    dev)
+        ),
+
+        TP_fast_assign(
+                __entry->parent = container_of(grp, struct vlan_info, grp)
+                                                        ->real_dev->ifindex;
+                __entry->proto  = ntohs(proto);
+                __entry->vid    = vid;
+                __entry->old    = old ? old->ifindex : 0;
+                __entry->dev    = dev ? dev->ifindex : 0;
+        ),
+
+        TP_printk("parent=%d proto=0x%04x vid=%u old=%d new=%d",
+                  __entry->parent, __entry->proto, __entry->vid,
+                  __entry->old, __entry->dev)
+);
+
+
+/* Empty part of vlan_group is unpublished, it's freed after grace period */
+TRACE_EVENT(ipe_part_free,
+        TP_PROTO(const struct vlan_group *grp, const unsigned int pidx,
+                                               const unsigned int vidx),
+        TP_ARGS(grp, pidx, vidx),
+
+        TP_STRUCT__entry(
+                __field(int,            parent)
+                __field(unsigned int,   pidx)
+                __field(unsigned int,   vidx)
+        ),
+
+        TP_fast_assign(
+                __entry->parent = container_of(grp, struct vlan_info, grp)
+                                                        ->real_dev->ifindex;
+                __entry->pidx   = pidx;
+                __entry->vidx   = vidx;
+        ),
+
+        TP_printk("parent=%d proto_idx=%u part=%u",
+                  __entry->parent, __entry->pidx, __entry->vidx)
+);
+
+
+TRACE_EVENT(ipe_txn_rollback,
+        TP_PROTO(const int count),
+        TP_ARGS(count),
+
+        TP_STRUCT__entry(
+                __field(int,    count)
+        ),
+
+        TP_fast_assign(
+                __entry->count = count;
+        ),
+
+        TP_printk("records=%d", __entry->count)
+);
+
+
+TRACE_EVENT(ipe_rtnl_unlock,
+        TP_PROTO(const int command, const u64 hold_ns, const int ops),
+        TP_ARGS(command, hold_ns, ops),
+
+        TP_STRUCT__entry(
+                __field(int,    command)
+                __field(u64,    hold_ns)
+                __field(int,    ops)
+        ),
+
+        TP_fast_assign(
+                __entry->command = command;
+                __entry->hold_ns = hold_ns;
+                __entry->ops     = ops;
+        ),
+
+        TP_printk("cmd=%s hold_ns=%llu ops=%d", show_ipe_cmd(__entry->command),
+                  __entry->hold_ns, __entry->ops)
+);
+
+
+/* Reply of request is sent: @count is operations or devices of reply */
+TRACE_EVENT(ipe_reply,
+        TP_PROTO(const int command, const u32 portid, const u32 seq,
+                 const int count, const int err),
+        TP_ARGS(command, portid, seq, count, err),
+
+        TP_STRUCT__entry(
+                __field(int,    command)
+                __field(u32,    portid)
+                __field(u32,    seq)
+                __field(int,    count)
+                __field(int,    err)
+        ),
+
+        TP_fast_assign(
+                __entry->command = command;
+                __entry->portid  = portid;
+                __entry->seq     = seq;
+                __entry->count   = count;
+                __entry->err     = err;
+        ),
+
+        TP_printk("cmd=%s portid=%u seq=%u count=%d err=%d",
+                  show_ipe_cmd(__entry->command), __entry->portid,
+                  __entry->seq, __entry->count, __entry->err)
+);
+
+
+/* Callback of IPE_CMD_DUMP is stopped at this position */
+TRACE_EVENT(ipe_dump,
+        TP_PROTO(const long net_idx, const long idx, const int len),
+        TP_ARGS(net_idx, idx, len),
+
+        TP_STRUCT__entry(
+                __field(long,   net_idx)
+                __field(long,   idx)
+                __field(int,    len)
+        ),
+
+        TP_fast_assign(
+                __entry->net_idx = net_idx;
+                __entry->idx     = idx;
+                __entry->len     = len;
+        ),
+
+        TP_printk("netns=%ld dev=%ld bytes=%d",
+                  __entry->net_idx, __entry->idx, __entry->len)
+);
+
+#endif // __IPE_TRACE_H
+
+/* out of tree: ../include is into include path of module (kernel/Makefile) */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ipeTrace
+#include <trace/define_trace.h>
@@ -0,0 +1,103 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Description:
+*     Undo log for changes of VLAN devices. Every mutation of vlan_group
+* slots, vlan_dev_priv fields and upper links is recorded before it's
+* applied, so on failure the log can be replayed in reverse order inside
+* the same rtnl_lock critical section.
+*
+******************************************************************************/
+
+#ifndef __IPE_TXN_H
+#define __IPE_TXN_H   1
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+
+#include "vlan.h"
+
+enum {
+        IPE_UNDO_SLOT,          /* vlan_group_set_device/del_device */
+        IPE_UNDO_VID,           /* vlan_dev_priv->vlan_id */
+        IPE_UNDO_PROTO,         /* vlan_dev_priv->vlan_proto */
+        IPE_UNDO_REAL_DEV,      /* vlan_dev_priv->real_dev, nest_level */
+        IPE_UNDO_LINK,          /* netdev_upper_dev_link */
+        IPE_UNDO_UNLINK,        /* netdev_upper_dev_unlink */
+        IPE_UNDO_VID_ADD,       /* vlan_vid_add */
+        IPE_UNDO_NAME,          /* net_device->name */
+        IPE_UNDO_VID_DEL,       /* vlan_vid_del, deferred to commit */
+};
+
+typedef struct {
+        int                     type;
+        struct net_device      *dev;
+        union {
+                struct {
+                        struct vlan_group *grp;
+                        struct net_device *old;
+                        __be16             proto;
+                        u16                vid;
+                } slot;
+                u16                     vid;
+                __be16                  proto;
+                struct {
+                        struct net_device *dev;
+                        unsigned int       nest_level;
+                } real;
+                struct net_device      *lower;
+                char                    name[IFNAMSIZ];
+        };
+} ipe_undo_t;
+
+typedef struct ipe_txn {
+        int             count;
+        int             size;
+        ipe_undo_t     *log;
+} ipe_txn_t;
+
+
+void ipe_txn_init     (ipe_txn_t *txn);
+void ipe_txn_destroy  (ipe_txn_t *txn);
+int  ipe_txn_reserve  (ipe_txn_t *txn, const int count);
+void ipe_txn_commit   (ipe_txn_t *txn);
+void ipe_txn_rollback (ipe_txn_t *txn);
+
+/*
+ * All functions below must be called under rtnl_lock. Functions without
+ * own failure case use space prepared by ipe_txn_reserve.
+ */
+void ipe_txn_set_device   (ipe_txn_t *txn, struct vlan_group *grp,
+                           __be16 proto, u16 vid, struct net_device *dev);
+void ipe_txn_del_device   (ipe_txn_t *txn, struct vlan_group *grp,
+                           __be16 proto, u16 vid);
+void ipe_txn_set_vid      (ipe_txn_t *txn, struct net_device *dev, u16 vid);
+void ipe_txn_set_proto    (ipe_txn_t *txn, struct net_device *dev,
+                                                        __be16 proto);
+void ipe_txn_set_real_dev (ipe_txn_t *txn, struct net_device *dev,
+                                           struct net_device *real_dev);
+int  ipe_txn_set_name     (ipe_txn_t *txn, struct net_device *dev,
+                                                   const char *name);
+int  ipe_txn_upper_link   (ipe_txn_t *txn, struct net_device *lower,
+                                           struct net_device *upper);
+void ipe_txn_upper_unlink (ipe_txn_t *txn, struct net_device *lower,
+                                           struct net_device *upper);
+int  ipe_txn_vid_add      (ipe_txn_t *txn, struct net_device *real_dev,
+                                           __be16 proto, u16 vid);
+/*
+ * Filter of VID is deleted by commit: frames of old VID are accepted
+ * till all changes are applied, and rollback has nothing to restore.
+ * VID that is added again into the same transaction keeps its filter.
+ */
+void ipe_txn_vid_del      (ipe_txn_t *txn, struct net_device *real_dev,
+                                           __be16 proto, u16 vid);
+
+#endif // __IPE_TXN_H
@@ -41,6 +41,13 @@ enum vlan_protos {
 	VLAN_PROTO_NUM,
 };
 
+/*
+ * 8021q of mainline has arrays of 8021Q and 8021AD only: QinQ rows of this
+ * vlan_group are past its end, there are vid_list and nr_vids of vlan_info.
+ * Walks over group of running 8021q are bounded by this.
+ */
+#define IPE_GROUP_PROTOS        (VLAN_PROTO_8021AD + 1)
+
 struct vlan_group {
 	unsigned int		nr_vlan_devs;
 	struct hlist_node	hlist;	/* linked list */
@@ -100,6 +107,49 @@ static inline void vlan_group_del_device(struct vlan_group *vg,
 }
 
 
+static inline struct net_device *__vlan_group_get_device(struct vlan_group *vg,
+							 unsigned int pidx,
+							 u16 vlan_id)
+{
+	struct net_device **array;
+
+	array = vg->vlan_devices_arrays[pidx]
+				       [vlan_id / VLAN_GROUP_ARRAY_PART_LEN];
+	return array ? array[vlan_id % VLAN_GROUP_ARRAY_PART_LEN] : NULL;
+}
+
+static inline struct net_device *vlan_group_get_device(struct vlan_group *vg,
+						       __be16 vlan_proto,
+						       u16 vlan_id)
+{
+	return __vlan_group_get_device(vg, vlan_proto_idx(vlan_proto), vlan_id);
+}
+
+static inline struct net_device *vlan_find_dev(struct net_device *real_dev,
+					       __be16 vlan_proto, u16 vlan_id)
+{
+	struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
+
+	if (vlan_info)
+		return vlan_group_get_device(&vlan_info->grp,
+					     vlan_proto, vlan_id);
+
+	return NULL;
+}
+
+/* Ethertype has row in group of running 8021q, see IPE_GROUP_PROTOS */
+static inline bool ipe_proto_in_group(__be16 proto)
+{
+        return vlan_proto_idx(proto) < IPE_GROUP_PROTOS;
+}
+
+/* 0 and 4095 are reserved by 802.1Q */
+static inline int ipe_vid_valid(int vlan_id)
+{
+        return vlan_id > 0 && vlan_id < VLAN_VID_MASK;
+}
+
+
 static int vlan_group_prealloc_vid(struct vlan_group *vg,
                                         __be16 vlan_proto, u16 vlan_id)
 {
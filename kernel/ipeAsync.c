@@ -0,0 +1,189 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Asynchronous batches (IPE_BATCH_ASYNC). Batch is validated into
+* context of sender (descriptors of netns are valid only there), then it's
+* queued into ordered workqueue and request is acknowledged. Results are
+* sent later with nlmsg_seq of request. If queue is full, sender waits
+* for free space: requests are never dropped.
+*
+******************************************************************************/
+
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <net/net_namespace.h>
+#include <net/genetlink.h>
+
+#include "../include/ipe.h"
+#include "../include/ipeDump.h"
+#include "../include/ipeAsync.h"
+#include "../include/ipeCmd.h"
+#include "../include/ipeStats.h"
+#include "../include/ipeTrace.h"
+
+typedef struct {
+        struct work_struct      work;
+        struct net             *net;    /* of sender */
+        u32                     portid;
+        u32                     seq;
+        u64                     start;  /* of request, for latency */
+        struct sk_buff         *reply;  /* is allocated before queueing */
+        ipe_batch_t            *batch;
+        int                    *retcode;
+} ipe_async_t;
+
+
+/* ordered: batches are applied one by one in order of queueing */
+static struct workqueue_struct *ipe_wq;
+
+static DECLARE_WAIT_QUEUE_HEAD(ipe_async_wait);
+static DEFINE_SPINLOCK(ipe_async_lock);
+static int ipe_async_ops;
+
+
+
+static bool async_reserve(const int count) {
+        bool ok;
+
+        spin_lock(&ipe_async_lock);
+        ok = ipe_async_ops + count <= IPE_ASYNC_MAX_OPS;
+        if (ok)
+                ipe_async_ops += count;
+        spin_unlock(&ipe_async_lock);
+
+        return ok;
+}
+
+static void async_unreserve(const int count) {
+        spin_lock(&ipe_async_lock);
+        ipe_async_ops -= count;
+        spin_unlock(&ipe_async_lock);
+
+        wake_up(&ipe_async_wait);
+}
+
+
+
+static void async_free(ipe_async_t *req) {
+        if (req->reply)
+                nlmsg_free(req->reply);
+        put_net(req->net);
+        kvfree(req->retcode);
+        kvfree(req->batch);
+        kfree(req);
+}
+
+
+static void async_complete(ipe_async_t *req) {
+        struct sk_buff *reply = req->reply;
+        void *hdr;
+        int err;
+
+        hdr = genlmsg_put(reply, req->portid, req->seq, &ipe_genl_family,
+                          0, IPE_CMD_BATCH);
+        if (!hdr || ipe_put_results(reply, req->batch, req->retcode)) {
+                printk(KERN_ERR "%s: results of %d operations don't fit into reply\n",
+                                                __FUNCTION__, req->batch->count);
+                return;
+        }
+
+        genlmsg_end(reply, hdr);
+
+        /* sender can be gone or its receive queue can be full */
+        req->reply = NULL;
+        err = genlmsg_unicast(req->net, reply, req->portid);
+        trace_ipe_reply(IPE_CMD_BATCH, req->portid, req->seq,
+                                       req->batch->count, err);
+        if (err)
+                pr_warn_ratelimited("%s: results for port %u seq %u are lost: %d\n",
+                                    __FUNCTION__, req->portid, req->seq, err);
+}
+
+
+static void async_work(struct work_struct *work) {
+        ipe_async_t *req = container_of(work, ipe_async_t, work);
+        int count = req->batch->count;
+        int res;
+
+        res = ipe_apply_batch(req->batch, req->retcode);
+        ipe_release_batch(req->batch);
+        ipe_stats_batch(req->batch, req->retcode, res, req->start);
+
+        async_complete(req);
+
+        async_free(req);
+        async_unreserve(count);
+}
+
+
+
+/*
+ * Queue validated @batch. On success @batch and @retcode are owned by 
+ * queue and freed after reply, else they stay with caller. Latency of
+ * batch is counted from @start, so it includes time into queue.
+ */
+int ipe_async_submit(ipe_batch_t *batch, int *retcode,
+                     struct genl_info *info, const u64 start)
+{
+        ipe_async_t *req;
+        int err;
+
+        req = kzalloc(sizeof(ipe_async_t), GFP_KERNEL);
+        if (!req)
+                return -ENOMEM;
+
+        req->reply = genlmsg_new(ipe_results_size(batch), GFP_KERNEL);
+        if (!req->reply) {
+                kfree(req);
+                return -ENOMEM;
+        }
+
+        /* backpressure: sender sleeps until queue has space */
+        err = wait_event_interruptible(ipe_async_wait, 
+                                       async_reserve(batch->count));
+        if (err) {
+                nlmsg_free(req->reply);
+                kfree(req);
+                return -EINTR;
+        }
+
+        INIT_WORK(&req->work, async_work);
+        req->net     = get_net(genl_info_net(info));
+        req->portid  = info->snd_portid;
+        req->seq     = info->snd_seq;
+        req->start   = start;
+        req->batch   = batch;
+        req->retcode = retcode;
+
+        queue_work(ipe_wq, &req->work);
+
+        return 0;
+}
+
+
+
+int ipe_async_init(void) {
+        ipe_wq = alloc_ordered_workqueue("ipe_async", 0);
+        return ipe_wq ? 0 : -ENOMEM;
+}
+
+/* Queued batches are applied and replied before exit */
+void ipe_async_exit(void) {
+        destroy_workqueue(ipe_wq);
+}
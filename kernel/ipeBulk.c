@@ -0,0 +1,1265 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Bulk operations over all VLAN children of one parent (real_dev).
+* Each of them walks vlan_info->grp of parent once and applies all changes
+* into one rtnl_lock critical section: renumber of VIDs, failover of
+* children to other parent, conversion of their ethertype and rename
+* (of children by pattern, or of any devices by list).
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/rtnetlink.h>
+#include <linux/bitmap.h>
+#include <linux/bsearch.h>
+#include <linux/sort.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeBulk.h"
+#include "../include/ipeOp.h"
+#include "../include/ipeEvent.h"
+#include "../include/ipeGroup.h"
+#include "../include/ipeTxn.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+extern ndev_t *get_dev(const ipe_nlmsg_t *msg, const int id);
+
+
+/* old VID -> new VID, 0 if VID is not changed */
+typedef struct {
+        u16             new_vid[VLAN_N_VID];
+        unsigned long   target[BITS_TO_LONGS(VLAN_N_VID)];
+} ipe_vid_table_t;
+
+/* VLAN child that will be moved into other slot of vlan_group */
+typedef struct {
+        ndev_t          *dev;
+        unsigned int     pidx;
+        u16              old_vid;
+        u16              new_vid;
+} ipe_vid_move_t;
+
+
+
+static int fill_vid_table(const ipe_vid_pair_t *map, const int count,
+                                          ipe_vid_table_t *table) 
+{
+        int i;
+
+        for (i = 0; i < count; ++i) {
+                u16 old_vid = map[i].old_vid;
+                u16 new_vid = map[i].new_vid;
+
+                if (!ipe_vid_valid(old_vid) || !ipe_vid_valid(new_vid)) {
+                        printk(KERN_WARNING "%s: bad pair %u -> %u\n",
+                                        __FUNCTION__, old_vid, new_vid);
+                        return IPE_BAD_VID;
+                }
+
+                if (table->new_vid[old_vid] ||
+                    test_and_set_bit(new_vid, table->target)) {
+                        printk(KERN_WARNING "%s: pair %u -> %u is ambiguous\n",
+                                        __FUNCTION__, old_vid, new_vid);
+                        return IPE_BAD_ARG;
+                }
+
+                if (old_vid != new_vid)
+                        table->new_vid[old_vid] = new_vid;
+        }
+
+        return IPE_OK;
+}
+
+
+/* Single walk over all parts of group, return number of moves */
+static int collect_vid_moves(struct vlan_group *grp,
+                             const ipe_vid_table_t *table,
+                             ipe_vid_move_t *moves)
+{
+        unsigned int pidx, part, i;
+        int nr = 0;
+
+        for (pidx = 0; pidx < IPE_GROUP_PROTOS; ++pidx) {
+                for (part = 0; part < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++part) {
+                        ndev_t **array = grp->vlan_devices_arrays[pidx][part];
+                        if (!array)
+                                continue;
+
+                        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                                u16 vid = part * VLAN_GROUP_ARRAY_PART_LEN + i;
+
+                                if (!array[i] || !table->new_vid[vid])
+                                        continue;
+
+                                moves[nr].dev     = array[i];
+                                moves[nr].pidx    = pidx;
+                                moves[nr].old_vid = vid;
+                                moves[nr].new_vid = table->new_vid[vid];
+                                ++nr;
+                        }
+                }
+        }
+
+        return nr;
+}
+
+
+/*
+ * New slot must be free or it's owner must be moved too.
+ * Allocate all required parts of group before changes.
+ */
+static int prepare_vid_moves(struct vlan_group *grp,
+                             const ipe_vid_table_t *table,
+                             const ipe_vid_move_t *moves, const int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                const ipe_vid_move_t *move = &moves[i];
+                ndev_t *owner = __vlan_group_get_device(grp, move->pidx,
+                                                        move->new_vid);
+
+                if (owner && !table->new_vid[move->new_vid]) {
+                        printk(KERN_WARNING "%s: VID %u already used by %s\n",
+                                   __FUNCTION__, move->new_vid, owner->name);
+                        return IPE_BAD_VID;
+                }
+
+                if (vlan_group_prealloc_vid(grp,
+                                            vlan_dev_priv(move->dev)->vlan_proto,
+                                            move->new_vid) < 0) {
+                        printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n",
+                                                           __FUNCTION__, grp);
+                        return IPE_BAD_ALLOC;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+/*
+ * Filters of new VIDs are added before any slot is changed, filters of
+ * old VIDs are deleted after all: VID that is both old and new (swap,
+ * shift) keeps its filter and real_dev is programmed with difference
+ * only. All or nothing, as renumber itself.
+ */
+static int add_vid_filters(ndev_t *real_dev,
+                           const ipe_vid_move_t *moves, const int nr)
+{
+        int err = 0;
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                __be16 proto = vlan_dev_priv(moves[i].dev)->vlan_proto;
+
+                err = vlan_vid_add(real_dev, proto, moves[i].new_vid);
+                if (err) {
+                        printk(KERN_ERR "%s: fail add filter of VID %u on %s: %d\n",
+                               __FUNCTION__, moves[i].new_vid, real_dev->name, err);
+                        break;
+                }
+        }
+
+        if (!err)
+                return IPE_OK;
+
+        while (i--)
+                vlan_vid_del(real_dev, vlan_dev_priv(moves[i].dev)->vlan_proto,
+                                                         moves[i].new_vid);
+
+        return err == -ENOMEM ? IPE_BAD_ALLOC : IPE_DEFAULT_FAIL;
+}
+
+
+static void del_vid_filters(ndev_t *real_dev,
+                            const ipe_vid_move_t *moves, const int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i)
+                vlan_vid_del(real_dev, vlan_dev_priv(moves[i].dev)->vlan_proto,
+                                                         moves[i].old_vid);
+}
+
+
+/* Can't fail: all slots are checked and preallocated */
+static void apply_vid_moves(struct vlan_group *grp,
+                            const ipe_vid_move_t *moves, const int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                struct vlan_dev_priv *vlan = vlan_dev_priv(moves[i].dev);
+
+                trace_ipe_slot_change(grp, vlan->vlan_proto, moves[i].old_vid,
+                                      moves[i].dev, NULL);
+                vlan_group_del_device(grp, vlan->vlan_proto, moves[i].old_vid);
+        }
+
+        for (i = 0; i < nr; ++i) {
+                struct vlan_dev_priv *vlan = vlan_dev_priv(moves[i].dev);
+
+                vlan->vlan_id = moves[i].new_vid;
+                trace_ipe_slot_change(grp, vlan->vlan_proto, moves[i].new_vid,
+                                      NULL, moves[i].dev);
+                vlan_group_set_device(grp, vlan->vlan_proto,
+                                      moves[i].new_vid, moves[i].dev);
+        }
+}
+
+
+/* Parts of group that moved children leave, for ipe_group_compact */
+static unsigned long vid_move_parts(const ipe_vid_move_t *moves, const int nr) {
+        unsigned long parts = 0;
+        int i;
+
+        for (i = 0; i < nr; ++i)
+                parts |= IPE_GROUP_PART(moves[i].pidx, moves[i].old_vid);
+
+        return parts;
+}
+
+
+/* IPE_CMD_EVENT for each moved child, must be called under rtnl_lock */
+static void notify_vid_moves(const ipe_vid_move_t *moves, const int nr) {
+        ipe_link_state_t old;
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                ipe_event_save(moves[i].dev, &old);
+                old.vid = moves[i].old_vid;
+                ipe_event_notify(moves[i].dev, &old, IPE_CMD_RENUMBER);
+        }
+}
+
+
+/*
+ * Renumber all VLAN children of parent (IPE_SRC of @msg) by @map of 
+ * @count pairs old VID -> new VID. All or nothing: if one of children 
+ * can't be moved, nothing changed. Takes rtnl_lock itself.
+ */
+int renumber_vids(const ipe_nlmsg_t *msg, const ipe_vid_pair_t *map,
+                                   const int count, int *moved)
+{
+        ipe_vid_table_t  *table;
+        ipe_vid_move_t   *moves;
+        struct vlan_info *vlan_info;
+        ndev_t *real_dev;
+        int nr;
+        int res;
+
+        *moved = 0;
+
+        table = kvzalloc(sizeof(ipe_vid_table_t), GFP_KERNEL);
+        if (!table)
+                return IPE_BAD_ALLOC;
+
+        res = fill_vid_table(map, count, table);
+        if (res)
+                goto free_table;
+
+        /* VID is unique into each proto of group */
+        moves = kvmalloc_array(count * IPE_GROUP_PROTOS,
+                               sizeof(ipe_vid_move_t), GFP_KERNEL);
+        if (!moves) {
+                res = IPE_BAD_ALLOC;
+                goto free_table;
+        }
+
+        ipe_rtnl_lock(IPE_CMD_RENUMBER);
+
+        real_dev = get_dev(msg, IPE_SRC);
+        if (IS_ERR_OR_NULL(real_dev)) {
+                printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
+                       __FUNCTION__, msg->ifindex[IPE_SRC], msg->nsfd[IPE_SRC]);
+                res = IPE_BAD_PTR;
+                goto unlock;
+        }
+
+        /* pinned before rtnl_lock */
+        res = ipe_op_verify(msg);
+        if (res)
+                goto put_dev;
+
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+        if (!vlan_info) {
+                printk(KERN_WARNING "%s: device %s has no VLAN children\n",
+                                                __FUNCTION__, real_dev->name);
+                res = IPE_BAD_DEV;
+                goto put_dev;
+        }
+
+        nr = collect_vid_moves(&vlan_info->grp, table, moves);
+
+        res = prepare_vid_moves(&vlan_info->grp, table, moves, nr);
+        if (res)
+                goto put_dev;
+
+        res = add_vid_filters(real_dev, moves, nr);
+        if (res)
+                goto put_dev;
+
+        apply_vid_moves(&vlan_info->grp, moves, nr);
+        del_vid_filters(real_dev, moves, nr);
+        notify_vid_moves(moves, nr);
+        ipe_group_compact(&vlan_info->grp, vid_move_parts(moves, nr));
+        *moved = nr;
+
+put_dev:
+        dev_put(real_dev);
+unlock:
+        ipe_rtnl_unlock(*moved);
+        kvfree(moves);
+free_table:
+        kvfree(table);
+
+        return res;
+}
+
+
+
+/* VLAN child of failover */
+typedef struct {
+        ndev_t          *dev;
+        __be16           proto;
+        u16              vid;
+        int              retcode;
+} ipe_child_t;
+
+
+/* Single walk over all parts of group, only count if @children is NULL */
+static int collect_children(struct vlan_group *grp, ipe_child_t *children) {
+        unsigned int pidx, part, i;
+        int nr = 0;
+
+        for (pidx = 0; pidx < IPE_GROUP_PROTOS; ++pidx) {
+                for (part = 0; part < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++part) {
+                        ndev_t **array = grp->vlan_devices_arrays[pidx][part];
+                        if (!array)
+                                continue;
+
+                        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                                if (!array[i])
+                                        continue;
+
+                                if (children) {
+                                        children[nr].dev   = array[i];
+                                        children[nr].proto = vlan_dev_priv(array[i])->vlan_proto;
+                                        children[nr].vid   = part * VLAN_GROUP_ARRAY_PART_LEN + i;
+                                }
+                                ++nr;
+                        }
+                }
+        }
+
+        return nr;
+}
+
+
+/*
+ * Filters and slots of all children are prepared on new parent before
+ * anybody is moved: frames of moved VLAN are accepted by new parent at
+ * once. Child that can't be moved gets own code, the rest -- IPE_OK.
+ */
+static void prepare_failover(ndev_t *new_real_dev, ipe_child_t *children,
+                                                   const int nr)
+{
+        struct vlan_info *dst_info;
+        int err;
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                ipe_child_t *child = &children[i];
+
+                /* new parent is this child or upper of it */
+                if (child->dev == new_real_dev ||
+                    netdev_has_upper_dev(child->dev, new_real_dev)) {
+                        child->retcode = IPE_BAD_DEV;
+                        continue;
+                }
+
+                if (vlan_find_dev(new_real_dev, child->proto, child->vid)) {
+                        printk(KERN_WARNING "%s: VID %u already used on %s\n",
+                               __FUNCTION__, child->vid, new_real_dev->name);
+                        child->retcode = IPE_BAD_VID;
+                        continue;
+                }
+
+                err = vlan_vid_add(new_real_dev, child->proto, child->vid);
+                if (err) {
+                        printk(KERN_ERR "%s: fail add filter of VID %u on %s: %d\n",
+                               __FUNCTION__, child->vid, new_real_dev->name, err);
+                        child->retcode = err == -ENOMEM ? IPE_BAD_ALLOC
+                                                        : IPE_DEFAULT_FAIL;
+                        continue;
+                }
+
+                /* vlan_vid_add took care of vlan_info */
+                dst_info = rtnl_dereference(new_real_dev->vlan_info);
+                if (vlan_group_prealloc_vid(&dst_info->grp, child->proto,
+                                                            child->vid) < 0) {
+                        printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n",
+                                                   __FUNCTION__, &dst_info->grp);
+                        vlan_vid_del(new_real_dev, child->proto, child->vid);
+                        child->retcode = IPE_BAD_ALLOC;
+                        continue;
+                }
+
+                child->retcode = IPE_OK;
+        }
+}
+
+
+/*
+ * The same changes as set_parent, filter and slot of new parent are
+ * prepared already. Filter of old parent is deleted by commit.
+ */
+static int move_child(ipe_txn_t *txn, ipe_child_t *child, ndev_t *real_dev,
+                                                          ndev_t *new_real_dev)
+{
+        struct vlan_info *src_info = rtnl_dereference(real_dev->vlan_info);
+        struct vlan_info *dst_info = rtnl_dereference(new_real_dev->vlan_info);
+        int res;
+
+        /* filters of children keep both of them */
+        BUG_ON(!src_info || !dst_info);
+
+        res = ipe_txn_reserve(txn, 6);
+        if (res)
+                return res;
+
+        if (ipe_txn_upper_link(txn, new_real_dev, child->dev) < 0)
+                return IPE_DEFAULT_FAIL;
+
+        ipe_txn_set_real_dev(txn, child->dev, new_real_dev);
+        ipe_txn_upper_unlink(txn, real_dev, child->dev);
+
+        ipe_txn_del_device(txn, &src_info->grp, child->proto, child->vid);
+        ipe_txn_set_device(txn, &dst_info->grp, child->proto, child->vid,
+                                                              child->dev);
+        ipe_txn_vid_del(txn, real_dev, child->proto, child->vid);
+
+        return IPE_OK;
+}
+
+
+/* Each child is moved completely or not at all, return number of moved */
+static int apply_failover(ndev_t *real_dev, ndev_t *new_real_dev,
+                          ipe_child_t *children, const int nr)
+{
+        ipe_link_state_t old;
+        ipe_txn_t txn;
+        int moved = 0;
+        int i;
+
+        ipe_txn_init(&txn);
+
+        for (i = 0; i < nr; ++i) {
+                ipe_child_t *child = &children[i];
+
+                if (child->retcode)
+                        continue;
+
+                ipe_event_save(child->dev, &old);
+
+                child->retcode = move_child(&txn, child, real_dev, new_real_dev);
+                if (child->retcode) {
+                        ipe_txn_rollback(&txn);
+                        vlan_vid_del(new_real_dev, child->proto, child->vid);
+                        continue;
+                }
+
+                ipe_txn_commit(&txn);
+                ipe_event_notify(child->dev, &old, IPE_CMD_FAILOVER);
+                moved++;
+        }
+
+        ipe_txn_destroy(&txn);
+
+        return moved;
+}
+
+
+/*
+ * Move all VLAN children of parent (IPE_SRC of @msg) to new parent
+ * (IPE_DST) into one rtnl_lock critical section. It isn't all or nothing:
+ * children that can't be moved stay on old parent and are reported into
+ * @result. Takes rtnl_lock itself.
+ */
+int failover_vlans(const ipe_nlmsg_t *msg, ipe_failover_t **result) {
+        ipe_failover_t   *failover = NULL;
+        ipe_child_t      *children = NULL;
+        struct vlan_info *vlan_info;
+        ndev_t *real_dev;
+        ndev_t *new_real_dev;
+        int moved = 0;
+        int nr = 0;
+        int res;
+        int i;
+
+        *result = NULL;
+
+        ipe_rtnl_lock(IPE_CMD_FAILOVER);
+
+        real_dev     = get_dev(msg, IPE_SRC);
+        new_real_dev = get_dev(msg, IPE_DST);
+        if (IS_ERR_OR_NULL(real_dev) || IS_ERR_OR_NULL(new_real_dev)) {
+                printk(KERN_WARNING "%s: fail search devices #%d and #%d\n",
+                       __FUNCTION__, msg->ifindex[IPE_SRC], msg->ifindex[IPE_DST]);
+                res = IPE_BAD_PTR;
+                goto put_dev;
+        }
+
+        /* pinned before rtnl_lock */
+        res = ipe_op_verify(msg);
+        if (res)
+                goto put_dev;
+
+        if (real_dev == new_real_dev) {
+                printk(KERN_WARNING "%s: device %s already parent\n",
+                                        __FUNCTION__, real_dev->name);
+                res = IPE_BAD_DEV;
+                goto put_dev;
+        }
+
+        /* the same for all children: checked once */
+        if (new_real_dev->features & NETIF_F_VLAN_CHALLENGED) {
+                printk(KERN_WARNING "%s: VLANs not supported on %s\n",
+                                        __FUNCTION__, new_real_dev->name);
+                res = IPE_BAD_DEV;
+                goto put_dev;
+        }
+
+        /* parent without VLAN children has nothing to move */
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+        if (vlan_info)
+                nr = collect_children(&vlan_info->grp, NULL);
+
+        res = IPE_BAD_ALLOC;
+        failover = kvzalloc(sizeof(ipe_failover_t) + nr * sizeof(ipe_failed_t),
+                                                                 GFP_KERNEL);
+        if (!failover)
+                goto put_dev;
+
+        if (nr) {
+                children = kvmalloc_array(nr, sizeof(ipe_child_t), GFP_KERNEL);
+                if (!children)
+                        goto put_dev;
+
+                collect_children(&vlan_info->grp, children);
+                prepare_failover(new_real_dev, children, nr);
+                moved = apply_failover(real_dev, new_real_dev, children, nr);
+        }
+
+        for (i = 0; i < nr; ++i) {
+                ipe_failed_t *failed = &failover->failed[failover->nr_failed];
+
+                if (!children[i].retcode)
+                        continue;
+
+                failed->ifindex = children[i].dev->ifindex;
+                failed->retcode = children[i].retcode;
+                failover->nr_failed++;
+        }
+
+        failover->moved = moved;
+        *result  = failover;
+        failover = NULL;
+        res      = IPE_OK;
+
+put_dev:
+        if (!IS_ERR_OR_NULL(new_real_dev))
+                dev_put(new_real_dev);
+        if (!IS_ERR_OR_NULL(real_dev))
+                dev_put(real_dev);
+        ipe_rtnl_unlock(moved);
+        kvfree(children);
+        kvfree(failover);
+
+        return res;
+}
+
+
+
+static int check_match(const ipe_match_t *match) {
+        if (match->proto && vlan_proto_idx(match->proto) == IPE_BAD_VLAN_PROTO) {
+                printk(KERN_WARNING "%s: bad VLAN ethertype: %x\n",
+                                        __FUNCTION__, ntohs(match->proto));
+                return IPE_BAD_VLAN_PROTO;
+        }
+
+        if (match->vid_min > match->vid_max) {
+                printk(KERN_WARNING "%s: bad VID range %u-%u\n",
+                       __FUNCTION__, match->vid_min, match->vid_max);
+                return IPE_BAD_VID;
+        }
+
+        return IPE_OK;
+}
+
+
+/* VLAN child that gets new ethertype, VID and parent are kept */
+typedef struct {
+        ndev_t          *dev;
+        __be16           old_proto;
+        u16              vid;
+} ipe_proto_move_t;
+
+
+/*
+ * Single walk over parts of group that intersect VID range, only count
+ * if @moves is NULL. Children of new ethertype are already converted.
+ */
+static int collect_proto_moves(struct vlan_group *grp,
+                               const ipe_convert_t *conv,
+                               ipe_proto_move_t *moves)
+{
+        unsigned int new_pidx = vlan_proto_idx(conv->proto);
+        unsigned int pidx, part, i;
+        int nr = 0;
+
+        for (pidx = 0; pidx < IPE_GROUP_PROTOS; ++pidx) {
+                if (pidx == new_pidx ||
+                    (conv->match.proto &&
+                     pidx != vlan_proto_idx(conv->match.proto)))
+                        continue;
+
+                for (part = 0; part < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++part) {
+                        ndev_t **array = grp->vlan_devices_arrays[pidx][part];
+                        if (!array)
+                                continue;
+
+                        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                                u16 vid = part * VLAN_GROUP_ARRAY_PART_LEN + i;
+
+                                if (!array[i] || vid < conv->match.vid_min ||
+                                                 vid > conv->match.vid_max)
+                                        continue;
+
+                                if (moves) {
+                                        moves[nr].dev       = array[i];
+                                        moves[nr].old_proto = vlan_dev_priv(array[i])->vlan_proto;
+                                        moves[nr].vid       = vid;
+                                }
+                                ++nr;
+                        }
+                }
+        }
+
+        return nr;
+}
+
+
+/*
+ * Slot of new ethertype must be free, and two children with the same VID
+ * (of different ethertypes) can't get it both. Allocate all required
+ * parts of group before changes.
+ */
+static int prepare_proto_moves(struct vlan_group *grp, const __be16 proto,
+                               const ipe_proto_move_t *moves, const int nr,
+                               unsigned long *taken)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                const ipe_proto_move_t *move = &moves[i];
+                ndev_t *owner = vlan_group_get_device(grp, proto, move->vid);
+
+                if (owner || test_and_set_bit(move->vid, taken)) {
+                        printk(KERN_WARNING "%s: VID %u with proto %x already used by %s\n",
+                               __FUNCTION__, move->vid, ntohs(proto),
+                               owner ? owner->name : move->dev->name);
+                        return IPE_BAD_VID;
+                }
+
+                if (vlan_group_prealloc_vid(grp, proto, move->vid) < 0) {
+                        printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n",
+                                                           __FUNCTION__, grp);
+                        return IPE_BAD_ALLOC;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+/*
+ * Filters of new ethertype are added for all children before any slot is
+ * changed and filters of old one are deleted after all, as renumber does:
+ * real_dev is switched between CTAG and STAG filters by one pass.
+ */
+static int add_proto_filters(ndev_t *real_dev, const __be16 proto,
+                             const ipe_proto_move_t *moves, const int nr)
+{
+        int err = 0;
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                err = vlan_vid_add(real_dev, proto, moves[i].vid);
+                if (err) {
+                        printk(KERN_ERR "%s: fail add filter of VID %u proto %x on %s: %d\n",
+                               __FUNCTION__, moves[i].vid, ntohs(proto),
+                               real_dev->name, err);
+                        break;
+                }
+        }
+
+        if (!err)
+                return IPE_OK;
+
+        while (i--)
+                vlan_vid_del(real_dev, proto, moves[i].vid);
+
+        return err == -ENOMEM ? IPE_BAD_ALLOC : IPE_DEFAULT_FAIL;
+}
+
+
+static void del_proto_filters(ndev_t *real_dev,
+                              const ipe_proto_move_t *moves, const int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i)
+                vlan_vid_del(real_dev, moves[i].old_proto, moves[i].vid);
+}
+
+
+/* Can't fail: all slots are checked and preallocated */
+static void apply_proto_moves(struct vlan_group *grp, const __be16 proto,
+                              const ipe_proto_move_t *moves, const int nr)
+{
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                struct vlan_dev_priv *vlan = vlan_dev_priv(moves[i].dev);
+
+                trace_ipe_slot_change(grp, moves[i].old_proto, moves[i].vid,
+                                      moves[i].dev, NULL);
+                vlan_group_del_device(grp, moves[i].old_proto, moves[i].vid);
+
+                vlan->vlan_proto = proto;
+                trace_ipe_slot_change(grp, proto, moves[i].vid,
+                                      NULL, moves[i].dev);
+                vlan_group_set_device(grp, proto, moves[i].vid, moves[i].dev);
+        }
+}
+
+
+/* Parts of group that converted children leave, for ipe_group_compact */
+static unsigned long proto_move_parts(const ipe_proto_move_t *moves,
+                                      const int nr)
+{
+        unsigned long parts = 0;
+        int i;
+
+        for (i = 0; i < nr; ++i)
+                parts |= IPE_GROUP_PART(vlan_proto_idx(moves[i].old_proto),
+                                        moves[i].vid);
+
+        return parts;
+}
+
+
+/* IPE_CMD_EVENT for each converted child, must be called under rtnl_lock */
+static void notify_proto_moves(const ipe_proto_move_t *moves, const int nr) {
+        ipe_link_state_t old;
+        int i;
+
+        for (i = 0; i < nr; ++i) {
+                ipe_event_save(moves[i].dev, &old);
+                old.proto = ntohs(moves[i].old_proto);
+                ipe_event_notify(moves[i].dev, &old, IPE_CMD_CONVERT);
+        }
+}
+
+
+/*
+ * Set ethertype @conv->proto to all VLAN children of parent (IPE_SRC of
+ * @msg) that are matched by @conv->match.
+ * All or nothing, as renumber. Takes rtnl_lock itself.
+ */
+int convert_vlans(const ipe_nlmsg_t *msg, const ipe_convert_t *conv,
+                                          int *converted)
+{
+        ipe_proto_move_t *moves = NULL;
+        struct vlan_info *vlan_info;
+        unsigned long    *taken;
+        ndev_t *real_dev;
+        int nr;
+        int res;
+
+        *converted = 0;
+
+        /* QinQ ethertypes have no slots in vlan_group of mainline 8021q */
+        if (!ipe_proto_in_group(conv->proto)) {
+                printk(KERN_WARNING "%s: bad VLAN ethertype: %x\n",
+                                        __FUNCTION__, ntohs(conv->proto));
+                return IPE_BAD_VLAN_PROTO;
+        }
+
+        res = check_match(&conv->match);
+        if (res)
+                return res;
+
+        taken = kcalloc(BITS_TO_LONGS(VLAN_N_VID), sizeof(unsigned long),
+                                                           GFP_KERNEL);
+        if (!taken)
+                return IPE_BAD_ALLOC;
+
+        ipe_rtnl_lock(IPE_CMD_CONVERT);
+
+        real_dev = get_dev(msg, IPE_SRC);
+        if (IS_ERR_OR_NULL(real_dev)) {
+                printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
+                       __FUNCTION__, msg->ifindex[IPE_SRC], msg->nsfd[IPE_SRC]);
+                res = IPE_BAD_PTR;
+                goto unlock;
+        }
+
+        /* pinned before rtnl_lock */
+        res = ipe_op_verify(msg);
+        if (res)
+                goto put_dev;
+
+        /* parent without VLAN children has nothing to convert */
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+        if (!vlan_info)
+                goto put_dev;
+
+        nr = collect_proto_moves(&vlan_info->grp, conv, NULL);
+        if (!nr)
+                goto put_dev;
+
+        moves = kvmalloc_array(nr, sizeof(ipe_proto_move_t), GFP_KERNEL);
+        if (!moves) {
+                res = IPE_BAD_ALLOC;
+                goto put_dev;
+        }
+
+        collect_proto_moves(&vlan_info->grp, conv, moves);
+
+        res = prepare_proto_moves(&vlan_info->grp, conv->proto, moves, nr, taken);
+        if (res)
+                goto put_dev;
+
+        res = add_proto_filters(real_dev, conv->proto, moves, nr);
+        if (res)
+                goto put_dev;
+
+        apply_proto_moves(&vlan_info->grp, conv->proto, moves, nr);
+        del_proto_filters(real_dev, moves, nr);
+        notify_proto_moves(moves, nr);
+        ipe_group_compact(&vlan_info->grp, proto_move_parts(moves, nr));
+        *converted = nr;
+
+put_dev:
+        dev_put(real_dev);
+unlock:
+        ipe_rtnl_unlock(*converted);
+        kvfree(moves);
+        kfree(taken);
+
+        return res;
+}
+
+
+
+/*
+ * Device of rename set. Each target name is owned by at most one other
+ * device of set and each old name is waited by at most one, so set is
+ * chains and cycles: @wait is rename that must vacate target first and
+ * @next is rename that waits for old name of this one, -1 is none.
+ */
+typedef struct {
+        ndev_t          *dev;
+        char             name[IFNAMSIZ];
+        int              wait;
+        int              next;
+        bool             done;
+        ipe_link_state_t old;
+} ipe_rename_t;
+
+/* (netns, name) of sorted index of set */
+typedef struct {
+        struct net       *net;
+        const char       *name;
+        int               idx;
+} ipe_name_key_t;
+
+/* Temporary name of device that breaks cycle of renames */
+#define IPE_RENAME_TMP          "ipetmp%d"
+
+
+static int cmp_name_key(const void *a, const void *b) {
+        const ipe_name_key_t *ka = a;
+        const ipe_name_key_t *kb = b;
+
+        if (ka->net != kb->net)
+                return ka->net < kb->net ? -1 : 1;
+
+        return strcmp(ka->name, kb->name);
+}
+
+
+/* Exactly one "%d" and nothing else for format */
+static bool valid_pattern(const char *pattern) {
+        const char *p = strchr(pattern, '%');
+
+        return p && p[1] == 'd' && !strchr(p + 2, '%');
+}
+
+
+/* Index of @nr keys sorted by cmp_name_key, duplicate is ambiguous */
+static int sort_names(ipe_name_key_t *keys, const int nr) {
+        int i;
+
+        sort(keys, nr, sizeof(ipe_name_key_t), cmp_name_key, NULL);
+
+        for (i = 1; i < nr; ++i) {
+                if (!cmp_name_key(&keys[i - 1], &keys[i])) {
+                        printk(KERN_WARNING "%s: name %s is given twice\n",
+                                                __FUNCTION__, keys[i].name);
+                        return IPE_BAD_ARG;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+/*
+ * All checks are done before the first change: new names are valid and
+ * different, each device is given once, and target is free or owned by
+ * device of set that is renamed too. Chains of set are linked.
+ */
+static int prepare_renames(ipe_rename_t *renames, const int nr,
+                                               ipe_name_key_t *keys)
+{
+        ipe_name_key_t *by_old = keys;
+        ipe_name_key_t *by_new = keys + nr;
+        int i;
+        int res;
+
+        for (i = 0; i < nr; ++i) {
+                ipe_rename_t *r = &renames[i];
+
+                if (!dev_valid_name(r->name) || strchr(r->name, '%')) {
+                        printk(KERN_WARNING "%s: bad name %s for %s\n",
+                                        __FUNCTION__, r->name, r->dev->name);
+                        return IPE_BAD_ARG;
+                }
+
+                by_old[i] = (ipe_name_key_t) { dev_net(r->dev), r->dev->name, i };
+                by_new[i] = (ipe_name_key_t) { dev_net(r->dev), r->name, i };
+                r->wait = -1;
+                r->next = -1;
+                r->done = false;
+        }
+
+        res = sort_names(by_old, nr);
+        if (!res)
+                res = sort_names(by_new, nr);
+        if (res)
+                return res;
+
+        for (i = 0; i < nr; ++i) {
+                ipe_rename_t *r = &renames[i];
+                ipe_name_key_t key = { dev_net(r->dev), r->name, i };
+                ipe_name_key_t *owner;
+
+                owner = bsearch(&key, by_old, nr, sizeof(ipe_name_key_t),
+                                                          cmp_name_key);
+                if (owner && owner->idx == i) {
+                        r->done = true;         /* name isn't changed */
+                } else if (owner) {
+                        r->wait = owner->idx;
+                        renames[owner->idx].next = i;
+                } else if (__dev_get_by_name(key.net, r->name)) {
+                        printk(KERN_WARNING "%s: name %s of %s is used\n",
+                                        __FUNCTION__, r->name, r->dev->name);
+                        return IPE_BAD_ARG;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+static int rename_one(ipe_txn_t *txn, ipe_rename_t *r, const char *name) {
+        int err = ipe_txn_set_name(txn, r->dev, name);
+
+        if (!err)
+                return IPE_OK;
+
+        printk(KERN_ERR "%s: fail rename %s to %s: %d\n",
+                        __FUNCTION__, r->dev->name, name, err);
+
+        switch (err) {
+        case -EBUSY:            /* device is up */
+                return IPE_BAD_DEV;
+        case -ENOMEM:
+                return IPE_BAD_ALLOC;
+        default:
+                return IPE_DEFAULT_FAIL;
+        }
+}
+
+
+/*
+ * Chain is applied from its head, that has free target: each rename
+ * vacates target of the next one. Each cycle is broken by temporary name
+ * of one device. Caller rolls @txn back on failure.
+ */
+static int apply_renames(ipe_txn_t *txn, ipe_rename_t *renames, const int nr) {
+        int res;
+        int i, j;
+
+        res = ipe_txn_reserve(txn, nr + nr / 2);
+        if (res)
+                return res;
+
+        for (i = 0; i < nr; ++i) {
+                if (renames[i].done || renames[i].wait >= 0)
+                        continue;
+
+                for (j = i; j >= 0; j = renames[j].next) {
+                        res = rename_one(txn, &renames[j], renames[j].name);
+                        if (res)
+                                return res;
+                        renames[j].done = true;
+                }
+        }
+
+        for (i = 0; i < nr; ++i) {
+                if (renames[i].done)
+                        continue;
+
+                res = rename_one(txn, &renames[i], IPE_RENAME_TMP);
+                for (j = renames[i].next; !res && j != i; j = renames[j].next) {
+                        res = rename_one(txn, &renames[j], renames[j].name);
+                        renames[j].done = true;
+                }
+                if (!res)
+                        res = rename_one(txn, &renames[i], renames[i].name);
+                if (res)
+                        return res;
+                renames[i].done = true;
+        }
+
+        return IPE_OK;
+}
+
+
+/*
+ * Rename all devices of set into one undo log: all or nothing. Must be
+ * called under rtnl_lock, devices are verified. Number of devices that
+ * got new name is returned into *@renamed.
+ */
+static int exec_renames(ipe_rename_t *renames, const int nr, int *renamed) {
+        ipe_name_key_t *keys;
+        ipe_txn_t txn;
+        int res;
+        int i;
+
+        keys = kvmalloc_array(2 * nr, sizeof(ipe_name_key_t), GFP_KERNEL);
+        if (!keys)
+                return IPE_BAD_ALLOC;
+
+        res = prepare_renames(renames, nr, keys);
+        kvfree(keys);
+        if (res)
+                return res;
+
+        for (i = 0; i < nr; ++i)
+                ipe_event_save(renames[i].dev, &renames[i].old);
+
+        ipe_txn_init(&txn);
+
+        res = apply_renames(&txn, renames, nr);
+        if (res) {
+                ipe_txn_rollback(&txn);
+                goto destroy_txn;
+        }
+
+        ipe_txn_commit(&txn);
+
+        for (i = 0; i < nr; ++i) {
+                if (strcmp(renames[i].old.ifname, renames[i].dev->name)) {
+                        ipe_event_notify(renames[i].dev, &renames[i].old,
+                                                         IPE_CMD_RENAME);
+                        ++*renamed;
+                }
+        }
+
+destroy_txn:
+        ipe_txn_destroy(&txn);
+
+        return res;
+}
+
+
+
+/* Single walk over all parts of group, only count if @renames is NULL */
+static int collect_renames(struct vlan_group *grp, const ipe_match_t *match,
+                           const char *pattern, ipe_rename_t *renames)
+{
+        unsigned int pidx, part, i;
+        int nr = 0;
+
+        for (pidx = 0; pidx < IPE_GROUP_PROTOS; ++pidx) {
+                if (match->proto && pidx != vlan_proto_idx(match->proto))
+                        continue;
+
+                for (part = 0; part < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++part) {
+                        ndev_t **array = grp->vlan_devices_arrays[pidx][part];
+                        if (!array)
+                                continue;
+
+                        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                                u16 vid = part * VLAN_GROUP_ARRAY_PART_LEN + i;
+
+                                if (!array[i] || vid < match->vid_min ||
+                                                 vid > match->vid_max)
+                                        continue;
+
+                                if (renames) {
+                                        renames[nr].dev = array[i];
+                                        snprintf(renames[nr].name, IFNAMSIZ,
+                                                             pattern, vid);
+                                }
+                                ++nr;
+                        }
+                }
+        }
+
+        return nr;
+}
+
+
+/*
+ * Name @pattern with VID instead of "%d" to all VLAN children of parent
+ * (IPE_SRC of @msg) that are matched by @match. All or nothing: name
+ * collision is found before the first rename. Takes rtnl_lock itself.
+ */
+int rename_vlans(const ipe_nlmsg_t *msg, const char *pattern,
+                 const ipe_match_t *match, int *renamed)
+{
+        ipe_rename_t *renames = NULL;
+        struct vlan_info *vlan_info;
+        ndev_t *real_dev;
+        int nr;
+        int res;
+
+        *renamed = 0;
+
+        /* name of the largest VID must fit */
+        if (!valid_pattern(pattern) ||
+            snprintf(NULL, 0, pattern, VLAN_VID_MASK) >= IFNAMSIZ) {
+                printk(KERN_WARNING "%s: bad pattern %s\n", __FUNCTION__, pattern);
+                return IPE_BAD_ARG;
+        }
+
+        res = check_match(match);
+        if (res)
+                return res;
+
+        ipe_rtnl_lock(IPE_CMD_RENAME);
+
+        real_dev = get_dev(msg, IPE_SRC);
+        if (IS_ERR_OR_NULL(real_dev)) {
+                printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
+                       __FUNCTION__, msg->ifindex[IPE_SRC], msg->nsfd[IPE_SRC]);
+                res = IPE_BAD_PTR;
+                goto unlock;
+        }
+
+        /* pinned before rtnl_lock */
+        res = ipe_op_verify(msg);
+        if (res)
+                goto put_dev;
+
+        /* parent without VLAN children has nothing to rename */
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+        if (!vlan_info)
+                goto put_dev;
+
+        nr = collect_renames(&vlan_info->grp, match, pattern, NULL);
+        if (!nr)
+                goto put_dev;
+
+        renames = kvmalloc_array(nr, sizeof(ipe_rename_t), GFP_KERNEL);
+        if (!renames) {
+                res = IPE_BAD_ALLOC;
+                goto put_dev;
+        }
+
+        collect_renames(&vlan_info->grp, match, pattern, renames);
+        res = exec_renames(renames, nr, renamed);
+
+put_dev:
+        dev_put(real_dev);
+unlock:
+        ipe_rtnl_unlock(*renamed);
+        kvfree(renames);
+
+        return res;
+}
+
+
+/*
+ * IPE_CMD_SET_NAME operations of @batch, that is prepared by
+ * ipe_check_batch, as one set: swap of names is possible, unlike
+ * atomic batch. Takes rtnl_lock itself.
+ */
+int rename_list(const ipe_batch_t *batch, int *renamed) {
+        ipe_rename_t *renames;
+        int res = IPE_OK;
+        int i;
+
+        *renamed = 0;
+
+        renames = kvmalloc_array(batch->count, sizeof(ipe_rename_t), GFP_KERNEL);
+        if (!renames)
+                return IPE_BAD_ALLOC;
+
+        ipe_rtnl_lock(IPE_CMD_RENAME);
+
+        for (i = 0; i < batch->count && !res; ++i) {
+                const ipe_nlmsg_t *msg = &batch->ops[i];
+
+                BUG_ON(msg->command != IPE_CMD_SET_NAME);
+
+                res = ipe_op_verify(msg);
+                renames[i].dev = msg->dev[IPE_SRC];
+                strlcpy(renames[i].name, msg->ifname, IFNAMSIZ);
+        }
+
+        if (!res)
+                res = exec_renames(renames, batch->count, renamed);
+
+        ipe_rtnl_unlock(*renamed);
+        kvfree(renames);
+
+        return res;
+}
@@ -0,0 +1,693 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Commands of ipe: checkers and handlers of commap, execution of
+* operation and batch under rtnl_lock with undo log. Netlink is parsed and
+* replied by ipeDrv.c, so this file depends on net_device and vlan_group
+* only and is built by userspace simulator too (test/sim).
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/rtnetlink.h>
+#include <linux/rcupdate.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeDebug.h"
+#include "../include/ipeTxn.h"
+#include "../include/ipeName.h"
+#include "../include/ipeNet.h"
+#include "../include/ipeOp.h"
+#include "../include/ipeEvent.h"
+#include "../include/ipeCmd.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+
+
+static int set_vid(const ipe_nlmsg_t *msg, ipe_txn_t *txn);
+static int set_eth(const ipe_nlmsg_t *msg, ipe_txn_t *txn);
+static int set_name(const ipe_nlmsg_t *msg, ipe_txn_t *txn);
+static int set_parent(const ipe_nlmsg_t *msg, ipe_txn_t *txn);
+
+extern int print_list_ndev(const ipe_nlmsg_t *msg);
+
+static int check_eth(const ipe_nlmsg_t *msg);
+static int check_vid(const ipe_nlmsg_t *msg);
+static int check_src(const ipe_nlmsg_t *msg);
+static int check_src_vlan(const ipe_nlmsg_t *msg);
+static int dummy(const ipe_nlmsg_t *msg);
+//static int check_ifname(const ipe_nlmsg_t *msg);
+static int check_parent(const ipe_nlmsg_t *msg);
+
+
+
+/* Indexed by IPE_CMD_*, commands without name are not operations */
+static ipe_tool_t commap[IPE_CMD_MAX + 1] = {
+        [IPE_CMD_SET_VID] = {NULL, "set_vid", check_vid, set_vid,
+                        IPE_ATTR_BIT(IPE_ATTR_SRC) | IPE_ATTR_BIT(IPE_ATTR_VALUE)},
+        [IPE_CMD_SET_ETH] = {NULL, "set_eth", check_eth, set_eth,
+                        IPE_ATTR_BIT(IPE_ATTR_SRC) | IPE_ATTR_BIT(IPE_ATTR_VALUE)},
+        /* debug: */
+        #ifdef IPE_DEBUG
+        [IPE_CMD_SHOW] = {show_vlan_info, "show_vlan_info", check_src_vlan, NULL,
+                        IPE_ATTR_BIT(IPE_ATTR_SRC)},
+        [IPE_CMD_LIST] = {print_list_ndev, "print_list_ndev", dummy, NULL, 0},
+        #endif
+        [IPE_CMD_SET_NAME] = {NULL, "set_name", check_src, set_name,
+                        IPE_ATTR_BIT(IPE_ATTR_SRC) | IPE_ATTR_BIT(IPE_ATTR_IFNAME)},
+        [IPE_CMD_SET_PARENT] = {NULL, "set_parent", check_parent, set_parent,
+                        IPE_ATTR_BIT(IPE_ATTR_SRC) | IPE_ATTR_BIT(IPE_ATTR_DST)},
+};
+
+
+
+int ipe_check_command(const ipe_nlmsg_t *msg) {
+        int command = msg->command;
+
+        if (command <= IPE_CMD_UNSPEC || command > IPE_CMD_MAX || 
+            !commap[command].name) {
+                printk(KERN_ERR "%s: bad command #%d!\n",
+                                        __FUNCTION__, command);
+                return IPE_UNKNOWN_COMMAND;
+        }
+
+        return IPE_OK;
+}
+
+/* Tool of command, that is checked by ipe_check_command already */
+const ipe_tool_t *ipe_tool(const int command) {
+        return &commap[command];
+}
+
+
+
+/*
+ * Context of operation: namespaces and devices are resolved and pinned
+ * once, checker runs under RCU before rtnl_lock. Must be paired with
+ * ipe_op_release, even on failure.
+ */
+int ipe_prepare_op(ipe_nlmsg_t *msg, ipe_name_cache_t *cache) {
+        int res;
+
+        trace_ipe_op_start(msg);
+
+        res = ipe_resolve_net(msg);
+        if (!res)
+                res = ipe_resolve_names(msg, cache);
+        if (!res)
+                res = ipe_op_pin(msg);
+        if (!res) {
+                rcu_read_lock();
+                res = commap[(int)msg->command].checker(msg);
+                rcu_read_unlock();
+        }
+
+        if (res)
+                trace_ipe_op_end(msg, res);
+
+        return res;
+}
+
+
+/* Must be called under rtnl_lock: devices are checked already */
+static int exec_op(ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+        int res = ipe_op_verify(msg);
+
+        if (!res) {
+                if (msg->dev[IPE_SRC])
+                        ipe_event_save(msg->dev[IPE_SRC], &msg->old);
+
+                res = commap[(int)msg->command].txn_handler(msg, txn);
+        }
+
+        trace_ipe_op_end(msg, res);
+
+        return res;
+}
+
+
+/* 
+ * Must be called under rtnl_lock. Changes of failed operation are 
+ * rolled back, so operation is applied completely or not at all.
+ */
+int ipe_exec_txn(ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+        int res = exec_op(msg, txn);
+
+        if (res) {
+                ipe_txn_rollback(txn);
+        } else {
+                ipe_txn_commit(txn);
+                ipe_event_op(msg);
+        }
+
+        return res;
+}
+
+
+/* Value of @state that @command changes */
+static u32 state_value(const ipe_link_state_t *state, const int command) {
+        switch (command) {
+        case IPE_CMD_SET_VID:
+                return state->vid;
+        case IPE_CMD_SET_ETH:
+                return state->proto;
+        case IPE_CMD_SET_PARENT:
+                return state->parent;
+        }
+
+        return 0;
+}
+
+
+/*
+ * Entry of IPE_ATTR_STATUS for operation @index of batch that's done with
+ * @code: old value is saved by exec_op, new one is taken from request.
+ */
+void ipe_op_status(const ipe_nlmsg_t *msg, const int index, const int code,
+                                           struct ipe_op_status *status)
+{
+        status->index     = index;
+        status->code      = code;
+        status->ifindex   = msg->ifindex[IPE_SRC];
+        status->old_value = state_value(&msg->old, msg->command);
+        status->new_value = status->old_value;
+
+        if (code != IPE_OK)
+                return;
+
+        switch (msg->command) {
+        case IPE_CMD_SET_VID:
+        case IPE_CMD_SET_ETH:
+                status->new_value = msg->value;
+                break;
+        case IPE_CMD_SET_PARENT:
+                status->new_value = msg->ifindex[IPE_DST];
+                break;
+        }
+}
+
+
+
+/*
+ * Validate all operations of batch before apply anybody. If one of them
+ * is bad, nothing applied: bad operations get own exit code, 
+ * other -- IPE_SKIPPED.
+ */
+int ipe_check_batch(ipe_batch_t *batch, int *retcode,
+                    ipe_name_cache_t *cache)
+{
+        int res = IPE_OK;
+        int i;
+
+        for (i = 0; i < batch->count; ++i) {
+                ipe_nlmsg_t *msg = &batch->ops[i];
+
+                retcode[i] = ipe_check_command(msg);
+                if (retcode[i] == IPE_OK && !commap[(int)msg->command].txn_handler) {
+                        printk(KERN_WARNING "%s: command %s can't be batched!\n",
+                                   __FUNCTION__, commap[(int)msg->command].name);
+                        retcode[i] = IPE_BAD_ARG;
+                }
+
+                if (retcode[i] == IPE_OK)
+                        retcode[i] = ipe_prepare_op(msg, cache);
+
+                if (retcode[i] != IPE_OK)
+                        res = retcode[i];
+        }
+
+        if (res == IPE_OK)
+                return IPE_OK;
+
+        for (i = 0; i < batch->count; ++i) {
+                if (retcode[i] == IPE_OK)
+                        retcode[i] = IPE_SKIPPED;
+        }
+
+        return res;
+}
+
+
+/*
+ * All operations into one undo log: on the first failure all applied
+ * operations are rolled back (IPE_ROLLED_BACK), rest -- IPE_SKIPPED.
+ * Must be called under rtnl_lock.
+ */
+static int exec_batch_atomic(ipe_batch_t *batch, int *retcode,
+                                             ipe_txn_t *txn)
+{
+        int res = IPE_OK;
+        int i, j;
+
+        for (i = 0; i < batch->count; ++i) {
+                res = exec_op(&batch->ops[i], txn);
+                retcode[i] = res;
+                if (res)
+                        break;
+        }
+
+        if (res == IPE_OK) {
+                ipe_txn_commit(txn);
+                for (j = 0; j < batch->count; ++j)
+                        ipe_event_op(&batch->ops[j]);
+                return IPE_OK;
+        }
+
+        ipe_txn_rollback(txn);
+        for (j = 0; j < batch->count; ++j) {
+                if (j < i)
+                        retcode[j] = IPE_ROLLED_BACK;
+                else if (j > i)
+                        retcode[j] = IPE_SKIPPED;
+        }
+
+        return res;
+}
+
+
+/*
+ * Apply all operations of prepared batch under one rtnl_lock. Exit code
+ * of each operation is written into @retcode.
+ */
+int ipe_apply_batch(ipe_batch_t *batch, int *retcode) {
+        ipe_txn_t txn;
+        int res = IPE_OK;
+        int i;
+
+        ipe_txn_init(&txn);
+
+        ipe_rtnl_lock(IPE_CMD_BATCH);
+        if (batch->flags & IPE_BATCH_ATOMIC) {
+                res = exec_batch_atomic(batch, retcode, &txn);
+        } else {
+                for (i = 0; i < batch->count; ++i) {
+                        retcode[i] = ipe_exec_txn(&batch->ops[i], &txn);
+                        if (retcode[i] != IPE_OK)
+                                res = retcode[i];
+                }
+        }
+        ipe_rtnl_unlock(batch->count);
+
+        ipe_txn_destroy(&txn);
+
+        return res;
+}
+
+
+void ipe_release_batch(ipe_batch_t *batch) {
+        int i;
+
+        for (i = 0; i < batch->count; ++i)
+                ipe_op_release(&batch->ops[i]);
+}
+
+
+static int check_vid(const ipe_nlmsg_t *msg) {
+
+        int ret = check_src_vlan(msg);
+        if (ret != IPE_OK) 
+                return ret;
+
+        if (msg->value >= VLAN_N_VID || msg->value < 0) {
+                printk(KERN_WARNING "%s: try set bad VID %d\n", 
+                                                __FUNCTION__, msg->value);
+                return IPE_BAD_VID;
+        }
+
+        /* 0 and 4095 */
+        if (!ipe_vid_valid(msg->value)) {
+                printk(KERN_WARNING "%s: this VID [%d] is reserved!\n", 
+                                        __FUNCTION__, msg->value);
+                return IPE_BAD_VID;
+        }
+
+        return IPE_OK;
+}
+
+static int check_eth(const ipe_nlmsg_t *msg) {
+        int ret = check_src_vlan(msg);
+        if (ret != IPE_OK) 
+                return ret;
+
+        /* QinQ ethertypes have no slots in vlan_group of mainline 8021q */
+        if (!ipe_proto_in_group(htons(msg->value))) {
+                printk(KERN_WARNING "%s: try set bad VLAN ethertype: %x\n",
+                                              __FUNCTION__, msg->value);
+                return IPE_BAD_VLAN_PROTO;
+        }
+
+        return IPE_OK;
+}
+
+static int dummy(const ipe_nlmsg_t *msg) {
+        return IPE_OK;
+}
+
+/*
+ * Checkers are called under RCU, devices are pinned by ipe_op_pin. Only
+ * what can't change is checked here: VIDs and parents are checked by
+ * handlers, because previous operations of batch can change them.
+ */
+static int check_dev(const ipe_nlmsg_t *msg, const int id) {
+        if (!msg->dev[id]) {
+                printk(KERN_WARNING "%s: device #%d isn't given\n",
+                                                __FUNCTION__, id);
+                return IPE_BAD_PTR;
+        }
+
+        return IPE_OK;
+}
+
+static int check_vlan(const ipe_nlmsg_t *msg, const int id) {
+        int res = check_dev(msg, id);
+        if (res)
+                return res;
+ 
+        if (!is_vlan_dev(msg->dev[id])) {
+                printk(KERN_WARNING "%s: device %s is not vlan type!\n", 
+                                                __FUNCTION__, msg->dev[id]->name);
+                return IPE_BAD_DEV;
+        }
+
+        return IPE_OK;
+}
+
+
+static int check_src(const ipe_nlmsg_t *msg) {
+        return check_dev(msg, IPE_SRC);
+}
+
+static int check_src_vlan(const ipe_nlmsg_t *msg) {
+        return check_vlan(msg, IPE_SRC);
+}
+
+/* New parent is any device, physical or VLAN, as for failover */
+static int check_parent(const ipe_nlmsg_t *msg) {
+        int res = check_src_vlan(msg);
+        if (!res)
+                res = check_dev(msg, IPE_DST);
+        if (res)
+                return res;
+
+        if (msg->dev[IPE_SRC] == msg->dev[IPE_DST]) {
+                printk(KERN_ERR "%s: u try set self as parent!\n", 
+                                __FUNCTION__);
+                return IPE_BAD_DEV;
+        }
+
+        return IPE_OK;
+}
+
+
+/* Must be called under rtnl lock */
+static ndev_t *unsafe_get_real_dev(ndev_t *dev) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        BUG_ON(!vlan);
+        return vlan->real_dev;
+}
+
+/* 
+ * commap handlers with undo log: must be called under rtnl_lock.
+ * Devices are pinned and verified by ipe_op_verify, but parent and VIDs
+ * can change between checker and handler, so check them again.
+ * Every change goes through ipe_txn_* for rollback on failure.
+ */
+static int set_name(const ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+        ndev_t *dev = msg->dev[IPE_SRC];
+        int res = ipe_txn_reserve(txn, 1);
+        int err;
+
+        if (res)
+                return res;
+
+        err = ipe_txn_set_name(txn, dev, msg->ifname);
+        if (!err)
+                return IPE_OK;
+
+        printk(KERN_WARNING "%s: fail rename %s to %s: %d\n",
+                        __FUNCTION__, dev->name, msg->ifname, err);
+
+        switch (err) {
+        case -EEXIST:
+        case -EINVAL:
+                return IPE_BAD_ARG;
+        case -EBUSY:            /* device is up */
+                return IPE_BAD_DEV;
+        case -ENOMEM:
+                return IPE_BAD_ALLOC;
+        default:
+                return IPE_DEFAULT_FAIL;
+        }
+}
+
+
+
+/*
+ * Filter of new VID is added before slot is changed: frames come to
+ * VLAN by both VIDs till commit deletes filter of old one.
+ */
+static int add_vid_filter(ipe_txn_t *txn, ndev_t *real_dev,
+                                          __be16 proto, u16 vid)
+{
+        int err = ipe_txn_vid_add(txn, real_dev, proto, vid);
+        if (!err)
+                return IPE_OK;
+
+        printk(KERN_ERR "%s: fail add filter of VID %d proto %x on %s: %d\n",
+                       __FUNCTION__, vid, ntohs(proto), real_dev->name, err);
+
+        return err == -ENOMEM ? IPE_BAD_ALLOC : IPE_DEFAULT_FAIL;
+}
+
+
+
+static int set_vid(const ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+        int res = IPE_DEFAULT_FAIL;
+
+        ndev_t *vlan_dev = msg->dev[IPE_SRC];
+        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
+
+        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
+        BUG_ON(!vlan);
+
+
+        int old_vlan_id  = vlan->vlan_id;
+
+        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
+        /* vlan_info should be there now. vlan_vid_add took care of it */
+        BUG_ON(!vlan_info);
+
+
+        struct vlan_group *grp = &vlan_info->grp;
+        if (vlan_group_get_device(grp, vlan->vlan_proto, msg->value)) {
+                printk(KERN_WARNING "%s: VID %d already used on %s!\n", 
+                                       __FUNCTION__, msg->value, real_dev->name);
+                return IPE_BAD_VID;
+        }
+
+        if (vlan_group_prealloc_vid(grp, vlan->vlan_proto, msg->value) < 0) {
+                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
+                                                           __FUNCTION__, grp);
+                return IPE_BAD_ALLOC;
+        }
+
+        res = ipe_txn_reserve(txn, 5);
+        if (res)
+                return res;
+
+        res = add_vid_filter(txn, real_dev, vlan->vlan_proto, msg->value);
+        if (res)
+                return res;
+
+        ipe_txn_del_device(txn, grp, vlan->vlan_proto, old_vlan_id);
+        ipe_txn_set_vid(txn, vlan_dev, msg->value);
+        ipe_txn_set_device(txn, grp, vlan->vlan_proto, vlan->vlan_id, vlan_dev);
+        ipe_txn_vid_del(txn, real_dev, vlan->vlan_proto, old_vlan_id);
+
+        return IPE_OK;
+}
+/* 
+ * WARNING! Must be call under rtnl_lock!
+ */
+int vlan_check_real_dev(struct net_device *real_dev,
+			__be16 protocol, u16 vlan_id)
+{
+        int ret = IPE_OK;
+
+        dev_hold(real_dev);
+
+	if (real_dev->features & NETIF_F_VLAN_CHALLENGED) {
+		pr_info("VLANs not supported on %s\n", real_dev->name);
+		ret = -EOPNOTSUPP;
+                goto vc_put;
+	}
+
+	if (vlan_find_dev(real_dev, protocol, vlan_id) != NULL)
+		ret = -EEXIST;
+
+vc_put:
+        dev_put(real_dev);
+
+	return ret;
+}
+
+static int check_loop_case(ndev_t *ldev, ndev_t *updev) {
+        /* updev must be not in uppers in ldev for IPE_OK */ 
+        if (netdev_has_upper_dev(ldev, updev)) 
+                return IPE_BAD_DEV;
+
+        return IPE_OK;
+}
+
+
+/*
+ * VLAN is moved between parents of any type, physical or VLAN, as
+ * failover does (check_parent). New parent can't be this VLAN's own child
+ * (or upper of it): that's a loop.
+ */
+static int set_parent(const ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+        int err;
+        __be16 vlan_proto;
+        u16    vlan_id;
+        ndev_t *vlan_dev     = msg->dev[IPE_SRC];
+        ndev_t *new_real_dev = msg->dev[IPE_DST];
+
+        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
+        if (real_dev == new_real_dev) {
+                printk(KERN_WARNING "%s: device %s already parent for %s\n",
+                                __FUNCTION__, new_real_dev->name, vlan_dev->name);
+                return IPE_DEFAULT_FAIL;
+        }
+
+        if (check_loop_case(vlan_dev, new_real_dev)) {
+                printk(KERN_ERR "%s: device %s has %s as upper neighbour!\n",
+                                __FUNCTION__, vlan_dev->name, new_real_dev->name);
+                return IPE_BAD_DEV;
+        }
+
+
+        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
+        BUG_ON(!vlan);
+
+        vlan_proto = vlan->vlan_proto;
+        vlan_id    = vlan->vlan_id;
+
+        err = vlan_check_real_dev(new_real_dev, vlan_proto, vlan_id);
+        if (err == -EEXIST) {
+                printk(KERN_WARNING "%s: VID %d already used on %s!\n",
+                                __FUNCTION__, vlan_id, new_real_dev->name);
+                return IPE_BAD_VID;
+        }
+        if (err < 0)            /* -EOPNOTSUPP: VLAN challenged */
+                return IPE_BAD_DEV;
+
+        err = ipe_txn_reserve(txn, 7);
+        if (err)
+                return err;
+
+        err = add_vid_filter(txn, new_real_dev, vlan_proto, vlan_id);
+        if (err)
+                return err;
+
+        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
+        /* vlan_info should be there now. vlan_vid_add took care of it */
+        BUG_ON(!vlan_info);
+        struct vlan_info *dst_info = rcu_dereference_rtnl(new_real_dev->vlan_info);
+        BUG_ON(!dst_info);
+
+        struct vlan_group *grp = &dst_info->grp;
+        if (vlan_group_prealloc_vid(grp, vlan_proto, vlan_id) < 0) {
+                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
+                                                           __FUNCTION__, grp);
+                return IPE_BAD_ALLOC;
+        }
+        
+        err = ipe_txn_upper_link(txn, new_real_dev, vlan_dev);
+        if (err < 0) {
+                printk(KERN_ERR "%s: fail link %s to %s: %d\n", __FUNCTION__,
+                                vlan_dev->name, new_real_dev->name, err);
+                switch (err) {
+                case -EBUSY:    /* already linked, or loop */
+                case -EEXIST:
+                        return IPE_BAD_DEV;
+                case -ENOMEM:
+                        return IPE_BAD_ALLOC;
+                default:
+                        return IPE_DEFAULT_FAIL;
+                }
+        }
+
+        /* Reference of struct vlan_dev_priv moves to new_real_dev */
+        ipe_txn_set_real_dev(txn, vlan_dev, new_real_dev);
+        ipe_txn_upper_unlink(txn, real_dev, vlan_dev);
+
+        ipe_txn_del_device(txn, &vlan_info->grp, vlan_proto, vlan_id);
+        ipe_txn_set_device(txn, &dst_info->grp, vlan_proto, vlan_id, vlan_dev);
+        ipe_txn_vid_del(txn, real_dev, vlan_proto, vlan_id);
+
+        return IPE_OK;
+}
+
+
+
+static int set_eth(const ipe_nlmsg_t *msg, ipe_txn_t *txn) {
+
+        int res = IPE_DEFAULT_FAIL;
+        __be16 new_vlan_proto = htons(msg->value);
+        ndev_t *vlan_dev = msg->dev[IPE_SRC];
+
+        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
+
+        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
+        BUG_ON(!vlan);
+
+        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
+        /* vlan_info should be there now. vlan_vid_add took care of it */
+        BUG_ON(!vlan_info);
+        
+
+        struct vlan_group *grp = &vlan_info->grp;
+        if (vlan_group_get_device(grp, new_vlan_proto, vlan->vlan_id)) {
+                printk(KERN_WARNING "%s: VID %d with proto %x already used on %s!\n", 
+                       __FUNCTION__, vlan->vlan_id, new_vlan_proto, real_dev->name);
+                return IPE_BAD_VID;
+        }
+
+        if (vlan_group_prealloc_vid(grp, new_vlan_proto, vlan->vlan_id) < 0) {
+                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
+                                                           __FUNCTION__, grp);
+                return IPE_BAD_ALLOC;
+        }
+
+        res = ipe_txn_reserve(txn, 5);
+        if (res)
+                return res;
+
+        res = add_vid_filter(txn, real_dev, new_vlan_proto, vlan->vlan_id);
+        if (res)
+                return res;
+
+        ipe_txn_del_device(txn, grp, vlan->vlan_proto, vlan->vlan_id);
+        ipe_txn_vid_del(txn, real_dev, vlan->vlan_proto, vlan->vlan_id);
+        ipe_txn_set_proto(txn, vlan_dev, new_vlan_proto);
+        ipe_txn_set_device(txn, grp, vlan->vlan_proto, vlan->vlan_id, vlan_dev);
+
+        return IPE_OK;
+}
@@ -25,6 +25,8 @@
 #include <linux/skbuff.h>
 #include <linux/netlink.h>
 #include <linux/netdevice.h>
+#include <linux/mm.h>
+#include <linux/ktime.h>
 
 #include <linux/if.h> // IFNAMSIZ
 #include <linux/if_vlan.h> 
@@ -32,644 +34,1231 @@
 #include <linux/err.h>
 #include <net/sock.h>
 #include <net/net_namespace.h>
+#include <net/genetlink.h>
 
 // Local Includes:
 #include "../include/ipe.h"
 #include "../include/vlan.h"
 #include "../include/ipeDebug.h"
+#include "../include/ipeBulk.h"
+#include "../include/ipeTxn.h"
+#include "../include/ipeDump.h"
+#include "../include/ipeName.h"
+#include "../include/ipeNet.h"
+#include "../include/ipeOp.h"
+#include "../include/ipeAsync.h"
+#include "../include/ipeEvent.h"
+#include "../include/ipeGroup.h"
+#include "../include/ipeStats.h"
+#include "../include/ipeCmd.h"
+
+#define CREATE_TRACE_POINTS
+#include "../include/ipeTrace.h"
 
 #define IPE_MAX_COMMAND_LEN      IFNAMSIZ
 
 typedef struct net_device ndev_t;
 
 
-static int set_vid(const ipe_nlmsg_t *msg);
-static int set_eth(const ipe_nlmsg_t *msg);
-static int set_name(const ipe_nlmsg_t *msg);
-static int set_parent(const ipe_nlmsg_t *msg);
-
-extern int print_list_ndev(const ipe_nlmsg_t *msg);
+static int fetch_and_exec(ipe_nlmsg_t *msg) {
+        u64 start = ktime_get_ns();
+        int command = msg->command;
+        ipe_txn_t txn;
+        int res = 0;
 
-static int check_eth(const ipe_nlmsg_t *msg);
-static int check_vid(const ipe_nlmsg_t *msg);
-static int check_src(const ipe_nlmsg_t *msg);
-static int check_src_vlan(const ipe_nlmsg_t *msg);
-static int dummy(const ipe_nlmsg_t *msg);
-//static int check_ifname(const ipe_nlmsg_t *msg);
-static int check_everybody(const ipe_nlmsg_t *msg);
+        res = ipe_check_command(msg);
+        if (res) {
+                ipe_stats_op(command, res, start);
+                return res;
+        }
 
-static inline ndev_t *vlan_find_dev(ndev_t *real_dev,
-					       __be16 vlan_proto, u16 vlan_id);
+        res = ipe_prepare_op(msg, NULL);
+        if (res)
+                goto release_op;
 
-static struct sock *nl_sk = NULL;
+        if (!ipe_tool(command)->txn_handler) {
+                res = ipe_tool(command)->handler(msg);
+                trace_ipe_op_end(msg, res);
+                goto release_op;
+        }
 
+        ipe_txn_init(&txn);
 
-static ipe_tool_t commap[IPE_COMMAND_COUNT] = {
-        {set_vid, "set_vid", check_vid},
-        {set_eth, "set_eth", check_eth},
-        /* debug: */
-        #ifdef IPE_DEBUG
-                {show_vlan_info, "show_vlan_info", check_src_vlan},
-                {print_list_ndev, "print_list_ndev", dummy},
-        #endif
-        {set_name, "set_name", check_src},
-        {set_parent, "set_parent", check_everybody},
-};
+        ipe_rtnl_lock(command);
+        res = ipe_exec_txn(msg, &txn);
+        ipe_rtnl_unlock(1);
 
+        ipe_txn_destroy(&txn);
 
+release_op:
+        ipe_op_release(msg);
+        ipe_stats_op(command, res, start);
 
+        return res;
+}
 
 
-static int fetch_and_exec(const ipe_nlmsg_t *msg) {
-        int command = msg->command;
-        int res = 0;
+/* Resolve and check all operations of batch, without rtnl_lock */
+static int prepare_batch(ipe_batch_t *batch, int *retcode) {
+        ipe_name_cache_t cache;
+        int res;
+        int i;
 
-        if (command < 0 || command >= IPE_COMMAND_COUNT) {
-                printk(KERN_ERR "%s: bad command #%d!\n",
-                                        __FUNCTION__, command);
-                return IPE_UNKNOWN_COMMAND;
+        res = ipe_name_cache_init(&cache, batch->count * IPE_DEV_COUNT);
+        if (res) {
+                for (i = 0; i < batch->count; ++i)
+                        retcode[i] = res;
+                return res;
         }
 
-        res = commap[command].checker(msg);
+        res = ipe_check_batch(batch, retcode, &cache);
+        ipe_name_cache_destroy(&cache);
 
-        return res ? res : commap[command].handler(msg);
+        return res;
+}
+
+
+static int fetch_and_exec_batch(ipe_batch_t *batch, int *retcode) {
+        int res = prepare_batch(batch, retcode);
+
+        if (!res)
+                res = ipe_apply_batch(batch, retcode);
+
+        ipe_release_batch(batch);
+
+        return res;
 }
 
 
 /*
- * Fetch find case in dependency of type namespace (defaulf/custom)
+ * Device pinned by ipe_op_pin, else fetch it from namespace, that was
+ * resolved by ipe_resolve_net
  * ATTENTION! Here called "dev_hold" function!
  */
 ndev_t *get_dev(const ipe_nlmsg_t *msg, const int id) {
-        return dev_get_by_index(msg->nsfd[id] == IPE_GLOBAL_NS ? 
-                            &init_net : get_net_ns_by_fd(msg->nsfd[id]),
-                                                         msg->ifindex[id]);
+        if (msg->dev[id]) {
+                dev_hold(msg->dev[id]);
+                return msg->dev[id];
+        }
+        if (!msg->net[id])
+                return NULL;
+        return dev_get_by_index(msg->net[id], msg->ifindex[id]);
 }
 
 
-#ifdef IPE_DEBUG
-void printk_msg(const ipe_nlmsg_t *msg) {
-        printk(KERN_DEBUG "%s: value %d\n", __FUNCTION__, msg->value);
-        printk(KERN_DEBUG "%s: command %s\n", __FUNCTION__, commap[msg->command].name);
-}
-#endif
 
+static struct vlan_info *vlan_info_alloc(ndev_t *dev)
+{
+	struct vlan_info *vlan_info;
 
+	vlan_info = kzalloc(sizeof(struct vlan_info), GFP_KERNEL);
+	if (!vlan_info)
+		return NULL;
 
-static int check_vid(const ipe_nlmsg_t *msg) {
+	vlan_info->real_dev = dev;
+	INIT_LIST_HEAD(&vlan_info->vid_list);
 
-        int ret = check_src_vlan(msg);
-        if (ret != IPE_OK) 
-                return ret;
+	return vlan_info;
+}
 
-        if (msg->value > VLAN_N_VID || msg->value < 0) {
-                printk(KERN_WARNING "%s: try set bad VID %d\n", 
-                                                __FUNCTION__, msg->value);
-                return IPE_BAD_VID;
-        }
 
 
-        if (msg->value == VLAN_N_VID || msg->value == 0) {
-                printk(KERN_WARNING "%s: this VID [%d] is reserved!\n", 
-                                        __FUNCTION__, msg->value);
-                return IPE_BAD_VID;
+/*
+ * Negative errno for netlink ACK, with message of extended ACK for IPE_*
+ * code. NL_SET_ERR_MSG keeps literals only, so it's a switch.
+ */
+static int ipe_genl_error(const int code, struct netlink_ext_ack *extack) {
+        switch (code) {
+        case IPE_OK:
+                return 0;
+        case IPE_BAD_VLAN_PROTO:
+                NL_SET_ERR_MSG(extack, "ipe: bad VLAN ethertype");
+                return -EPROTONOSUPPORT;
+        case IPE_BAD_ARG:
+                NL_SET_ERR_MSG(extack, "ipe: bad argument");
+                break;
+        case IPE_BAD_VID:
+                NL_SET_ERR_MSG(extack, "ipe: VID is reserved or already used");
+                break;
+        case IPE_BAD_PTR:
+                NL_SET_ERR_MSG(extack, "ipe: device not found");
+                break;
+        case IPE_BAD_DEV:
+                NL_SET_ERR_MSG(extack, "ipe: unsuitable device");
+                break;
+        case IPE_BAD_IF_IDX:
+                NL_SET_ERR_MSG(extack, "ipe: bad interface index");
+                break;
+        case IPE_UNKNOWN_COMMAND:
+                NL_SET_ERR_MSG(extack, "ipe: unknown command");
+                break;
+        case IPE_FAIL_NS:
+                NL_SET_ERR_MSG(extack, "ipe: bad network namespace");
+                break;
+        case IPE_BAD_ALLOC:
+                NL_SET_ERR_MSG(extack, "ipe: out of memory");
+                break;
+        case IPE_DEFAULT_FAIL:
+                NL_SET_ERR_MSG(extack, "ipe: operation failed");
+                break;
+        case IPE_SKIPPED:
+                NL_SET_ERR_MSG(extack, "ipe: operation skipped");
+                break;
+        case IPE_ROLLED_BACK:
+                NL_SET_ERR_MSG(extack, "ipe: operation rolled back");
+                break;
         }
 
-        return IPE_OK;
+        return -ipe_code_to_errno(code);
 }
 
-static int check_eth(const ipe_nlmsg_t *msg) {
-        int ret = check_src_vlan(msg);
-        if (ret != IPE_OK) 
-                return ret;
 
-        if (vlan_proto_idx(htons(msg->value)) == IPE_BAD_VLAN_PROTO) {
-                printk(KERN_WARNING "%s: try set bad VLAN ethertype: %x\n",
-                                              __FUNCTION__, htons(msg->value));
-                return IPE_BAD_VLAN_PROTO;
-        }
 
-        return IPE_OK;
-}
+static const struct nla_policy ipe_dev_policy[IPE_DEV_ATTR_MAX + 1] = {
+        [IPE_DEV_ATTR_IFINDEX]  = { .type = NLA_U32 },
+        [IPE_DEV_ATTR_NSFD]     = { .type = NLA_U32 },
+        [IPE_DEV_ATTR_IFNAME]   = { .type = NLA_NUL_STRING, .len = IFNAMSIZ - 1 },
+        [IPE_DEV_ATTR_NSID]     = { .type = NLA_S32 },
+};
 
-static int dummy(const ipe_nlmsg_t *msg) {
-        return IPE_OK;
+static const struct nla_policy ipe_op_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+        [IPE_ATTR_DST]          = { .type = NLA_NESTED },
+        [IPE_ATTR_VALUE]        = { .type = NLA_U32 },
+        [IPE_ATTR_IFNAME]       = { .type = NLA_NUL_STRING, .len = IFNAMSIZ - 1 },
+        [IPE_ATTR_CMD]          = { .type = NLA_U8 },
+};
+
+static const struct nla_policy ipe_batch_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_OPS]          = { .type = NLA_NESTED },
+        [IPE_ATTR_FLAGS]        = { .type = NLA_U32 },
+};
+
+static const struct nla_policy ipe_compact_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ipe_get_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ipe_failover_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+        [IPE_ATTR_DST]          = { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ipe_convert_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+        [IPE_ATTR_VALUE]        = { .type = NLA_U32 },
+        [IPE_ATTR_FILTER]       = { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ipe_rename_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+        [IPE_ATTR_IFNAME]       = { .type = NLA_NUL_STRING, .len = IFNAMSIZ - 1 },
+        [IPE_ATTR_FILTER]       = { .type = NLA_NESTED },
+        [IPE_ATTR_OPS]          = { .type = NLA_NESTED },
+};
+
+static const struct nla_policy ipe_match_policy[IPE_FILTER_ATTR_MAX + 1] = {
+        [IPE_FILTER_ATTR_PROTO]         = { .type = NLA_U16 },
+        [IPE_FILTER_ATTR_VID_MIN]       = { .type = NLA_U16 },
+        [IPE_FILTER_ATTR_VID_MAX]       = { .type = NLA_U16 },
+};
+
+static const struct nla_policy ipe_renumber_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_SRC]          = { .type = NLA_NESTED },
+        [IPE_ATTR_VID_MAP]      = { .type = NLA_BINARY, 
+                                    .len  = VLAN_N_VID * sizeof(ipe_vid_pair_t) },
+};
+
+
+
+static int parse_dev(ipe_nlmsg_t *msg, const int id, const struct nlattr *nla,
+                                           struct netlink_ext_ack *extack)
+{
+        struct nlattr *tb[IPE_DEV_ATTR_MAX + 1];
+        int err;
+
+        msg->nsfd[id] = IPE_GLOBAL_NS;
+        msg->nsid[id] = IPE_NO_NSID;
+        if (!nla)
+                return 0;
+
+        err = nla_parse_nested(tb, IPE_DEV_ATTR_MAX, nla, ipe_dev_policy, extack);
+        if (err)
+                return err;
+
+        if (tb[IPE_DEV_ATTR_IFINDEX])
+                msg->ifindex[id] = nla_get_u32(tb[IPE_DEV_ATTR_IFINDEX]);
+        if (tb[IPE_DEV_ATTR_NSFD])
+                msg->nsfd[id] = (int)nla_get_u32(tb[IPE_DEV_ATTR_NSFD]);
+        if (tb[IPE_DEV_ATTR_IFNAME])
+                nla_strlcpy(msg->devname[id], tb[IPE_DEV_ATTR_IFNAME], IFNAMSIZ);
+        if (tb[IPE_DEV_ATTR_NSID])
+                msg->nsid[id] = nla_get_s32(tb[IPE_DEV_ATTR_NSID]);
+
+        return 0;
 }
 
-static int check_vlan(const ipe_nlmsg_t *msg, const int id) {
-        ndev_t *vlan_dev = get_dev(msg, id);
 
-        if (IS_ERR_OR_NULL(vlan_dev)) {
-                printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
-                       __FUNCTION__, msg->ifindex[id], msg->nsfd[id]);
-                return IPE_BAD_PTR;
+/* Fill operation from attributes, that was validated by ipe_op_policy */
+static int parse_op(ipe_nlmsg_t *msg, const int command, struct nlattr **tb,
+                                            struct netlink_ext_ack *extack)
+{
+        unsigned long present = 0;
+        int attr;
+        int err;
+
+        memset(msg, 0, sizeof(ipe_nlmsg_t));
+        msg->command = command;
+
+        if (ipe_check_command(msg)) {
+                NL_SET_ERR_MSG(extack, "ipe: unknown command");
+                return -EOPNOTSUPP;
         }
- 
-        if (!is_vlan_dev(vlan_dev)) {
-                printk(KERN_WARNING "%s: device %s is not vlan type!\n", 
-                                                __FUNCTION__, vlan_dev->name);
-                dev_put(vlan_dev);
-                return IPE_BAD_DEV;
+
+        for (attr = 1; attr <= IPE_ATTR_MAX; ++attr) {
+                if (tb[attr])
+                        present |= IPE_ATTR_BIT(attr);
         }
 
-        dev_put(vlan_dev);
-        return IPE_OK;
+        if ((present & ipe_tool(command)->attrs) != ipe_tool(command)->attrs) {
+                NL_SET_ERR_MSG(extack, "ipe: missing required attribute");
+                return -EINVAL;
+        }
+
+        err = parse_dev(msg, IPE_SRC, tb[IPE_ATTR_SRC], extack);
+        if (!err)
+                err = parse_dev(msg, IPE_DST, tb[IPE_ATTR_DST], extack);
+        if (err)
+                return err;
+
+        if (tb[IPE_ATTR_VALUE])
+                msg->value = nla_get_u32(tb[IPE_ATTR_VALUE]);
+        if (tb[IPE_ATTR_IFNAME])
+                nla_strlcpy(msg->ifname, tb[IPE_ATTR_IFNAME], IFNAMSIZ);
+
+        return 0;
 }
 
-static int check_dev(const ipe_nlmsg_t *msg, const int id) {
-        ndev_t *vlan_dev = get_dev(msg, id);
-        if (IS_ERR_OR_NULL(vlan_dev)) {
-                printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
-                       __FUNCTION__, msg->ifindex[id], msg->nsfd[id]);
-                return IPE_BAD_PTR;
-        }
-        
-        dev_put(vlan_dev);
-        return IPE_OK;
+
+
+/* doit of single operations: IPE_CMD_SET_* and debug */
+static int ipe_genl_op(struct sk_buff *skb, struct genl_info *info) {
+        ipe_nlmsg_t msg;
+        int err;
+
+        err = parse_op(&msg, info->genlhdr->cmd, info->attrs, info->extack);
+        if (err)
+                return err;
+
+        return ipe_genl_error(fetch_and_exec(&msg), info->extack);
 }
 
 
-static int check_src(const ipe_nlmsg_t *msg) {
-        return check_dev(msg, IPE_SRC);
+
+static int parse_batch(ipe_batch_t *batch, const struct nlattr *ops,
+                                         struct netlink_ext_ack *extack)
+{
+        struct nlattr *tb[IPE_ATTR_MAX + 1];
+        struct nlattr *op;
+        int rem;
+        int err;
+
+        batch->count = 0;
+        nla_for_each_nested(op, ops, rem) {
+                if (nla_type(op) != IPE_ATTR_OP)
+                        continue;
+
+                err = nla_parse_nested(tb, IPE_ATTR_MAX, op, ipe_op_policy, extack);
+                if (err)
+                        return err;
+
+                if (!tb[IPE_ATTR_CMD]) {
+                        NL_SET_ERR_MSG_ATTR(extack, op, "ipe: operation without command");
+                        return -EINVAL;
+                }
+
+                err = parse_op(&batch->ops[batch->count], 
+                               nla_get_u8(tb[IPE_ATTR_CMD]), tb, extack);
+                if (err) {
+                        NL_SET_BAD_ATTR(extack, op);
+                        return err;
+                }
+
+                batch->count++;
+        }
+
+        return 0;
 }
 
-static int check_src_vlan(const ipe_nlmsg_t *msg) {
-        return check_vlan(msg, IPE_SRC);
+
+/* Space of IPE_ATTR_RESULTS or IPE_ATTR_STATUS of @batch into reply */
+size_t ipe_results_size(const ipe_batch_t *batch) {
+        if (batch->flags & IPE_BATCH_STATUS)
+                return nla_total_size(batch->count * sizeof(struct ipe_op_status));
+
+        return nla_total_size(0) + batch->count * nla_total_size(sizeof(u32));
 }
 
-static int check_everybody(const ipe_nlmsg_t *msg) {
-        int res;
+
+/* IPE_ATTR_STATUS is written in place: one attribute for all operations */
+static int put_status(struct sk_buff *skb, const ipe_batch_t *batch,
+                                           const int *retcode)
+{
+        struct ipe_op_status *status;
+        struct nlattr *nla;
         int i;
-        for (i = 0; i < IPE_DEV_COUNT; ++i) {
-                res = check_vlan(msg, i);
-                if (res)
-                        return res;
-        }
 
-        #ifdef IPE_DEBUG
-                printk(KERN_DEBUG "%s: res %d\n", __FUNCTION__, res);
-        #endif
+        nla = nla_reserve(skb, IPE_ATTR_STATUS,
+                          batch->count * sizeof(struct ipe_op_status));
+        if (!nla)
+                return -EMSGSIZE;
 
-        return res ? res : IPE_OK;
+        status = nla_data(nla);
+        for (i = 0; i < batch->count; ++i)
+                ipe_op_status(&batch->ops[i], i, retcode[i], &status[i]);
+
+        return 0;
 }
 
 
-/* Must be called under rtnl lock */
-static ndev_t *unsafe_get_real_dev(ndev_t *dev) {
-        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
-        BUG_ON(!vlan);
-        return vlan->real_dev;
-}
+int ipe_put_results(struct sk_buff *skb, const ipe_batch_t *batch,
+                                         const int *retcode)
+{
+        struct nlattr *results;
+        int i;
 
-static int unsafe_change_name(ndev_t *dev, const char *name) {
-        strcpy(dev->name, name);
-        return IPE_OK;
-}
+        if (batch->flags & IPE_BATCH_STATUS)
+                return put_status(skb, batch, retcode);
 
-static int set_name(const ipe_nlmsg_t *msg) {
-        int res = IPE_OK;
+        results = nla_nest_start(skb, IPE_ATTR_RESULTS);
+        if (!results)
+                return -EMSGSIZE;
 
-        rtnl_lock();
-        ndev_t *vlan_dev = get_dev(msg, IPE_SRC);
-        res = unsafe_change_name(vlan_dev, msg->ifname);
-        rtnl_unlock();
+        for (i = 0; i < batch->count; ++i) {
+                if (nla_put_u32(skb, IPE_ATTR_RETCODE, retcode[i]))
+                        return -EMSGSIZE;
+        }
 
-        dev_put(vlan_dev);
-        return res < 0 ? res : IPE_OK;
+        nla_nest_end(skb, results);
+        return 0;
 }
 
 
+/*
+ * Exec batch and reply with exit code of each operation. Reply is sent 
+ * even if operations fail: their exit codes are into IPE_ATTR_RESULTS,
+ * or into IPE_ATTR_STATUS with old and new values (IPE_BATCH_STATUS).
+ * Valid IPE_BATCH_ASYNC batch is queued, reply is sent by ipeAsync.c.
+ */
+static int ipe_genl_batch(struct sk_buff *skb, struct genl_info *info) {
+        const struct nlattr *ops = info->attrs[IPE_ATTR_OPS];
+        u64 start = ktime_get_ns();
+        ipe_batch_t *batch;
+        struct sk_buff *reply;
+        void *hdr;
+        int *retcode;
+        int count = 0;
+        int err = -ENOMEM;
+        int res = IPE_OK;
+        struct nlattr *op;
+        int rem;
 
-static int set_vid(const ipe_nlmsg_t *msg) {
+        if (!ops) {
+                NL_SET_ERR_MSG(info->extack, "ipe: batch without operations");
+                return -EINVAL;
+        }
 
-        rtnl_lock();
-        ndev_t *vlan_dev = get_dev(msg, IPE_SRC);
-        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
+        nla_for_each_nested(op, ops, rem)
+                count++;
 
-        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
-        BUG_ON(!vlan);
+        if (count > IPE_BATCH_MAX) {
+                NL_SET_ERR_MSG_ATTR(info->extack, ops, "ipe: too many operations");
+                return -E2BIG;
+        }
 
+        batch = kvmalloc(sizeof(ipe_batch_t) + count * sizeof(ipe_nlmsg_t),
+                                                                GFP_KERNEL);
+        retcode = kvmalloc_array(count, sizeof(int), GFP_KERNEL);
+        if (!batch || !retcode)
+                goto free_batch;
 
-        int old_vlan_id  = vlan->vlan_id;
+        err = parse_batch(batch, ops, info->extack);
+        if (err)
+                goto free_batch;
 
-        /*
-        if (vlan_vid_add(real_dev, vlan->vlan_proto, msg->value))
-                goto set_rtnl_unlock;
-        */
+        if (!batch->count) {
+                NL_SET_ERR_MSG(info->extack, "ipe: batch without operations");
+                err = -EINVAL;
+                goto free_batch;
+        }
 
-        #ifdef IPE_DEBUG
-                printk(KERN_DEBUG "%s: current vid #%d\n", 
-                                        __FUNCTION__, old_vlan_id);
-        #endif
-        vlan->vlan_id = msg->value;
-        #ifdef IPE_DEBUG
-                printk(KERN_DEBUG "%s: new vid #%d\n", 
-                                        __FUNCTION__, vlan->vlan_id);
-                printk(KERN_DEBUG "%s: find parent: %s by addr %p\n", 
-                                        __FUNCTION__, real_dev->name, real_dev);
-        #endif
+        batch->flags = info->attrs[IPE_ATTR_FLAGS] ? 
+                       nla_get_u32(info->attrs[IPE_ATTR_FLAGS]) : 0;
+
+        if (batch->flags & IPE_BATCH_ASYNC) {
+                res = prepare_batch(batch, retcode);
+                if (res == IPE_OK) {
+                        err = ipe_async_submit(batch, retcode, info, start);
+                        if (!err)
+                                return 0;       /* batch is owned by queue */
+                }
+
+                /* invalid batch is replied right now, like synchronous one */
+                ipe_release_batch(batch);
+                if (err)
+                        goto free_batch;
+        }
+
+        /* reply is sized once for all results */
+        err = -ENOMEM;
+        reply = genlmsg_new(ipe_results_size(batch), GFP_KERNEL);
+        if (!reply)
+                goto free_batch;
 
-        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
-        /* vlan_info should be there now. vlan_vid_add took care of it */
-        BUG_ON(!vlan_info);
+        if (!(batch->flags & IPE_BATCH_ASYNC))
+                res = fetch_and_exec_batch(batch, retcode);
 
+        ipe_stats_batch(batch, retcode, res, start);
 
-        struct vlan_group *grp = &vlan_info->grp;
-        if (vlan_group_prealloc_vid(grp, vlan->vlan_proto, vlan->vlan_id) < 0) {
-                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
-                                                           __FUNCTION__, grp);
-                goto set_rtnl_unlock;
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_BATCH);
+        if (!hdr || ipe_put_results(reply, batch, retcode)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto free_batch;
         }
 
-        vlan_group_del_device(&vlan_info->grp,
-                               vlan->vlan_proto, old_vlan_id);
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_BATCH, info->snd_portid, info->snd_seq,
+                                                    batch->count, err);
 
-        vlan_group_set_device(&vlan_info->grp, vlan->vlan_proto, 
-                                                       vlan->vlan_id, vlan_dev);
-        // here will be: grp->nr_vlan_devs++;
-        dev_put(vlan_dev);
+free_batch:
+        kvfree(retcode);
+        kvfree(batch);
 
-        rtnl_unlock();
-        return IPE_OK;
+        return err;
+}
 
-set_rtnl_unlock:
-        vlan_vid_del(real_dev, vlan->vlan_proto, vlan->vlan_id);
-        dev_put(vlan_dev);
 
-        rtnl_unlock();
-        return IPE_DEFAULT_FAIL;
-}
 
+static int ipe_genl_renumber(struct sk_buff *skb, struct genl_info *info) {
+        const struct nlattr *map = info->attrs[IPE_ATTR_VID_MAP];
+        u64 start = ktime_get_ns();
+        struct sk_buff *reply;
+        ipe_nlmsg_t msg;
+        void *hdr;
+        int moved = 0;
+        int count;
+        int res;
+        int err;
+
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, NULL, info->extack);
+        if (err)
+                return err;
+
+        if (!info->attrs[IPE_ATTR_SRC] || !map ||
+            nla_len(map) % sizeof(ipe_vid_pair_t)) {
+                NL_SET_ERR_MSG(info->extack, "ipe: bad VID map");
+                return -EINVAL;
+        }
 
+        count = nla_len(map) / sizeof(ipe_vid_pair_t);
+        if (count <= 0 || count > VLAN_N_VID) {
+                NL_SET_ERR_MSG_ATTR(info->extack, map, "ipe: bad VID map");
+                return -EINVAL;
+        }
 
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_resolve_names(&msg, NULL);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-/* 
- * WARNING! Must be call under rtnl_lock!
- */
-int vlan_check_real_dev(struct net_device *real_dev,
-			__be16 protocol, u16 vlan_id)
-{
-        int ret = IPE_OK;
+        err = -ENOMEM;
+        res = IPE_BAD_ALLOC;
+        reply = genlmsg_new(nla_total_size(sizeof(u32)), GFP_KERNEL);
+        if (!reply)
+                goto release_op;
 
-        dev_hold(real_dev);
+        res = renumber_vids(&msg, nla_data(map), count, &moved);
+        if (res) {
+                nlmsg_free(reply);
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-	if (real_dev->features & NETIF_F_VLAN_CHALLENGED) {
-		pr_info("VLANs not supported on %s\n", real_dev->name);
-		ret = -EOPNOTSUPP;
-                goto vc_put;
-	}
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_RENUMBER);
+        if (!hdr || nla_put_u32(reply, IPE_ATTR_COUNT, moved)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto release_op;
+        }
 
-	if (vlan_find_dev(real_dev, protocol, vlan_id) != NULL)
-		ret = -EEXIST;
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_RENUMBER, info->snd_portid, info->snd_seq,
+                                                             moved, err);
 
-vc_put:
-        dev_put(real_dev);
+release_op:
+        ipe_op_release(&msg);
+        ipe_stats_op(IPE_CMD_RENUMBER, res, start);
 
-	return ret;
+        return err;
 }
 
-static inline ndev_t *__vlan_group_get_device(struct vlan_group *vg,
-							 unsigned int pidx,
-							 u16 vlan_id)
-{
-	struct net_device **array;
 
-	array = vg->vlan_devices_arrays[pidx]
-				       [vlan_id / VLAN_GROUP_ARRAY_PART_LEN];
-	return array ? array[vlan_id % VLAN_GROUP_ARRAY_PART_LEN] : NULL;
-}
 
-static inline ndev_t *vlan_group_get_device(struct vlan_group *vg,
-						       __be16 vlan_proto,
-						       u16 vlan_id)
-{
-	return __vlan_group_get_device(vg, vlan_proto_idx(vlan_proto), vlan_id);
-}
+/* Free empty parts of vlan_group of parent, reply with their number */
+static int ipe_genl_compact(struct sk_buff *skb, struct genl_info *info) {
+        u64 start = ktime_get_ns();
+        struct sk_buff *reply;
+        ipe_nlmsg_t msg;
+        void *hdr;
+        int freed = 0;
+        int res;
+        int err;
 
-static inline ndev_t *vlan_find_dev(ndev_t *real_dev,
-					       __be16 vlan_proto, u16 vlan_id)
-{
-	struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
+        if (!info->attrs[IPE_ATTR_SRC]) {
+                NL_SET_ERR_MSG(info->extack, "ipe: missing required attribute");
+                return -EINVAL;
+        }
 
-	if (vlan_info)
-		return vlan_group_get_device(&vlan_info->grp,
-					     vlan_proto, vlan_id);
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, NULL, info->extack);
+        if (err)
+                return err;
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_resolve_names(&msg, NULL);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-	return NULL;
-}
+        err = -ENOMEM;
+        res = IPE_BAD_ALLOC;
+        reply = genlmsg_new(nla_total_size(sizeof(u32)), GFP_KERNEL);
+        if (!reply)
+                goto release_op;
 
-static struct vlan_info *vlan_info_alloc(ndev_t *dev)
-{
-	struct vlan_info *vlan_info;
+        res = compact_group(&msg, &freed);
+        if (res) {
+                nlmsg_free(reply);
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-	vlan_info = kzalloc(sizeof(struct vlan_info), GFP_KERNEL);
-	if (!vlan_info)
-		return NULL;
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_COMPACT);
+        if (!hdr || nla_put_u32(reply, IPE_ATTR_COUNT, freed)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto release_op;
+        }
 
-	vlan_info->real_dev = dev;
-	INIT_LIST_HEAD(&vlan_info->vid_list);
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_COMPACT, info->snd_portid, info->snd_seq,
+                                                             freed, err);
 
-	return vlan_info;
+release_op:
+        ipe_op_release(&msg);
+        ipe_stats_op(IPE_CMD_COMPACT, res, start);
+
+        return err;
 }
 
 
 
-static int check_loop_case(ndev_t *ldev, ndev_t *updev) {
-        /* updev must be not in uppers in ldev for IPE_OK */ 
-        if (netdev_has_upper_dev(ldev, updev)) 
-                return IPE_BAD_DEV;
+/* IPE_ATTR_FAILED: ifindex and exit code of children that aren't moved */
+static int put_failed(struct sk_buff *skb, const ipe_failover_t *failover,
+                                           const int count)
+{
+        struct nlattr *failed, *op, *dev;
+        int i;
+
+        failed = nla_nest_start(skb, IPE_ATTR_FAILED);
+        if (!failed)
+                return -EMSGSIZE;
+
+        for (i = 0; i < count; ++i) {
+                op = nla_nest_start(skb, IPE_ATTR_OP);
+                if (!op)
+                        return -EMSGSIZE;
 
-        return IPE_OK;
+                dev = nla_nest_start(skb, IPE_ATTR_SRC);
+                if (!dev || nla_put_u32(skb, IPE_DEV_ATTR_IFINDEX,
+                                        failover->failed[i].ifindex))
+                        return -EMSGSIZE;
+                nla_nest_end(skb, dev);
+
+                if (nla_put_u32(skb, IPE_ATTR_RETCODE, failover->failed[i].retcode))
+                        return -EMSGSIZE;
+                nla_nest_end(skb, op);
+        }
+
+        nla_nest_end(skb, failed);
+        return 0;
 }
 
 
 /*
- * TODO: This functions are very similary, should be think about 
- * refactoring. Moreover, they is very long
+ * Move all VLAN children of SRC to DST, reply with number of moved and
+ * IPE_ATTR_FAILED. Children that can't be moved don't fail request.
  */
-static int set_parent(const ipe_nlmsg_t *msg) {
+static int ipe_genl_failover(struct sk_buff *skb, struct genl_info *info) {
+        u64 start = ktime_get_ns();
+        ipe_failover_t *failover = NULL;
+        struct sk_buff *reply;
+        ipe_nlmsg_t msg;
+        size_t size;
+        void *hdr;
+        int failed;
+        int res;
         int err;
-        __be16 vlan_proto;
-        u16    vlan_id;
-        ndev_t *new_real_dev;
-
 
-        rtnl_lock();
-
-        ndev_t *vlan_dev = get_dev(msg, IPE_SRC);
-        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
-        if (!is_vlan_dev(real_dev)) {
-                printk(KERN_ERR "%s: device %s bounded with phy interface %s!\n",
-                                __FUNCTION__, vlan_dev->name, real_dev->name);
-                goto put_src;
+        if (!info->attrs[IPE_ATTR_SRC] || !info->attrs[IPE_ATTR_DST]) {
+                NL_SET_ERR_MSG(info->extack, "ipe: missing required attribute");
+                return -EINVAL;
         }
 
-        new_real_dev = get_dev(msg, IPE_DST);
-        if (vlan_dev == new_real_dev) {
-                printk(KERN_ERR "%s: u try set self as parent!\n", 
-                                __FUNCTION__);
-                goto put_dst;
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, info->attrs[IPE_ATTR_DST], info->extack);
+        if (err)
+                return err;
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_resolve_names(&msg, NULL);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
         }
 
-        if (real_dev == new_real_dev) {
-                printk(KERN_WARNING "%s: device %s already parent for %s\n",
-                                __FUNCTION__, new_real_dev->name, vlan_dev->name);
-                goto put_dst;
+        res = failover_vlans(&msg, &failover);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
         }
 
-        if (check_loop_case(vlan_dev, new_real_dev)) {
-                printk(KERN_ERR "%s: device %s has %s as upper neighbour!\n",
-                                __FUNCTION__, vlan_dev->name, new_real_dev->name);
-                goto put_dst;
+        /* reply is sized after rtnl_lock: failures are known only now */
+        failed = min(failover->nr_failed, IPE_FAILED_MAX);
+        size   = nla_total_size(sizeof(u32)) + nla_total_size(0) +
+                 failed * (2 * nla_total_size(0) + 2 * nla_total_size(sizeof(u32)));
+
+        err = -ENOMEM;
+        reply = genlmsg_new(size, GFP_KERNEL);
+        if (!reply)
+                goto release_op;
+
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_FAILOVER);
+        if (!hdr || nla_put_u32(reply, IPE_ATTR_COUNT, failover->moved) ||
+            put_failed(reply, failover, failed)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto release_op;
         }
 
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_FAILOVER, info->snd_portid, info->snd_seq,
+                                                  failover->moved, err);
 
-        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
-        BUG_ON(!vlan);
+release_op:
+        kvfree(failover);
+        ipe_op_release(&msg);
+        ipe_stats_op(IPE_CMD_FAILOVER, res, start);
 
-        vlan_proto = vlan->vlan_proto;
-        vlan_id    = vlan->vlan_id;
+        return err;
+}
 
-        err = vlan_check_real_dev(new_real_dev, vlan_proto, vlan_id);
-        if (err < 0) 
-                goto set_rtnl_unlock;
 
-        if (vlan_vid_add(real_dev, vlan_proto, vlan_id))
-                goto set_rtnl_unlock;
 
-        if (vlan_vid_add(new_real_dev, vlan_proto, vlan_id))
-                goto set_rtnl_unlock;
+/* IPE_ATTR_FILTER of bulk commands, absent filter matches all children */
+static int parse_match(ipe_match_t *match, const struct nlattr *nla,
+                                           struct netlink_ext_ack *extack)
+{
+        struct nlattr *tb[IPE_FILTER_ATTR_MAX + 1];
+        int err;
 
-        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
-        /* vlan_info should be there now. vlan_vid_add took care of it */
-        BUG_ON(!vlan_info);
-        struct vlan_info *dst_info = rcu_dereference_rtnl(new_real_dev->vlan_info);
-        BUG_ON(!dst_info);
-        
-        err = netdev_upper_dev_link(new_real_dev, vlan_dev);
-        if (err < 0)
-                goto set_rtnl_unlock;
+        match->proto   = 0;
+        match->vid_min = 0;
+        match->vid_max = VLAN_VID_MASK;
+        if (!nla)
+                return 0;
+
+        err = nla_parse_nested(tb, IPE_FILTER_ATTR_MAX, nla,
+                               ipe_match_policy, extack);
+        if (err)
+                return err;
+
+        if (tb[IPE_FILTER_ATTR_PROTO])
+                match->proto   = htons(nla_get_u16(tb[IPE_FILTER_ATTR_PROTO]));
+        if (tb[IPE_FILTER_ATTR_VID_MIN])
+                match->vid_min = nla_get_u16(tb[IPE_FILTER_ATTR_VID_MIN]);
+        if (tb[IPE_FILTER_ATTR_VID_MAX])
+                match->vid_max = nla_get_u16(tb[IPE_FILTER_ATTR_VID_MAX]);
+
+        return 0;
+}
 
-        vlan->real_dev = new_real_dev;
-        netdev_upper_dev_unlink(real_dev, vlan_dev);
-        /* Get rid of the vlan's reference to real_dev */
-        dev_put(real_dev);
 
-        /* Account for reference in struct vlan_dev_priv */
-        dev_hold(new_real_dev);
+/* New ethertype for children of parent, reply with number of converted */
+static int ipe_genl_convert(struct sk_buff *skb, struct genl_info *info) {
+        u64 start = ktime_get_ns();
+        struct sk_buff *reply;
+        ipe_convert_t conv;
+        ipe_nlmsg_t msg;
+        void *hdr;
+        int converted = 0;
+        int res;
+        int err;
 
-        struct vlan_group *grp = &dst_info->grp;
-        if (vlan_group_prealloc_vid(grp, vlan_proto, vlan_id) < 0) {
-                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
-                                                           __FUNCTION__, grp);
-                goto set_rtnl_unlock;
+        if (!info->attrs[IPE_ATTR_SRC] || !info->attrs[IPE_ATTR_VALUE]) {
+                NL_SET_ERR_MSG(info->extack, "ipe: missing required attribute");
+                return -EINVAL;
         }
 
-        vlan_group_del_device(&vlan_info->grp, vlan->vlan_proto, vlan->vlan_id);
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, NULL, info->extack);
+        if (!err)
+                err = parse_match(&conv.match, info->attrs[IPE_ATTR_FILTER],
+                                                               info->extack);
+        if (err)
+                return err;
+
+        conv.proto = htons(nla_get_u32(info->attrs[IPE_ATTR_VALUE]));
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_resolve_names(&msg, NULL);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-        vlan_group_set_device(&dst_info->grp, vlan->vlan_proto, 
-                                                       vlan->vlan_id, vlan_dev);
+        err = -ENOMEM;
+        res = IPE_BAD_ALLOC;
+        reply = genlmsg_new(nla_total_size(sizeof(u32)), GFP_KERNEL);
+        if (!reply)
+                goto release_op;
 
-        dev_put(new_real_dev);
-        dev_put(vlan_dev);
+        res = convert_vlans(&msg, &conv, &converted);
+        if (res) {
+                nlmsg_free(reply);
+                err = ipe_genl_error(res, info->extack);
+                goto release_op;
+        }
 
-        rtnl_unlock();
-        return IPE_OK;
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_CONVERT);
+        if (!hdr || nla_put_u32(reply, IPE_ATTR_COUNT, converted)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto release_op;
+        }
 
-set_rtnl_unlock:
-//      vlan_vid_del(real_dev, vlan->vlan_proto, vlan->vlan_id);
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_CONVERT, info->snd_portid, info->snd_seq,
+                                                         converted, err);
 
-put_dst:
-        dev_put(new_real_dev);
-put_src_prev:
-put_src:
-        dev_put(vlan_dev);
-        rtnl_unlock();
+release_op:
+        ipe_op_release(&msg);
+        ipe_stats_op(IPE_CMD_CONVERT, res, start);
 
-        return IPE_DEFAULT_FAIL;
+        return err;
 }
 
 
 
-
-
 /*
- * TODO: This functions are very similary, should be think about 
- * refactoring. Moreover, they is very long
+ * Children of parent by pattern: "%d" of IFNAME is VID. Parse error is
+ * returned, exit code of rename is put into *@res.
  */
-static int set_eth(const ipe_nlmsg_t *msg) {
+static int rename_by_pattern(struct genl_info *info, int *res, int *renamed) {
+        char pattern[IFNAMSIZ];
+        ipe_match_t match;
+        ipe_nlmsg_t msg;
+        int err;
 
-        __be16 old_vlan_proto;
-        ndev_t *vlan_dev = get_dev(msg, IPE_SRC);
-        ndev_t *real_dev = unsafe_get_real_dev(vlan_dev);
+        if (!info->attrs[IPE_ATTR_SRC] || !info->attrs[IPE_ATTR_IFNAME]) {
+                NL_SET_ERR_MSG(info->extack, "ipe: missing required attribute");
+                return -EINVAL;
+        }
 
-        struct vlan_dev_priv *vlan = vlan_dev_priv(vlan_dev);
-        BUG_ON(!vlan);
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, NULL, info->extack);
+        if (!err)
+                err = parse_match(&match, info->attrs[IPE_ATTR_FILTER],
+                                                      info->extack);
+        if (err)
+                return err;
+
+        nla_strlcpy(pattern, info->attrs[IPE_ATTR_IFNAME], IFNAMSIZ);
+
+        *res = ipe_resolve_net(&msg);
+        if (!*res)
+                *res = ipe_resolve_names(&msg, NULL);
+        if (!*res)
+                *res = ipe_op_pin(&msg);
+        if (!*res)
+                *res = rename_vlans(&msg, pattern, &match, renamed);
+
+        ipe_op_release(&msg);
+
+        return 0;
+}
 
-        rtnl_lock();
 
-        old_vlan_proto = vlan->vlan_proto;
+/* Any devices by OPS of IPE_CMD_SET_NAME, checked like batch */
+static int rename_by_list(struct genl_info *info, int *res, int *renamed) {
+        const struct nlattr *ops = info->attrs[IPE_ATTR_OPS];
+        ipe_batch_t *batch;
+        int *retcode;
+        int count = 0;
+        int err = -ENOMEM;
+        struct nlattr *op;
+        int rem;
+        int i;
 
-        /*
-        if (vlan_vid_add(real_dev, htons(msg->value), vlan->vlan_id))
-                goto set_rtnl_unlock;
-        */
+        nla_for_each_nested(op, ops, rem)
+                count++;
 
-        #ifdef IPE_DEBUG
-                printk(KERN_DEBUG "%s: current proto #%x\n", 
-                                        __FUNCTION__, old_vlan_proto);
-        #endif
-        vlan->vlan_proto = htons(msg->value);
-        #ifdef IPE_DEBUG
-                printk(KERN_DEBUG "%s: new proto #%x\n", 
-                                        __FUNCTION__, vlan->vlan_proto);
-                printk(KERN_DEBUG "%s: find parent: %s by addr %p\n", 
-                                        __FUNCTION__, real_dev->name, real_dev);
-        #endif
+        if (!count) {
+                NL_SET_ERR_MSG(info->extack, "ipe: rename without operations");
+                return -EINVAL;
+        }
 
-        struct vlan_info *vlan_info = rcu_dereference_rtnl(real_dev->vlan_info);
-        /* vlan_info should be there now. vlan_vid_add took care of it */
-        BUG_ON(!vlan_info);
-        
+        if (count > IPE_BATCH_MAX) {
+                NL_SET_ERR_MSG_ATTR(info->extack, ops, "ipe: too many operations");
+                return -E2BIG;
+        }
 
-        struct vlan_group *grp = &vlan_info->grp;
-        if (vlan_group_prealloc_vid(grp, vlan->vlan_proto, vlan->vlan_id) < 0) {
-                printk(KERN_ERR "%s: fail alloc memory for vlan group %p!\n", 
-                                                           __FUNCTION__, grp);
-                goto set_rtnl_unlock;
+        batch = kvmalloc(sizeof(ipe_batch_t) + count * sizeof(ipe_nlmsg_t),
+                                                                GFP_KERNEL);
+        retcode = kvmalloc_array(count, sizeof(int), GFP_KERNEL);
+        if (!batch || !retcode) {
+                *res = IPE_BAD_ALLOC;
+                goto free_batch;
         }
 
-        vlan_group_del_device(&vlan_info->grp, old_vlan_proto, vlan->vlan_id);
-        vlan_group_set_device(&vlan_info->grp, vlan->vlan_proto, 
-                                                       vlan->vlan_id, vlan_dev);
-        dev_put(vlan_dev);
+        err = parse_batch(batch, ops, info->extack);
+        if (err)
+                goto free_batch;
 
-        rtnl_unlock();
-        return IPE_OK;
+        for (i = 0; i < batch->count; ++i) {
+                if (batch->ops[i].command != IPE_CMD_SET_NAME) {
+                        NL_SET_ERR_MSG(info->extack, "ipe: rename takes set_name only");
+                        err = -EINVAL;
+                        goto free_batch;
+                }
+        }
 
-set_rtnl_unlock:
-        vlan_vid_del(real_dev, vlan->vlan_proto, vlan->vlan_id);
-        dev_put(vlan_dev);
+        batch->flags = IPE_BATCH_ATOMIC;
 
-        rtnl_unlock();
-        return IPE_DEFAULT_FAIL;
-}
+        *res = prepare_batch(batch, retcode);
+        if (!*res)
+                *res = rename_list(batch, renamed);
+        ipe_release_batch(batch);
 
+free_batch:
+        kvfree(retcode);
+        kvfree(batch);
 
+        return err;
+}
 
 
-static int send_reply(struct nlmsghdr *nlh, const ipe_nlmsg_t *msg, 
-                                                ipe_reply_t *reply) 
-{
-        struct sk_buff *skb;
-        int pid;
-        int msg_size;
-        int res;
+/*
+ * All renames are applied into one rtnl_lock section, collisions are
+ * found before the first one. Reply with number of renamed devices.
+ */
+static int ipe_genl_rename(struct sk_buff *skb, struct genl_info *info) {
+        u64 start = ktime_get_ns();
+        struct sk_buff *reply;
+        void *hdr;
+        int renamed = 0;
+        int res = IPE_OK;
+        int err;
 
-#ifdef IPE_DEBUG
-        printk(KERN_DEBUG "%s: entry nlh %p, msg %p\n", 
-                        __FUNCTION__, nlh, msg);
-#endif
-        msg_size = sizeof(ipe_reply_t);
-        pid = nlh->nlmsg_pid; /* pid of sending process */
-#ifdef IPE_DEBUG
-        printk(KERN_DEBUG "%s: process to send message: [%d]\n", 
-                                __FUNCTION__, pid);
-#endif
-        skb = nlmsg_new(msg_size, 0);
-        if (!skb) {
-                printk(KERN_ERR "%s: failed to allocate new skb!\n", 
-                                                __FUNCTION__);
-                return IPE_BAD_ALLOC;
+        reply = genlmsg_new(nla_total_size(sizeof(u32)), GFP_KERNEL);
+        if (!reply) {
+                res = IPE_BAD_ALLOC;
+                err = -ENOMEM;
+                goto stats;
         }
 
-        nlh = nlmsg_put(skb, 0, 0, NLMSG_DONE, msg_size, 0);
-        NETLINK_CB(skb).dst_group = 0; /* not in mcast group */
-        memcpy(nlmsg_data(nlh), reply, msg_size);
-
-#ifdef IPE_DEBUG
-        printk(KERN_DEBUG "%s: payload -- %d\n", 
-                        __FUNCTION__, ((ipe_reply_t *)nlmsg_data(nlh))->retcode);
-        printk(KERN_DEBUG "%s: retcode %d\n", __FUNCTION__, reply->retcode);
-#endif
-
-        res = nlmsg_unicast(nl_sk, skb, pid);
+        if (info->attrs[IPE_ATTR_OPS])
+                err = rename_by_list(info, &res, &renamed);
+        else
+                err = rename_by_pattern(info, &res, &renamed);
 
-        if (res < 0) {
-                printk(KERN_ERR "%s: error while sending back to user %d\n",
-                                __FUNCTION__, pid);
-                return IPE_DEFAULT_FAIL;
+        if (!err && res)
+                err = ipe_genl_error(res, info->extack);
+        if (err) {
+                nlmsg_free(reply);
+                goto stats;
         }
 
-        return res;
-}
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_RENAME);
+        if (!hdr || nla_put_u32(reply, IPE_ATTR_COUNT, renamed)) {
+                nlmsg_free(reply);
+                err = -EMSGSIZE;
+                goto stats;
+        }
 
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_RENAME, info->snd_portid, info->snd_seq,
+                                                         renamed, err);
 
+stats:
+        ipe_stats_op(IPE_CMD_RENAME, res, start);
 
-static void init_reply(ipe_reply_t *reply, const int retcode,
-                                            const ipe_nlmsg_t *msg) 
-{
-        reply->retcode  = retcode;
-        if (retcode) {
-                snprintf(reply->report, IPE_BUFF_SIZE, 
-                        "%s(%d) return with exit code 0x%x\n",
-                         commap[(int)(msg->command)].name, msg->value, retcode);
-        } else {
-                snprintf(reply->report, IPE_BUFF_SIZE, 
-                        "%s(%d) success!\n",
-                         commap[(int)(msg->command)].name, msg->value);
-        }
+        return err;
 }
 
 
+
 /*
- * Call hadler for required ops
+ * IPE_CMD_GET: state of VLAN device without rtnl_lock, the device isn't
+ * pinned, it's read under rcu_read_lock by ipeDump.c
  */
-static void vlan_ext_handler(struct sk_buff *skb) {
-        struct  nlmsghdr *nlh;
-        ipe_nlmsg_t *msg;
-        ipe_reply_t reply;
+static int ipe_genl_get(struct sk_buff *skb, struct genl_info *info) {
+        u64 start = ktime_get_ns();
+        struct sk_buff *reply;
+        ipe_nlmsg_t msg;
+        void *hdr;
         int res;
+        int err;
 
-        nlh = (struct nlmsghdr*)skb->data;
-        msg = (ipe_nlmsg_t *)nlmsg_data(nlh);
+        if (!info->attrs[IPE_ATTR_SRC]) {
+                NL_SET_ERR_MSG(info->extack, "ipe: missing required attribute");
+                return -EINVAL;
+        }
 
-        #ifdef IPE_DEBUG
-                printk_msg(msg);
-        #endif
+        memset(&msg, 0, sizeof(ipe_nlmsg_t));
+        err = parse_dev(&msg, IPE_SRC, info->attrs[IPE_ATTR_SRC], info->extack);
+        if (!err)
+                err = parse_dev(&msg, IPE_DST, NULL, info->extack);
+        if (err)
+                return err;
+
+        res = ipe_resolve_net(&msg);
+        if (res) {
+                err = ipe_genl_error(res, info->extack);
+                goto release_net;
+        }
 
-        init_reply(&reply, fetch_and_exec(msg), msg);
+        err = -ENOMEM;
+        res = IPE_BAD_ALLOC;
+        reply = genlmsg_new(ipe_get_size(), GFP_KERNEL);
+        if (!reply)
+                goto release_net;
 
-        res = send_reply(nlh, msg, &reply);
-        #ifdef IPE_DEBUG
+        hdr = genlmsg_put_reply(reply, info, &ipe_genl_family, 0, IPE_CMD_GET);
+        res = hdr ? ipe_get_link(reply, &msg, genl_info_net(info)) :
+                    IPE_DEFAULT_FAIL;
         if (res) {
-                printk(KERN_ERR "%s: send_reply return with exit code %d!\n",
-                                                           __FUNCTION__, res);
+                nlmsg_free(reply);
+                err = ipe_genl_error(res, info->extack);
+                goto release_net;
         }
-        #endif
+
+        genlmsg_end(reply, hdr);
+        err = genlmsg_reply(reply, info);
+        trace_ipe_reply(IPE_CMD_GET, info->snd_portid, info->snd_seq, 1, err);
+
+release_net:
+        ipe_release_net(&msg);
+        ipe_stats_op(IPE_CMD_GET, res, start);
+
+        return err;
 }
 
 
 
-static int __init ipe_init(void) {
+static const struct genl_ops ipe_genl_ops[] = {
+        {
+                .cmd    = IPE_CMD_SET_VID,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_SET_ETH,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_SET_NAME,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_SET_PARENT,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+#ifdef IPE_DEBUG
+        {
+                .cmd    = IPE_CMD_SHOW,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_LIST,
+                .doit   = ipe_genl_op,
+                .policy = ipe_op_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+#endif
+        {
+                .cmd    = IPE_CMD_BATCH,
+                .doit   = ipe_genl_batch,
+                .policy = ipe_batch_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_RENUMBER,
+                .doit   = ipe_genl_renumber,
+                .policy = ipe_renumber_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_DUMP,
+                .start  = ipe_dump_start,
+                .dumpit = ipe_dump_links,
+                .done   = ipe_dump_done,
+                .policy = ipe_dump_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_COMPACT,
+                .doit   = ipe_genl_compact,
+                .policy = ipe_compact_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_FAILOVER,
+                .doit   = ipe_genl_failover,
+                .policy = ipe_failover_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_CONVERT,
+                .doit   = ipe_genl_convert,
+                .policy = ipe_convert_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_RENAME,
+                .doit   = ipe_genl_rename,
+                .policy = ipe_rename_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+        {
+                .cmd    = IPE_CMD_GET,
+                .doit   = ipe_genl_get,
+                .policy = ipe_get_policy,
+                .flags  = GENL_ADMIN_PERM,
+        },
+};
+
 
-        //This is for 3.6 kernels and above.
-        struct netlink_kernel_cfg cfg = {
-                .input = vlan_ext_handler,
-        };
+static const struct genl_multicast_group ipe_genl_mcgrps[] = {
+        [IPE_MCGRP_EVENTS] = { .name = IPE_GENL_MCGRP_EVENTS },
+};
+
+
+struct genl_family ipe_genl_family __ro_after_init = {
+        .name           = IPE_GENL_NAME,
+        .version        = IPE_GENL_VERSION,
+        .maxattr        = IPE_ATTR_MAX,
+        .module         = THIS_MODULE,
+        .ops            = ipe_genl_ops,
+        .n_ops          = ARRAY_SIZE(ipe_genl_ops),
+        .mcgrps         = ipe_genl_mcgrps,
+        .n_mcgrps       = ARRAY_SIZE(ipe_genl_mcgrps),
+        /* IPE_BATCH_ASYNC sender can wait for space into queue */
+        .parallel_ops   = true,
+};
+
+
+
+static int __init ipe_init(void) {
+        int err;
 
         #ifdef IPE_DEBUG
                 printk(KERN_INFO "%s: init module %s\n", 
                                                __FUNCTION__, THIS_MODULE->name);
         #endif
-        nl_sk = netlink_kernel_create(&init_net, NETLINK_USER, &cfg);
-        if (!nl_sk) {
-                printk(KERN_ALERT "%s: error creating socket.\n", __FUNCTION__);
+        err = ipe_net_cache_init();
+        if (err) {
+                printk(KERN_ALERT "%s: error register pernet operations: %d\n",
+                                                          __FUNCTION__, err);
+                return err;
+        }
+
+        err = ipe_stats_init();
+        if (err) {
+                printk(KERN_ALERT "%s: error alloc stats: %d\n",
+                                                          __FUNCTION__, err);
+                goto net_cache_exit;
+        }
 
-                return IPE_FAIL_CR_SOC;
+        err = ipe_async_init();
+        if (err) {
+                printk(KERN_ALERT "%s: error alloc workqueue: %d\n",
+                                                          __FUNCTION__, err);
+                goto stats_exit;
+        }
+
+        err = genl_register_family(&ipe_genl_family);
+        if (err) {
+                printk(KERN_ALERT "%s: error register genetlink family %s: %d\n",
+                                          __FUNCTION__, IPE_GENL_NAME, err);
+                goto async_exit;
         }
 
         return IPE_OK;
+
+async_exit:
+        ipe_async_exit();
+stats_exit:
+        ipe_stats_exit();
+net_cache_exit:
+        ipe_net_cache_exit();
+
+        return err;
 }
 
 
@@ -680,7 +1269,11 @@ static void __exit ipe_exit(void) {
                 printk(KERN_INFO "%s: exiting %s\n", 
                                                __FUNCTION__, THIS_MODULE->name);
         #endif
-        netlink_kernel_release(nl_sk);
+        genl_unregister_family(&ipe_genl_family);
+        ipe_async_exit();
+        ipe_group_exit();
+        ipe_stats_exit();
+        ipe_net_cache_exit();
 }
 
 
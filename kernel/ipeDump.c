@@ -0,0 +1,323 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     IPE_CMD_DUMP: multipart dump of VLAN devices of all namespaces.
+* Filter is evaluated here, so only matched devices are sent. Position of
+* dump (netns, device) is kept into cb->args between callbacks.
+*     IPE_CMD_GET: the same attributes of one device and check of it's slot
+* into vlan_group. Both are read under rcu_read_lock only, so they never
+* wait for writers on rtnl_lock.
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <net/sock.h>
+#include <net/net_namespace.h>
+#include <net/genetlink.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeDump.h"
+#include "../include/ipeNet.h"
+#include "../include/ipeGroup.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+/* cb->args: */
+enum {
+        IPE_DUMP_NET,           /* index of netns */
+        IPE_DUMP_DEV,           /* index of device into netns */
+        IPE_DUMP_FILTER,        /* ipe_dump_filter_t */
+};
+
+typedef struct {
+        struct net     *net;            /* NULL for all namespaces */
+        int             parent;
+        u16             proto;
+        u16             vid_min;
+        u16             vid_max;
+} ipe_dump_filter_t;
+
+
+static const struct nla_policy ipe_filter_policy[IPE_FILTER_ATTR_MAX + 1] = {
+        [IPE_FILTER_ATTR_PARENT]        = { .type = NLA_U32 },
+        [IPE_FILTER_ATTR_PROTO]         = { .type = NLA_U16 },
+        [IPE_FILTER_ATTR_VID_MIN]       = { .type = NLA_U16 },
+        [IPE_FILTER_ATTR_VID_MAX]       = { .type = NLA_U16 },
+        [IPE_FILTER_ATTR_NSFD]          = { .type = NLA_U32 },
+        [IPE_FILTER_ATTR_NSID]          = { .type = NLA_S32 },
+};
+
+const struct nla_policy ipe_dump_policy[IPE_ATTR_MAX + 1] = {
+        [IPE_ATTR_FILTER]       = { .type = NLA_NESTED },
+};
+
+
+
+static int parse_filter(ipe_dump_filter_t *filter, const struct nlattr *nla) {
+        struct nlattr *tb[IPE_FILTER_ATTR_MAX + 1];
+        int err;
+
+        filter->vid_max = VLAN_VID_MASK;
+        if (!nla)
+                return 0;
+
+        err = nla_parse_nested(tb, IPE_FILTER_ATTR_MAX, nla,
+                               ipe_filter_policy, NULL);
+        if (err)
+                return err;
+
+        if (tb[IPE_FILTER_ATTR_PARENT])
+                filter->parent  = nla_get_u32(tb[IPE_FILTER_ATTR_PARENT]);
+        if (tb[IPE_FILTER_ATTR_PROTO])
+                filter->proto   = nla_get_u16(tb[IPE_FILTER_ATTR_PROTO]);
+        if (tb[IPE_FILTER_ATTR_VID_MIN])
+                filter->vid_min = nla_get_u16(tb[IPE_FILTER_ATTR_VID_MIN]);
+        if (tb[IPE_FILTER_ATTR_VID_MAX])
+                filter->vid_max = nla_get_u16(tb[IPE_FILTER_ATTR_VID_MAX]);
+
+        /* descriptor is valid only into context of sender */
+        if (tb[IPE_FILTER_ATTR_NSFD]) {
+                filter->net = get_net_ns_by_fd(nla_get_u32(tb[IPE_FILTER_ATTR_NSFD]));
+                if (IS_ERR(filter->net)) {
+                        err = PTR_ERR(filter->net);
+                        filter->net = NULL;
+                        return err;
+                }
+        } else if (tb[IPE_FILTER_ATTR_NSID]) {
+                filter->net = ipe_get_net_by_id(nla_get_s32(tb[IPE_FILTER_ATTR_NSID]));
+                if (!filter->net)
+                        return -ENOENT;
+        }
+
+        return 0;
+}
+
+
+
+/* Called into context of sender, before first ipe_dump_links */
+int ipe_dump_start(struct netlink_callback *cb) {
+        struct nlattr *tb[IPE_ATTR_MAX + 1];
+        ipe_dump_filter_t *filter;
+        int err;
+
+        err = nlmsg_parse(cb->nlh, GENL_HDRLEN, tb, IPE_ATTR_MAX,
+                          ipe_dump_policy, NULL);
+        if (err)
+                return err;
+
+        filter = kzalloc(sizeof(ipe_dump_filter_t), GFP_KERNEL);
+        if (!filter)
+                return -ENOMEM;
+
+        err = parse_filter(filter, tb[IPE_ATTR_FILTER]);
+        if (err) {
+                kfree(filter);
+                return err;
+        }
+
+        cb->args[IPE_DUMP_FILTER] = (long)filter;
+
+        return 0;
+}
+
+
+int ipe_dump_done(struct netlink_callback *cb) {
+        ipe_dump_filter_t *filter = (ipe_dump_filter_t *)cb->args[IPE_DUMP_FILTER];
+
+        if (filter) {
+                if (filter->net)
+                        put_net(filter->net);
+                kfree(filter);
+        }
+
+        return 0;
+}
+
+
+
+static bool dump_match(const ipe_dump_filter_t *filter, ndev_t *dev) {
+        struct vlan_dev_priv *vlan;
+
+        if (!is_vlan_dev(dev))
+                return false;
+
+        vlan = vlan_dev_priv(dev);
+
+        if (filter->parent && vlan->real_dev->ifindex != filter->parent)
+                return false;
+        if (filter->proto && ntohs(vlan->vlan_proto) != filter->proto)
+                return false;
+
+        return vlan->vlan_id >= filter->vid_min && vlan->vlan_id <= filter->vid_max;
+}
+
+
+static int put_netnsid(struct sk_buff *skb, const int attr,
+                       struct net *src_net, struct net *net)
+{
+        if (net_eq(src_net, net))
+                return 0;
+
+        return nla_put_s32(skb, attr, peernet2id(src_net, net));
+}
+
+
+/* IPE_LINK_ATTR_* of VLAN device, under rcu_read_lock */
+static int put_link(struct sk_buff *skb, struct net *src_net, ndev_t *dev) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ndev_t *real_dev = READ_ONCE(vlan->real_dev);
+
+        if (nla_put_u32(skb, IPE_LINK_ATTR_IFINDEX, dev->ifindex) ||
+            nla_put_string(skb, IPE_LINK_ATTR_IFNAME, dev->name) ||
+            nla_put_u16(skb, IPE_LINK_ATTR_VID, vlan->vlan_id) ||
+            nla_put_u16(skb, IPE_LINK_ATTR_PROTO, ntohs(vlan->vlan_proto)) ||
+            nla_put_u32(skb, IPE_LINK_ATTR_PARENT, real_dev->ifindex) ||
+            nla_put_string(skb, IPE_LINK_ATTR_PARENT_NAME, real_dev->name) ||
+            nla_put_u32(skb, IPE_LINK_ATTR_NEST_LEVEL, vlan->nest_level) ||
+            put_netnsid(skb, IPE_LINK_ATTR_NETNSID, src_net, dev_net(dev)) ||
+            put_netnsid(skb, IPE_LINK_ATTR_PARENT_NETNSID, src_net,
+                                                           dev_net(real_dev)))
+                return -EMSGSIZE;
+
+        return 0;
+}
+
+
+static int fill_link(struct sk_buff *skb, struct netlink_callback *cb,
+                                                          ndev_t *dev)
+{
+        void *hdr;
+
+        hdr = genlmsg_put(skb, NETLINK_CB(cb->skb).portid, cb->nlh->nlmsg_seq,
+                          &ipe_genl_family, NLM_F_MULTI, IPE_CMD_DUMP);
+        if (!hdr)
+                return -EMSGSIZE;
+
+        if (put_link(skb, sock_net(cb->skb->sk), dev)) {
+                genlmsg_cancel(skb, hdr);
+                return -EMSGSIZE;
+        }
+
+        genlmsg_end(skb, hdr);
+        return 0;
+}
+
+
+
+/*
+ * dumpit of IPE_CMD_DUMP. Walks under RCU, like dump of rtnetlink it
+ * can skip or repeat devices, that were added or removed between callbacks.
+ */
+int ipe_dump_links(struct sk_buff *skb, struct netlink_callback *cb) {
+        const ipe_dump_filter_t *filter = (void *)cb->args[IPE_DUMP_FILTER];
+        long s_net_idx = cb->args[IPE_DUMP_NET];
+        long s_idx     = cb->args[IPE_DUMP_DEV];
+        long net_idx   = 0;
+        long idx       = 0;
+        struct net *net;
+        ndev_t *dev;
+
+        rcu_read_lock();
+        for_each_net_rcu(net) {
+                if (net_idx < s_net_idx)
+                        goto cont_net;
+                if (filter->net && !net_eq(net, filter->net))
+                        goto cont_net;
+
+                idx = 0;
+                for_each_netdev_rcu(net, dev) {
+                        if (idx < s_idx || !dump_match(filter, dev))
+                                goto cont;
+
+                        if (fill_link(skb, cb, dev) < 0)
+                                goto out;
+cont:
+                        idx++;
+                }
+                s_idx = 0;
+                idx   = 0;
+cont_net:
+                net_idx++;
+        }
+out:
+        rcu_read_unlock();
+
+        cb->args[IPE_DUMP_NET] = net_idx;
+        cb->args[IPE_DUMP_DEV] = idx;
+
+        trace_ipe_dump(net_idx, idx, skb->len);
+
+        return skb->len;
+}
+
+
+
+/* Size of reply of IPE_CMD_GET */
+size_t ipe_get_size(void) {
+        return nla_total_size(sizeof(u32)) +            /* IFINDEX */
+               nla_total_size(IFNAMSIZ) +               /* IFNAME */
+               nla_total_size(sizeof(u16)) +            /* VID */
+               nla_total_size(sizeof(u16)) +            /* PROTO */
+               nla_total_size(sizeof(u32)) +            /* PARENT */
+               nla_total_size(IFNAMSIZ) +               /* PARENT_NAME */
+               nla_total_size(sizeof(u32)) +            /* NEST_LEVEL */
+               nla_total_size(sizeof(s32)) +            /* NETNSID */
+               nla_total_size(sizeof(s32)) +            /* PARENT_NETNSID */
+               nla_total_size(sizeof(u8));              /* SLOT */
+}
+
+
+/*
+ * IPE_CMD_GET: attributes of VLAN device (IPE_SRC of @msg, it's netns is
+ * resolved) into @skb. Device is found and read under rcu_read_lock, it
+ * isn't pinned: nothing waits for rtnl_lock.
+ */
+int ipe_get_link(struct sk_buff *skb, const ipe_nlmsg_t *msg,
+                                      struct net *src_net)
+{
+        struct net *net = msg->net[IPE_SRC];
+        int res = IPE_OK;
+        ndev_t *dev;
+
+        rcu_read_lock();
+
+        dev = msg->ifindex[IPE_SRC] ?
+                dev_get_by_index_rcu(net, msg->ifindex[IPE_SRC]) :
+                dev_get_by_name_rcu(net, msg->devname[IPE_SRC]);
+        if (!dev) {
+                res = IPE_BAD_PTR;
+                goto unlock;
+        }
+
+        if (!is_vlan_dev(dev)) {
+                res = IPE_BAD_DEV;
+                goto unlock;
+        }
+
+        if (put_link(skb, src_net, dev) ||
+            nla_put_u8(skb, IPE_LINK_ATTR_SLOT, ipe_group_holds(dev)))
+                res = IPE_DEFAULT_FAIL;
+
+unlock:
+        rcu_read_unlock();
+
+        return res;
+}
@@ -0,0 +1,152 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     IPE_CMD_EVENT: each applied change of device is published into
+* multicast group "events". Event is sent after commit of undo log, so
+* rolled back changes are never published. Generation is increased for
+* each event: listener can see that events were lost (ENOBUFS).
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/rtnetlink.h>
+#include <net/net_namespace.h>
+#include <net/genetlink.h>
+
+#include "../include/ipe.h"
+#include "../include/ipeDump.h"
+#include "../include/ipeEvent.h"
+
+typedef struct net_device ndev_t;
+
+/* Changed under rtnl_lock only */
+static u32 ipe_event_gen;
+
+
+
+/* Must be called under rtnl_lock */
+void ipe_event_save(const ndev_t *dev, ipe_link_state_t *state) {
+        memset(state, 0, sizeof(ipe_link_state_t));
+        strlcpy(state->ifname, dev->name, IFNAMSIZ);
+
+        if (is_vlan_dev(dev)) {
+                const struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+
+                state->parent = vlan->real_dev->ifindex;
+                state->vid    = vlan->vlan_id;
+                state->proto  = ntohs(vlan->vlan_proto);
+        }
+}
+
+
+
+static int put_netnsid(struct sk_buff *skb, const int attr, struct net *net) {
+        if (net_eq(net, &init_net))
+                return 0;
+
+        return nla_put_s32(skb, attr, peernet2id(&init_net, net));
+}
+
+
+static int fill_event(struct sk_buff *skb, const ndev_t *dev,
+                      const ipe_link_state_t *old, const ipe_link_state_t *cur,
+                      const int change)
+{
+        void *hdr;
+
+        hdr = genlmsg_put(skb, 0, 0, &ipe_genl_family, 0, IPE_CMD_EVENT);
+        if (!hdr)
+                return -EMSGSIZE;
+
+        if (nla_put_u32(skb, IPE_LINK_ATTR_IFINDEX, dev->ifindex) ||
+            nla_put_string(skb, IPE_LINK_ATTR_IFNAME, cur->ifname) ||
+            nla_put_u8(skb, IPE_LINK_ATTR_CHANGE, change) ||
+            nla_put_u32(skb, IPE_LINK_ATTR_GENERATION, ++ipe_event_gen) ||
+            put_netnsid(skb, IPE_LINK_ATTR_NETNSID, dev_net(dev)))
+                goto cancel;
+
+        if (cur->parent) {
+                const ndev_t *real_dev = vlan_dev_priv(dev)->real_dev;
+
+                if (nla_put_u16(skb, IPE_LINK_ATTR_VID, cur->vid) ||
+                    nla_put_u16(skb, IPE_LINK_ATTR_PROTO, cur->proto) ||
+                    nla_put_u32(skb, IPE_LINK_ATTR_PARENT, cur->parent) ||
+                    nla_put_string(skb, IPE_LINK_ATTR_PARENT_NAME, real_dev->name) ||
+                    put_netnsid(skb, IPE_LINK_ATTR_PARENT_NETNSID, dev_net(real_dev)))
+                        goto cancel;
+        }
+
+        if ((old->vid != cur->vid &&
+             nla_put_u16(skb, IPE_LINK_ATTR_OLD_VID, old->vid)) ||
+            (old->proto != cur->proto &&
+             nla_put_u16(skb, IPE_LINK_ATTR_OLD_PROTO, old->proto)) ||
+            (old->parent != cur->parent &&
+             nla_put_u32(skb, IPE_LINK_ATTR_OLD_PARENT, old->parent)) ||
+            (strcmp(old->ifname, cur->ifname) &&
+             nla_put_string(skb, IPE_LINK_ATTR_OLD_IFNAME, old->ifname)))
+                goto cancel;
+
+        genlmsg_end(skb, hdr);
+        return 0;
+
+cancel:
+        genlmsg_cancel(skb, hdr);
+        return -EMSGSIZE;
+}
+
+
+/*
+ * Publish change of @dev, @old is state before change. Must be called 
+ * under rtnl_lock after commit. Nothing is allocated without listeners.
+ */
+void ipe_event_notify(const ndev_t *dev, const ipe_link_state_t *old,
+                                          const int change)
+{
+        ipe_link_state_t cur;
+        struct sk_buff *skb;
+
+        ASSERT_RTNL();
+
+        if (!genl_has_listeners(&ipe_genl_family, &init_net, IPE_MCGRP_EVENTS))
+                return;
+
+        ipe_event_save(dev, &cur);
+
+        skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
+        if (!skb)
+                goto lost;
+
+        if (fill_event(skb, dev, old, &cur, change)) {
+                nlmsg_free(skb);
+                goto lost;
+        }
+
+        genlmsg_multicast(&ipe_genl_family, skb, 0, IPE_MCGRP_EVENTS, GFP_KERNEL);
+        return;
+
+lost:
+        /* listeners see gap of generation */
+        ipe_event_gen++;
+        pr_warn_ratelimited("%s: event of %s is lost\n", __FUNCTION__, dev->name);
+}
+
+
+/* Event of applied operation: device is IPE_SRC, old state is saved */
+void ipe_event_op(const ipe_nlmsg_t *msg) {
+        if (msg->dev[IPE_SRC])
+                ipe_event_notify(msg->dev[IPE_SRC], &msg->old, msg->command);
+}
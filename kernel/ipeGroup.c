@@ -0,0 +1,200 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Reclaim of empty parts of vlan_group. vlan_group_prealloc_vid
+* allocates part of VLAN_GROUP_ARRAY_PART_LEN pointers, but nobody frees it
+* before vlan_info itself. struct vlan_group is layout of 8021q and 8021q
+* changes slots too, so occupancy of part can't be counted beside: part is
+* scanned when it's slot is freed. Empty part is unpublished under 
+* rtnl_lock and freed after RCU grace period, because RX path reads it 
+* without rtnl_lock.
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/rtnetlink.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeGroup.h"
+#include "../include/ipeOp.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+extern ndev_t *get_dev(const ipe_nlmsg_t *msg, const int id);
+
+/* Part is empty, but readers can be into it yet */
+typedef struct {
+        struct rcu_head         rcu;
+        ndev_t                **array;
+} ipe_part_free_t;
+
+
+
+static bool part_is_empty(ndev_t **array) {
+        int i;
+
+        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                if (array[i])
+                        return false;
+        }
+
+        return true;
+}
+
+
+static void part_free_rcu(struct rcu_head *head) {
+        ipe_part_free_t *part = container_of(head, ipe_part_free_t, rcu);
+
+        kfree(part->array);
+        kfree(part);
+}
+
+
+/* Return 1 if part is freed */
+static int reclaim_part(struct vlan_group *grp, const unsigned int pidx,
+                                                const unsigned int vidx)
+{
+        ndev_t **array = grp->vlan_devices_arrays[pidx][vidx];
+        ipe_part_free_t *part;
+
+        if (!array || !part_is_empty(array))
+                return 0;
+
+        /* without memory part stays, it can be compacted later */
+        part = kmalloc(sizeof(ipe_part_free_t), GFP_KERNEL);
+        if (!part)
+                return 0;
+
+        trace_ipe_part_free(grp, pidx, vidx);
+        WRITE_ONCE(grp->vlan_devices_arrays[pidx][vidx], NULL);
+
+        part->array = array;
+        call_rcu(&part->rcu, part_free_rcu);
+
+        return 1;
+}
+
+
+
+/*
+ * Free part of slot (@proto, @vid) if it's empty. Must be called under 
+ * rtnl_lock, after commit: rollback can return device into slot.
+ */
+void ipe_group_reclaim(struct vlan_group *grp, __be16 proto, u16 vid) {
+        unsigned int pidx = vlan_proto_idx(proto);
+
+        ASSERT_RTNL();
+
+        if (pidx >= IPE_GROUP_PROTOS)
+                return;
+
+        reclaim_part(grp, pidx, vid / VLAN_GROUP_ARRAY_PART_LEN);
+}
+
+
+/*
+ * Free empty parts of group that are into @parts (IPE_GROUP_PART), return
+ * number of them. Only rows of running 8021q are walked.
+ */
+int ipe_group_compact(struct vlan_group *grp, const unsigned long parts) {
+        unsigned int pidx, vidx;
+        int freed = 0;
+
+        ASSERT_RTNL();
+
+        for (pidx = 0; pidx < IPE_GROUP_PROTOS; ++pidx) {
+                for (vidx = 0; vidx < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++vidx) {
+                        if (parts & IPE_GROUP_PART(pidx, vidx * VLAN_GROUP_ARRAY_PART_LEN))
+                                freed += reclaim_part(grp, pidx, vidx);
+                }
+        }
+
+        return freed;
+}
+
+
+
+/* IPE_CMD_COMPACT: group of parent (IPE_SRC of @msg) */
+int compact_group(const ipe_nlmsg_t *msg, int *freed) {
+        struct vlan_info *vlan_info;
+        ndev_t *real_dev;
+        int res;
+
+        *freed = 0;
+
+        ipe_rtnl_lock(IPE_CMD_COMPACT);
+
+        real_dev = get_dev(msg, IPE_SRC);
+        if (IS_ERR_OR_NULL(real_dev)) {
+                res = IPE_BAD_PTR;
+                goto unlock;
+        }
+
+        res = ipe_op_verify(msg);
+        if (res)
+                goto put_dev;
+
+        /* parent without VLAN children has nothing to compact */
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+        if (vlan_info)
+                *freed = ipe_group_compact(&vlan_info->grp, IPE_GROUP_ALL);
+
+put_dev:
+        dev_put(real_dev);
+unlock:
+        ipe_rtnl_unlock(1);
+
+        return res;
+}
+
+
+/*
+ * VLAN device is into slot of it's (proto, VID) in group of parent. Called
+ * under rcu_read_lock only: vlan_info and parts are freed after grace
+ * period. Fields of device aren't read atomically, so it can be false
+ * while device is moved under rtnl_lock, caller can ask again.
+ */
+bool ipe_group_holds(const ndev_t *dev) {
+        const struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ndev_t *real_dev  = READ_ONCE(vlan->real_dev);
+        __be16 proto      = READ_ONCE(vlan->vlan_proto);
+        u16 vid           = READ_ONCE(vlan->vlan_id);
+        struct vlan_info *vlan_info;
+        ndev_t **array;
+        unsigned int pidx;
+
+        vlan_info = rcu_dereference(real_dev->vlan_info);
+        pidx      = vlan_proto_idx(proto);
+        if (!vlan_info || pidx >= IPE_GROUP_PROTOS || vid >= VLAN_N_VID)
+                return false;
+
+        array = READ_ONCE(vlan_info->grp.vlan_devices_arrays[pidx]
+                                        [vid / VLAN_GROUP_ARRAY_PART_LEN]);
+
+        return array && READ_ONCE(array[vid % VLAN_GROUP_ARRAY_PART_LEN]) == dev;
+}
+
+
+
+/* Wait for parts that are freed after grace period */
+void ipe_group_exit(void) {
+        rcu_barrier();
+}
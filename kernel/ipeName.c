@@ -0,0 +1,155 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Devices can be addressed by name instead of ifindex. Name is looked
+* up into name hash of netns once for each request and the device found is
+* pinned at once, so it isn't looked up again by ifindex and a rename
+* between lookup and pinning can't give other device. Batch keeps pinned
+* devices into cache, so the same parent into many operations costs one
+* lookup.
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/stringhash.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <net/net_namespace.h>
+
+#include "../include/ipe.h"
+#include "../include/ipeName.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+
+int ipe_name_cache_init(ipe_name_cache_t *cache, const int size) {
+        hash_init(cache->table);
+        cache->count = 0;
+        cache->size  = size;
+        cache->entry = kvmalloc_array(size, sizeof(ipe_name_entry_t), GFP_KERNEL);
+
+        return cache->entry ? IPE_OK : IPE_BAD_ALLOC;
+}
+
+/* Entries hold reference of device */
+void ipe_name_cache_destroy(ipe_name_cache_t *cache) {
+        int i;
+
+        for (i = 0; i < cache->count; ++i)
+                dev_put(cache->entry[i].dev);
+
+        kvfree(cache->entry);
+        cache->entry = NULL;
+        cache->count = 0;
+}
+
+
+
+static u32 name_key(const struct net *net, const char *name) {
+        return full_name_hash(net, name, strlen(name));
+}
+
+
+static ipe_name_entry_t *cache_find(ipe_name_cache_t *cache, 
+                                    const struct net *net, const char *name)
+{
+        ipe_name_entry_t *entry;
+
+        hash_for_each_possible(cache->table, entry, node, name_key(net, name)) {
+                if (entry->net == net && !strcmp(entry->name, name))
+                        return entry;
+        }
+
+        return NULL;
+}
+
+
+static void cache_add(ipe_name_cache_t *cache, struct net *net,
+                      const char *name, ndev_t *dev)
+{
+        ipe_name_entry_t *entry;
+
+        if (cache->count == cache->size)
+                return;
+
+        dev_hold(dev);
+
+        entry = &cache->entry[cache->count++];
+        entry->net = net;
+        entry->dev = dev;
+        strlcpy(entry->name, name, IFNAMSIZ);
+
+        hash_add(cache->table, &entry->node, name_key(net, name));
+}
+
+
+
+/* Device found by @name is pinned under the same RCU section */
+static ndev_t *lookup_dev(struct net *net, const char *name) {
+        ndev_t *dev;
+
+        rcu_read_lock();
+        dev = dev_get_by_name_rcu(net, name);
+        if (dev)
+                dev_hold(dev);
+        rcu_read_unlock();
+
+        if (!dev)
+                printk(KERN_WARNING "%s: fail search device %s\n",
+                                                __FUNCTION__, name);
+
+        return dev;
+}
+
+
+
+/*
+ * Pin devices that are given by name and fill their ifindex, ipe_op_pin
+ * skips them then. Name is resolved before the operation is applied, so
+ * it's name of device before request. Namespaces must be resolved by
+ * ipe_resolve_net. @cache can be NULL for single operation.
+ */
+int ipe_resolve_names(ipe_nlmsg_t *msg, ipe_name_cache_t *cache) {
+        ipe_name_entry_t *entry;
+        ndev_t *dev;
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                const char *name = msg->devname[id];
+
+                if (msg->dev[id] || msg->ifindex[id] || !name[0])
+                        continue;
+
+                entry = cache ? cache_find(cache, msg->net[id], name) : NULL;
+                if (entry) {
+                        dev = entry->dev;
+                        dev_hold(dev);
+                } else {
+                        dev = lookup_dev(msg->net[id], name);
+                        if (!dev)
+                                return IPE_BAD_PTR;
+                        if (cache)
+                                cache_add(cache, msg->net[id], name, dev);
+                }
+
+                msg->dev[id]     = dev;
+                msg->ifindex[id] = dev->ifindex;
+                trace_ipe_dev_resolve(id, msg->ifindex[id], dev);
+        }
+
+        return IPE_OK;
+}
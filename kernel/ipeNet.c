@@ -0,0 +1,187 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Network namespaces of operations. Namespace of each device is
+* resolved once for operation and reference is kept until operation is
+* done. Namespaces given by netnsid are cached: cache doesn't hold
+* reference (it would keep namespace alive), entry is removed by pernet
+* exit of namespace.
+*
+******************************************************************************/
+
+#include <linux/hashtable.h>
+#include <linux/spinlock.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+#include <net/net_namespace.h>
+
+#include "../include/ipe.h"
+#include "../include/ipeNet.h"
+
+#define IPE_NET_HASH_BITS       6
+
+typedef struct {
+        struct hlist_node       node;
+        int                     nsid;
+        struct net             *net;
+} ipe_net_entry_t;
+
+/* netnsid of init_net -> namespace */
+static DEFINE_HASHTABLE(ipe_net_table, IPE_NET_HASH_BITS);
+static DEFINE_SPINLOCK(ipe_net_lock);
+
+
+
+static void __net_exit ipe_net_ns_exit(struct net *net) {
+        ipe_net_entry_t *entry;
+        struct hlist_node *tmp;
+        int bkt;
+
+        spin_lock(&ipe_net_lock);
+        hash_for_each_safe(ipe_net_table, bkt, tmp, entry, node) {
+                if (entry->net == net) {
+                        hash_del(&entry->node);
+                        kfree(entry);
+                }
+        }
+        spin_unlock(&ipe_net_lock);
+}
+
+static struct pernet_operations ipe_net_ops = {
+        .exit = ipe_net_ns_exit,
+};
+
+
+int ipe_net_cache_init(void) {
+        return register_pernet_subsys(&ipe_net_ops);
+}
+
+void ipe_net_cache_exit(void) {
+        ipe_net_entry_t *entry;
+        struct hlist_node *tmp;
+        int bkt;
+
+        unregister_pernet_subsys(&ipe_net_ops);
+
+        /* entries of namespaces that are dying now */
+        spin_lock(&ipe_net_lock);
+        hash_for_each_safe(ipe_net_table, bkt, tmp, entry, node) {
+                hash_del(&entry->node);
+                kfree(entry);
+        }
+        spin_unlock(&ipe_net_lock);
+}
+
+
+
+/*
+ * Namespace by netnsid (for init_net, family isn't netnsok).
+ * ATTENTION! Returns reference, put_net must be called!
+ */
+struct net *ipe_get_net_by_id(const int nsid) {
+        ipe_net_entry_t *entry;
+        ipe_net_entry_t *new;
+        struct net *net = NULL;
+
+        spin_lock(&ipe_net_lock);
+        hash_for_each_possible(ipe_net_table, entry, node, nsid) {
+                if (entry->nsid == nsid) {
+                        /* fails if namespace is dying */
+                        net = maybe_get_net(entry->net);
+                        break;
+                }
+        }
+        spin_unlock(&ipe_net_lock);
+
+        if (net)
+                return net;
+
+        net = get_net_ns_by_id(&init_net, nsid);
+        if (!net)
+                return NULL;
+
+        /* without cache it works too */
+        new = kmalloc(sizeof(ipe_net_entry_t), GFP_KERNEL);
+        if (!new)
+                return net;
+
+        new->nsid = nsid;
+        new->net  = net;
+
+        spin_lock(&ipe_net_lock);
+        hash_for_each_possible(ipe_net_table, entry, node, nsid) {
+                if (entry->nsid == nsid) {
+                        /* nsid of dead namespace is reused */
+                        entry->net = net;
+                        kfree(new);
+                        new = NULL;
+                        break;
+                }
+        }
+        if (new)
+                hash_add(ipe_net_table, &new->node, nsid);
+        spin_unlock(&ipe_net_lock);
+
+        return net;
+}
+
+
+
+static struct net *get_net_of_dev(const ipe_nlmsg_t *msg, const int id) {
+        if (msg->nsid[id] != IPE_NO_NSID)
+                return ipe_get_net_by_id(msg->nsid[id]);
+
+        if (msg->nsfd[id] != IPE_GLOBAL_NS) {
+                struct net *net = get_net_ns_by_fd(msg->nsfd[id]);
+                return IS_ERR(net) ? NULL : net;
+        }
+
+        return get_net(&init_net);
+}
+
+
+/*
+ * Take namespaces of all devices of @msg, so get_dev don't resolve them
+ * again. Must be paired with ipe_release_net.
+ */
+int ipe_resolve_net(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->net[id])
+                        continue;
+
+                msg->net[id] = get_net_of_dev(msg, id);
+                if (!msg->net[id]) {
+                        printk(KERN_WARNING "%s: bad net_namespace: fd %d, nsid %d\n",
+                                   __FUNCTION__, msg->nsfd[id], msg->nsid[id]);
+                        return IPE_FAIL_NS;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+void ipe_release_net(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->net[id])
+                        put_net(msg->net[id]);
+                msg->net[id] = NULL;
+        }
+}
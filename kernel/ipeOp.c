@@ -0,0 +1,176 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Context of operation. Devices are looked up and pinned once, before
+* rtnl_lock: checker works with them under RCU, handler gets them under
+* rtnl_lock and verifies only that they are still registered into the same
+* namespace. Time of rtnl_lock is accumulated into "rtnl_stats" parameter
+* of module (write anything to reset it), wait and hold time of each
+* command go into histograms of ipeStats.c.
+*
+******************************************************************************/
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <net/net_namespace.h>
+
+#include "../include/ipe.h"
+#include "../include/ipeNet.h"
+#include "../include/ipeOp.h"
+#include "../include/ipeStats.h"
+#include "../include/ipeTrace.h"
+
+typedef struct net_device ndev_t;
+
+/* Changed under rtnl_lock only */
+static struct {
+        u64     start;
+        u64     total_ns;
+        u64     max_ns;
+        u64     locks;
+        u64     ops;
+        int     command;        /* IPE_CMD_* of holder */
+} ipe_rtnl_stats;
+
+
+
+/* @command -- IPE_CMD_* of request, for its stats */
+void ipe_rtnl_lock(const int command) {
+        u64 wait = ktime_get_ns();
+
+        rtnl_lock();
+        ipe_rtnl_stats.start   = ktime_get_ns();
+        ipe_rtnl_stats.command = command;
+
+        ipe_stats_wait(command, ipe_rtnl_stats.start - wait);
+}
+
+
+/* @ops -- operations applied into this critical section */
+void ipe_rtnl_unlock(const int ops) {
+        u64 hold = ktime_get_ns() - ipe_rtnl_stats.start;
+
+        ipe_rtnl_stats.total_ns += hold;
+        ipe_rtnl_stats.locks++;
+        ipe_rtnl_stats.ops += ops;
+        if (hold > ipe_rtnl_stats.max_ns)
+                ipe_rtnl_stats.max_ns = hold;
+
+        ipe_stats_hold(ipe_rtnl_stats.command, hold);
+
+        trace_ipe_rtnl_unlock(ipe_rtnl_stats.command, hold, ops);
+
+        rtnl_unlock();
+}
+
+
+static int rtnl_stats_get(char *buf, const struct kernel_param *kp) {
+        u64 locks = READ_ONCE(ipe_rtnl_stats.locks);
+        u64 ops   = READ_ONCE(ipe_rtnl_stats.ops);
+        u64 total = READ_ONCE(ipe_rtnl_stats.total_ns);
+
+        return scnprintf(buf, PAGE_SIZE,
+                         "locks %llu ops %llu total_ns %llu max_ns %llu avg_op_ns %llu\n",
+                         locks, ops, total, READ_ONCE(ipe_rtnl_stats.max_ns),
+                         ops ? div64_u64(total, ops) : 0);
+}
+
+static int rtnl_stats_reset(const char *val, const struct kernel_param *kp) {
+        rtnl_lock();
+        memset(&ipe_rtnl_stats, 0, sizeof(ipe_rtnl_stats));
+        rtnl_unlock();
+
+        return 0;
+}
+
+static const struct kernel_param_ops rtnl_stats_ops = {
+        .set = rtnl_stats_reset,
+        .get = rtnl_stats_get,
+};
+
+module_param_cb(rtnl_stats, &rtnl_stats_ops, NULL, 0644);
+MODULE_PARM_DESC(rtnl_stats, "time of rtnl_lock held by ipe, write to reset");
+
+
+
+/*
+ * Take reference of devices of @msg given by ifindex. Namespaces and names
+ * must be resolved already, devices given by name are pinned by then.
+ * Device that is not given stays NULL.
+ */
+int ipe_op_pin(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->dev[id] || !msg->ifindex[id])
+                        continue;
+
+                msg->dev[id] = dev_get_by_index(msg->net[id], msg->ifindex[id]);
+                trace_ipe_dev_resolve(id, msg->ifindex[id], msg->dev[id]);
+                if (!msg->dev[id]) {
+                        printk(KERN_WARNING "%s: fail search device #%d info net_namespace [%d]\n",
+                               __FUNCTION__, msg->ifindex[id], msg->nsfd[id]);
+                        return IPE_BAD_PTR;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+/*
+ * Must be called under rtnl_lock. Reference keeps device from freeing,
+ * but it can be unregistered or moved into other netns since pinning.
+ */
+int ipe_op_verify(const ipe_nlmsg_t *msg) {
+        int id;
+
+        ASSERT_RTNL();
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                ndev_t *dev = msg->dev[id];
+
+                if (!dev)
+                        continue;
+
+                if (dev->reg_state != NETREG_REGISTERED ||
+                    !net_eq(dev_net(dev), msg->net[id])) {
+                        printk(KERN_WARNING "%s: device %s is gone since check\n",
+                                                        __FUNCTION__, dev->name);
+                        return IPE_BAD_PTR;
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+/* Put devices and namespaces of @msg, works for partly resolved too */
+void ipe_op_release(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->dev[id])
+                        dev_put(msg->dev[id]);
+                msg->dev[id] = NULL;
+        }
+
+        ipe_release_net(msg);
+}
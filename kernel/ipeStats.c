@@ -0,0 +1,324 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Counters of commands: calls, failures by IPE_* code and log2
+* histograms of rtnl_lock wait, rtnl_lock hold and total latency. Counters
+* are per-CPU and are summed only by reader, so they stay enabled always.
+* Operations of batch are counted by own command, latency and rtnl_lock
+* time are of whole batch ("batch").
+*
+*     Text of <debugfs>/ipe/stats, one value per line (write to reset):
+*
+*       version 1
+*       <command> calls <n>
+*       <command> error <IPE_* name | other> <n>        (only non-zero)
+*       <command> <hist> sum <ns>
+*       <command> <hist> count <n>
+*       <command> <hist> bucket <upper bound ns | inf> <n> (only non-zero)
+*
+* where <hist> is wait_ns, hold_ns or latency_ns. Bucket holds values less
+* than its bound and not less than bound of previous one.
+*
+******************************************************************************/
+
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeStats.h"
+
+#define IPE_STATS_VERSION       1
+#define IPE_STATS_BAD_PROTO     IPE_ERR_COUNT   /* IPE_BAD_VLAN_PROTO < 0 */
+#define IPE_STATS_OTHER         (IPE_ERR_COUNT + 1) /* code isn't IPE_* */
+#define IPE_STATS_CODES         (IPE_ERR_COUNT + 2)
+
+typedef struct {
+        u64     count[IPE_STATS_BUCKETS];
+        u64     sum_ns;
+} ipe_hist_t;
+
+typedef struct {
+        u64             calls;
+        u64             errors[IPE_STATS_CODES];
+        ipe_hist_t      wait;
+        ipe_hist_t      hold;
+        ipe_hist_t      latency;
+} ipe_cmd_stats_t;
+
+typedef struct {
+        ipe_cmd_stats_t cmd[IPE_CMD_MAX + 1];
+} ipe_stats_t;
+
+
+static ipe_stats_t __percpu *ipe_stats;
+static struct dentry *ipe_debugfs;
+
+/* Commands without name aren't counted */
+static const char *ipe_cmd_name[IPE_CMD_MAX + 1] = {
+        [IPE_CMD_UNSPEC]        = "unknown",
+        [IPE_CMD_SET_VID]       = "set_vid",
+        [IPE_CMD_SET_ETH]       = "set_eth",
+        [IPE_CMD_SET_NAME]      = "set_name",
+        [IPE_CMD_SET_PARENT]    = "set_parent",
+        [IPE_CMD_SHOW]          = "show_vlan_info",
+        [IPE_CMD_LIST]          = "print_list_ndev",
+        [IPE_CMD_BATCH]         = "batch",
+        [IPE_CMD_RENUMBER]      = "renumber",
+        [IPE_CMD_COMPACT]       = "compact",
+        [IPE_CMD_FAILOVER]      = "failover",
+        [IPE_CMD_CONVERT]       = "convert",
+        [IPE_CMD_RENAME]        = "rename",
+        [IPE_CMD_GET]           = "get",
+};
+
+static const char *ipe_code_name[IPE_STATS_CODES] = {
+        [IPE_OK]                = "IPE_OK",
+        [IPE_BAD_ARG]           = "IPE_BAD_ARG",
+        [IPE_BAD_VID]           = "IPE_BAD_VID",
+        [IPE_BAD_PTR]           = "IPE_BAD_PTR",
+        [IPE_BAD_DEV]           = "IPE_BAD_DEV",
+        [IPE_BAD_IF_IDX]        = "IPE_BAD_IF_IDX",
+        [IPE_UNKNOWN_COMMAND]   = "IPE_UNKNOWN_COMMAND",
+        [IPE_FAIL_NS]           = "IPE_FAIL_NS",
+        [IPE_FAIL_CR_SOC]       = "IPE_FAIL_CR_SOC",
+        [IPE_FEW_ARG]           = "IPE_FEW_ARG",
+        [IPE_NULLPTR]           = "IPE_NULLPTR",
+        [IPE_BAD_SOC]           = "IPE_BAD_SOC",
+        [IPE_BAD_ALLOC]         = "IPE_BAD_ALLOC",
+        [IPE_DEFAULT_FAIL]      = "IPE_DEFAULT_FAIL",
+        [IPE_SKIPPED]           = "IPE_SKIPPED",
+        [IPE_ROLLED_BACK]       = "IPE_ROLLED_BACK",
+        [IPE_STATS_BAD_PROTO]   = "IPE_BAD_VLAN_PROTO",
+        [IPE_STATS_OTHER]       = "other",
+};
+
+
+
+static int cmd_index(const int command) {
+        if (command <= IPE_CMD_UNSPEC || command > IPE_CMD_MAX ||
+            !ipe_cmd_name[command])
+                return IPE_CMD_UNSPEC;
+
+        return command;
+}
+
+
+static void hist_add(ipe_hist_t __percpu *hist, const u64 ns) {
+        int bucket = fls64(ns);
+
+        if (bucket >= IPE_STATS_BUCKETS)
+                bucket = IPE_STATS_BUCKETS - 1;
+
+        this_cpu_inc(hist->count[bucket]);
+        this_cpu_add(hist->sum_ns, ns);
+}
+
+
+
+/* Calls and exit code only: for operations of batch */
+void ipe_stats_count(const int command, const int res) {
+        ipe_cmd_stats_t __percpu *stats = &ipe_stats->cmd[cmd_index(command)];
+
+        this_cpu_inc(stats->calls);
+        if (res == IPE_OK)
+                return;
+
+        if (res > IPE_OK && res < IPE_ERR_COUNT)
+                this_cpu_inc(stats->errors[res]);
+        else if (res == IPE_BAD_VLAN_PROTO)
+                this_cpu_inc(stats->errors[IPE_STATS_BAD_PROTO]);
+        else
+                this_cpu_inc(stats->errors[IPE_STATS_OTHER]);
+}
+
+
+/* Request is done: @start is ktime_get_ns() of its receiving */
+void ipe_stats_op(const int command, const int res, const u64 start) {
+        ipe_stats_count(command, res);
+        hist_add(&ipe_stats->cmd[cmd_index(command)].latency,
+                 ktime_get_ns() - start);
+}
+
+
+void ipe_stats_batch(const ipe_batch_t *batch, const int *retcode,
+                     const int res, const u64 start)
+{
+        int i;
+
+        for (i = 0; i < batch->count; ++i)
+                ipe_stats_count(batch->ops[i].command, retcode[i]);
+
+        ipe_stats_op(IPE_CMD_BATCH, res, start);
+}
+
+
+void ipe_stats_wait(const int command, const u64 ns) {
+        hist_add(&ipe_stats->cmd[cmd_index(command)].wait, ns);
+}
+
+void ipe_stats_hold(const int command, const u64 ns) {
+        hist_add(&ipe_stats->cmd[cmd_index(command)].hold, ns);
+}
+
+
+
+static void hist_sum(ipe_hist_t *sum, const ipe_hist_t *hist) {
+        int i;
+
+        for (i = 0; i < IPE_STATS_BUCKETS; ++i)
+                sum->count[i] += READ_ONCE(hist->count[i]);
+        sum->sum_ns += READ_ONCE(hist->sum_ns);
+}
+
+
+static void cmd_sum(ipe_cmd_stats_t *sum, const int command) {
+        int cpu;
+        int i;
+
+        memset(sum, 0, sizeof(ipe_cmd_stats_t));
+
+        for_each_possible_cpu(cpu) {
+                const ipe_cmd_stats_t *stats = &per_cpu_ptr(ipe_stats, cpu)->cmd[command];
+
+                sum->calls += READ_ONCE(stats->calls);
+                for (i = 0; i < IPE_STATS_CODES; ++i)
+                        sum->errors[i] += READ_ONCE(stats->errors[i]);
+
+                hist_sum(&sum->wait, &stats->wait);
+                hist_sum(&sum->hold, &stats->hold);
+                hist_sum(&sum->latency, &stats->latency);
+        }
+}
+
+
+static void show_hist(struct seq_file *m, const char *cmd, const char *name,
+                                                      const ipe_hist_t *hist)
+{
+        u64 count = 0;
+        int i;
+
+        for (i = 0; i < IPE_STATS_BUCKETS; ++i)
+                count += hist->count[i];
+
+        seq_printf(m, "%s %s sum %llu\n", cmd, name, hist->sum_ns);
+        seq_printf(m, "%s %s count %llu\n", cmd, name, count);
+
+        for (i = 0; i < IPE_STATS_BUCKETS - 1; ++i) {
+                if (hist->count[i])
+                        seq_printf(m, "%s %s bucket %llu %llu\n",
+                                   cmd, name, 1ULL << i, hist->count[i]);
+        }
+
+        if (hist->count[i])
+                seq_printf(m, "%s %s bucket inf %llu\n", cmd, name, hist->count[i]);
+}
+
+
+static int stats_show(struct seq_file *m, void *v) {
+        ipe_cmd_stats_t *sum;
+        int command;
+        int i;
+
+        sum = kmalloc(sizeof(ipe_cmd_stats_t), GFP_KERNEL);
+        if (!sum)
+                return -ENOMEM;
+
+        seq_printf(m, "version %d\n", IPE_STATS_VERSION);
+
+        for (command = 0; command <= IPE_CMD_MAX; ++command) {
+                const char *cmd = ipe_cmd_name[command];
+
+                if (!cmd)
+                        continue;
+
+                cmd_sum(sum, command);
+
+                seq_printf(m, "%s calls %llu\n", cmd, sum->calls);
+                for (i = IPE_OK + 1; i < IPE_STATS_CODES; ++i) {
+                        if (sum->errors[i])
+                                seq_printf(m, "%s error %s %llu\n",
+                                           cmd, ipe_code_name[i], sum->errors[i]);
+                }
+
+                show_hist(m, cmd, "wait_ns", &sum->wait);
+                show_hist(m, cmd, "hold_ns", &sum->hold);
+                show_hist(m, cmd, "latency_ns", &sum->latency);
+        }
+
+        kfree(sum);
+
+        return 0;
+}
+
+
+static int stats_open(struct inode *inode, struct file *file) {
+        return single_open(file, stats_show, NULL);
+}
+
+
+/* Counters are zeroed without stopping writers, increment can be lost */
+static ssize_t stats_reset(struct file *file, const char __user *buf,
+                                        size_t count, loff_t *ppos)
+{
+        int cpu;
+
+        for_each_possible_cpu(cpu)
+                memset(per_cpu_ptr(ipe_stats, cpu), 0, sizeof(ipe_stats_t));
+
+        return count;
+}
+
+static const struct file_operations ipe_stats_fops = {
+        .owner          = THIS_MODULE,
+        .open           = stats_open,
+        .read           = seq_read,
+        .write          = stats_reset,
+        .llseek         = seq_lseek,
+        .release        = single_release,
+};
+
+
+
+int ipe_stats_init(void) {
+        ipe_stats = alloc_percpu(ipe_stats_t);
+        if (!ipe_stats)
+                return -ENOMEM;
+
+        /* counters work without debugfs too */
+        ipe_debugfs = debugfs_create_dir(THIS_MODULE->name, NULL);
+        if (IS_ERR_OR_NULL(ipe_debugfs)) {
+                printk(KERN_WARNING "%s: debugfs isn't available, stats are hidden\n",
+                                                                __FUNCTION__);
+                ipe_debugfs = NULL;
+                return 0;
+        }
+
+        debugfs_create_file("stats", 0600, ipe_debugfs, NULL, &ipe_stats_fops);
+
+        return 0;
+}
+
+/* Must be called when no request can be running */
+void ipe_stats_exit(void) {
+        debugfs_remove_recursive(ipe_debugfs);
+        free_percpu(ipe_stats);
+}
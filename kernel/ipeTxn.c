@@ -0,0 +1,299 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Undo log for changes of VLAN devices (see include/ipeTxn.h)
+*
+******************************************************************************/
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+#include <linux/rtnetlink.h>
+#include <linux/slab.h>
+
+#include "../include/ipe.h"
+#include "../include/vlan.h"
+#include "../include/ipeTxn.h"
+#include "../include/ipeGroup.h"
+#include "../include/ipeTrace.h"
+
+#define IPE_TXN_MIN_SIZE        16
+
+
+void ipe_txn_init(ipe_txn_t *txn) {
+        txn->count = 0;
+        txn->size  = 0;
+        txn->log   = NULL;
+}
+
+void ipe_txn_destroy(ipe_txn_t *txn) {
+        kfree(txn->log);
+        ipe_txn_init(txn);
+}
+
+
+/* Prepare space for @count records, so next records can't fail */
+int ipe_txn_reserve(ipe_txn_t *txn, const int count) {
+        ipe_undo_t *log;
+        int size;
+
+        if (txn->count + count <= txn->size)
+                return IPE_OK;
+
+        size = max(txn->size * 2, txn->count + count);
+        size = max(size, IPE_TXN_MIN_SIZE);
+
+        log = krealloc(txn->log, size * sizeof(ipe_undo_t), GFP_KERNEL);
+        if (!log) {
+                printk(KERN_ERR "%s: fail alloc undo log for %d records\n",
+                                                        __FUNCTION__, size);
+                return IPE_BAD_ALLOC;
+        }
+
+        txn->log  = log;
+        txn->size = size;
+
+        return IPE_OK;
+}
+
+
+static ipe_undo_t *txn_record(ipe_txn_t *txn, const int type,
+                                         struct net_device *dev)
+{
+        ipe_undo_t *undo;
+
+        BUG_ON(txn->count >= txn->size);
+
+        undo = &txn->log[txn->count++];
+        undo->type = type;
+        undo->dev  = dev;
+
+        return undo;
+}
+
+
+void ipe_txn_set_device(ipe_txn_t *txn, struct vlan_group *grp,
+                        __be16 proto, u16 vid, struct net_device *dev)
+{
+        ipe_undo_t *undo = txn_record(txn, IPE_UNDO_SLOT, dev);
+
+        undo->slot.grp   = grp;
+        undo->slot.old   = vlan_group_get_device(grp, proto, vid);
+        undo->slot.proto = proto;
+        undo->slot.vid   = vid;
+
+        trace_ipe_slot_change(grp, proto, vid, undo->slot.old, dev);
+        vlan_group_set_device(grp, proto, vid, dev);
+}
+
+void ipe_txn_del_device(ipe_txn_t *txn, struct vlan_group *grp,
+                        __be16 proto, u16 vid)
+{
+        ipe_txn_set_device(txn, grp, proto, vid, NULL);
+}
+
+
+void ipe_txn_set_vid(ipe_txn_t *txn, struct net_device *dev, u16 vid) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ipe_undo_t *undo = txn_record(txn, IPE_UNDO_VID, dev);
+
+        undo->vid      = vlan->vlan_id;
+        vlan->vlan_id  = vid;
+}
+
+void ipe_txn_set_proto(ipe_txn_t *txn, struct net_device *dev, __be16 proto) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ipe_undo_t *undo = txn_record(txn, IPE_UNDO_PROTO, dev);
+
+        undo->proto      = vlan->vlan_proto;
+        vlan->vlan_proto = proto;
+}
+
+
+/* Moves reference of struct vlan_dev_priv from old real_dev to new */
+static void swap_real_dev(struct net_device *dev, struct net_device *real_dev) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        struct net_device *old = vlan->real_dev;
+
+        dev_hold(real_dev);
+        vlan->real_dev = real_dev;
+        dev_put(old);
+}
+
+void ipe_txn_set_real_dev(ipe_txn_t *txn, struct net_device *dev,
+                                          struct net_device *real_dev)
+{
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ipe_undo_t *undo = txn_record(txn, IPE_UNDO_REAL_DEV, dev);
+
+        undo->real.dev        = vlan->real_dev;
+        undo->real.nest_level = vlan->nest_level;
+        swap_real_dev(dev, real_dev);
+        /* as register_vlan_dev: lockdep subclass of address lists */
+        vlan->nest_level = dev_get_nest_level(real_dev) + 1;
+}
+
+
+/*
+ * dev_change_name updates name hash of netns and notifies listeners
+ * (NETDEV_CHANGENAME, RTM_NEWLINK). @name with "%d" gets free number.
+ */
+int ipe_txn_set_name(ipe_txn_t *txn, struct net_device *dev,
+                                               const char *name)
+{
+        char old[IFNAMSIZ];
+        int err;
+
+        strlcpy(old, dev->name, IFNAMSIZ);
+
+        err = dev_change_name(dev, name);
+        if (err < 0)
+                return err;
+
+        strlcpy(txn_record(txn, IPE_UNDO_NAME, dev)->name, old, IFNAMSIZ);
+        return IPE_OK;
+}
+
+
+int ipe_txn_upper_link(ipe_txn_t *txn, struct net_device *lower,
+                                       struct net_device *upper)
+{
+        int err = netdev_upper_dev_link(lower, upper);
+        if (err < 0)
+                return err;
+
+        txn_record(txn, IPE_UNDO_LINK, upper)->lower = lower;
+        return IPE_OK;
+}
+
+void ipe_txn_upper_unlink(ipe_txn_t *txn, struct net_device *lower,
+                                          struct net_device *upper)
+{
+        txn_record(txn, IPE_UNDO_UNLINK, upper)->lower = lower;
+        netdev_upper_dev_unlink(lower, upper);
+}
+
+
+int ipe_txn_vid_add(ipe_txn_t *txn, struct net_device *real_dev,
+                                    __be16 proto, u16 vid)
+{
+        ipe_undo_t *undo;
+        int err = vlan_vid_add(real_dev, proto, vid);
+        if (err)
+                return err;
+
+        undo = txn_record(txn, IPE_UNDO_VID_ADD, real_dev);
+        undo->slot.proto = proto;
+        undo->slot.vid   = vid;
+
+        return IPE_OK;
+}
+
+
+void ipe_txn_vid_del(ipe_txn_t *txn, struct net_device *real_dev,
+                                     __be16 proto, u16 vid)
+{
+        ipe_undo_t *undo = txn_record(txn, IPE_UNDO_VID_DEL, real_dev);
+
+        undo->slot.proto = proto;
+        undo->slot.vid   = vid;
+}
+
+
+static void txn_undo(ipe_undo_t *undo) {
+        struct vlan_dev_priv *vlan;
+
+        switch (undo->type) {
+        case IPE_UNDO_SLOT:
+                trace_ipe_slot_change(undo->slot.grp, undo->slot.proto,
+                                      undo->slot.vid, undo->dev, undo->slot.old);
+                vlan_group_set_device(undo->slot.grp, undo->slot.proto,
+                                      undo->slot.vid, undo->slot.old);
+                break;
+        case IPE_UNDO_VID:
+                vlan = vlan_dev_priv(undo->dev);
+                vlan->vlan_id = undo->vid;
+                break;
+        case IPE_UNDO_PROTO:
+                vlan = vlan_dev_priv(undo->dev);
+                vlan->vlan_proto = undo->proto;
+                break;
+        case IPE_UNDO_REAL_DEV:
+                swap_real_dev(undo->dev, undo->real.dev);
+                vlan = vlan_dev_priv(undo->dev);
+                vlan->nest_level = undo->real.nest_level;
+                break;
+        case IPE_UNDO_LINK:
+                netdev_upper_dev_unlink(undo->lower, undo->dev);
+                break;
+        case IPE_UNDO_UNLINK:
+                if (netdev_upper_dev_link(undo->lower, undo->dev) < 0)
+                        printk(KERN_ERR "%s: fail restore link %s -> %s!\n",
+                               __FUNCTION__, undo->lower->name, undo->dev->name);
+                break;
+        case IPE_UNDO_VID_ADD:
+                vlan_vid_del(undo->dev, undo->slot.proto, undo->slot.vid);
+                break;
+        case IPE_UNDO_NAME:
+                if (dev_change_name(undo->dev, undo->name) < 0)
+                        printk(KERN_ERR "%s: fail restore name %s of %s!\n",
+                               __FUNCTION__, undo->name, undo->dev->name);
+                break;
+        case IPE_UNDO_VID_DEL:
+                /* filter isn't deleted yet */
+                break;
+        }
+}
+
+
+/* 
+ * Forget all records: changes stay applied. Parts of vlan_group that
+ * became empty are freed only now, rollback would need them. Filters of
+ * old VIDs are deleted after all new ones are added, so device is
+ * programmed with difference of transaction only.
+ */
+void ipe_txn_commit(ipe_txn_t *txn) {
+        int i;
+
+        ASSERT_RTNL();
+
+        for (i = 0; i < txn->count; ++i) {
+                const ipe_undo_t *undo = &txn->log[i];
+
+                switch (undo->type) {
+                case IPE_UNDO_SLOT:
+                        if (!undo->dev)
+                                ipe_group_reclaim(undo->slot.grp, undo->slot.proto,
+                                                                  undo->slot.vid);
+                        break;
+                case IPE_UNDO_VID_DEL:
+                        vlan_vid_del(undo->dev, undo->slot.proto, undo->slot.vid);
+                        break;
+                }
+        }
+
+        txn->count = 0;
+}
+
+
+/* Replay log in reverse order */
+void ipe_txn_rollback(ipe_txn_t *txn) {
+        ASSERT_RTNL();
+
+        trace_ipe_txn_rollback(txn->count);
+
+        while (txn->count > 0)
+                txn_undo(&txn->log[--txn->count]);
+}
@@ -0,0 +1,318 @@
+#! /bin/bash
+#
+# Control-plane benchmark: ipe operations against "ip link del" + "ip link
+# add" of the same VLAN. Module must be loaded, ../ipe must be built.
+#
+# Usage: ipe_bench.sh [ -n VLANS ] [ -p PARENTS ] [ -s SAMPLES ]
+#                     [ -t dummy | veth ] [ -o FILE ]
+#
+#   -n  VLANs for each parent, 100..4093 (one VID stays free for moves)
+#   -p  parents, each of them gets VLANS children
+#   -s  operations of each kind
+#   -t  type of parents
+#   -o  results (JSON), default ipe_bench_<date>.json
+#
+# Everything is created into throwaway netns, that is deleted on exit.
+# Each operation is measured in two modes:
+#   single -- one process per operation: ipe or "ip -batch -" with del and
+#             add, latency percentiles are of these runs (fork included);
+#   batch  -- all operations by one process: ipe -batch or ip -batch.
+# Operations of baseline are the reverse of ipe's ones, so each pass
+# leaves devices for the next one.
+#
+# Compare files of two module builds, e.g. with jq:
+#   jq -r '.results[] | [.op, .tool, .mode, .ops_per_sec] | @tsv' FILE
+#
+set -e
+
+VLANS=1000
+PARENTS=2
+SAMPLES=500
+TYPE="dummy"
+OUT="ipe_bench_$(date +%Y%m%d%H%M%S).json"
+
+NS="ipe_bench_$$"
+IPE="../ipe"
+SPARE="bspare"
+ETH_8021AD=34984
+
+while getopts "n:p:s:t:o:" opt; do
+        case ${opt} in
+        n) VLANS=${OPTARG} ;;
+        p) PARENTS=${OPTARG} ;;
+        s) SAMPLES=${OPTARG} ;;
+        t) TYPE=${OPTARG} ;;
+        o) OUT=${OPTARG} ;;
+        *) sed -n '6,13p' $0; exit 1 ;;
+        esac
+done
+
+if (( BASH_VERSINFO[0] < 5 )); then
+        echo "bash 5 is required (EPOCHREALTIME)"
+        exit 1
+fi
+if [[ ! -d /sys/module/ipe ]]; then
+        echo "module ipe isn't loaded"
+        exit 1
+fi
+if (( VLANS < 100 || VLANS > 4093 || PARENTS < 1 )); then
+        echo "VLANS must be into 100..4093, PARENTS at least 1"
+        exit 1
+fi
+if (( SAMPLES < 1 || SAMPLES > VLANS * PARENTS )); then
+        SAMPLES=$(( VLANS * PARENTS ))
+fi
+if [[ ${TYPE} != "dummy" && ${TYPE} != "veth" ]]; then
+        echo "type of parents must be dummy or veth"
+        exit 1
+fi
+
+TMP=$(mktemp -d)
+RESULTS=()
+
+function cleanup() {
+        ip netns del ${NS} 2>/dev/null || true
+        rm -rf ${TMP}
+}
+trap cleanup EXIT
+
+# Failed operation makes numbers meaningless: stop without results
+# Usage: fail WHAT
+function fail() {
+        echo "$1 failed, results aren't written" >&2
+        exit 1
+}
+
+
+# Current state of sampled VLANs, index is number of sample
+NAME=()
+VID=()
+PARENT=()
+# the only free VID of each parent
+HOLE=()
+
+function add_parent() {
+        if [[ ${TYPE} == "veth" ]]; then
+                echo "link add $1 type veth peer name $1p"
+                echo "link set $1p up"
+        else
+                echo "link add $1 type dummy"
+        fi
+        echo "link set $1 up"
+}
+
+function setup() {
+        local p v
+
+        ip netns add ${NS}
+        {
+                for ((p = 0; p < PARENTS; ++p)); do
+                        add_parent bp$p
+                        for ((v = 1; v <= VLANS; ++v)); do
+                                echo "link add link bp$p name b${p}v${v} type vlan id ${v}"
+                        done
+                done
+                add_parent ${SPARE}
+        } > ${TMP}/setup
+        ip -n ${NS} -batch ${TMP}/setup
+
+        for ((p = 0; p < PARENTS; ++p)); do
+                HOLE[p]=$(( VLANS + 1 ))
+        done
+
+        # spread over parents and VIDs
+        for ((k = 0; k < SAMPLES; ++k)); do
+                p=$(( k % PARENTS ))
+                v=$(( 1 + (k / PARENTS) % VLANS ))
+                NAME[k]="b${p}v${v}"
+                VID[k]=${v}
+                PARENT[k]=${p}
+        done
+}
+
+
+# Baseline of one operation: delete VLAN and create it again
+# Usage: recreate NAME NEW_NAME PARENT VID PROTO
+function recreate() {
+        echo "link del $1"
+        echo "link add link $3 name $2 type vlan proto $5 id $4"
+}
+
+
+# Lines of operation for each sample, state is updated.
+# Usage: gen_ops OP ipe|ip
+function gen_ops() {
+        local k p new
+
+        for ((k = 0; k < SAMPLES; ++k)); do
+                p="bp${PARENT[k]}"
+
+                case $1-$2 in
+                set_vid-ipe|set_vid-ip)
+                        new=${HOLE[PARENT[k]]}
+                        HOLE[PARENT[k]]=${VID[k]}
+                        VID[k]=${new}
+                        if [[ $2 == "ipe" ]]; then
+                                echo "dev ${NAME[k]} netns ${NS} id ${new}"
+                        else
+                                recreate ${NAME[k]} ${NAME[k]} $p ${new} 802.1Q
+                        fi
+                        ;;
+                set_eth-ipe)
+                        echo "dev ${NAME[k]} netns ${NS} eth ${ETH_8021AD}"
+                        ;;
+                set_eth-ip)
+                        recreate ${NAME[k]} ${NAME[k]} $p ${VID[k]} 802.1Q
+                        ;;
+                set_name-ipe)
+                        echo "dev ${NAME[k]} netns ${NS} name ${NAME[k]}r"
+                        ;;
+                set_name-ip)
+                        recreate ${NAME[k]}r ${NAME[k]} $p ${VID[k]} 802.1Q
+                        ;;
+                set_parent-ipe)
+                        # VIDs of the first parent only, spare has no VLANs.
+                        # Parent of any type is accepted, dummy one too
+                        (( PARENT[k] == 0 )) || continue
+                        echo "dev ${NAME[k]} netns ${NS} dst ${SPARE} dstns ${NS} prev"
+                        ;;
+                set_parent-ip)
+                        (( PARENT[k] == 0 )) || continue
+                        recreate ${NAME[k]} ${NAME[k]} $p ${VID[k]} 802.1Q
+                        ;;
+                esac
+        done
+}
+
+
+# Usage: percentile SORTED_FILE COUNT P (P of 1000), microseconds
+function percentile() {
+        local idx=$(( ($2 * $3 + 999) / 1000 ))
+
+        (( idx < 1 )) && idx=1
+        sed -n "${idx}p" $1
+}
+
+# Usage: add_result OP TOOL MODE OPS ELAPSED_US [ LATENCY_FILE ]
+function add_result() {
+        local rate=$(awk -v n=$4 -v us=$5 'BEGIN { printf "%.1f", us ? n * 1e6 / us : 0 }')
+        local res="{\"op\": \"$1\", \"tool\": \"$2\", \"mode\": \"$3\", \"ops\": $4, \"ops_per_sec\": ${rate}"
+        local p50 p99 p999
+
+        if [[ -n $6 ]]; then
+                sort -n $6 > $6.sorted
+                p50=$(percentile $6.sorted $4 500)
+                p99=$(percentile $6.sorted $4 990)
+                p999=$(percentile $6.sorted $4 999)
+                res+=", \"p50_us\": ${p50}, \"p99_us\": ${p99}, \"p999_us\": ${p999}"
+        fi
+
+        RESULTS+=("${res}}")
+        printf "%-10s %-9s %-6s %6d ops %10s ops/s %8s %8s %8s\n" \
+               $1 $2 $3 $4 ${rate} ${p50:--} ${p99:--} ${p999:--}
+}
+
+
+# One process for each operation
+# Usage: run_single OP TOOL
+function run_single() {
+        local lat=${TMP}/$1-$2.lat
+        local total=0
+        local n=0
+        local line add t0 t1
+
+        gen_ops $1 $2 > ${TMP}/ops
+        : > ${lat}
+
+        if [[ $2 == "ipe" ]]; then
+                while read -r line; do
+                        t0=${EPOCHREALTIME/./}
+                        ${IPE} ${line} > /dev/null || fail "ipe ${line}"
+                        t1=${EPOCHREALTIME/./}
+                        echo $(( t1 - t0 )) >> ${lat}
+                        total=$(( total + t1 - t0 ))
+                        n=$(( n + 1 ))
+                done < ${TMP}/ops
+        else
+                # del and add are one operation
+                while read -r line; do
+                        read -r add
+                        t0=${EPOCHREALTIME/./}
+                        printf "%s\n%s\n" "${line}" "${add}" | ip -n ${NS} -batch - \
+                                || fail "ip ${line}; ${add}"
+                        t1=${EPOCHREALTIME/./}
+                        echo $(( t1 - t0 )) >> ${lat}
+                        total=$(( total + t1 - t0 ))
+                        n=$(( n + 1 ))
+                done < ${TMP}/ops
+        fi
+
+        add_result $1 $([[ $2 == "ipe" ]] && echo ipe || echo iproute2) \
+                   single ${n} ${total} ${lat}
+}
+
+
+# One process for all operations
+# Usage: run_batch OP TOOL
+function run_batch() {
+        local n t0 t1
+
+        gen_ops $1 $2 > ${TMP}/ops
+        n=$(wc -l < ${TMP}/ops)
+
+        t0=${EPOCHREALTIME/./}
+        if [[ $2 == "ipe" ]]; then
+                # failed lines are reported, exit code is the first one
+                ${IPE} -batch ${TMP}/ops > /dev/null || fail "ipe -batch of $1"
+        else
+                n=$(( n / 2 ))
+                ip -n ${NS} -batch ${TMP}/ops || fail "ip -batch of $1"
+        fi
+        t1=${EPOCHREALTIME/./}
+
+        add_result $1 $([[ $2 == "ipe" ]] && echo ipe || echo iproute2) \
+                   batch ${n} $(( t1 - t0 ))
+}
+
+
+function write_results() {
+        local module=$(cat /sys/module/ipe/version 2>/dev/null || echo unknown)
+        local commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+        local i
+
+        {
+                echo "{"
+                echo "  \"version\": 1,"
+                echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+                echo "  \"kernel\": \"$(uname -r)\","
+                echo "  \"module\": \"${module}\","
+                echo "  \"commit\": \"${commit}\","
+                echo "  \"parent_type\": \"${TYPE}\","
+                echo "  \"parents\": ${PARENTS},"
+                echo "  \"vlans_per_parent\": ${VLANS},"
+                echo "  \"samples\": ${SAMPLES},"
+                echo "  \"results\": ["
+                for ((i = 0; i < ${#RESULTS[@]}; ++i)); do
+                        echo -n "    ${RESULTS[i]}"
+                        (( i + 1 < ${#RESULTS[@]} )) && echo "," || echo
+                done
+                echo "  ]"
+                echo "}"
+        } > ${OUT}
+}
+
+
+setup
+echo "${PARENTS} x ${VLANS} VLANs on ${TYPE}, ${SAMPLES} operations of each kind"
+printf "%-10s %-9s %-6s %10s %16s %8s %8s %8s\n" \
+       op tool mode "" "" p50_us p99_us p999_us
+
+for op in set_vid set_eth set_name set_parent; do
+        run_single ${op} ipe
+        run_single ${op} ip
+        run_batch  ${op} ipe
+        run_batch  ${op} ip
+done
+
+write_results
+echo "results: ${OUT}"
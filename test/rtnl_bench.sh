@@ -0,0 +1,57 @@
+#! /bin/bash
+#
+# Time of rtnl_lock held by ipe per operation. Module must be loaded.
+# Usage: rtnl_bench.sh [ COUNT ]
+#
+# Run it on two builds of module for compare: avg_op_ns is average time
+# of rtnl_lock for one operation, max_ns -- the longest critical section.
+#
+set -e
+
+COUNT=${1:-1000}
+PARENT="ipe_bench0"
+PREFIX="ipeb"
+STATS="/sys/module/ipe/parameters/rtnl_stats"
+IPE="../ipe"
+BATCH=$(mktemp)
+
+function cleanup() {
+        ip link del ${PARENT} 2>/dev/null || true
+        rm -f ${BATCH}
+}
+trap cleanup EXIT
+
+function reset_stats() {
+        echo 0 > ${STATS}
+}
+
+if (( COUNT < 1 || COUNT > 2000 )); then
+        echo "COUNT must be into 1..2000: VIDs are moved by 2000"
+        exit 1
+fi
+
+if [[ ! -f ${STATS} ]]; then
+        echo "module ipe isn't loaded"
+        exit 1
+fi
+
+ip link add ${PARENT} type dummy
+for ((i = 1; i <= COUNT; ++i)); do
+        ip link add link ${PARENT} name ${PREFIX}.${i} type vlan id ${i}
+done
+
+# single operations: one request and one rtnl_lock for each
+reset_stats
+for ((i = 1; i <= COUNT; ++i)); do
+        ${IPE} dev ${PREFIX}.${i} id $((i + 2000))
+done
+echo "single: $(cat ${STATS})"
+
+# the same operations back into one -batch stream
+for ((i = 1; i <= COUNT; ++i)); do
+        echo "dev ${PREFIX}.${i} id ${i}"
+done > ${BATCH}
+
+reset_stats
+${IPE} -batch ${BATCH}
+echo "batch:  $(cat ${STATS})"
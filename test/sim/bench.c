@@ -0,0 +1,399 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Benchmark of handlers on simulator: sequences of set_vid, set_eth and
+* set_parent are generated first and then replayed, one by one (sim_exec)
+* and by batches (sim_exec_batch). failover moves all children of parent
+* by one request, its ops are moved VLANs, convert changes ethertype of
+* them, its ops are converted VLANs. ndo/op is calls of ndo_vlan_rx_add_vid
+* and ndo_vlan_rx_kill_vid. Cost of netlink and of real rtnl_lock
+* isn't here, it's cost of checkers, handlers, undo log and vlan_group
+* (see ../ipe_bench.sh for module).
+*
+*     Usage: sim_bench [ -n OPS ] [ -p PARENTS ] [ -l VLANS ] [ -b BATCH ]
+*                      [ -s SEED ]
+*
+*   -n  operations of each kind
+*   -p  QinQ parents (802.1ad on eth0), at least 2 for set_parent and
+*       failover
+*   -l  802.1Q VLANs of each parent, all VIDs are different, so
+*       PARENTS * VLANS < 4094: one VID stays free for set_vid
+*   -b  operations of batch
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#include <unistd.h>
+#include <time.h>
+
+#include "sim.h"
+
+#define ETH_8021Q       0x8100
+#define ETH_8021AD      0x88a8
+
+/* Operation of sequence, ifindex of devices */
+typedef struct {
+        int     command;
+        int     src;
+        int     dst;
+        int     value;
+} bench_op_t;
+
+enum {
+        BENCH_SET_VID,
+        BENCH_SET_ETH,
+        BENCH_SET_PARENT,
+        BENCH_MIXED,
+        BENCH_COUNT,
+};
+
+static const char *bench_names[BENCH_COUNT] = {
+        [BENCH_SET_VID]         = "set_vid",
+        [BENCH_SET_ETH]         = "set_eth",
+        [BENCH_SET_PARENT]      = "set_parent",
+        [BENCH_MIXED]           = "mixed",
+};
+
+static long parents = 4;
+static long vlans   = 1000;
+static long ops     = 1000000;
+static long batch_size = 256;
+
+/* Topology and its state for generator */
+static int *child;       /* ifindex of VLANs */
+static int *outer;       /* ifindex of parents */
+static int *child_vid;
+static int *child_proto;
+static int *child_parent; /* index into outer */
+static int  hole;        /* the only free VID */
+
+
+static unsigned long long rnd_state;
+
+static unsigned int rnd(const unsigned int n) {
+        rnd_state = rnd_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (rnd_state >> 33) % n;
+}
+
+
+static void setup(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        char name[64];
+        long p, v, k;
+
+        for (p = 0; p < parents; ++p) {
+                snprintf(name, sizeof(name), "o%ld", p);
+                outer[p] = sim_add_vlan(eth, name, ETH_8021AD, 1 + p)->ifindex;
+        }
+
+        for (p = 0; p < parents; ++p) {
+                for (v = 0; v < vlans; ++v) {
+                        k = p * vlans + v;
+                        snprintf(name, sizeof(name), "o%ldv%ld", p, v);
+                        child[k] = sim_add_vlan(sim_dev(outer[p]), name,
+                                                ETH_8021Q, 1 + k)->ifindex;
+                        child_vid[k]    = 1 + k;
+                        child_proto[k]  = ETH_8021Q;
+                        child_parent[k] = p;
+                }
+        }
+
+        hole = 1 + parents * vlans;
+}
+
+
+/* Next operation of @kind, state of generator is updated */
+static void gen_op(bench_op_t *op, int kind) {
+        int k = rnd(parents * vlans);
+
+        if (kind == BENCH_MIXED)
+                kind = rnd(parents > 1 ? 3 : 2);
+
+        op->src = child[k];
+        op->dst = 0;
+
+        switch (kind) {
+        case BENCH_SET_VID:
+                op->command  = IPE_CMD_SET_VID;
+                op->value    = hole;
+                hole         = child_vid[k];
+                child_vid[k] = op->value;
+                break;
+        case BENCH_SET_ETH:
+                op->command    = IPE_CMD_SET_ETH;
+                op->value      = child_proto[k] == ETH_8021Q ? ETH_8021AD : ETH_8021Q;
+                child_proto[k] = op->value;
+                break;
+        case BENCH_SET_PARENT:
+                op->command     = IPE_CMD_SET_PARENT;
+                child_parent[k] = (child_parent[k] + 1) % parents;
+                op->dst         = outer[child_parent[k]];
+                op->value       = 0;
+                break;
+        }
+}
+
+
+static void fill_msg(ipe_nlmsg_t *msg, const bench_op_t *op) {
+        sim_op(msg, op->command, sim_dev(op->src), sim_dev(op->dst), op->value);
+}
+
+
+static double now(void) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+/* Row of table: costs of sim_stats per one of @n operations */
+static void print_row(const char *name, const char *mode, const long n,
+                                                          const double elapsed)
+{
+        printf("%-10s %-6s %9ld %12.0f %8.1f %9.2f %9.2f %8.3f %8.2f\n",
+               name, mode, n, n / elapsed, elapsed * 1e9 / n,
+               (double)sim_stats.allocs / n,
+               (double)sim_stats.rcu_calls / n,
+               (double)sim_stats.locks / n,
+               (double)(sim_stats.vid_adds + sim_stats.vid_kills) / n);
+}
+
+
+/* Replay of @seq, return number of failed operations */
+static long replay(const bench_op_t *seq, const int batched) {
+        ipe_batch_t *batch;
+        ipe_nlmsg_t msg;
+        int *retcode;
+        long failed = 0;
+        long i;
+        int j;
+
+        if (!batched) {
+                for (i = 0; i < ops; ++i) {
+                        fill_msg(&msg, &seq[i]);
+                        if (sim_exec(&msg))
+                                failed++;
+                }
+                return failed;
+        }
+
+        batch   = malloc(sizeof(ipe_batch_t) + batch_size * sizeof(ipe_nlmsg_t));
+        retcode = malloc(batch_size * sizeof(int));
+        BUG_ON(!batch || !retcode);
+
+        for (i = 0; i < ops; i += batch->count) {
+                batch->count = min(batch_size, ops - i);
+                batch->flags = IPE_BATCH_ATOMIC;
+                for (j = 0; j < batch->count; ++j)
+                        fill_msg(&batch->ops[j], &seq[i + j]);
+
+                if (sim_exec_batch(batch, retcode)) {
+                        for (j = 0; j < batch->count; ++j)
+                                failed += retcode[j] != IPE_OK;
+                }
+        }
+
+        free(batch);
+        free(retcode);
+
+        return failed;
+}
+
+
+static int run(const int kind, const int batched, bench_op_t *seq) {
+        double start, elapsed;
+        long failed;
+        long i;
+
+        setup();
+        for (i = 0; i < ops; ++i)
+                gen_op(&seq[i], kind);
+        memset(&sim_stats, 0, sizeof(sim_stats));
+
+        start   = now();
+        failed  = replay(seq, batched);
+        elapsed = now() - start;
+
+        print_row(bench_names[kind], batched ? "batch" : "single", ops, elapsed);
+
+        if (failed)
+                fprintf(stderr, "%s: %ld operations failed\n",
+                                        bench_names[kind], failed);
+        if (sim_verify()) {
+                fprintf(stderr, "%s: inconsistent state\n", bench_names[kind]);
+                failed++;
+        }
+
+        sim_reset();
+
+        return failed ? 1 : 0;
+}
+
+
+/*
+ * All children of parent are moved by one request, back and forth between
+ * the first two parents: cost of moved VLAN against set_parent.
+ */
+static int run_failover(void) {
+        ipe_failover_t *failover;
+        double start, elapsed;
+        long moved = 0;
+        long failed = 0;
+        int from = 0;
+
+        setup();
+        memset(&sim_stats, 0, sizeof(sim_stats));
+
+        start = now();
+        while (moved < ops) {
+                if (sim_failover(sim_dev(outer[from]), sim_dev(outer[!from]),
+                                                               &failover)) {
+                        failed++;
+                        break;
+                }
+
+                moved  += failover->moved;
+                failed += failover->nr_failed;
+                from    = !from;
+                kvfree(failover);
+        }
+        elapsed = now() - start;
+
+        print_row("failover", "bulk", moved, elapsed);
+
+        if (failed)
+                fprintf(stderr, "failover: %ld children aren't moved\n", failed);
+        if (sim_verify()) {
+                fprintf(stderr, "failover: inconsistent state\n");
+                failed++;
+        }
+
+        sim_reset();
+
+        return failed ? 1 : 0;
+}
+
+
+/*
+ * All children of the first parent are converted by one request, back
+ * and forth between 802.1Q and 802.1ad: cost of converted VLAN against
+ * set_eth.
+ */
+static int run_convert(void) {
+        double start, elapsed;
+        long converted = 0;
+        long failed = 0;
+        int proto = ETH_8021AD;
+        int count;
+
+        setup();
+        memset(&sim_stats, 0, sizeof(sim_stats));
+
+        start = now();
+        while (converted < ops) {
+                if (sim_convert(sim_dev(outer[0]), proto, 0, 1, VLAN_VID_MASK - 1,
+                                                                &count) ||
+                    count != vlans) {
+                        failed++;
+                        break;
+                }
+
+                converted += count;
+                proto      = proto == ETH_8021Q ? ETH_8021AD : ETH_8021Q;
+        }
+        elapsed = now() - start;
+
+        print_row("convert", "bulk", converted, elapsed);
+
+        if (failed)
+                fprintf(stderr, "convert: request failed\n");
+        if (sim_verify()) {
+                fprintf(stderr, "convert: inconsistent state\n");
+                failed++;
+        }
+
+        sim_reset();
+
+        return failed ? 1 : 0;
+}
+
+
+int main(int argc, char **argv) {
+        unsigned long long seed = 1;
+        bench_op_t *seq;
+        int res = 0;
+        int kind;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "n:p:l:b:s:")) != -1) {
+                switch (opt) {
+                case 'n': ops        = strtol(optarg, NULL, 0); break;
+                case 'p': parents    = strtol(optarg, NULL, 0); break;
+                case 'l': vlans      = strtol(optarg, NULL, 0); break;
+                case 'b': batch_size = strtol(optarg, NULL, 0); break;
+                case 's': seed       = strtoull(optarg, NULL, 0); break;
+                default:
+                        fprintf(stderr, "Usage: %s [ -n OPS ] [ -p PARENTS ] "
+                                        "[ -l VLANS ] [ -b BATCH ] [ -s SEED ]\n",
+                                                                argv[0]);
+                        return 1;
+                }
+        }
+
+        if (ops < 1 || parents < 1 || vlans < 1 || parents * vlans > 4093 ||
+            batch_size < 1 || batch_size > IPE_BATCH_MAX) {
+                fprintf(stderr, "bad arguments: PARENTS * VLANS must be into "
+                                "1..4093, BATCH into 1..%d\n", IPE_BATCH_MAX);
+                return 1;
+        }
+
+        rnd_state    = seed;
+        seq          = malloc(ops * sizeof(bench_op_t));
+        child        = malloc(parents * vlans * sizeof(int));
+        child_vid    = malloc(parents * vlans * sizeof(int));
+        child_proto  = malloc(parents * vlans * sizeof(int));
+        child_parent = malloc(parents * vlans * sizeof(int));
+        outer        = malloc(parents * sizeof(int));
+        BUG_ON(!seq || !child || !child_vid || !child_proto ||
+               !child_parent || !outer);
+
+        printf("%ld x %ld VLANs, %ld operations of each kind, batches of %ld\n",
+               parents, vlans, ops, batch_size);
+        printf("%-10s %-6s %9s %12s %8s %9s %9s %8s %8s\n", "op", "mode", "ops",
+               "ops/s", "ns/op", "allocs/op", "rcu/op", "locks/op", "ndo/op");
+
+        for (kind = 0; kind < BENCH_COUNT; ++kind) {
+                if (parents < 2 && kind == BENCH_SET_PARENT)
+                        continue;
+
+                res |= run(kind, 0, seq);
+                res |= run(kind, 1, seq);
+        }
+
+        if (parents > 1)
+                res |= run_failover();
+        res |= run_convert();
+
+        free(seq);
+        free(child);
+        free(child_vid);
+        free(child_proto);
+        free(child_parent);
+        free(outer);
+
+        return res;
+}
@@ -0,0 +1,22 @@
+/*
+ * Mock of <linux/bitmap.h> for simulator: bit operations aren't atomic,
+ * simulator has one thread.
+ */
+#ifndef __SIM_LINUX_BITMAP_H
+#define __SIM_LINUX_BITMAP_H   1
+
+#include <linux/kernel.h>
+
+#define BITS_PER_LONG           (8 * sizeof(long))
+#define BITS_TO_LONGS(nr)       (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+static inline int test_and_set_bit(const int nr, unsigned long *addr) {
+        unsigned long mask = 1UL << (nr % BITS_PER_LONG);
+        unsigned long *word = addr + nr / BITS_PER_LONG;
+        int old = (*word & mask) != 0;
+
+        *word |= mask;
+        return old;
+}
+
+#endif // __SIM_LINUX_BITMAP_H
@@ -0,0 +1,10 @@
+/*
+ * Mock of <linux/bsearch.h> for simulator: bsearch of libc has the same
+ * arguments.
+ */
+#ifndef __SIM_LINUX_BSEARCH_H
+#define __SIM_LINUX_BSEARCH_H   1
+
+#include <linux/kernel.h>
+
+#endif // __SIM_LINUX_BSEARCH_H
@@ -0,0 +1,9 @@
+/* Mock of <linux/hashtable.h> for simulator: declaration only */
+#ifndef __SIM_LINUX_HASHTABLE_H
+#define __SIM_LINUX_HASHTABLE_H   1
+
+#include <linux/list.h>
+
+#define DECLARE_HASHTABLE(name, bits)   struct hlist_head name[1 << (bits)]
+
+#endif // __SIM_LINUX_HASHTABLE_H
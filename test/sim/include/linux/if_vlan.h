@@ -0,0 +1,31 @@
+/* Mock of <linux/if_vlan.h> for simulator, fields that ipe uses */
+#ifndef __SIM_LINUX_IF_VLAN_H
+#define __SIM_LINUX_IF_VLAN_H   1
+
+#include <linux/netdevice.h>
+#include <linux/if_ether.h>
+
+#define VLAN_VID_MASK           0x0fff
+#define VLAN_N_VID              4096
+
+struct vlan_dev_priv {
+        __be16                  vlan_proto;
+        u16                     vlan_id;
+        u16                     flags;
+        struct net_device      *real_dev;
+        unsigned int            nest_level;
+};
+
+static inline struct vlan_dev_priv *vlan_dev_priv(const struct net_device *dev) {
+        return netdev_priv(dev);
+}
+
+static inline bool is_vlan_dev(const struct net_device *dev) {
+        return dev->priv_flags & IFF_802_1Q_VLAN;
+}
+
+/* Filter of VID on real device, vlan_info is created by the first one */
+int  vlan_vid_add (struct net_device *dev, __be16 proto, u16 vid);
+void vlan_vid_del (struct net_device *dev, __be16 proto, u16 vid);
+
+#endif // __SIM_LINUX_IF_VLAN_H
@@ -0,0 +1,78 @@
+/*
+ * Mock of kernel core for simulator (test/sim): printk, BUG_ON and byte
+ * order. BUG_ON and broken lock assertions abort the simulator, it is
+ * the point of the tests.
+ */
+#ifndef __SIM_LINUX_KERNEL_H
+#define __SIM_LINUX_KERNEL_H   1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+#include <linux/errno.h>
+
+#define KERN_ERR        ""
+#define KERN_WARNING    ""
+#define KERN_INFO       ""
+
+/* printk of kernel code is silent, unless sim_verbose is set */
+extern int sim_verbose;
+
+#define printk(fmt, ...)                                                \
+        do {                                                            \
+                if (sim_verbose)                                        \
+                        fprintf(stderr, fmt, ##__VA_ARGS__);            \
+        } while (0)
+#define pr_info(fmt, ...)       printk(fmt, ##__VA_ARGS__)
+
+void sim_bug(const char *cond, const char *file, const int line)
+                                        __attribute__((noreturn));
+
+#define BUG_ON(cond)                                                    \
+        do {                                                            \
+                if (cond)                                               \
+                        sim_bug(#cond, __FILE__, __LINE__);             \
+        } while (0)
+#define BUG()           sim_bug("BUG", __FILE__, __LINE__)
+
+#define likely(x)       __builtin_expect(!!(x), 1)
+#define unlikely(x)     __builtin_expect(!!(x), 0)
+
+#define container_of(ptr, type, member) \
+        ((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define max(a, b)       ((a) > (b) ? (a) : (b))
+#define min(a, b)       ((a) < (b) ? (a) : (b))
+
+#define READ_ONCE(x)            (*(volatile typeof(x) *)&(x))
+#define WRITE_ONCE(x, val)      (*(volatile typeof(x) *)&(x) = (val))
+
+#define MAX_ERRNO       4095
+#define IS_ERR_VALUE(x) ((unsigned long)(void *)(x) >= (unsigned long)-MAX_ERRNO)
+#define IS_ERR(ptr)             IS_ERR_VALUE(ptr)
+#define IS_ERR_OR_NULL(ptr)     (!(ptr) || IS_ERR_VALUE(ptr))
+
+/* constant expressions, vlan_proto_idx uses them as case labels */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define htons(x)        ((__be16)__builtin_bswap16((u16)(x)))
+#else
+#define htons(x)        ((__be16)(x))
+#endif
+#define ntohs(x)        htons(x)
+
+static inline size_t sim_strlcpy(char *dst, const char *src, size_t size) {
+        size_t len = strlen(src);
+
+        if (size) {
+                size_t n = len >= size ? size - 1 : len;
+
+                memcpy(dst, src, n);
+                dst[n] = '\0';
+        }
+
+        return len;
+}
+#define strlcpy sim_strlcpy
+
+#endif // __SIM_LINUX_KERNEL_H
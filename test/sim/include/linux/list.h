@@ -0,0 +1,48 @@
+/* Mock of <linux/list.h> for simulator, the part that ipe uses */
+#ifndef __SIM_LINUX_LIST_H
+#define __SIM_LINUX_LIST_H   1
+
+#include <linux/kernel.h>
+
+struct list_head {
+        struct list_head *next, *prev;
+};
+
+struct hlist_node {
+        struct hlist_node *next, **pprev;
+};
+
+struct hlist_head {
+        struct hlist_node *first;
+};
+
+static inline void INIT_LIST_HEAD(struct list_head *list) {
+        list->next = list;
+        list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head) {
+        new->prev = head->prev;
+        new->next = head;
+        head->prev->next = new;
+        head->prev = new;
+}
+
+static inline void list_del(struct list_head *entry) {
+        entry->prev->next = entry->next;
+        entry->next->prev = entry->prev;
+        entry->next = entry->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *head) {
+        return head->next == head;
+}
+
+#define list_entry(ptr, type, member)   container_of(ptr, type, member)
+
+#define list_for_each_entry(pos, head, member)                            \
+        for (pos = list_entry((head)->next, typeof(*pos), member);        \
+             &pos->member != (head);                                      \
+             pos = list_entry(pos->member.next, typeof(*pos), member))
+
+#endif // __SIM_LINUX_LIST_H
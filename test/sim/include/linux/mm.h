@@ -0,0 +1,2 @@
+/* Mock of <linux/mm.h> for simulator */
+#include <linux/slab.h>
@@ -0,0 +1,88 @@
+/*
+ * Mock of <linux/netdevice.h> for simulator: one netns, devices are kept
+ * by table of sim.c, private area of VLAN device follows net_device like
+ * alloc_netdev() does. Upper and lower lists are adjacency of one level.
+ */
+#ifndef __SIM_LINUX_NETDEVICE_H
+#define __SIM_LINUX_NETDEVICE_H   1
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/rcupdate.h>
+#include <linux/rtnetlink.h>
+
+#define IFNAMSIZ                16
+
+#define IFF_802_1Q_VLAN         (1U << 0)
+
+#define NETIF_F_VLAN_CHALLENGED (1ULL << 0)
+
+enum {
+        NETREG_UNINITIALIZED = 0,
+        NETREG_REGISTERED,
+        NETREG_UNREGISTERING,
+        NETREG_UNREGISTERED,
+};
+
+struct net {
+        int     id;
+};
+
+struct vlan_info;
+
+struct net_device {
+        char                    name[IFNAMSIZ];
+        int                     ifindex;
+        unsigned int            priv_flags;
+        netdev_features_t       features;
+        unsigned char           reg_state;
+        struct net             *nd_net;
+        struct vlan_info __rcu *vlan_info;
+        int                     refcnt;
+        struct {
+                struct list_head upper;
+                struct list_head lower;
+        } adj_list;
+        /* simulator: references of vlan_vid_add, see sim.c */
+        u16                    *vid_refs;
+};
+
+static inline void *netdev_priv(const struct net_device *dev) {
+        return (char *)dev + sizeof(struct net_device);
+}
+
+static inline struct net *dev_net(const struct net_device *dev) {
+        return dev->nd_net;
+}
+
+static inline bool net_eq(const struct net *net1, const struct net *net2) {
+        return net1 == net2;
+}
+
+static inline void dev_hold(struct net_device *dev) {
+        dev->refcnt++;
+}
+
+static inline void dev_put(struct net_device *dev) {
+        BUG_ON(--dev->refcnt < 0);
+}
+
+struct net_device *dev_get_by_index (struct net *net, int ifindex);
+struct net_device *__dev_get_by_name (struct net *net, const char *name);
+
+/* Name hash of sim.c is the table itself: "%d" gets the first free number */
+bool dev_valid_name  (const char *name);
+int  dev_change_name (struct net_device *dev, const char *name);
+
+int  netdev_upper_dev_link   (struct net_device *dev,
+                              struct net_device *upper_dev);
+void netdev_upper_dev_unlink (struct net_device *dev,
+                              struct net_device *upper_dev);
+bool netdev_has_upper_dev    (struct net_device *dev,
+                              struct net_device *upper_dev);
+
+/* nest_level of VLAN, 0 for others */
+int  dev_get_nest_level      (struct net_device *dev);
+
+#endif // __SIM_LINUX_NETDEVICE_H
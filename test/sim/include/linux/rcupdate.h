@@ -0,0 +1,38 @@
+/*
+ * Mock of <linux/rcupdate.h> for simulator. There are no readers besides
+ * of checkers, so grace period ends when simulator says: callbacks of
+ * call_rcu wait for sim_rcu_quiesce() outside of read-side section.
+ */
+#ifndef __SIM_LINUX_RCUPDATE_H
+#define __SIM_LINUX_RCUPDATE_H   1
+
+#include <linux/kernel.h>
+
+struct rcu_head {
+        struct rcu_head *next;
+        void (*func)(struct rcu_head *head);
+};
+
+extern int sim_rcu_depth;
+extern int sim_rtnl_held;
+
+#define rcu_read_lock()         (++sim_rcu_depth)
+#define rcu_read_unlock()       BUG_ON(--sim_rcu_depth < 0)
+
+#define __rcu
+
+/* like lockdep: pointer is read under rcu_read_lock or rtnl_lock */
+#define rcu_dereference(p)                                              \
+        ({ BUG_ON(!sim_rcu_depth); (p); })
+#define rcu_dereference_rtnl(p)                                         \
+        ({ BUG_ON(!sim_rcu_depth && !sim_rtnl_held); (p); })
+#define rcu_dereference_protected(p, c)                                 \
+        ({ BUG_ON(!(c)); (p); })
+#define rcu_assign_pointer(p, v)        WRITE_ONCE(p, v)
+#define RCU_INIT_POINTER(p, v)          ((p) = (v))
+
+void call_rcu    (struct rcu_head *head, void (*func)(struct rcu_head *head));
+void rcu_barrier (void);
+void synchronize_rcu (void);
+
+#endif // __SIM_LINUX_RCUPDATE_H
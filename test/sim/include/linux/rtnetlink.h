@@ -0,0 +1,29 @@
+/* Mock of <linux/rtnetlink.h> for simulator: rtnl_lock is a flag */
+#ifndef __SIM_LINUX_RTNETLINK_H
+#define __SIM_LINUX_RTNETLINK_H   1
+
+#include <linux/rcupdate.h>
+
+void sim_rtnl_assert (const char *file, const int line);
+
+#define rtnl_lock()                                                     \
+        do {                                                            \
+                BUG_ON(sim_rtnl_held);                                  \
+                sim_rtnl_held = 1;                                      \
+        } while (0)
+#define rtnl_unlock()                                                   \
+        do {                                                            \
+                BUG_ON(!sim_rtnl_held);                                 \
+                sim_rtnl_held = 0;                                      \
+        } while (0)
+#define rtnl_is_locked()        (sim_rtnl_held)
+
+#define ASSERT_RTNL()                                                   \
+        do {                                                            \
+                if (!sim_rtnl_held)                                     \
+                        sim_rtnl_assert(__FILE__, __LINE__);            \
+        } while (0)
+
+#define rtnl_dereference(p)     rcu_dereference_protected(p, sim_rtnl_held)
+
+#endif // __SIM_LINUX_RTNETLINK_H
@@ -0,0 +1,27 @@
+/*
+ * Mock of <linux/slab.h> for simulator: allocations of kernel code are
+ * counted, and sim_fail_alloc fails one of them for rollback tests.
+ */
+#ifndef __SIM_LINUX_SLAB_H
+#define __SIM_LINUX_SLAB_H   1
+
+#include <linux/kernel.h>
+
+typedef unsigned int gfp_t;
+
+#define GFP_KERNEL      0u
+#define GFP_ATOMIC      1u
+
+void *kmalloc  (size_t size, gfp_t flags);
+void *kzalloc  (size_t size, gfp_t flags);
+void *krealloc (const void *p, size_t size, gfp_t flags);
+void  kfree    (const void *p);
+
+#define kmalloc_array(n, size, flags)   kmalloc((n) * (size), flags)
+#define kcalloc(n, size, flags)         kzalloc((n) * (size), flags)
+#define kvmalloc(size, flags)           kmalloc(size, flags)
+#define kvzalloc(size, flags)           kzalloc(size, flags)
+#define kvmalloc_array(n, size, flags)  kmalloc((n) * (size), flags)
+#define kvfree(p)                       kfree(p)
+
+#endif // __SIM_LINUX_SLAB_H
@@ -0,0 +1,13 @@
+/*
+ * Mock of <linux/sort.h> for simulator: qsort of libc, @swap_func is
+ * always NULL in kernel code.
+ */
+#ifndef __SIM_LINUX_SORT_H
+#define __SIM_LINUX_SORT_H   1
+
+#include <linux/kernel.h>
+
+#define sort(base, num, size, cmp_func, swap_func)                      \
+        qsort(base, num, size, cmp_func)
+
+#endif // __SIM_LINUX_SORT_H
@@ -0,0 +1,14 @@
+/* Mock of <linux/tracepoint.h> for simulator: tracepoints are empty */
+#ifndef __SIM_LINUX_TRACEPOINT_H
+#define __SIM_LINUX_TRACEPOINT_H   1
+
+#include <linux/kernel.h>
+
+#define TP_PROTO(args...)       args
+#define TP_ARGS(args...)        args
+
+#define TRACE_DEFINE_ENUM(a)
+#define TRACE_EVENT(name, proto, args, ...)                             \
+        static inline void trace_##name(proto) { }
+
+#endif // __SIM_LINUX_TRACEPOINT_H
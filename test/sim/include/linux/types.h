@@ -0,0 +1,20 @@
+/* Mock of <linux/types.h> for simulator: UAPI types and kernel ones */
+#ifndef __SIM_LINUX_TYPES_H
+#define __SIM_LINUX_TYPES_H   1
+
+#include_next <linux/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t         u8;
+typedef uint16_t        u16;
+typedef uint32_t        u32;
+typedef uint64_t        u64;
+typedef int32_t         s32;
+typedef int64_t         s64;
+
+typedef u64             netdev_features_t;
+
+#endif // __SIM_LINUX_TYPES_H
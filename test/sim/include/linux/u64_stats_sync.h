@@ -0,0 +1,2 @@
+/* Mock of <linux/u64_stats_sync.h> for simulator */
+#include <linux/kernel.h>
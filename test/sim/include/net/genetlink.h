@@ -0,0 +1,7 @@
+/* Mock of <net/genetlink.h> for simulator: ipeCmd.c doesn't send messages */
+#ifndef __SIM_NET_GENETLINK_H
+#define __SIM_NET_GENETLINK_H   1
+
+#include <linux/netdevice.h>
+
+#endif // __SIM_NET_GENETLINK_H
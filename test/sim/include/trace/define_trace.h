@@ -0,0 +1 @@
+/* Mock of <trace/define_trace.h> for simulator: nothing to define */
@@ -0,0 +1,1048 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Runtime of simulator (see sim.h): devices of one netns, rtnl_lock,
+* RCU and allocator of kernel code, and the parts of module that aren't
+* built here (ipeOp.c, ipeNet.c, ipeName.c, ipeEvent.c), reduced to one
+* netns without netlink.
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#include <ctype.h>
+
+#include "sim.h"
+
+#include "../../include/ipeTxn.h"
+#include "../../include/ipeName.h"
+#include "../../include/ipeNet.h"
+#include "../../include/ipeOp.h"
+#include "../../include/ipeEvent.h"
+#include "../../include/ipeCmd.h"
+#include "../../include/ipeBulk.h"
+
+int sim_verbose;
+int sim_rcu_depth;
+int sim_rtnl_held;
+
+sim_stats_t sim_stats;
+struct net  sim_net;
+long        sim_fail_alloc = -1;
+int         sim_mainline_group;
+
+/* Devices by ifindex - 1, unregistered ones stay till sim_reset */
+static ndev_t **devs;
+static int      devs_count;
+static int      devs_size;
+
+/* Rows of mainline group past IPE_GROUP_PROTOS, all slots are poison_dev */
+static ndev_t  *poison_part[VLAN_GROUP_ARRAY_PART_LEN];
+static ndev_t  *poison_dev;
+
+/* Callbacks of call_rcu, waiting for sim_rcu_quiesce */
+static struct rcu_head *rcu_pending;
+
+/* Node of upper or lower list, @peer is node of the other device */
+typedef struct sim_adj {
+        ndev_t                 *dev;
+        struct sim_adj         *peer;
+        struct list_head        list;
+} sim_adj_t;
+
+
+
+void sim_bug(const char *cond, const char *file, const int line) {
+        fprintf(stderr, "BUG: %s at %s:%d\n", cond, file, line);
+        abort();
+}
+
+void sim_rtnl_assert(const char *file, const int line) {
+        fprintf(stderr, "RTNL: assertion failed at %s:%d\n", file, line);
+        abort();
+}
+
+
+
+static bool alloc_fails(void) {
+        if (sim_fail_alloc < 0)
+                return false;
+
+        if (sim_fail_alloc-- > 0)
+                return false;
+
+        sim_fail_alloc = -1;
+        return true;
+}
+
+void *kmalloc(size_t size, gfp_t flags) {
+        void *p;
+
+        if (alloc_fails())
+                return NULL;
+
+        p = malloc(size);
+        if (p)
+                sim_stats.allocs++;
+
+        return p;
+}
+
+void *kzalloc(size_t size, gfp_t flags) {
+        void *p = kmalloc(size, flags);
+
+        if (p)
+                memset(p, 0, size);
+
+        return p;
+}
+
+/* Moved block is counted as free of old one and allocation of new */
+void *krealloc(const void *p, size_t size, gfp_t flags) {
+        void *new;
+
+        if (alloc_fails())
+                return NULL;
+
+        new = realloc((void *)p, size);
+        if (!new)
+                return NULL;
+
+        sim_stats.allocs++;
+        if (p)
+                sim_stats.frees++;
+
+        return new;
+}
+
+void kfree(const void *p) {
+        if (!p)
+                return;
+
+        sim_stats.frees++;
+        free((void *)p);
+}
+
+
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head)) {
+        head->func  = func;
+        head->next  = rcu_pending;
+        rcu_pending = head;
+
+        sim_stats.rcu_calls++;
+}
+
+void sim_rcu_quiesce(void) {
+        struct rcu_head *head;
+
+        BUG_ON(sim_rcu_depth);
+
+        while (rcu_pending) {
+                head = rcu_pending;
+                rcu_pending = head->next;
+                head->func(head);
+        }
+}
+
+void rcu_barrier(void) {
+        sim_rcu_quiesce();
+}
+
+void synchronize_rcu(void) {
+        sim_rcu_quiesce();
+}
+
+
+
+static ndev_t *alloc_dev(const char *name) {
+        ndev_t *dev;
+
+        if (devs_count == devs_size) {
+                devs_size = devs_size ? devs_size * 2 : 64;
+                devs = realloc(devs, devs_size * sizeof(ndev_t *));
+                BUG_ON(!devs);
+        }
+
+        /* names are unique into netns, as register_netdevice checks */
+        BUG_ON(__dev_get_by_name(&sim_net, name));
+
+        dev = calloc(1, sizeof(ndev_t) + sizeof(struct vlan_dev_priv));
+        BUG_ON(!dev);
+
+        strlcpy(dev->name, name, IFNAMSIZ);
+        dev->ifindex   = devs_count + 1;
+        dev->reg_state = NETREG_REGISTERED;
+        dev->nd_net    = &sim_net;
+        dev->refcnt    = 1;     /* of registration */
+        INIT_LIST_HEAD(&dev->adj_list.upper);
+        INIT_LIST_HEAD(&dev->adj_list.lower);
+
+        devs[devs_count++] = dev;
+
+        return dev;
+}
+
+ndev_t *sim_dev(const int ifindex) {
+        if (ifindex < 1 || ifindex > devs_count)
+                return NULL;
+
+        return devs[ifindex - 1];
+}
+
+ndev_t *dev_get_by_index(struct net *net, int ifindex) {
+        ndev_t *dev = sim_dev(ifindex);
+
+        if (!dev || dev->reg_state != NETREG_REGISTERED || dev_net(dev) != net)
+                return NULL;
+
+        dev_hold(dev);
+        return dev;
+}
+
+ndev_t *__dev_get_by_name(struct net *net, const char *name) {
+        int i;
+
+        for (i = 0; i < devs_count; ++i) {
+                if (devs[i]->reg_state == NETREG_REGISTERED &&
+                    dev_net(devs[i]) == net && !strcmp(devs[i]->name, name))
+                        return devs[i];
+        }
+
+        return NULL;
+}
+
+bool dev_valid_name(const char *name) {
+        if (!*name || strlen(name) >= IFNAMSIZ ||
+            !strcmp(name, ".") || !strcmp(name, ".."))
+                return false;
+
+        for (; *name; ++name) {
+                if (*name == '/' || *name == ':' || isspace(*name))
+                        return false;
+        }
+
+        return true;
+}
+
+int dev_get_nest_level(ndev_t *dev) {
+        return is_vlan_dev(dev) ? vlan_dev_priv(dev)->nest_level : 0;
+}
+
+/* Like dev_change_name: allocation of kernel can fail, it's -ENOMEM */
+int dev_change_name(ndev_t *dev, const char *name) {
+        char buf[IFNAMSIZ];
+        int i;
+
+        if (!strncmp(name, dev->name, IFNAMSIZ))
+                return 0;
+
+        if (!dev_valid_name(name))
+                return -EINVAL;
+
+        if (strchr(name, '%')) {
+                for (i = 0; ; ++i) {
+                        snprintf(buf, IFNAMSIZ, name, i);
+                        if (!__dev_get_by_name(dev_net(dev), buf))
+                                break;
+                }
+                name = buf;
+        } else if (__dev_get_by_name(dev_net(dev), name)) {
+                return -EEXIST;
+        }
+
+        if (alloc_fails())
+                return -ENOMEM;
+
+        strlcpy(dev->name, name, IFNAMSIZ);
+        sim_stats.renames++;
+
+        return 0;
+}
+
+
+
+static sim_adj_t *adj_find(struct list_head *list, const ndev_t *dev) {
+        sim_adj_t *adj;
+
+        list_for_each_entry(adj, list, list) {
+                if (adj->dev == dev)
+                        return adj;
+        }
+
+        return NULL;
+}
+
+bool netdev_has_upper_dev(ndev_t *dev, ndev_t *upper_dev) {
+        sim_adj_t *adj;
+
+        ASSERT_RTNL();
+
+        list_for_each_entry(adj, &dev->adj_list.upper, list) {
+                if (adj->dev == upper_dev ||
+                    netdev_has_upper_dev(adj->dev, upper_dev))
+                        return true;
+        }
+
+        return false;
+}
+
+int netdev_upper_dev_link(ndev_t *dev, ndev_t *upper_dev) {
+        sim_adj_t *upper, *lower;
+
+        ASSERT_RTNL();
+
+        if (dev == upper_dev || netdev_has_upper_dev(upper_dev, dev))
+                return -EBUSY;
+
+        /* the same as upper list of @dev, but it's short for VLAN */
+        if (adj_find(&upper_dev->adj_list.lower, dev))
+                return -EEXIST;
+
+        upper = kmalloc(sizeof(sim_adj_t), GFP_KERNEL);
+        lower = kmalloc(sizeof(sim_adj_t), GFP_KERNEL);
+        if (!upper || !lower) {
+                kfree(upper);
+                kfree(lower);
+                return -ENOMEM;
+        }
+
+        upper->dev  = upper_dev;
+        upper->peer = lower;
+        lower->dev  = dev;
+        lower->peer = upper;
+        list_add_tail(&upper->list, &dev->adj_list.upper);
+        list_add_tail(&lower->list, &upper_dev->adj_list.lower);
+
+        return 0;
+}
+
+/* Lower list of VLAN is short, upper list of parent can be long */
+void netdev_upper_dev_unlink(ndev_t *dev, ndev_t *upper_dev) {
+        sim_adj_t *lower;
+
+        ASSERT_RTNL();
+
+        lower = adj_find(&upper_dev->adj_list.lower, dev);
+        BUG_ON(!lower);
+
+        list_del(&lower->peer->list);
+        list_del(&lower->list);
+        kfree(lower->peer);
+        kfree(lower);
+}
+
+
+
+/*
+ * vid_list of vlan_info isn't kept: references of VIDs are counted into
+ * table of simulator, it's hardware filter of device too.
+ */
+static u16 *vid_ref(ndev_t *dev, __be16 proto, u16 vid) {
+        unsigned int pidx = vlan_proto_idx(proto);
+
+        BUG_ON(pidx >= VLAN_PROTO_NUM || vid >= VLAN_N_VID);
+
+        if (!dev->vid_refs) {
+                dev->vid_refs = calloc(VLAN_PROTO_NUM * VLAN_N_VID, sizeof(u16));
+                BUG_ON(!dev->vid_refs);
+        }
+
+        return &dev->vid_refs[pidx * VLAN_N_VID + vid];
+}
+
+int sim_vid_refs(const ndev_t *dev, const int proto, const u16 vid) {
+        unsigned int pidx = vlan_proto_idx(htons(proto));
+
+        if (!dev->vid_refs || pidx >= VLAN_PROTO_NUM)
+                return 0;
+
+        return dev->vid_refs[pidx * VLAN_N_VID + vid];
+}
+
+static void vlan_group_poison(struct vlan_group *grp) {
+        int i, j;
+
+        if (!poison_dev) {
+                poison_dev = calloc(1, sizeof(ndev_t) + sizeof(struct vlan_dev_priv));
+                BUG_ON(!poison_dev);
+                for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i)
+                        poison_part[i] = poison_dev;
+        }
+
+        for (i = IPE_GROUP_PROTOS; i < VLAN_PROTO_NUM; ++i) {
+                for (j = 0; j < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++j)
+                        grp->vlan_devices_arrays[i][j] = poison_part;
+        }
+}
+
+static void vlan_group_free(struct vlan_group *grp) {
+        int i, j;
+
+        for (i = 0; i < VLAN_PROTO_NUM; ++i) {
+                for (j = 0; j < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++j) {
+                        if (grp->vlan_devices_arrays[i][j] != poison_part)
+                                kfree(grp->vlan_devices_arrays[i][j]);
+                }
+        }
+}
+
+static void vlan_info_rcu_free(struct rcu_head *rcu) {
+        struct vlan_info *vlan_info = container_of(rcu, struct vlan_info, rcu);
+
+        vlan_group_free(&vlan_info->grp);
+        kfree(vlan_info);
+}
+
+/*
+ * ndo_vlan_rx_add_vid is called for the first reference of VID only and
+ * ndo_vlan_rx_kill_vid for the last one, both are counted. Programming
+ * of filter fails like allocation (sim_fail_alloc).
+ */
+int vlan_vid_add(ndev_t *dev, __be16 proto, u16 vid) {
+        struct vlan_info *vlan_info;
+        u16 *ref;
+
+        ASSERT_RTNL();
+
+        ref = vid_ref(dev, proto, vid);
+        if (*ref == 0 && alloc_fails())
+                return -EIO;
+
+        vlan_info = rtnl_dereference(dev->vlan_info);
+        if (!vlan_info) {
+                vlan_info = kzalloc(sizeof(struct vlan_info), GFP_KERNEL);
+                if (!vlan_info)
+                        return -ENOMEM;
+
+                vlan_info->real_dev = dev;
+                INIT_LIST_HEAD(&vlan_info->vid_list);
+                if (sim_mainline_group)
+                        vlan_group_poison(&vlan_info->grp);
+                rcu_assign_pointer(dev->vlan_info, vlan_info);
+        }
+
+        if ((*ref)++ == 0) {
+                vlan_info->nr_vids++;
+                sim_stats.vid_adds++;
+        }
+
+        return 0;
+}
+
+/* The last VID frees vlan_info after grace period, like 8021q */
+void vlan_vid_del(ndev_t *dev, __be16 proto, u16 vid) {
+        struct vlan_info *vlan_info;
+        u16 *ref;
+
+        ASSERT_RTNL();
+
+        vlan_info = rtnl_dereference(dev->vlan_info);
+        BUG_ON(!vlan_info);
+
+        ref = vid_ref(dev, proto, vid);
+        BUG_ON(*ref == 0);
+        if (--(*ref) > 0)
+                return;
+
+        sim_stats.vid_kills++;
+        if (--vlan_info->nr_vids == 0) {
+                RCU_INIT_POINTER(dev->vlan_info, NULL);
+                call_rcu(&vlan_info->rcu, vlan_info_rcu_free);
+        }
+}
+
+
+
+ndev_t *sim_add_dev(const char *name) {
+        return alloc_dev(name);
+}
+
+
+/* Like register_vlan_dev of 8021q, NULL if (proto, vid) is used */
+ndev_t *sim_add_vlan(ndev_t *real_dev, const char *name,
+                     const int proto, const u16 vid)
+{
+        struct vlan_dev_priv *vlan;
+        struct vlan_info *vlan_info;
+        __be16 vlan_proto = htons(proto);
+        ndev_t *dev = NULL;
+
+        /* 8021q of mainline has no QinQ rows */
+        BUG_ON(!ipe_proto_in_group(vlan_proto));
+
+        rtnl_lock();
+
+        if (vlan_find_dev(real_dev, vlan_proto, vid))
+                goto unlock;
+
+        dev = alloc_dev(name);
+        dev->priv_flags |= IFF_802_1Q_VLAN;
+
+        vlan = vlan_dev_priv(dev);
+        vlan->vlan_proto = vlan_proto;
+        vlan->vlan_id    = vid;
+        vlan->real_dev   = real_dev;
+        vlan->nest_level = dev_get_nest_level(real_dev) + 1;
+
+        BUG_ON(vlan_vid_add(real_dev, vlan_proto, vid));
+        vlan_info = rtnl_dereference(real_dev->vlan_info);
+
+        BUG_ON(vlan_group_prealloc_vid(&vlan_info->grp, vlan_proto, vid));
+        BUG_ON(netdev_upper_dev_link(real_dev, dev));
+
+        vlan_group_set_device(&vlan_info->grp, vlan_proto, vid, dev);
+        vlan_info->grp.nr_vlan_devs++;
+
+        /* Account for reference in struct vlan_dev_priv */
+        dev_hold(real_dev);
+
+unlock:
+        rtnl_unlock();
+
+        return dev;
+}
+
+
+void sim_unregister(ndev_t *dev) {
+        dev->reg_state = NETREG_UNREGISTERED;
+}
+
+
+/* Memory of kernel code is freed by kfree, so stats stay balanced */
+void sim_reset(void) {
+        struct vlan_info *vlan_info;
+        sim_adj_t *adj;
+        ndev_t *dev;
+        int i;
+
+        sim_rcu_quiesce();
+
+        for (i = 0; i < devs_count; ++i) {
+                dev = devs[i];
+
+                while (!list_empty(&dev->adj_list.upper)) {
+                        adj = list_entry(dev->adj_list.upper.next, sim_adj_t, list);
+                        list_del(&adj->list);
+                        kfree(adj);
+                }
+                while (!list_empty(&dev->adj_list.lower)) {
+                        adj = list_entry(dev->adj_list.lower.next, sim_adj_t, list);
+                        list_del(&adj->list);
+                        kfree(adj);
+                }
+
+                vlan_info = dev->vlan_info;
+                if (vlan_info) {
+                        vlan_group_free(&vlan_info->grp);
+                        kfree(vlan_info);
+                }
+        }
+
+        for (i = 0; i < devs_count; ++i) {
+                free(devs[i]->vid_refs);
+                free(devs[i]);
+        }
+
+        free(devs);
+        devs       = NULL;
+        devs_count = 0;
+        devs_size  = 0;
+}
+
+
+
+/*
+ * Replacement of ipeNet.c, ipeName.c and ipeOp.c: one netns, so nsfd and
+ * nsid are ignored and names are looked up without cache.
+ */
+int ipe_resolve_net(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->ifindex[id] || msg->devname[id][0])
+                        msg->net[id] = &sim_net;
+        }
+
+        return IPE_OK;
+}
+
+void ipe_release_net(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id)
+                msg->net[id] = NULL;
+}
+
+int ipe_resolve_names(ipe_nlmsg_t *msg, ipe_name_cache_t *cache) {
+        ndev_t *dev;
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->ifindex[id] || !msg->devname[id][0])
+                        continue;
+
+                dev = __dev_get_by_name(msg->net[id], msg->devname[id]);
+                if (!dev)
+                        return IPE_BAD_PTR;
+
+                dev_hold(dev);
+                msg->dev[id]     = dev;
+                msg->ifindex[id] = dev->ifindex;
+        }
+
+        return IPE_OK;
+}
+
+
+int ipe_op_pin(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->dev[id] || !msg->ifindex[id])
+                        continue;
+
+                msg->dev[id] = dev_get_by_index(msg->net[id], msg->ifindex[id]);
+                if (!msg->dev[id])
+                        return IPE_BAD_PTR;
+        }
+
+        return IPE_OK;
+}
+
+int ipe_op_verify(const ipe_nlmsg_t *msg) {
+        int id;
+
+        ASSERT_RTNL();
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                ndev_t *dev = msg->dev[id];
+
+                if (!dev)
+                        continue;
+
+                if (dev->reg_state != NETREG_REGISTERED ||
+                    !net_eq(dev_net(dev), msg->net[id]))
+                        return IPE_BAD_PTR;
+        }
+
+        return IPE_OK;
+}
+
+void ipe_op_release(ipe_nlmsg_t *msg) {
+        int id;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                if (msg->dev[id])
+                        dev_put(msg->dev[id]);
+                msg->dev[id] = NULL;
+        }
+
+        ipe_release_net(msg);
+}
+
+
+void ipe_rtnl_lock(const int command) {
+        rtnl_lock();
+        sim_stats.locks++;
+}
+
+void ipe_rtnl_unlock(const int ops) {
+        rtnl_unlock();
+}
+
+
+/* ipeEvent.c: state is saved the same way, events are only counted */
+void ipe_event_save(const ndev_t *dev, ipe_link_state_t *state) {
+        memset(state, 0, sizeof(ipe_link_state_t));
+        strlcpy(state->ifname, dev->name, IFNAMSIZ);
+
+        if (is_vlan_dev(dev)) {
+                const struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+
+                state->parent = vlan->real_dev->ifindex;
+                state->vid    = vlan->vlan_id;
+                state->proto  = ntohs(vlan->vlan_proto);
+        }
+}
+
+void ipe_event_op(const ipe_nlmsg_t *msg) {
+        sim_stats.events++;
+}
+
+void ipe_event_notify(const ndev_t *dev, const ipe_link_state_t *old,
+                                         const int command)
+{
+        sim_stats.events++;
+}
+
+
+/* ipeDrv.c */
+ndev_t *get_dev(const ipe_nlmsg_t *msg, const int id) {
+        if (msg->dev[id]) {
+                dev_hold(msg->dev[id]);
+                return msg->dev[id];
+        }
+        if (!msg->net[id])
+                return NULL;
+        return dev_get_by_index(msg->net[id], msg->ifindex[id]);
+}
+
+
+
+int sim_exec(ipe_nlmsg_t *msg) {
+        int command = msg->command;
+        ipe_txn_t txn;
+        int res;
+
+        res = ipe_check_command(msg);
+        if (res)
+                return res;
+
+        res = ipe_prepare_op(msg, NULL);
+        if (res)
+                goto release_op;
+
+        if (!ipe_tool(command)->txn_handler) {
+                res = ipe_tool(command)->handler(msg);
+                goto release_op;
+        }
+
+        ipe_txn_init(&txn);
+
+        ipe_rtnl_lock(command);
+        res = ipe_exec_txn(msg, &txn);
+        ipe_rtnl_unlock(1);
+
+        ipe_txn_destroy(&txn);
+
+release_op:
+        ipe_op_release(msg);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_exec_batch(ipe_batch_t *batch, int *retcode) {
+        int res = ipe_check_batch(batch, retcode, NULL);
+
+        if (!res)
+                res = ipe_apply_batch(batch, retcode);
+
+        ipe_release_batch(batch);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_renumber(const ndev_t *real_dev, const ipe_vid_pair_t *map,
+                 const int count, int *moved)
+{
+        ipe_nlmsg_t msg;
+        int res;
+
+        sim_op(&msg, IPE_CMD_RENUMBER, real_dev, NULL, 0);
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (!res)
+                res = renumber_vids(&msg, map, count, moved);
+
+        ipe_op_release(&msg);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_failover(const ndev_t *real_dev, const ndev_t *new_real_dev,
+                 ipe_failover_t **result)
+{
+        ipe_nlmsg_t msg;
+        int res;
+
+        sim_op(&msg, IPE_CMD_FAILOVER, real_dev, new_real_dev, 0);
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (!res)
+                res = failover_vlans(&msg, result);
+
+        ipe_op_release(&msg);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_convert(const ndev_t *real_dev, const int proto, const int from,
+                const u16 vid_min, const u16 vid_max, int *converted)
+{
+        ipe_convert_t conv = {
+                .proto = htons(proto),
+                .match = { htons(from), vid_min, vid_max },
+        };
+        ipe_nlmsg_t msg;
+        int res;
+
+        sim_op(&msg, IPE_CMD_CONVERT, real_dev, NULL, proto);
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (!res)
+                res = convert_vlans(&msg, &conv, converted);
+
+        ipe_op_release(&msg);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_rename(const ndev_t *real_dev, const char *pattern, const int proto,
+               const u16 vid_min, const u16 vid_max, int *renamed)
+{
+        ipe_match_t match = { htons(proto), vid_min, vid_max };
+        ipe_nlmsg_t msg;
+        int res;
+
+        sim_op(&msg, IPE_CMD_RENAME, real_dev, NULL, 0);
+        strlcpy(msg.ifname, pattern, IFNAMSIZ);
+
+        res = ipe_resolve_net(&msg);
+        if (!res)
+                res = ipe_op_pin(&msg);
+        if (!res)
+                res = rename_vlans(&msg, msg.ifname, &match, renamed);
+
+        ipe_op_release(&msg);
+        sim_rcu_quiesce();
+
+        return res;
+}
+
+
+int sim_rename_list(ipe_batch_t *batch, int *renamed) {
+        int *retcode = malloc(batch->count * sizeof(int));
+        int res;
+
+        BUG_ON(!retcode);
+        *renamed = 0;
+
+        res = ipe_check_batch(batch, retcode, NULL);
+        if (!res)
+                res = rename_list(batch, renamed);
+
+        ipe_release_batch(batch);
+        sim_rcu_quiesce();
+        free(retcode);
+
+        return res;
+}
+
+
+void sim_op(ipe_nlmsg_t *msg, const int command, const ndev_t *src,
+                              const ndev_t *dst, const int value)
+{
+        int id;
+
+        memset(msg, 0, sizeof(ipe_nlmsg_t));
+        msg->command = command;
+        msg->value   = value;
+        msg->ifindex[IPE_SRC] = src ? src->ifindex : 0;
+        msg->ifindex[IPE_DST] = dst ? dst->ifindex : 0;
+
+        for (id = 0; id < IPE_DEV_COUNT; ++id) {
+                msg->nsfd[id] = IPE_GLOBAL_NS;
+                msg->nsid[id] = IPE_NO_NSID;
+        }
+}
+
+
+
+#define VERIFY(cond, fmt, ...)                                          \
+        do {                                                            \
+                if (!(cond)) {                                          \
+                        fprintf(stderr, "verify: " fmt "\n", ##__VA_ARGS__); \
+                        bad++;                                          \
+                }                                                       \
+        } while (0)
+
+static int count_adj(struct list_head *list) {
+        sim_adj_t *adj;
+        int count = 0;
+
+        list_for_each_entry(adj, list, list)
+                count++;
+
+        return count;
+}
+
+/*
+ * Each non-empty slot is VLAN of this parent with the same proto and VID,
+ * and filter of real_dev is programmed for non-empty slots only, once.
+ */
+static int verify_group(ndev_t *real_dev) {
+        struct vlan_info *vlan_info = real_dev->vlan_info;
+        struct vlan_dev_priv *vlan;
+        unsigned int pidx, vidx, i;
+        unsigned int used = 0;
+        unsigned int poisoned = 0;
+        ndev_t **array;
+        ndev_t *dev;
+        int bad = 0;
+
+        VERIFY(vlan_info->real_dev == real_dev, "%s: real_dev of vlan_info",
+                                                real_dev->name);
+
+        for (pidx = 0; pidx < VLAN_PROTO_NUM; ++pidx) {
+                for (vidx = 0; vidx < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++vidx) {
+                        array = vlan_info->grp.vlan_devices_arrays[pidx][vidx];
+                        if (!array || array == poison_part)
+                                continue;
+
+                        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN; ++i) {
+                                dev = array[i];
+                                if (!dev)
+                                        continue;
+
+                                vlan = vlan_dev_priv(dev);
+                                VERIFY(is_vlan_dev(dev) &&
+                                       vlan->real_dev == real_dev &&
+                                       vlan_proto_idx(vlan->vlan_proto) == pidx &&
+                                       vlan->vlan_id == vidx * VLAN_GROUP_ARRAY_PART_LEN + i,
+                                       "%s: slot %u/%u holds %s", real_dev->name, pidx,
+                                       vidx * VLAN_GROUP_ARRAY_PART_LEN + i, dev->name);
+
+                                VERIFY(real_dev->vid_refs[pidx * VLAN_N_VID +
+                                       vidx * VLAN_GROUP_ARRAY_PART_LEN + i] == 1,
+                                       "%s: filter of slot %u/%u isn't programmed once",
+                                       real_dev->name, pidx,
+                                       vidx * VLAN_GROUP_ARRAY_PART_LEN + i);
+                                used++;
+                        }
+                }
+        }
+
+        /* rows of mainline group are poisoned all or none */
+        for (pidx = IPE_GROUP_PROTOS; pidx < VLAN_PROTO_NUM; ++pidx) {
+                for (vidx = 0; vidx < VLAN_GROUP_ARRAY_SPLIT_PARTS; ++vidx)
+                        poisoned += vlan_info->grp.vlan_devices_arrays[pidx][vidx] ==
+                                                                    poison_part;
+        }
+        VERIFY(!poisoned || poisoned == (VLAN_PROTO_NUM - IPE_GROUP_PROTOS) *
+                                        VLAN_GROUP_ARRAY_SPLIT_PARTS,
+               "%s: QinQ rows of mainline group are changed", real_dev->name);
+
+        /* nr_vids counts programmed filters */
+        VERIFY(vlan_info->nr_vids == used, "%s: %u filters for %u VLANs",
+                                 real_dev->name, vlan_info->nr_vids, used);
+
+        return bad;
+}
+
+/* Slots past mainline group are neither read as devices nor written */
+static int verify_poison(void) {
+        const unsigned char *p = (const unsigned char *)poison_dev;
+        size_t size = sizeof(ndev_t) + sizeof(struct vlan_dev_priv);
+        int bad = 0;
+        size_t i, j;
+
+        if (!poison_dev)
+                return 0;
+
+        for (i = 0; i < VLAN_GROUP_ARRAY_PART_LEN && poison_part[i] == poison_dev; ++i)
+                ;
+        for (j = 0; j < size && !p[j]; ++j)
+                ;
+        VERIFY(i == VLAN_GROUP_ARRAY_PART_LEN, "slot %zu of poisoned part", i);
+        VERIFY(j == size, "byte %zu of poisoned device", j);
+
+        return bad;
+}
+
+static int verify_vlan(ndev_t *dev) {
+        struct vlan_dev_priv *vlan = vlan_dev_priv(dev);
+        ndev_t *real_dev = vlan->real_dev;
+        struct vlan_info *vlan_info;
+        sim_adj_t *lower;
+        int bad = 0;
+
+        if (vlan_proto_idx(vlan->vlan_proto) >= VLAN_PROTO_NUM ||
+            !ipe_vid_valid(vlan->vlan_id)) {
+                VERIFY(0, "%s: proto %x vid %u", dev->name,
+                          ntohs(vlan->vlan_proto), vlan->vlan_id);
+                return bad;
+        }
+
+        vlan_info = real_dev->vlan_info;
+        VERIFY(vlan_info, "%s: parent %s without vlan_info", dev->name,
+                                                             real_dev->name);
+        if (vlan_info)
+                VERIFY(__vlan_group_get_device(&vlan_info->grp,
+                                       vlan_proto_idx(vlan->vlan_proto),
+                                       vlan->vlan_id) == dev,
+                       "%s: isn't into slot %u of %s", dev->name,
+                       vlan->vlan_id, real_dev->name);
+
+        lower = list_empty(&dev->adj_list.lower) ? NULL :
+                list_entry(dev->adj_list.lower.next, sim_adj_t, list);
+        VERIFY(count_adj(&dev->adj_list.lower) == 1 && lower->dev == real_dev,
+               "%s: lower isn't %s only", dev->name, real_dev->name);
+
+        return bad;
+}
+
+int sim_verify(void) {
+        int *holds = calloc(devs_count + 1, sizeof(int));
+        int bad = 0;
+        ndev_t *dev;
+        int i;
+
+        BUG_ON(!holds);
+
+        VERIFY(!sim_rtnl_held, "rtnl_lock is held");
+        VERIFY(!sim_rcu_depth, "into rcu_read_lock");
+        bad += verify_poison();
+
+        for (i = 0; i < devs_count; ++i) {
+                dev = devs[i];
+                holds[dev->ifindex]++;
+
+                if (is_vlan_dev(dev)) {
+                        bad += verify_vlan(dev);
+                        holds[vlan_dev_priv(dev)->real_dev->ifindex]++;
+                } else {
+                        VERIFY(list_empty(&dev->adj_list.lower),
+                               "%s: lower of not VLAN", dev->name);
+                }
+
+                if (dev->vlan_info)
+                        bad += verify_group(dev);
+        }
+
+        for (i = 0; i < devs_count; ++i)
+                VERIFY(devs[i]->refcnt == holds[i + 1], "%s: refcnt %d, expected %d",
+                       devs[i]->name, devs[i]->refcnt, holds[i + 1]);
+
+        free(holds);
+
+        return bad;
+}
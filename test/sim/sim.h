@@ -0,0 +1,108 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Userspace simulator of ipe: kernel/ipeCmd.c, ipeTxn.c, ipeGroup.c and
+* ipeBulk.c are built as is against mock of net_device, rtnl_lock and RCU
+* (include/), so handlers of commap, renumber, failover, convert, rename
+* and slots of vlan_group are tested without insmod.
+* Operations go the way of ipeDrv.c: ipe_prepare_op, then ipe_exec_txn
+* under rtnl_lock.
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#ifndef __IPE_SIM_H
+#define __IPE_SIM_H              1
+
+#include <linux/netdevice.h>
+#include <linux/if_vlan.h>
+
+#include "../../include/ipe.h"
+#include "../../include/vlan.h"
+#include "../../include/ipeBulk.h"
+#include "../../include/ipeCmd.h"
+#include "../../include/ipeGroup.h"
+
+typedef struct net_device ndev_t;
+
+typedef struct {
+        u64     allocs;         /* kmalloc & co. of kernel code */
+        u64     frees;
+        u64     rcu_calls;      /* call_rcu */
+        u64     locks;          /* ipe_rtnl_lock */
+        u64     events;         /* ipe_event_op, ipe_event_notify */
+        u64     vid_adds;       /* ndo_vlan_rx_add_vid */
+        u64     vid_kills;      /* ndo_vlan_rx_kill_vid */
+        u64     renames;        /* dev_change_name */
+} sim_stats_t;
+
+extern sim_stats_t sim_stats;
+extern struct net  sim_net;
+
+/*
+ * Fail allocation of kernel code after @n successful ones, -1 is never.
+ * It's reset after the failure.
+ */
+extern long sim_fail_alloc;
+
+/*
+ * New vlan_info gets group of mainline 8021q: its QinQ rows aren't there,
+ * they point to poisoned part, and sim_verify checks nobody touched it.
+ */
+extern int  sim_mainline_group;
+
+
+ndev_t *sim_add_dev     (const char *name);
+ndev_t *sim_add_vlan    (ndev_t *real_dev, const char *name,
+                         const int proto, const u16 vid);
+ndev_t *sim_dev         (const int ifindex);
+/* Device is still pinned by simulator, but ipe_op_verify rejects it */
+void    sim_unregister  (ndev_t *dev);
+/* Free all devices, wait for RCU: kernel allocations must be freed */
+void    sim_reset       (void);
+
+/* End of grace period: callbacks of call_rcu are run */
+void    sim_rcu_quiesce (void);
+
+/* References of VID filter of vlan_vid_add on @dev, host order @proto */
+int     sim_vid_refs    (const ndev_t *dev, const int proto, const u16 vid);
+
+/* Like fetch_and_exec and fetch_and_exec_batch of ipeDrv.c */
+int     sim_exec        (ipe_nlmsg_t *msg);
+int     sim_exec_batch  (ipe_batch_t *batch, int *retcode);
+/* Like IPE_CMD_RENUMBER of ipeDrv.c */
+int     sim_renumber    (const ndev_t *real_dev, const ipe_vid_pair_t *map,
+                         const int count, int *moved);
+/* Like IPE_CMD_FAILOVER, *@result is freed by kvfree */
+int     sim_failover    (const ndev_t *real_dev, const ndev_t *new_real_dev,
+                         ipe_failover_t **result);
+/* Like IPE_CMD_CONVERT, host order @proto and @from (0 is any) */
+int     sim_convert     (const ndev_t *real_dev, const int proto, const int from,
+                         const u16 vid_min, const u16 vid_max, int *converted);
+/* Like IPE_CMD_RENAME by pattern, host order @proto (0 is any) */
+int     sim_rename      (const ndev_t *real_dev, const char *pattern,
+                         const int proto, const u16 vid_min, const u16 vid_max,
+                         int *renamed);
+/* Like IPE_CMD_RENAME by list of IPE_CMD_SET_NAME operations */
+int     sim_rename_list (ipe_batch_t *batch, int *renamed);
+
+void    sim_op          (ipe_nlmsg_t *msg, const int command, const ndev_t *src,
+                         const ndev_t *dst, const int value);
+
+/* Consistency of devices, slots and references: number of violations */
+int     sim_verify      (void);
+
+#endif // __IPE_SIM_H
@@ -0,0 +1,1072 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Tests of handlers on simulator: each command and its failures, batches
+* with rollback, filters of VIDs, failure of each allocation (and of each
+* filter programming) of an operation, check of slot by reader of
+* IPE_CMD_GET, bulk commands on group of mainline 8021q, and random
+* sequences. After each operation devices, slots, references and filters
+* must be consistent (sim_verify), and failed operation must change
+* nothing.
+*
+*     Usage: sim_test [ -v ] [ -s SEED ] [ -n OPS ]
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#include <unistd.h>
+
+#include "sim.h"
+
+#define ETH_8021Q       0x8100
+#define ETH_8021AD      0x88a8
+
+static int tests;
+static int failed;
+
+#define CHECK(cond)                                                     \
+        do {                                                            \
+                if (!(cond)) {                                          \
+                        fprintf(stderr, "%s:%d: %s: CHECK(%s) failed\n",\
+                                __FILE__, __LINE__, __FUNCTION__, #cond);\
+                        failed++;                                       \
+                }                                                       \
+        } while (0)
+
+#define CHECK_RES(res, code)                                            \
+        do {                                                            \
+                int __res = (res);                                      \
+                if (__res != (code)) {                                  \
+                        fprintf(stderr, "%s:%d: %s: %s = %d, expected %s\n", \
+                                __FILE__, __LINE__, __FUNCTION__, #res, \
+                                __res, #code);                          \
+                        failed++;                                       \
+                }                                                       \
+        } while (0)
+
+
+/* State of device that operations can change */
+typedef struct {
+        char    name[IFNAMSIZ];
+        int     parent;
+        int     vid;
+        int     proto;
+        int     level;
+} dev_state_t;
+
+#define MAX_DEVS        64
+
+typedef struct {
+        int             count;
+        dev_state_t     dev[MAX_DEVS];
+} snapshot_t;
+
+
+static void snapshot(snapshot_t *snap) {
+        ndev_t *dev;
+
+        memset(snap, 0, sizeof(snapshot_t));
+        while ((dev = sim_dev(snap->count + 1)) && snap->count < MAX_DEVS) {
+                dev_state_t *state = &snap->dev[snap->count++];
+
+                strlcpy(state->name, dev->name, IFNAMSIZ);
+                if (is_vlan_dev(dev)) {
+                        state->parent = vlan_dev_priv(dev)->real_dev->ifindex;
+                        state->vid    = vlan_dev_priv(dev)->vlan_id;
+                        state->proto  = ntohs(vlan_dev_priv(dev)->vlan_proto);
+                        state->level  = vlan_dev_priv(dev)->nest_level;
+                }
+        }
+}
+
+static bool snapshot_eq(const snapshot_t *a, const snapshot_t *b) {
+        return !memcmp(a, b, sizeof(snapshot_t));
+}
+
+
+static int vid(const ndev_t *dev) {
+        return vlan_dev_priv(dev)->vlan_id;
+}
+
+static int proto(const ndev_t *dev) {
+        return ntohs(vlan_dev_priv(dev)->vlan_proto);
+}
+
+static ndev_t *parent(const ndev_t *dev) {
+        return vlan_dev_priv(dev)->real_dev;
+}
+
+static int level(const ndev_t *dev) {
+        return vlan_dev_priv(dev)->nest_level;
+}
+
+static ndev_t *slot(ndev_t *real_dev, const int proto, const int vid) {
+        return real_dev->vlan_info ?
+               vlan_group_get_device(&real_dev->vlan_info->grp, htons(proto), vid) :
+               NULL;
+}
+
+static int exec(const int command, const ndev_t *src, const ndev_t *dst,
+                                                      const int value)
+{
+        ipe_nlmsg_t msg;
+
+        sim_op(&msg, command, src, dst, value);
+        return sim_exec(&msg);
+}
+
+static int set_name(const ndev_t *src, const char *name) {
+        ipe_nlmsg_t msg;
+
+        sim_op(&msg, IPE_CMD_SET_NAME, src, NULL, 0);
+        strlcpy(msg.ifname, name, IFNAMSIZ);
+        return sim_exec(&msg);
+}
+
+
+/* All memory of kernel code is freed with devices */
+static void finish(void) {
+        CHECK_RES(sim_verify(), 0);
+        sim_reset();
+        CHECK(sim_stats.allocs == sim_stats.frees);
+        memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+
+
+static void test_set_vid(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *v10 = sim_add_vlan(eth, "eth0.10", ETH_8021Q, 10);
+        ndev_t *v20 = sim_add_vlan(eth, "eth0.20", ETH_8021Q, 20);
+        struct vlan_group *grp = &eth->vlan_info->grp;
+        ipe_nlmsg_t msg;
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, 600), IPE_OK);
+        CHECK(vid(v10) == 600);
+        CHECK(slot(eth, ETH_8021Q, 600) == v10 && !slot(eth, ETH_8021Q, 10));
+        CHECK(grp->vlan_devices_arrays[VLAN_PROTO_8021Q][0]);
+
+        /* the last device of part: part is freed after commit */
+        CHECK_RES(exec(IPE_CMD_SET_VID, v20, NULL, 700), IPE_OK);
+        CHECK(!grp->vlan_devices_arrays[VLAN_PROTO_8021Q][0]);
+        CHECK(sim_stats.rcu_calls == 1);
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, 700), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, 0), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, VLAN_VID_MASK), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, VLAN_N_VID), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, -1), IPE_BAD_VID);
+        CHECK(vid(v10) == 600 && vid(v20) == 700);
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, eth, NULL, 30), IPE_BAD_DEV);
+        CHECK_RES(exec(IPE_CMD_SET_VID, NULL, NULL, 30), IPE_BAD_PTR);
+
+        /* by name: device of lookup is pinned, reference is put */
+        sim_op(&msg, IPE_CMD_SET_VID, NULL, NULL, 800);
+        strlcpy(msg.devname[IPE_SRC], "eth0.20", IFNAMSIZ);
+        CHECK_RES(sim_exec(&msg), IPE_OK);
+        CHECK(vid(v20) == 800 && msg.ifindex[IPE_SRC] == v20->ifindex);
+        CHECK_RES(sim_verify(), 0);
+
+        sim_unregister(v10);
+        CHECK_RES(exec(IPE_CMD_SET_VID, v10, NULL, 30), IPE_BAD_PTR);
+        CHECK(sim_stats.events == 3);
+
+        finish();
+}
+
+
+static void test_set_eth(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *v10 = sim_add_vlan(eth, "eth0.10", ETH_8021Q, 10);
+        ndev_t *q10;
+
+        CHECK_RES(exec(IPE_CMD_SET_ETH, v10, NULL, ETH_8021AD), IPE_OK);
+        CHECK(proto(v10) == ETH_8021AD);
+        CHECK(slot(eth, ETH_8021AD, 10) == v10 && !slot(eth, ETH_8021Q, 10));
+
+        q10 = sim_add_vlan(eth, "eth0.q10", ETH_8021Q, 10);
+        CHECK(q10);
+        CHECK_RES(exec(IPE_CMD_SET_ETH, q10, NULL, ETH_8021AD), IPE_BAD_VID);
+        CHECK(proto(q10) == ETH_8021Q);
+
+        CHECK_RES(exec(IPE_CMD_SET_ETH, v10, NULL, 0x1234), IPE_BAD_VLAN_PROTO);
+        /* QinQ ethertypes have no slots in group of mainline 8021q */
+        CHECK_RES(exec(IPE_CMD_SET_ETH, v10, NULL, 0x9100), IPE_BAD_VLAN_PROTO);
+        CHECK(proto(v10) == ETH_8021AD);
+
+        finish();
+}
+
+
+/* set_parent moves VLAN between parents of any type: QinQ, phy */
+static void test_set_parent(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *o1  = sim_add_vlan(eth, "o1", ETH_8021AD, 100);
+        ndev_t *o2  = sim_add_vlan(eth, "o2", ETH_8021AD, 200);
+        ndev_t *in  = sim_add_vlan(o1, "in", ETH_8021Q, 10);
+        ndev_t *j, *k;
+        snapshot_t before, after;
+
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, o2, 0), IPE_OK);
+        CHECK(parent(in) == o2 && level(in) == 2);
+        CHECK(slot(o2, ETH_8021Q, 10) == in && !slot(o1, ETH_8021Q, 10));
+        CHECK(sim_vid_refs(o2, ETH_8021Q, 10) == 1);
+        CHECK_RES(sim_verify(), 0);
+
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, o2, 0), IPE_DEFAULT_FAIL);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, in, 0), IPE_BAD_DEV);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, eth, o2, 0), IPE_BAD_DEV);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, NULL, 0), IPE_BAD_PTR);
+
+        /* VID is used on destination, and loop: k is upper of in */
+        j = sim_add_vlan(o1, "j", ETH_8021Q, 10);
+        k = sim_add_vlan(in, "k", ETH_8021Q, 5);
+        snapshot(&before);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, o1, 0), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, j, o2, 0), IPE_BAD_VID);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, k, 0), IPE_BAD_DEV);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, o1, j, 0), IPE_BAD_DEV);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+
+        /* VLAN of phy is moved under VLAN, and VLAN of VLAN onto phy */
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, o1, o2, 0), IPE_OK);
+        CHECK(parent(o1) == o2 && slot(o2, ETH_8021AD, 100) == o1);
+        CHECK(level(o1) == 2);
+        CHECK(!slot(eth, ETH_8021AD, 100) && sim_vid_refs(eth, ETH_8021AD, 100) == 0);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, eth, 0), IPE_OK);
+        CHECK(parent(in) == eth && slot(eth, ETH_8021Q, 10) == in);
+        CHECK(level(in) == 1);
+        CHECK(!slot(o2, ETH_8021Q, 10) && sim_vid_refs(o2, ETH_8021Q, 10) == 0);
+        CHECK_RES(sim_verify(), 0);
+
+        finish();
+}
+
+
+static void test_set_name(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *v10 = sim_add_vlan(eth, "eth0.10", ETH_8021Q, 10);
+
+        CHECK_RES(set_name(v10, "uplink"), IPE_OK);
+        CHECK(!strcmp(v10->name, "uplink"));
+        CHECK(sim_stats.renames == 1);
+
+        /* name hash of netns: the name is taken, or isn't valid */
+        CHECK_RES(set_name(v10, "eth0"), IPE_BAD_ARG);
+        CHECK_RES(set_name(v10, "a b"), IPE_BAD_ARG);
+        CHECK(!strcmp(v10->name, "uplink") && !strcmp(eth->name, "eth0"));
+        CHECK(__dev_get_by_name(&sim_net, "uplink") == v10);
+        CHECK(!__dev_get_by_name(&sim_net, "eth0.10"));
+
+        finish();
+}
+
+
+static void add_op(ipe_batch_t *batch, const int command, const ndev_t *src,
+                                       const ndev_t *dst, const int value)
+{
+        sim_op(&batch->ops[batch->count++], command, src, dst, value);
+}
+
+static ipe_batch_t *alloc_batch(const int flags) {
+        ipe_batch_t *batch = calloc(1, sizeof(ipe_batch_t) +
+                                       16 * sizeof(ipe_nlmsg_t));
+
+        batch->flags = flags;
+        return batch;
+}
+
+
+static void test_batch(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *v10 = sim_add_vlan(eth, "eth0.10", ETH_8021Q, 10);
+        ndev_t *v20 = sim_add_vlan(eth, "eth0.20", ETH_8021Q, 20);
+        struct ipe_op_status status;
+        ipe_batch_t *batch;
+        snapshot_t before, after;
+        int retcode[16];
+
+        /* all or nothing: the third one fails */
+        batch = alloc_batch(IPE_BATCH_ATOMIC);
+        add_op(batch, IPE_CMD_SET_VID, v10, NULL, 30);
+        add_op(batch, IPE_CMD_SET_VID, v20, NULL, 40);
+        add_op(batch, IPE_CMD_SET_VID, v20, NULL, 30);
+
+        snapshot(&before);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_BAD_VID);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+        CHECK(retcode[0] == IPE_ROLLED_BACK && retcode[1] == IPE_ROLLED_BACK &&
+              retcode[2] == IPE_BAD_VID);
+        CHECK(slot(eth, ETH_8021Q, 10) == v10 && slot(eth, ETH_8021Q, 20) == v20);
+        CHECK(!slot(eth, ETH_8021Q, 30) && !slot(eth, ETH_8021Q, 40));
+        CHECK(sim_stats.events == 0);
+        CHECK_RES(sim_verify(), 0);
+
+        /* without ATOMIC the first ones stay */
+        batch->flags = 0;
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_BAD_VID);
+        CHECK(retcode[0] == IPE_OK && retcode[1] == IPE_OK &&
+              retcode[2] == IPE_BAD_VID);
+        CHECK(vid(v10) == 30 && vid(v20) == 40);
+        CHECK(sim_stats.events == 2);
+        CHECK_RES(sim_verify(), 0);
+
+        /* IPE_ATTR_STATUS: old and new VID, failed one stays */
+        ipe_op_status(&batch->ops[0], 0, retcode[0], &status);
+        CHECK(status.index == 0 && status.code == IPE_OK &&
+              status.ifindex == v10->ifindex &&
+              status.old_value == 10 && status.new_value == 30);
+        ipe_op_status(&batch->ops[2], 2, retcode[2], &status);
+        CHECK(status.index == 2 && status.code == IPE_BAD_VID &&
+              status.ifindex == v20->ifindex &&
+              status.old_value == 40 && status.new_value == 40);
+
+        /* bad operation: nothing is applied */
+        batch->count = 0;
+        add_op(batch, IPE_CMD_SET_VID, v10, NULL, 40);
+        add_op(batch, IPE_CMD_SET_VID, eth, NULL, 40);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_BAD_DEV);
+        CHECK(retcode[0] == IPE_SKIPPED && retcode[1] == IPE_BAD_DEV);
+        CHECK(vid(v10) == 30);
+        ipe_op_status(&batch->ops[1], 1, retcode[1], &status);
+        CHECK(status.code == IPE_BAD_DEV && !status.old_value && !status.new_value);
+
+        /* negative code is kept by status */
+        batch->count = 0;
+        add_op(batch, IPE_CMD_SET_ETH, v10, NULL, 0x1234);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_BAD_VLAN_PROTO);
+        ipe_op_status(&batch->ops[0], 0, retcode[0], &status);
+        CHECK(status.code == IPE_BAD_VLAN_PROTO && status.ifindex == v10->ifindex);
+
+        /* the same slot twice into one batch */
+        batch->count = 0;
+        batch->flags = IPE_BATCH_ATOMIC;
+        add_op(batch, IPE_CMD_SET_VID, v10, NULL, 50);
+        add_op(batch, IPE_CMD_SET_VID, v10, NULL, 30);
+        add_op(batch, IPE_CMD_SET_VID, v10, NULL, 50);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_OK);
+        CHECK(vid(v10) == 50 && slot(eth, ETH_8021Q, 50) == v10);
+        CHECK(!slot(eth, ETH_8021Q, 30));
+
+        free(batch);
+        finish();
+}
+
+
+
+/*
+ * Filter of real_dev (vlan_vid_add) follows slot: ndo_vlan_rx_add_vid for
+ * new VID, ndo_vlan_rx_kill_vid for old one. VID that is both added and
+ * deleted into one transaction or renumber isn't reprogrammed.
+ */
+#define CHECK_NDO(adds, kills)                                          \
+        do {                                                            \
+                CHECK(sim_stats.vid_adds == (adds) &&                   \
+                      sim_stats.vid_kills == (kills));                  \
+                sim_stats.vid_adds  = 0;                                \
+                sim_stats.vid_kills = 0;                                \
+        } while (0)
+
+static void test_filters(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *a = sim_add_vlan(eth, "a", ETH_8021Q, 10);
+        ndev_t *b = sim_add_vlan(eth, "b", ETH_8021Q, 20);
+        ndev_t *c = sim_add_vlan(eth, "c", ETH_8021Q, 30);
+        ndev_t *o1, *o2, *in;
+        ipe_batch_t *batch;
+        ipe_vid_pair_t swap[] = { { 20, 30 }, { 30, 20 } };
+        ipe_vid_pair_t shift[] = { { 20, 21 }, { 30, 20 } };
+        int retcode[16];
+        int moved;
+
+        CHECK_NDO(3, 0);
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, a, NULL, 40), IPE_OK);
+        CHECK_NDO(1, 1);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 40) == 1);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 10) == 0);
+
+        CHECK_RES(exec(IPE_CMD_SET_ETH, a, NULL, ETH_8021AD), IPE_OK);
+        CHECK_NDO(1, 1);
+        CHECK(sim_vid_refs(eth, ETH_8021AD, 40) == 1);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 40) == 0);
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, b, NULL, 30), IPE_BAD_VID);
+        CHECK_NDO(0, 0);
+
+        /* swap by free VID: only it is programmed */
+        batch = alloc_batch(IPE_BATCH_ATOMIC);
+        add_op(batch, IPE_CMD_SET_VID, b, NULL, 50);
+        add_op(batch, IPE_CMD_SET_VID, c, NULL, 20);
+        add_op(batch, IPE_CMD_SET_VID, b, NULL, 30);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_OK);
+        CHECK_NDO(1, 1);
+        CHECK(vid(b) == 30 && vid(c) == 20);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 50) == 0);
+
+        /* rollback deletes filter of applied operation */
+        batch->count = 0;
+        add_op(batch, IPE_CMD_SET_VID, b, NULL, 60);
+        add_op(batch, IPE_CMD_SET_VID, c, NULL, 20);
+        CHECK_RES(sim_exec_batch(batch, retcode), IPE_BAD_VID);
+        CHECK_NDO(1, 1);
+        CHECK(vid(b) == 30 && sim_vid_refs(eth, ETH_8021Q, 60) == 0);
+        free(batch);
+
+        CHECK_RES(sim_renumber(eth, swap, 2, &moved), IPE_OK);
+        CHECK(moved == 2 && vid(b) == 20 && vid(c) == 30);
+        CHECK_NDO(0, 0);
+
+        CHECK_RES(sim_renumber(eth, shift, 2, &moved), IPE_OK);
+        CHECK(moved == 2 && vid(b) == 21 && vid(c) == 20);
+        CHECK_NDO(1, 1);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 30) == 0);
+
+        /* filter moves between parents */
+        o1 = sim_add_vlan(eth, "o1", ETH_8021AD, 100);
+        o2 = sim_add_vlan(eth, "o2", ETH_8021AD, 200);
+        in = sim_add_vlan(o1, "in", ETH_8021Q, 10);
+        CHECK_NDO(3, 0);
+
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, in, o2, 0), IPE_OK);
+        CHECK_NDO(1, 1);
+        CHECK(sim_vid_refs(o2, ETH_8021Q, 10) == 1);
+        CHECK(sim_vid_refs(o1, ETH_8021Q, 10) == 0);
+        CHECK(!o1->vlan_info);
+
+        finish();
+}
+
+
+
+/*
+ * Each allocation of operation fails in turn: operation is applied or
+ * fails without changes, and nothing leaks.
+ */
+typedef void (*setup_t)(ndev_t **dev);
+typedef int  (*op_t)(ndev_t **dev);
+
+static void setup_qinq(ndev_t **dev) {
+        dev[0] = sim_add_dev("eth0");
+        dev[1] = sim_add_vlan(dev[0], "o1", ETH_8021AD, 100);
+        dev[2] = sim_add_vlan(dev[0], "o2", ETH_8021AD, 200);
+        dev[3] = sim_add_vlan(dev[1], "in", ETH_8021Q, 10);
+        dev[4] = sim_add_vlan(dev[1], "in2", ETH_8021Q, 20);
+}
+
+static int op_set_parent(ndev_t **dev) {
+        return exec(IPE_CMD_SET_PARENT, dev[3], dev[2], 0);
+}
+
+static int op_set_vid(ndev_t **dev) {
+        return exec(IPE_CMD_SET_VID, dev[3], NULL, 4000);
+}
+
+static int op_set_eth(ndev_t **dev) {
+        return exec(IPE_CMD_SET_ETH, dev[3], NULL, ETH_8021AD);
+}
+
+static int op_batch(ndev_t **dev) {
+        ipe_batch_t *batch = alloc_batch(IPE_BATCH_ATOMIC);
+        int retcode[16];
+        int res;
+
+        add_op(batch, IPE_CMD_SET_PARENT, dev[3], dev[2], 0);
+        add_op(batch, IPE_CMD_SET_VID, dev[4], NULL, 3000);
+        add_op(batch, IPE_CMD_SET_ETH, dev[4], NULL, ETH_8021AD);
+        add_op(batch, IPE_CMD_SET_PARENT, dev[4], dev[2], 0);
+        res = sim_exec_batch(batch, retcode);
+        free(batch);
+
+        return res;
+}
+
+static int op_renumber(ndev_t **dev) {
+        ipe_vid_pair_t map[] = { { 10, 20 }, { 20, 30 } };
+        int moved;
+
+        return sim_renumber(dev[1], map, 2, &moved);
+}
+
+static int op_convert(ndev_t **dev) {
+        int converted;
+
+        return sim_convert(dev[1], ETH_8021AD, 0, 1, VLAN_VID_MASK - 1, &converted);
+}
+
+/* swap of in and in2 is cycle: one of them gets temporary name */
+static int op_rename(ndev_t **dev) {
+        ipe_batch_t *batch = alloc_batch(0);
+        int renamed;
+        int res;
+
+        add_op(batch, IPE_CMD_SET_NAME, dev[3], NULL, 0);
+        strlcpy(batch->ops[0].ifname, "in2", IFNAMSIZ);
+        add_op(batch, IPE_CMD_SET_NAME, dev[4], NULL, 0);
+        strlcpy(batch->ops[1].ifname, "in", IFNAMSIZ);
+        add_op(batch, IPE_CMD_SET_NAME, dev[2], NULL, 0);
+        strlcpy(batch->ops[2].ifname, "o3", IFNAMSIZ);
+        res = sim_rename_list(batch, &renamed);
+        free(batch);
+
+        return res;
+}
+
+static void fault_injection(const char *name, setup_t setup, op_t op) {
+        snapshot_t before, after, expected;
+        ndev_t *dev[8];
+        long n;
+        int res;
+
+        setup(dev);
+        CHECK_RES(op(dev), IPE_OK);
+        snapshot(&expected);
+        finish();
+
+        for (n = 0; ; ++n) {
+                setup(dev);
+                snapshot(&before);
+
+                sim_fail_alloc = n;
+                res = op(dev);
+                snapshot(&after);
+
+                if (res == IPE_OK) {
+                        if (!snapshot_eq(&after, &expected))
+                                fprintf(stderr, "%s: allocation #%ld\n", name, n);
+                        CHECK(snapshot_eq(&after, &expected));
+                } else {
+                        if (!snapshot_eq(&after, &before))
+                                fprintf(stderr, "%s: allocation #%ld\n", name, n);
+                        CHECK(snapshot_eq(&after, &before));
+                        /* filter of VID fails with -EIO, others are -ENOMEM */
+                        CHECK(res == IPE_BAD_ALLOC || res == IPE_DEFAULT_FAIL);
+                }
+
+                /* nothing was failed: all allocations are passed */
+                if (sim_fail_alloc >= 0) {
+                        sim_fail_alloc = -1;
+                        finish();
+                        break;
+                }
+
+                finish();
+        }
+}
+
+static void test_fault_injection(void) {
+        fault_injection("set_parent", setup_qinq, op_set_parent);
+        fault_injection("set_vid", setup_qinq, op_set_vid);
+        fault_injection("set_eth", setup_qinq, op_set_eth);
+        fault_injection("batch", setup_qinq, op_batch);
+        fault_injection("renumber", setup_qinq, op_renumber);
+        fault_injection("convert", setup_qinq, op_convert);
+        fault_injection("rename", setup_qinq, op_rename);
+}
+
+
+
+/* Exit code of failover for @dev, IPE_OK if it's moved */
+static int failover_code(const ipe_failover_t *failover, const ndev_t *dev) {
+        int i;
+
+        for (i = 0; i < failover->nr_failed; ++i) {
+                if (failover->failed[i].ifindex == dev->ifindex)
+                        return failover->failed[i].retcode;
+        }
+
+        return IPE_OK;
+}
+
+static void test_failover(void) {
+        ndev_t *eth0 = sim_add_dev("eth0");
+        ndev_t *eth1 = sim_add_dev("eth1");
+        ndev_t *a = sim_add_vlan(eth0, "a", ETH_8021Q, 10);
+        ndev_t *b = sim_add_vlan(eth0, "b", ETH_8021Q, 20);
+        ndev_t *c = sim_add_vlan(eth0, "c", ETH_8021AD, 30);
+        ndev_t *d = sim_add_vlan(a, "d", ETH_8021Q, 5);
+        ndev_t *x = sim_add_vlan(eth1, "x", ETH_8021Q, 20);
+        sim_stats_t stats = sim_stats;
+        ipe_failover_t *failover;
+        snapshot_t before, after;
+
+        /* VID 20 is used on eth1: b stays */
+        CHECK_RES(sim_failover(eth0, eth1, &failover), IPE_OK);
+        CHECK(failover->moved == 2 && failover->nr_failed == 1);
+        CHECK_RES(failover_code(failover, b), IPE_BAD_VID);
+        kvfree(failover);
+        CHECK(parent(a) == eth1 && parent(c) == eth1 && parent(b) == eth0);
+        CHECK(parent(d) == a && parent(x) == eth1);
+        CHECK(slot(eth1, ETH_8021Q, 10) == a && slot(eth1, ETH_8021AD, 30) == c);
+        CHECK(slot(eth0, ETH_8021Q, 20) == b && !slot(eth0, ETH_8021Q, 10));
+        CHECK(sim_vid_refs(eth0, ETH_8021Q, 10) == 0);
+        CHECK(sim_vid_refs(eth1, ETH_8021AD, 30) == 1);
+        CHECK(sim_stats.vid_adds - stats.vid_adds == 2);
+        CHECK(sim_stats.vid_kills - stats.vid_kills == 2);
+        CHECK(sim_stats.locks - stats.locks == 1);
+        CHECK(sim_stats.events - stats.events == 2);
+        CHECK_RES(sim_verify(), 0);
+
+        /* into own child: the child itself stays */
+        CHECK_RES(sim_failover(eth1, a, &failover), IPE_OK);
+        CHECK(failover->moved == 2 && failover->nr_failed == 1);
+        CHECK_RES(failover_code(failover, a), IPE_BAD_DEV);
+        kvfree(failover);
+        CHECK(parent(c) == a && parent(x) == a && parent(a) == eth1);
+        CHECK_RES(sim_verify(), 0);
+
+        /* the last child is gone: vlan_info of old parent too */
+        CHECK_RES(sim_failover(eth0, eth1, &failover), IPE_OK);
+        CHECK(failover->moved == 1 && failover->nr_failed == 0);
+        kvfree(failover);
+        CHECK(parent(b) == eth1 && !eth0->vlan_info);
+
+        CHECK_RES(sim_failover(eth0, eth1, &failover), IPE_OK);
+        CHECK(failover->moved == 0 && failover->nr_failed == 0);
+        kvfree(failover);
+
+        snapshot(&before);
+        CHECK_RES(sim_failover(eth1, eth1, &failover), IPE_BAD_DEV);
+        CHECK_RES(sim_failover(eth1, NULL, &failover), IPE_BAD_PTR);
+        CHECK(!failover);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+
+        finish();
+}
+
+
+/*
+ * Failover isn't all or nothing: with failure of each allocation in turn
+ * every child is moved or stays, as failover reports.
+ */
+static void test_failover_faults(void) {
+        ipe_failover_t *failover;
+        snapshot_t before, after;
+        ndev_t *dev[8];
+        long n;
+        int res;
+        int i;
+
+        for (n = 0; ; ++n) {
+                setup_qinq(dev);
+                snapshot(&before);
+
+                sim_fail_alloc = n;
+                res = sim_failover(dev[1], dev[2], &failover);
+
+                if (res == IPE_OK) {
+                        CHECK(failover->moved + failover->nr_failed == 2);
+                        for (i = 3; i < 5; ++i)
+                                CHECK(parent(dev[i]) == (failover_code(failover, dev[i]) ?
+                                                         dev[1] : dev[2]));
+                        kvfree(failover);
+                } else {
+                        snapshot(&after);
+                        CHECK(snapshot_eq(&before, &after));
+                }
+
+                /* nothing was failed: all allocations are passed */
+                if (sim_fail_alloc >= 0) {
+                        sim_fail_alloc = -1;
+                        finish();
+                        break;
+                }
+
+                finish();
+        }
+}
+
+
+
+/* C-tags to S-tags of one parent: one rtnl_lock, filters by one pass */
+static void test_convert(void) {
+        ndev_t *eth  = sim_add_dev("eth0");
+        ndev_t *eth1 = sim_add_dev("eth1");
+        ndev_t *a = sim_add_vlan(eth, "a", ETH_8021Q, 10);
+        ndev_t *b = sim_add_vlan(eth, "b", ETH_8021Q, 20);
+        ndev_t *c = sim_add_vlan(eth, "c", ETH_8021Q, 600);
+        ndev_t *s = sim_add_vlan(eth, "s", ETH_8021AD, 30);
+        sim_stats_t stats = sim_stats;
+        snapshot_t before, after;
+        ndev_t *d, *e;
+        int converted;
+
+        /* VID range: c stays */
+        CHECK_RES(sim_convert(eth, ETH_8021AD, 0, 1, 100, &converted), IPE_OK);
+        CHECK(converted == 2 && proto(a) == ETH_8021AD && proto(b) == ETH_8021AD);
+        CHECK(proto(c) == ETH_8021Q && proto(s) == ETH_8021AD);
+        CHECK(slot(eth, ETH_8021AD, 10) == a && !slot(eth, ETH_8021Q, 10));
+        CHECK(!eth->vlan_info->grp.vlan_devices_arrays[VLAN_PROTO_8021Q][0]);
+        CHECK(sim_vid_refs(eth, ETH_8021Q, 20) == 0);
+        CHECK(sim_vid_refs(eth, ETH_8021AD, 20) == 1);
+        CHECK(sim_stats.vid_adds - stats.vid_adds == 2);
+        CHECK(sim_stats.vid_kills - stats.vid_kills == 2);
+        CHECK(sim_stats.locks - stats.locks == 1);
+        CHECK(sim_stats.events - stats.events == 2);
+
+        /* all or nothing: VID 10 of d is used by a, c stays too */
+        d = sim_add_vlan(eth, "d", ETH_8021Q, 10);
+        snapshot(&before);
+        CHECK_RES(sim_convert(eth, ETH_8021AD, 0, 1, 4094, &converted), IPE_BAD_VID);
+        CHECK(converted == 0);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+        CHECK(slot(eth, ETH_8021Q, 10) == d && slot(eth, ETH_8021Q, 600) == c);
+
+        /* slot of c is taken by e of the other ethertype */
+        e = sim_add_vlan(eth, "e", ETH_8021AD, 600);
+        CHECK_RES(sim_convert(eth, ETH_8021Q, ETH_8021AD, 600, 600, &converted),
+                                                                IPE_BAD_VID);
+        CHECK(proto(c) == ETH_8021Q && proto(e) == ETH_8021AD);
+        CHECK(slot(eth, ETH_8021AD, 30) == s);
+
+        /* QinQ ethertypes have no slots in group of mainline 8021q */
+        snapshot(&before);
+        CHECK_RES(sim_convert(eth, 0x9100, 0, 1, 4094, &converted), IPE_BAD_VLAN_PROTO);
+        CHECK_RES(sim_convert(eth, 0x1234, 0, 1, 4094, &converted), IPE_BAD_VLAN_PROTO);
+        CHECK_RES(sim_convert(eth, ETH_8021AD, 0x1234, 1, 4094, &converted),
+                                                         IPE_BAD_VLAN_PROTO);
+        CHECK_RES(sim_convert(eth, ETH_8021AD, 0, 100, 10, &converted), IPE_BAD_VID);
+        CHECK_RES(sim_convert(NULL, ETH_8021AD, 0, 1, 4094, &converted), IPE_BAD_PTR);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+
+        /* parent without VLAN children has nothing to convert */
+        CHECK_RES(sim_convert(eth1, ETH_8021AD, 0, 1, 4094, &converted), IPE_OK);
+        CHECK(converted == 0);
+
+        finish();
+}
+
+
+static void rename_op(ipe_batch_t *batch, const ndev_t *dev, const char *name) {
+        add_op(batch, IPE_CMD_SET_NAME, dev, NULL, 0);
+        strlcpy(batch->ops[batch->count - 1].ifname, name, IFNAMSIZ);
+}
+
+static void test_rename(void) {
+        ipe_batch_t *batch = alloc_batch(0);
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *a = sim_add_vlan(eth, "a", ETH_8021Q, 10);
+        ndev_t *b = sim_add_vlan(eth, "b", ETH_8021Q, 20);
+        ndev_t *c = sim_add_vlan(eth, "c", ETH_8021AD, 30);
+        ndev_t *d = sim_add_vlan(eth, "d", ETH_8021Q, 300);
+        sim_stats_t stats = sim_stats;
+        snapshot_t before, after;
+        int renamed;
+
+        /* pattern by VID of children, one rtnl_lock section */
+        CHECK_RES(sim_rename(eth, "svc%d", 0, 1, 100, &renamed), IPE_OK);
+        CHECK(renamed == 3 && !strcmp(a->name, "svc10") &&
+              !strcmp(b->name, "svc20") && !strcmp(c->name, "svc30"));
+        CHECK(!strcmp(d->name, "d"));
+        CHECK(sim_stats.locks - stats.locks == 1);
+        CHECK(sim_stats.events - stats.events == 3);
+        CHECK(sim_stats.renames - stats.renames == 3);
+
+        /* only children of ethertype, the same names aren't renamed */
+        CHECK_RES(sim_rename(eth, "q%d", ETH_8021Q, 1, 4094, &renamed), IPE_OK);
+        CHECK(renamed == 3 && !strcmp(d->name, "q300") && !strcmp(c->name, "svc30"));
+        CHECK_RES(sim_rename(eth, "q%d", ETH_8021Q, 1, 4094, &renamed), IPE_OK);
+        CHECK(renamed == 0);
+
+        /* collision with device out of set is found before any rename */
+        sim_add_dev("svc20");
+        snapshot(&before);
+        stats = sim_stats;
+        CHECK_RES(sim_rename(eth, "svc%d", 0, 1, 4094, &renamed), IPE_BAD_ARG);
+        batch->count = 0;
+        rename_op(batch, a, "x");
+        rename_op(batch, b, "svc20");
+        CHECK_RES(sim_rename_list(batch, &renamed), IPE_BAD_ARG);
+        CHECK(renamed == 0 && sim_stats.renames == stats.renames);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+
+        /* swap is cycle, chain goes from free target: c -> d -> d2 */
+        batch->count = 0;
+        rename_op(batch, a, "q20");
+        rename_op(batch, b, "q10");
+        rename_op(batch, c, "q300");
+        rename_op(batch, d, "d2");
+        stats = sim_stats;
+        CHECK_RES(sim_rename_list(batch, &renamed), IPE_OK);
+        CHECK(renamed == 4 && sim_stats.locks - stats.locks == 1);
+        CHECK(!strcmp(a->name, "q20") && !strcmp(b->name, "q10"));
+        CHECK(!strcmp(c->name, "q300") && !strcmp(d->name, "d2"));
+        CHECK(sim_stats.renames - stats.renames == 5);
+        CHECK(sim_stats.events - stats.events == 4);
+
+        /* the same device or target twice, bad name, bad pattern */
+        snapshot(&before);
+        batch->count = 0;
+        rename_op(batch, a, "z1");
+        rename_op(batch, a, "z2");
+        CHECK_RES(sim_rename_list(batch, &renamed), IPE_BAD_ARG);
+        batch->count = 0;
+        rename_op(batch, a, "z1");
+        rename_op(batch, b, "z1");
+        CHECK_RES(sim_rename_list(batch, &renamed), IPE_BAD_ARG);
+        batch->count = 0;
+        rename_op(batch, a, "z:1");
+        CHECK_RES(sim_rename_list(batch, &renamed), IPE_BAD_ARG);
+        CHECK_RES(sim_rename(eth, "svc", 0, 1, 4094, &renamed), IPE_BAD_ARG);
+        CHECK_RES(sim_rename(eth, "%d%d", 0, 1, 4094, &renamed), IPE_BAD_ARG);
+        CHECK_RES(sim_rename(eth, "%s", 0, 1, 4094, &renamed), IPE_BAD_ARG);
+        CHECK_RES(sim_rename(eth, "longlongname%d", 0, 1, 4094, &renamed),
+                                                              IPE_BAD_ARG);
+        CHECK_RES(sim_rename(eth, "v%d", 0x1234, 1, 4094, &renamed),
+                                                 IPE_BAD_VLAN_PROTO);
+        snapshot(&after);
+        CHECK(snapshot_eq(&before, &after));
+
+        free(batch);
+        finish();
+}
+
+
+
+static unsigned long long rnd_state;
+
+static unsigned int rnd(const unsigned int n) {
+        rnd_state = rnd_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (rnd_state >> 33) % n;
+}
+
+static const int eth_values[] = { ETH_8021Q, ETH_8021AD, 0x9100, 0x9200, 0x1234 };
+
+/* Random operation on random devices, values are valid mostly */
+static void random_op(ipe_nlmsg_t *msg, ndev_t **dev, const int count) {
+        const ndev_t *src = dev[rnd(count)];
+
+        switch (rnd(4)) {
+        case 0:
+                sim_op(msg, IPE_CMD_SET_VID, src, NULL,
+                       rnd(16) ? 1 + rnd(VLAN_N_VID - 2) : rnd(VLAN_N_VID + 1));
+                break;
+        case 1:
+                sim_op(msg, IPE_CMD_SET_ETH, src, NULL, eth_values[rnd(5)]);
+                break;
+        case 2:
+                sim_op(msg, IPE_CMD_SET_PARENT, src, dev[rnd(count)], 0);
+                break;
+        default:
+                sim_op(msg, IPE_CMD_SET_NAME, src, NULL, 0);
+                snprintf(msg->ifname, IFNAMSIZ, "r%u", rnd(100000));
+                break;
+        }
+}
+
+/* Reader of IPE_CMD_GET: slot is checked under RCU, rtnl_lock isn't taken */
+static bool holds(const ndev_t *dev) {
+        bool res;
+
+        rcu_read_lock();
+        res = ipe_group_holds(dev);
+        rcu_read_unlock();
+
+        return res;
+}
+
+static void test_group_holds(void) {
+        ndev_t *eth = sim_add_dev("eth0");
+        ndev_t *o1  = sim_add_vlan(eth, "o1", ETH_8021AD, 100);
+        ndev_t *o2  = sim_add_vlan(eth, "o2", ETH_8021AD, 200);
+        ndev_t *a   = sim_add_vlan(o1, "a", ETH_8021Q, 10);
+        ndev_t *b   = sim_add_vlan(o1, "b", ETH_8021Q, 20);
+        u64 locks = sim_stats.locks;
+
+        CHECK(holds(o1) && holds(a) && holds(b));
+        CHECK(sim_stats.locks == locks);
+
+        CHECK_RES(exec(IPE_CMD_SET_VID, a, NULL, 300), IPE_OK);
+        CHECK_RES(exec(IPE_CMD_SET_ETH, b, NULL, ETH_8021AD), IPE_OK);
+        CHECK_RES(exec(IPE_CMD_SET_PARENT, b, o2, 0), IPE_OK);
+        locks = sim_stats.locks;
+        CHECK(holds(a) && holds(b));
+        CHECK(sim_stats.locks == locks);
+
+        /* slot of other device, or empty one */
+        vlan_group_set_device(&o1->vlan_info->grp, htons(ETH_8021Q), 300, NULL);
+        CHECK(!holds(a));
+        vlan_group_set_device(&o1->vlan_info->grp, htons(ETH_8021Q), 300, b);
+        CHECK(!holds(a));
+        vlan_group_set_device(&o1->vlan_info->grp, htons(ETH_8021Q), 300, a);
+        CHECK(holds(a));
+
+        finish();
+}
+
+
+/*
+ * Group of mainline 8021q has rows of 8021Q and 8021AD only: bulk
+ * commands walk them, poisoned QinQ rows aren't read.
+ */
+static void test_mainline_group(void) {
+        ipe_vid_pair_t map[] = { { 10, 11 }, { 20, 21 } };
+        ipe_failover_t *failover;
+        ndev_t *eth, *eth1, *a, *b, *c;
+        int converted;
+        int renamed;
+        int moved;
+
+        sim_mainline_group = 1;
+        eth  = sim_add_dev("eth0");
+        eth1 = sim_add_dev("eth1");
+        a   = sim_add_vlan(eth, "a", ETH_8021Q, 10);
+        b   = sim_add_vlan(eth, "b", ETH_8021AD, 20);
+        c   = sim_add_vlan(eth, "c", ETH_8021Q, 600);
+
+        CHECK_RES(sim_renumber(eth, map, 2, &moved), IPE_OK);
+        CHECK(moved == 2 && vid(a) == 11 && vid(b) == 21 && vid(c) == 600);
+        CHECK_RES(sim_verify(), 0);
+
+        CHECK_RES(sim_failover(eth, eth1, &failover), IPE_OK);
+        CHECK(failover->moved == 3 && failover->nr_failed == 0);
+        kvfree(failover);
+        CHECK(parent(a) == eth1 && parent(b) == eth1 && parent(c) == eth1);
+        CHECK_RES(sim_verify(), 0);
+
+        CHECK_RES(sim_convert(eth1, ETH_8021AD, ETH_8021Q, 1, 4094, &converted), IPE_OK);
+        CHECK(converted == 2 && proto(a) == ETH_8021AD && proto(c) == ETH_8021AD);
+        CHECK_RES(sim_convert(eth1, 0x9100, 0, 1, 4094, &converted), IPE_BAD_VLAN_PROTO);
+        CHECK_RES(exec(IPE_CMD_SET_ETH, b, NULL, 0x9200), IPE_BAD_VLAN_PROTO);
+        CHECK_RES(sim_verify(), 0);
+
+        CHECK_RES(sim_rename(eth1, "m%d", 0, 1, 4094, &renamed), IPE_OK);
+        CHECK(renamed == 3 && !strcmp(a->name, "m11") && !strcmp(c->name, "m600"));
+        CHECK_RES(sim_verify(), 0);
+
+        sim_mainline_group = 0;
+        finish();
+}
+
+
+static void test_random(const long ops) {
+        ipe_batch_t *batch = alloc_batch(0);
+        snapshot_t before, after;
+        ndev_t *dev[MAX_DEVS];
+        char name[IFNAMSIZ];
+        int retcode[16];
+        int count = 0;
+        int res;
+        long i;
+        int j;
+
+        dev[count++] = sim_add_dev("eth0");
+        for (j = 0; j < 4; ++j) {
+                snprintf(name, sizeof(name), "o%d", j);
+                dev[count++] = sim_add_vlan(dev[0], name, ETH_8021AD, 100 + j);
+        }
+        while (count < 40) {
+                ndev_t *vlan;
+
+                snprintf(name, sizeof(name), "v%d", count);
+                vlan = sim_add_vlan(dev[1 + rnd(count - 1)], name,
+                                    ETH_8021Q, 1 + rnd(64));
+                if (vlan)
+                        dev[count++] = vlan;
+        }
+
+        for (i = 0; i < ops && !failed; ++i) {
+                snapshot(&before);
+
+                if (rnd(8)) {
+                        ipe_nlmsg_t msg;
+
+                        random_op(&msg, dev, count);
+                        res = sim_exec(&msg);
+                } else {
+                        /* atomic batch: applied whole or not at all */
+                        batch->count = 1 + rnd(16);
+                        batch->flags = IPE_BATCH_ATOMIC;
+                        for (j = 0; j < batch->count; ++j)
+                                random_op(&batch->ops[j], dev, count);
+                        res = sim_exec_batch(batch, retcode);
+                }
+
+                snapshot(&after);
+                if (res != IPE_OK)
+                        CHECK(snapshot_eq(&before, &after));
+
+                if (sim_verify()) {
+                        fprintf(stderr, "random: after operation #%ld\n", i);
+                        failed++;
+                }
+        }
+
+        free(batch);
+        finish();
+}
+
+
+
+int main(int argc, char **argv) {
+        unsigned long long seed = 1;
+        long ops = 100000;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "vs:n:")) != -1) {
+                switch (opt) {
+                case 'v':
+                        sim_verbose = 1;
+                        break;
+                case 's':
+                        seed = strtoull(optarg, NULL, 0);
+                        break;
+                case 'n':
+                        ops = strtol(optarg, NULL, 0);
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [ -v ] [ -s SEED ] [ -n OPS ]\n",
+                                                                argv[0]);
+                        return 1;
+                }
+        }
+
+        rnd_state = seed;
+
+#define RUN(test)                                                       \
+        do {                                                            \
+                int __failed = failed;                                  \
+                test;                                                   \
+                tests++;                                                \
+                printf("%-24s %s\n", #test, failed == __failed ? "ok" : "FAIL"); \
+        } while (0)
+
+        RUN(test_set_vid());
+        RUN(test_set_eth());
+        RUN(test_set_parent());
+        RUN(test_set_name());
+        RUN(test_batch());
+        RUN(test_filters());
+        RUN(test_fault_injection());
+        RUN(test_failover());
+        RUN(test_failover_faults());
+        RUN(test_convert());
+        RUN(test_rename());
+        RUN(test_group_holds());
+        RUN(test_mainline_group());
+        RUN(test_random(ops));
+
+        printf("%d tests, %d checks failed\n", tests, failed);
+
+        return failed ? 1 : 0;
+}
@@ -8,11 +8,6 @@ IF_NAME="vlan1"
 PARENT="enp3s0"
 VID="42"
 
-function get_ifindex() {
-        LIST=`ip a | grep ${PARENT} | grep -o -E '[0-9]+'`
-        echo `echo $LIST | cut -d" " -f1`
-}
-
 function make_all() {
         cd ../kernel
         make disclean
@@ -62,11 +57,15 @@ if [[ $1 == "ins" ]]; then
 fi
 
 if [[ $1 == "run" ]]; then
-        IFINDEX=`get_ifindex`
         NEW_VID="142"
-        echo $IFINDEX
-#        ../ipe dev ${IFINDEX} netns ${VRF_NAME} id ${NEW_VID}
-        ../ipe dev ${IFINDEX} id ${NEW_VID}
+#        ../ipe dev ${IF_NAME} netns ${VRF_NAME} id ${NEW_VID}
+        ../ipe dev ${IF_NAME} id ${NEW_VID}
+        exit
+fi
+
+if [[ $1 == "bench" ]]; then
+        shift
+        ./ipe_bench.sh "$@"
         exit
 fi
 
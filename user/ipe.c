@@ -20,13 +20,11 @@
 *
 ******************************************************************************/
 
+
+
 #define _GNU_SOURCE
 
-#include <sys/syscall.h>
-#include <sys/socket.h>
-#include <fcntl.h>
-#include <linux/netlink.h>
-#include <linux/if.h> // IFNAMSIZ
+#include <errno.h>
 
 #include <stdlib.h>
 #include <string.h>
@@ -34,36 +32,43 @@
 
 #include "ipe.h"
 
-#define MAX_PAYLOAD 1024  /* maximum payload size*/
+#define MAX_VID     4094
+
+/* -batch mode: */
+#define BATCH_MAX_ARGS       64   /* words into one line */
 
 #define NEXT_ARG(args, argv) (argv++, args--)
 #define CHECK_ARGS(args)     (args - 1 > 0)
 
 
-typedef struct nlmsghdr nmsgh_t;
-
-
 
 /* Parser's structure for create Netlink message */
 typedef struct {
         char *net    [IPE_DEV_COUNT];
+        char *nsid   [IPE_DEV_COUNT];
         int   ifindex[IPE_DEV_COUNT];
+        char *devname[IPE_DEV_COUNT];
         char ifname  [IFNAMSIZ];
         char *ctype;
         int   value;
+        /* for renumber: */
+        ipe_vid_pair_t *map;
+        int   map_count;
+        /* filter of dump, convert and rename, 0 matches all: */
+        int   parent;
+        int   proto;
+        int   vid_min;
+        int   vid_max;
 } ipe_arg_t;
 
 
 static ipe_arg_t g_arg;
 
-
-int sock_fd;
-struct sockaddr_nl src_addr, dest_addr;
-struct msghdr msg;
-nmsgh_t *nlh; 
+/* socket and buffers of libipe, one for all lines of -batch */
+static ipe_handle_t *handle;
 
 
-//#ifdef IPE_DEBUG
+#ifdef IPE_DEBUG
 static void print_msg(const ipe_nlmsg_t *msg) {
         int i;
         for (i = 0; i < IPE_DEV_COUNT; ++i)
@@ -75,133 +80,412 @@ static void print_msg(const ipe_nlmsg_t *msg) {
         printf("value: %d\n", msg->value);
         printf("command: %d\n", msg->command);
 }
-//#endif
+#endif
+
+
+
+static int open_handle(void) {
+        unsigned int version;
+
+        handle = ipe_open();
+        if (!handle) {
+                if (errno == ENOENT)
+                        fprintf(stderr, "Generic netlink family \"%s\" not found: %s. "
+                                        "Is the module loaded?\n",
+                                        IPE_GENL_NAME, strerror(errno));
+                else
+                        perror("socket");
+                return IPE_BAD_SOC;
+        }
+
+        version = ipe_module_version(handle);
+        if (version && version < IPE_GENL_VERSION)
+                fprintf(stderr, "Warning: module of version %u is older than "
+                                "ipe (%u)\n", version, IPE_GENL_VERSION);
+
+        return IPE_OK;
+}
+
+
+
+/* Device @id of arguments: netns is opened once by handle */
+static int arg_dev(ipe_dev_t *dev, const ipe_arg_t *arg, const int id) {
+        dev->ifindex = arg->ifindex[id];
+        dev->name    = arg->devname[id];
+        dev->nsfd    = -1;
+        dev->nsid    = arg->nsid[id] ? atoi(arg->nsid[id]) : -1;
+
+        if (arg->net[id]) {
+                dev->nsfd = ipe_netns_fd(handle, arg->net[id]);
+                if (dev->nsfd < 0) {
+                        perror(arg->net[id]);
+                        return IPE_FAIL_NS;
+                }
+        }
+
+        return IPE_OK;
+}
+
 
-static void prepare(void) {
+static int create_msg(ipe_nlmsg_t *op, const ipe_arg_t *arg) {
         #ifdef IPE_DEBUG
                 printf("%s: entry\n", __FUNCTION__);
         #endif
+        ipe_dev_t dev;
+        ipe_dev_t dst;
+        int res;
 
-        memset(&src_addr, 0, sizeof(src_addr));
-        src_addr.nl_family = AF_NETLINK;
+        res = arg_dev(&dev, arg, IPE_SRC);
+        if (res)
+                return res;
+
+        if (!strcmp(arg->ctype, "id")) {
+                res = ipe_op_set_vid(op, &dev, arg->value);
+        } else if (!strcmp(arg->ctype, "eth")) {
+                res = ipe_op_set_eth(op, &dev, arg->value);
+        } else if (!strcmp(arg->ctype, "name")) {
+                res = ipe_op_set_name(op, &dev, arg->ifname);
+        } else if (!strcmp(arg->ctype, "prev")) {
+                res = arg_dev(&dst, arg, IPE_DST);
+                if (!res)
+                        res = ipe_op_set_parent(op, &dev, &dst);
+        } else if (!strcmp(arg->ctype, "compact")) {
+                res = ipe_op_compact(op, &dev);
+        }
+        #ifdef IPE_DEBUG
+                else if (!strcmp(arg->ctype, "parent"))
+                        res = ipe_op_init(op, IPE_CMD_SHOW, &dev);
+                else if (!strcmp(arg->ctype, "list"))
+                        res = ipe_op_init(op, IPE_CMD_LIST, &dev);
+        #endif
+        else {
+                res = IPE_UNKNOWN_COMMAND;
+        }
+
+        #ifdef IPE_DEBUG
+                if (!res)
+                        print_msg(op);
+                printf("%s: ret\n", __FUNCTION__);
+        #endif
+
+        return res;
+}
 
-        bind(sock_fd, (struct sockaddr*)&src_addr, sizeof(src_addr));
-        memset(&dest_addr, 0, sizeof(dest_addr));
 
-        dest_addr.nl_family = AF_NETLINK;
-        dest_addr.nl_pid    = 0; /* For Linux Kernel */
-        dest_addr.nl_groups = 0; /* unicast */
+
+static int is_vid_map(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "renumber");
+}
+
+
+static int is_dump(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "dump");
 }
 
 
+static int is_compact(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "compact");
+}
+
+
+static int is_failover(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "failover");
+}
+
+
+static int is_convert(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "convert");
+}
+
+
+static int is_rename(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "rename");
+}
+
+
+static int is_get(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "get");
+}
+
+
+static int is_monitor(const ipe_arg_t *arg) {
+        return arg->ctype && !strcmp(arg->ctype, "monitor");
+}
+
+
+
+/* Ethertype and VIDs of children for convert and rename, parent is IPE_SRC */
+static void convert_filter(ipe_filter_t *filter, const ipe_arg_t *arg) {
+        memset(filter, 0, sizeof(ipe_filter_t));
+        filter->proto   = arg->proto;
+        filter->vid_min = arg->vid_min;
+        filter->vid_max = arg->vid_max;
+        filter->nsfd    = -1;
+        filter->nsid    = -1;
+}
+
 
-/* This function is paste from iproute2 */
-static int get_netns_fd(const char *name)
+/* Child of failover that stays on old parent */
+static void failover_report(void *data, const int ifindex, const int code,
+                                                           const char *errmsg)
 {
-        char pathbuf[MAX_PATH_LEN];
-        const char *path, *ptr;
+        fprintf(stderr, "ifindex %d: %s (%d)\n", ifindex,
+                                        ipe_code_name(code), code);
+}
+
 
-        path = name;
-        ptr = strchr(name, '/');
-        if (!ptr) {
-                snprintf(pathbuf, sizeof(pathbuf), "%s/%s",
-                        NETNS_RUN_DIR, name );
-                path = pathbuf;
+/* One request, exit code is taken from ACK */
+static int exec_single(const ipe_arg_t *arg) {
+        ipe_nlmsg_t op;
+        ipe_dev_t parent;
+        ipe_dev_t new_parent;
+        ipe_filter_t filter;
+        int count = -1;
+        int res;
+
+        if (is_convert(arg)) {
+                convert_filter(&filter, arg);
+                res = arg_dev(&parent, arg, IPE_SRC);
+                if (!res)
+                        res = ipe_convert(handle, &parent, arg->value, &filter,
+                                                                   &count);
+                if (!res && count >= 0)
+                        printf("%d devices converted\n", count);
+                return res;
+        }
+
+        if (is_rename(arg)) {
+                convert_filter(&filter, arg);
+                res = arg_dev(&parent, arg, IPE_SRC);
+                if (!res)
+                        res = ipe_rename(handle, &parent, arg->ifname, &filter,
+                                                                   &count);
+                if (!res && count >= 0)
+                        printf("%d devices renamed\n", count);
+                return res;
+        }
+
+        if (is_failover(arg)) {
+                res = arg_dev(&parent, arg, IPE_SRC);
+                if (!res)
+                        res = arg_dev(&new_parent, arg, IPE_DST);
+                if (!res)
+                        res = ipe_failover(handle, &parent, &new_parent, &count,
+                                                        failover_report, NULL);
+                if (!res && count >= 0)
+                        printf("%d devices moved\n", count);
+                return res;
+        }
+
+        if (is_vid_map(arg) || is_compact(arg)) {
+                res = arg_dev(&parent, arg, IPE_SRC);
+                if (res)
+                        return res;
+
+                if (is_vid_map(arg))
+                        res = ipe_renumber(handle, &parent, arg->map,
+                                           arg->map_count, &count);
+                else
+                        res = ipe_compact(handle, &parent, &count);
+
+                if (!res && count >= 0)
+                        printf(is_compact(arg) ? "%d parts freed\n" :
+                                                 "%d devices renumbered\n", count);
+                return res;
         }
-        return open(path, O_RDONLY);
-}
 
+        res = create_msg(&op, arg);
+        if (res)
+                return res;
 
+        res = ipe_exec(handle, &op);
 
-static void create_msg() {
         #ifdef IPE_DEBUG
-                printf("%s: entry\n", __FUNCTION__);
+                printf("%s: result is %s\n", __FUNCTION__, ipe_code_name(res));
         #endif
-        int i;
 
-        ipe_nlmsg_t msgs = {
-                .value   = g_arg.value,
+        return res;
+}
+
+
+
+/* One line for each VLAN device, "key value" pairs */
+static int print_link(void *data, const ipe_link_t *link) {
+        if (!IPE_LINK_HAS(link, IPE_LINK_ATTR_IFINDEX) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_IFNAME))
+                return 0;
+
+        printf("ifindex %d name %s", link->ifindex, link->ifname);
+
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_VID))
+                printf(" vid %d", link->vid);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PROTO))
+                printf(" proto 0x%04x", link->proto);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT))
+                printf(" parent %d", link->parent);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NAME))
+                printf(" parent_name %s", link->parent_name);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_NETNSID))
+                printf(" netnsid %d", link->netnsid);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NETNSID))
+                printf(" parent_netnsid %d", link->parent_netnsid);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_NEST_LEVEL))
+                printf(" nest %d", link->nest_level);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_SLOT))
+                printf(" slot %s", link->slot ? "ok" : "lost");
+
+        printf("\n");
+
+        return 0;
+}
+
+
+
+/* IPE_CMD_DUMP: filter is evaluated by kernel */
+static int dump_links(const ipe_arg_t *arg) {
+        ipe_filter_t filter = {
+                .parent  = arg->parent,
+                .proto   = arg->proto,
+                .vid_min = arg->vid_min,
+                .vid_max = arg->vid_max,
+                .nsfd    = -1,
+                .nsid    = -1,
         };
 
-        for (i = 0; i < IPE_DEV_COUNT; ++i) {
-                msgs.ifindex[i] = g_arg.ifindex[i];     
-                msgs.nsfd[i]    = g_arg.net[i] ? get_netns_fd(g_arg.net[i]) : -1;
+        if (arg->net[IPE_SRC]) {
+                filter.nsfd = ipe_netns_fd(handle, arg->net[IPE_SRC]);
+                if (filter.nsfd < 0) {
+                        perror(arg->net[IPE_SRC]);
+                        return IPE_FAIL_NS;
+                }
+        } else if (arg->nsid[IPE_SRC]) {
+                filter.nsid = atoi(arg->nsid[IPE_SRC]);
         }
 
-        strcpy(msgs.ifname, g_arg.ifname);
+        return ipe_dump(handle, &filter, print_link, NULL);
+}
 
-        if (!strcmp(g_arg.ctype, "id"))
-                msgs.command = IPE_SET_VID;
-        else if (!strcmp(g_arg.ctype, "eth"))
-                msgs.command = IPE_SET_ETH;
-        else if (!strcmp(g_arg.ctype, "name"))
-                msgs.command = IPE_SET_NAME;
-        else if (!strcmp(g_arg.ctype, "prev"))
-                msgs.command = IPE_SET_PARENT;
 
-        #ifdef IPE_DEBUG
-                else if (!strcmp(g_arg.ctype, "parent"))
-                        msgs.command = IPE_PRINT_ADDR;
-                else if (!strcmp(g_arg.ctype, "list"))
-                        msgs.command = IPE_LIST;
 
-                printf("%s: memcpy %lu to %s\n", 
-                                __FUNCTION__, sizeof(msgs), (char *)nlh);
-        #endif
+/* IPE_CMD_GET: one device, it's read by module without rtnl_lock */
+static int get_link(const ipe_arg_t *arg) {
+        ipe_link_t link;
+        ipe_dev_t dev;
+        int res;
 
-        printf("ok\n");
-        print_msg(&msgs);
-        memcpy(NLMSG_DATA(nlh), &msgs, sizeof(msgs));
+        res = arg_dev(&dev, arg, IPE_SRC);
+        if (!res)
+                res = ipe_get(handle, &dev, &link);
+        if (!res)
+                print_link(NULL, &link);
 
-        #ifdef IPE_DEBUG
-                printf("%s: ret\n", __FUNCTION__);
-        #endif
+        return res;
 }
 
 
 
-static void sending(struct msghdr *msgh) {
-        #ifdef IPE_DEBUG
-                printf("%s: entry\n", __FUNCTION__);
-        #endif
+static const char *change_name(const int cmd) {
+        switch (cmd) {
+        case IPE_CMD_SET_VID:
+                return "id";
+        case IPE_CMD_SET_ETH:
+                return "eth";
+        case IPE_CMD_SET_NAME:
+                return "name";
+        case IPE_CMD_SET_PARENT:
+                return "prev";
+        case IPE_CMD_RENUMBER:
+                return "renumber";
+        case IPE_CMD_FAILOVER:
+                return "failover";
+        case IPE_CMD_CONVERT:
+                return "convert";
+        case IPE_CMD_RENAME:
+                return "rename";
+        }
+        return "unknown";
+}
 
-        struct iovec iov;
-        nlh = (struct nlmsghdr *)malloc(NLMSG_SPACE(MAX_PAYLOAD));
-        memset(nlh, 0, NLMSG_SPACE(MAX_PAYLOAD));
 
-        nlh->nlmsg_len   = NLMSG_SPACE(MAX_PAYLOAD);
-        nlh->nlmsg_pid   = getpid();
-        nlh->nlmsg_flags = 0;
+/* One line for each event: "key value" pairs, "old -> new" for changed */
+static int print_event(void *data, const ipe_link_t *link) {
+        /* receive queue was overrun: gap of generation */
+        if (!link) {
+                fprintf(stderr, "Warning: events are lost\n");
+                return 0;
+        }
 
-        create_msg();
+        if (!IPE_LINK_HAS(link, IPE_LINK_ATTR_IFINDEX) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_IFNAME) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_GENERATION) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_CHANGE))
+                return 0;
 
-        iov.iov_base = (void *)nlh;
-        iov.iov_len  = nlh->nlmsg_len;
+        printf("gen %u %s ifindex %d name ", link->generation,
+               change_name(link->change), link->ifindex);
 
-        msg.msg_name    = (void *)&dest_addr;
-        msg.msg_namelen = sizeof(dest_addr);
-        msg.msg_iov     = &iov;
-        msg.msg_iovlen  = 1;
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_OLD_IFNAME))
+                printf("%s -> ", link->old_ifname);
+        printf("%s", link->ifname);
 
-        #ifdef IPE_DEBUG
-                printf("Sending message to kernel\n");
-        #endif
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_VID)) {
+                printf(" vid ");
+                if (IPE_LINK_HAS(link, IPE_LINK_ATTR_OLD_VID))
+                        printf("%d -> ", link->old_vid);
+                printf("%d", link->vid);
+        }
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PROTO)) {
+                printf(" proto ");
+                if (IPE_LINK_HAS(link, IPE_LINK_ATTR_OLD_PROTO))
+                        printf("0x%04x -> ", link->old_proto);
+                printf("0x%04x", link->proto);
+        }
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT)) {
+                printf(" parent ");
+                if (IPE_LINK_HAS(link, IPE_LINK_ATTR_OLD_PARENT))
+                        printf("%d -> ", link->old_parent);
+                printf("%d", link->parent);
+        }
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NAME))
+                printf(" parent_name %s", link->parent_name);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_NETNSID))
+                printf(" netnsid %d", link->netnsid);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NETNSID))
+                printf(" parent_netnsid %d", link->parent_netnsid);
 
-        sendmsg(sock_fd,&msg,0);
-}
+        printf("\n");
+        fflush(stdout);
 
+        return 0;
+}
 
 
 static void show_usage(void) {
-        printf("Usage: ipe dev IFINDEX [ netns NETNS ] id   [ VID ]\n");
-        printf("                                       eth  [ ETH_TYPE ]\n");
-        printf("                                       name [ IFNAME ]\n");
-        printf("                                       dst IFINDEX [ dstns NETNS ] prev\n");
+        printf("Usage: ipe [ -force ] [ -async ] -batch FILENAME\n");
+        printf("       ipe [ -plan ] apply FILENAME\n");
+        printf("       ipe dev DEV [ NS ] id   [ VID ]\n");
+        printf("                          eth  [ ETH_TYPE ]\n");
+        printf("                          name [ IFNAME ]\n");
+        printf("                          dst DEV [ DST_NS ] prev\n");
+        printf("                          renumber VID_MAP [ VID_MAP ... ]\n");
+        printf("                          compact\n");
+        printf("                          get\n");
+        printf("                          dst DEV [ DST_NS ] failover\n");
+        printf("                          convert ETH_TYPE [ proto ETH_TYPE ] [ vid VID_RANGE ]\n");
+        printf("                          rename PATTERN [ proto ETH_TYPE ] [ vid VID_RANGE ]\n");
 #ifdef IPE_DEBUG
-        printf("                                       parent\n");
+        printf("                          parent\n");
         printf("           list\n");
 #endif
-        printf("where ETH_TYPE := { 33024 for 0x8100 aka 802.1Q          |\n");
+        printf("       ipe [ NS ] dump [ parent IFINDEX ] [ proto ETH_TYPE ] [ vid VID_RANGE ]\n");
+        printf("       ipe monitor\n");
+        printf("where DEV      := { IFINDEX | IFNAME }\n");
+        printf("      NS       := { netns NETNS | nsid NETNSID }\n");
+        printf("      DST_NS   := { dstns NETNS | dstnsid NETNSID }\n");
+        printf("      VID_MAP  := { OLD_VID:NEW_VID | FIRST_VID-LAST_VID:NEW_FIRST_VID }\n");
+        printf("      VID_RANGE := { VID | FIRST_VID-LAST_VID }\n");
+        printf("      PATTERN  := IFNAME with %%d, it is VID of child (e.g. svc%%d)\n");
+        printf("      ETH_TYPE := { 33024 for 0x8100 aka 802.1Q          |\n");
         printf("                    34984 for 0x88A8 aka 802.1ad         }\n");
         /* TODO: need support into kernelspace */
 #if 0
@@ -212,7 +496,84 @@ static void show_usage(void) {
 
 
 
-static int parse_arg(int args, char **argv) {
+/* 
+ * Parse "OLD:NEW" or "FIRST-LAST:NEW_FIRST" into arg->map
+ */
+static int parse_vid_map(ipe_arg_t *arg, const char *str) {
+        int first, last, new_first;
+        int i;
+
+        if (sscanf(str, "%d-%d:%d", &first, &last, &new_first) != 3) {
+                if (sscanf(str, "%d:%d", &first, &new_first) != 2)
+                        return IPE_BAD_ARG;
+                last = first;
+        }
+
+        if (first < 1 || last < first || last > MAX_VID ||
+            new_first < 1 || new_first + (last - first) > MAX_VID) {
+                printf("%s: bad VID map \"%s\"\n", __FUNCTION__, str);
+                return IPE_BAD_VID;
+        }
+
+        arg->map = realloc(arg->map, (arg->map_count + last - first + 1) * 
+                                       sizeof(ipe_vid_pair_t));
+        if (!arg->map)
+                return IPE_BAD_ALLOC;
+
+        for (i = first; i <= last; ++i) {
+                arg->map[arg->map_count].old_vid = i;
+                arg->map[arg->map_count].new_vid = new_first + (i - first);
+                arg->map_count++;
+        }
+
+        return IPE_OK;
+}
+
+
+
+/* IFINDEX or IFNAME: name is resolved by kernel */
+static int parse_dev_arg(ipe_arg_t *arg, const int id, char *str) {
+        char *end;
+        long ifindex = strtol(str, &end, 10);
+
+        if (*str && !*end) {
+                arg->ifindex[id] = ifindex;
+        } else if (strlen(str) < IFNAMSIZ) {
+                arg->devname[id] = str;
+        } else {
+                printf("%s: bad interface name \"%s\"\n", __FUNCTION__, str);
+                return IPE_BAD_ARG;
+        }
+
+        #ifdef IPE_DEBUG
+                printf("%s: get device %s\n", __FUNCTION__, str);
+        #endif
+
+        return IPE_OK;
+}
+
+
+
+/* "VID" or "FIRST-LAST" for filter of dump */
+static int parse_vid_range(ipe_arg_t *arg, const char *str) {
+        if (sscanf(str, "%d-%d", &arg->vid_min, &arg->vid_max) != 2) {
+                if (sscanf(str, "%d", &arg->vid_min) != 1)
+                        return IPE_BAD_ARG;
+                arg->vid_max = arg->vid_min;
+        }
+
+        if (arg->vid_min < 0 || arg->vid_min > arg->vid_max || 
+            arg->vid_max > MAX_VID) {
+                printf("%s: bad VID range \"%s\"\n", __FUNCTION__, str);
+                return IPE_BAD_VID;
+        }
+
+        return IPE_OK;
+}
+
+
+
+static int parse_arg(ipe_arg_t *arg, int args, char **argv) {
         
         inline int matches(const char *arg) {
                 return !strcmp(*argv, arg);
@@ -227,32 +588,26 @@ static int parse_arg(int args, char **argv) {
                 if (matches("dev")) {
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.ifindex[IPE_SRC] = atoi(*argv);
-                                #ifdef IPE_DEBUG
-                                        printf("%s: get index %d\n", 
-                                                 __FUNCTION__, g_arg.ifindex[IPE_SRC]);
-                                #endif
+                                if (parse_dev_arg(arg, IPE_SRC, *argv))
+                                        goto usage_ret;
                         } else {
                                 goto usage_ret;
                         }
                 } else if (matches("dst")) {
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.ifindex[IPE_DST] = atoi(*argv);
-                                #ifdef IPE_DEBUG
-                                        printf("%s: get index %d\n", 
-                                                 __FUNCTION__, g_arg.ifindex[IPE_DST]);
-                                #endif
+                                if (parse_dev_arg(arg, IPE_DST, *argv))
+                                        goto usage_ret;
                         } else {
                                 goto usage_ret;
                         }
                 } else if (matches("netns")) {
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.net[IPE_SRC] = *argv;
+                                arg->net[IPE_SRC] = *argv;
                                 #ifdef IPE_DEBUG
                                         printf("%s: get net %s\n", 
-                                                 __FUNCTION__, g_arg.net[IPE_SRC]);
+                                                 __FUNCTION__, arg->net[IPE_SRC]);
                                 #endif
                         } else {
                                 goto usage_ret;
@@ -260,61 +615,175 @@ static int parse_arg(int args, char **argv) {
                 } else if (matches("dstns")) {
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.net[IPE_DST] = *argv;
+                                arg->net[IPE_DST] = *argv;
                                 #ifdef IPE_DEBUG
                                         printf("%s: get net %s\n", 
-                                                 __FUNCTION__, g_arg.net[IPE_DST]);
+                                                 __FUNCTION__, arg->net[IPE_DST]);
+                                #endif
+                        } else {
+                                goto usage_ret;
+                        }
+                } else if (matches("nsid")) {
+                        if (CHECK_ARGS(args)) {
+                                NEXT_ARG(args, argv);
+                                arg->nsid[IPE_SRC] = *argv;
+                                #ifdef IPE_DEBUG
+                                        printf("%s: get nsid %s\n", 
+                                                 __FUNCTION__, arg->nsid[IPE_SRC]);
+                                #endif
+                        } else {
+                                goto usage_ret;
+                        }
+                } else if (matches("dstnsid")) {
+                        if (CHECK_ARGS(args)) {
+                                NEXT_ARG(args, argv);
+                                arg->nsid[IPE_DST] = *argv;
+                                #ifdef IPE_DEBUG
+                                        printf("%s: get nsid %s\n", 
+                                                 __FUNCTION__, arg->nsid[IPE_DST]);
                                 #endif
                         } else {
                                 goto usage_ret;
                         }
                 } else if (matches("id")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.value = atoi(*argv);
+                                arg->value = atoi(*argv);
                                 #ifdef IPE_DEBUG
                                         printf("%s: get command set vid %d\n", 
-                                                 __FUNCTION__, g_arg.value);
+                                                 __FUNCTION__, arg->value);
                                 #endif
                                 goto ret_ok;
                         } else {
                                 goto usage_ret;
                         }
                 } else if (matches("eth")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                g_arg.value = atoi(*argv);
+                                arg->value = atoi(*argv);
                                 #ifdef IPE_DEBUG
                                         printf("%s: get command set eth_type %d\n", 
-                                                 __FUNCTION__, g_arg.value);
+                                                 __FUNCTION__, arg->value);
                                 #endif
                                 goto ret_ok;
                         } else {
                                 goto usage_ret;
                         }
                 } else if (matches("name")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         if (CHECK_ARGS(args)) {
                                 NEXT_ARG(args, argv);
-                                strcpy(g_arg.ifname, *argv);
+                                if (strlen(*argv) >= IFNAMSIZ)
+                                        return IPE_BAD_ARG;
+                                strcpy(arg->ifname, *argv);
                                 #ifdef IPE_DEBUG
                                         printf("%s: get command set ifname %s\n", 
-                                                 __FUNCTION__, g_arg.ifname);
+                                                 __FUNCTION__, arg->ifname);
                                 #endif
                                 goto ret_ok;
                         } else {
                                 goto usage_ret;
                         }
+                } else if (matches("renumber")) {
+                        arg->ctype = *argv;
+                        if (!CHECK_ARGS(args))
+                                goto usage_ret;
+
+                        while (CHECK_ARGS(args)) {
+                                NEXT_ARG(args, argv);
+                                if (parse_vid_map(arg, *argv))
+                                        goto usage_ret;
+                        }
+                        #ifdef IPE_DEBUG
+                                printf("%s: get command renumber, %d pairs\n", 
+                                         __FUNCTION__, arg->map_count);
+                        #endif
+                        goto ret_ok;
+                } else if (matches("dump")) {
+                        arg->ctype = *argv;
+                        while (CHECK_ARGS(args)) {
+                                NEXT_ARG(args, argv);
+                                if (!CHECK_ARGS(args))
+                                        goto usage_ret;
+
+                                if (matches("parent")) {
+                                        NEXT_ARG(args, argv);
+                                        arg->parent = atoi(*argv);
+                                } else if (matches("proto")) {
+                                        NEXT_ARG(args, argv);
+                                        arg->proto = strtol(*argv, NULL, 0);
+                                } else if (matches("vid")) {
+                                        NEXT_ARG(args, argv);
+                                        if (parse_vid_range(arg, *argv))
+                                                goto usage_ret;
+                                } else {
+                                        printf("%s: filter \"%s\" not matches\n", 
+                                                                __FUNCTION__, *argv);
+                                        goto usage_ret;
+                                }
+                        }
+                        #ifdef IPE_DEBUG
+                                printf("%s: get command dump\n", __FUNCTION__);
+                        #endif
+                        goto ret_ok;
+                } else if (matches("convert") || matches("rename")) {
+                        arg->ctype = *argv;
+                        if (!CHECK_ARGS(args))
+                                goto usage_ret;
+
+                        NEXT_ARG(args, argv);
+                        if (is_convert(arg)) {
+                                arg->value = strtol(*argv, NULL, 0);
+                        } else if (strlen(*argv) < IFNAMSIZ) {
+                                strcpy(arg->ifname, *argv);
+                        } else {
+                                goto usage_ret;
+                        }
+                        while (CHECK_ARGS(args)) {
+                                NEXT_ARG(args, argv);
+                                if (!CHECK_ARGS(args))
+                                        goto usage_ret;
+
+                                if (matches("proto")) {
+                                        NEXT_ARG(args, argv);
+                                        arg->proto = strtol(*argv, NULL, 0);
+                                } else if (matches("vid")) {
+                                        NEXT_ARG(args, argv);
+                                        if (parse_vid_range(arg, *argv))
+                                                goto usage_ret;
+                                } else {
+                                        printf("%s: filter \"%s\" not matches\n", 
+                                                                __FUNCTION__, *argv);
+                                        goto usage_ret;
+                                }
+                        }
+                        #ifdef IPE_DEBUG
+                                printf("%s: get command %s\n", 
+                                         __FUNCTION__, arg->ctype);
+                        #endif
+                        goto ret_ok;
+                } else if (matches("compact")) {
+                        arg->ctype = *argv;
+                        goto ret_ok;
+                } else if (matches("get")) {
+                        arg->ctype = *argv;
+                        goto ret_ok;
+                } else if (matches("failover")) {
+                        arg->ctype = *argv;
+                        goto ret_ok;
+                } else if (matches("monitor")) {
+                        arg->ctype = *argv;
+                        goto ret_ok;
                 } else if (matches("prev")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         goto ret_ok;
                 } else if (matches("parent")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         goto ret_ok;
                 } else if (matches("list")) {
-                        g_arg.ctype = *argv;
+                        arg->ctype = *argv;
                         goto ret_ok;
                 } else {
                         printf("%s: arg \"%s\" not matches\n", 
@@ -324,7 +793,6 @@ static int parse_arg(int args, char **argv) {
         }
 
 usage_ret:
-        show_usage();
         return IPE_FEW_ARG;
 ret_ok:
         return IPE_OK;
@@ -333,38 +801,214 @@ ret_ok:
 
 
 
-int main(int args, char **argv)
+
+
+
+/*
+ * -batch mode: commands are read line by line (the same syntax as command
+ * line without "ipe") and are given to batch builder of libipe, errors are
+ * reported for each line. Number of line is tag of operation.
+ */
+static void batch_report(void *data, const int line, const int code,
+                                                     const char *errmsg)
 {
-        ipe_reply_t reply;
-        int res = parse_arg(args, argv);
-        if (res) {
-                printf("res %d\n", res);
+        fprintf(stderr, "%s:%d: %s (%d)%s%s\n", (const char *)data, line,
+                        ipe_code_name(code), code, errmsg ? ": " : "",
+                        errmsg ? errmsg : "");
+}
+
+
+
+/* Non-zero if batch is stopped by failure */
+static int batch_add_line(const int line, char *str) {
+        char *argv[BATCH_MAX_ARGS] = { "ipe" };
+        ipe_filter_t filter;
+        ipe_dev_t parent;
+        ipe_nlmsg_t op;
+        char *save;
+        ipe_arg_t arg;
+        int args = 1;
+        int res;
+
+        for (str = strtok_r(str, " \t\r\n", &save); str && args < BATCH_MAX_ARGS;
+             str = strtok_r(NULL, " \t\r\n", &save))
+                argv[args++] = str;
+
+        if (args == 1 || argv[1][0] == '#')
+                return IPE_OK;
+
+        memset(&arg, 0, sizeof(arg));
+        if (parse_arg(&arg, args, argv)) {
+                res = ipe_batch_fail(handle, line, IPE_FEW_ARG);
+                goto free_arg;
+        }
+
+        /* failover and get aren't operations of batch: they have own reply */
+        if (is_dump(&arg) || is_monitor(&arg) || is_failover(&arg) ||
+            is_get(&arg)) {
+                res = ipe_batch_fail(handle, line, IPE_UNKNOWN_COMMAND);
+                goto free_arg;
+        }
+
+        if (is_convert(&arg)) {
+                convert_filter(&filter, &arg);
+                res = arg_dev(&parent, &arg, IPE_SRC);
+                if (res)
+                        res = ipe_batch_fail(handle, line, res);
+                else
+                        res = ipe_batch_add_convert(handle, &parent, arg.value,
+                                                    &filter, line);
+                goto free_arg;
+        }
+
+        if (is_rename(&arg)) {
+                convert_filter(&filter, &arg);
+                res = arg_dev(&parent, &arg, IPE_SRC);
+                if (res)
+                        res = ipe_batch_fail(handle, line, res);
+                else
+                        res = ipe_batch_add_rename(handle, &parent, arg.ifname,
+                                                   &filter, line);
+                goto free_arg;
+        }
+
+        if (is_vid_map(&arg)) {
+                res = arg_dev(&parent, &arg, IPE_SRC);
+                if (res)
+                        res = ipe_batch_fail(handle, line, res);
+                else
+                        res = ipe_batch_add_renumber(handle, &parent, arg.map,
+                                                     arg.map_count, line);
+                goto free_arg;
+        }
+
+        res = create_msg(&op, &arg);
+        if (res)
+                res = ipe_batch_fail(handle, line, res);
+        else
+                res = ipe_batch_add(handle, &op, line);
+
+free_arg:
+        free(arg.map);
+
+        return res;
+}
+
+
+
+static int batch_mode(const char *path, const int flags) {
+        FILE *in;
+        char *line = NULL;
+        size_t size = 0;
+        int lineno = 0;
+        int res;
+
+        in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+        if (!in) {
+                perror(path);
+                return IPE_BAD_ARG;
+        }
+
+        res = open_handle();
+        if (res)
+                goto close_in;
+
+        res = ipe_batch_begin(handle, flags, batch_report, (void *)path);
+        if (res)
+                goto close_handle;
+
+        while (getline(&line, &size, in) != -1 && !batch_add_line(++lineno, line))
+                ;
+
+        res = ipe_batch_end(handle);
+        free(line);
+
+close_handle:
+        ipe_close(handle);
+close_in:
+        if (in != stdin)
+                fclose(in);
+
+        return res;
+}
+
+
+
+/*
+ * apply mode: lines of file are desired state of devices (see ipeApply.c),
+ * -plan prints operations in syntax of -batch without sending them
+ */
+static int apply_file(const char *path, const int plan) {
+        int res;
+
+        res = open_handle();
+        if (res)
                 return res;
+
+        res = apply_mode(handle, path, plan);
+        if (res && ipe_errmsg(handle))
+                fprintf(stderr, "Error: %s\n", ipe_errmsg(handle));
+
+        ipe_close(handle);
+
+        return res;
+}
+
+
+
+int main(int args, char **argv)
+{
+        int flags = 0;
+        int plan = 0;
+        int res;
+
+        if (args > 1 && !strcmp(argv[1], "-force")) {
+                flags |= IPE_BATCH_FORCE;
+                NEXT_ARG(args, argv);
         }
 
+        if (args > 1 && !strcmp(argv[1], "-async")) {
+                flags |= IPE_BATCH_ASYNC;
+                NEXT_ARG(args, argv);
+        }
 
-        sock_fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_USER);
+        if (args == 3 && !strcmp(argv[1], "-batch"))
+                return batch_mode(argv[2], flags);
 
-        if (sock_fd < 0) {
-                printf("Bad socket: %d\n", sock_fd);
-                return IPE_BAD_SOC;
+        if (args > 1 && !strcmp(argv[1], "-plan")) {
+                plan = 1;
+                NEXT_ARG(args, argv);
         }
 
-        prepare();
-        sending(&msg);
+        if (args == 3 && !strcmp(argv[1], "apply"))
+                return apply_file(argv[2], plan);
 
-        recvmsg(sock_fd, &msg, 0);
-        memcpy(&reply, NLMSG_DATA(nlh), sizeof(ipe_reply_t));
+        res = parse_arg(&g_arg, args, argv);
+        if (res) {
+                show_usage();
+                printf("res %d\n", res);
+                return res;
+        }
 
-#ifdef IPE_DEBUG
-        printf("%s", reply.report);
-        printf("return code: %d\n", reply.retcode);
-        printf("%s: result is %s\n", __FUNCTION__,
-                       reply.retcode < IPE_ERR_COUNT ? errors[reply.retcode].name : "unknown");
-#endif
+        res = open_handle();
+        if (res)
+                goto free_arg;
+
+        if (is_dump(&g_arg))
+                res = dump_links(&g_arg);
+        else if (is_get(&g_arg))
+                res = get_link(&g_arg);
+        else if (is_monitor(&g_arg))
+                res = ipe_monitor(handle, print_event, NULL);
+        else
+                res = exec_single(&g_arg);
+
+        if (res && ipe_errmsg(handle))
+                fprintf(stderr, "Error: %s\n", ipe_errmsg(handle));
 
-        free(nlh);
-        close(sock_fd);
+        ipe_close(handle);
+free_arg:
+        free(g_arg.map);
 
-        return reply.retcode;
+        return res;
 }
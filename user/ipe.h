@@ -25,101 +25,9 @@
 #define __IPE_IPE_H              1
 
 
-#define NETLINK_USER            31 /* this port than used kernel module */
-#define MAX_PATH_LEN            256
-#define NETNS_RUN_DIR           "/var/run/netns"
+#include "libipe.h"
 
-#ifdef IPE_DEBUG
-        #define IPE_BUFF_SIZE   128
-#endif
-
-enum {
-        IPE_SRC,
-        IPE_DST,
-        IPE_DEV_COUNT,
-};
-
-
-/* This structure for Netlink message into ipe */
-typedef struct nl_message {
-        int   ifindex [IPE_DEV_COUNT];     
-        int   nsfd    [IPE_DEV_COUNT];
-        char  ifname  [IFNAMSIZ];
-        int   value;
-        char  command;
-} ipe_nlmsg_t;
-
-
-typedef struct {
-        int     retcode;
-#ifdef IPE_DEBUG
-        char    report[IPE_BUFF_SIZE];
-#endif
-        int     reserve;
-} ipe_reply_t;
-
-
-
-
-/* Functions that extend usage netlink */
-enum {
-        IPE_SET_VID    = 0,
-        IPE_SET_ETH, 
-#ifdef IPE_DEBUG
-        /* debug: */
-        IPE_PRINT_ADDR,
-        IPE_LIST,
-#endif
-        IPE_SET_NAME,
-        IPE_SET_PARENT,
-
-        IPE_COMMAND_COUNT,
-};
-
-#define ERR_BUFF_LEN 64
-
-typedef struct {
-        int id;
-        char name[ERR_BUFF_LEN];
-} ipe_err_t;
-
-
-/* Error's code: */
-enum {
-        IPE_OK             = 0,
-        IPE_BAD_ARG,
-        IPE_BAD_VID,
-        IPE_BAD_PTR,
-        IPE_BAD_DEV,
-        IPE_BAD_IF_IDX,
-        IPE_UNKNOWN_COMMAND,
-        IPE_FAIL_NS,
-        IPE_FAIL_CR_SOC,
-        IPE_FEW_ARG,
-        IPE_NULLPTR,
-        IPE_BAD_SOC,
-        IPE_BAD_ALLOC,
-        IPE_DEFAULT_FAIL,
-        IPE_ERR_COUNT,
-};
-
-
-
-static ipe_err_t errors[IPE_ERR_COUNT] = {
-        {IPE_OK, "IPE_OK"},
-        {IPE_BAD_ARG, "IPE_BAD_ARG"},
-        {IPE_BAD_VID, "IPE_BAD_VID"},
-        {IPE_BAD_PTR, "IPE_BAD_PTR"},
-        {IPE_BAD_DEV, "IPE_BAD_DEV"},
-        {IPE_BAD_IF_IDX, "IPE_BAD_IF_IDX"},
-        {IPE_UNKNOWN_COMMAND, "IPE_UNKNOWN_COMMAND"},
-        {IPE_FAIL_NS, "IPE_FAIL_NS"},
-        {IPE_FAIL_CR_SOC, "IPE_FAIL_CR_SOC"},
-        {IPE_FEW_ARG, "IPE_FEW_ARG"},
-        {IPE_NULLPTR, "IPE_NULLPTR"},
-        {IPE_BAD_SOC, "IPE_BAD_SOC"},
-        {IPE_BAD_ALLOC, "IPE_BAD_ALLOC"},
-        {IPE_DEFAULT_FAIL, "IPE_DEFAULT_FAIL"},
-};
+/* ipeApply.c: desired state of file by one atomic batch, or its plan only */
+int apply_mode(ipe_handle_t *h, const char *path, const int plan);
 
 #endif // __IPE_IPE_H
@@ -0,0 +1,1048 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     apply mode: desired state of VLAN devices is read from file, current
+* state is taken by one dump of all netns, and only the difference is sent
+* as one atomic IPE_CMD_BATCH. Operations are ordered on a model of slots
+* (parent, proto, VID) and of names, so no operation takes a slot or a name
+* that is still held: a device whose target is held by another pending one
+* is parked on a free VID (or on a temporary name) first.
+*
+*     One line of file for each device, "key value" like output of dump:
+*
+*       [ ifindex IFINDEX ] name IFNAME [ vid VID ] [ proto ETH_TYPE ]
+*       [ parent IFINDEX | parent_name IFNAME ] [ netnsid NETNSID ]
+*       [ parent_netnsid NETNSID ]
+*
+* Device is found by ifindex (then name is its new name) or by name. Omitted
+* key isn't changed, netnsid that isn't given is netns of ipe (like dump).
+* Parent is any device, VLAN or not, but not the device itself or one of its
+* uppers: kernel refuses such loop, so file with it isn't planned.
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <net/if.h>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "ipe.h"
+
+#define MAX_VID              4094
+#define APPLY_MAX_ARGS       32   /* words into one line */
+#define APPLY_TMP_NAME       "ipeapply%d"
+#define APPLY_NO_NS          -1   /* netns of ipe */
+
+
+
+/* (parent, proto, VID) of VLAN device, it can be held by one device only */
+typedef struct {
+        int     ns;             /* netnsid of parent */
+        int     parent;
+        int     proto;
+        int     vid;
+} apply_slot_t;
+
+
+/* Device of dump: its state is changed by planned operations */
+typedef struct {
+        int             ifindex;
+        int             ns;
+        apply_slot_t    slot;
+        char            ifname[IFNAMSIZ];
+        char            parent_name[IFNAMSIZ];
+        /* desired state, line is 0 if device isn't in file */
+        int             line;
+        apply_slot_t    want;
+        char            want_name[IFNAMSIZ];
+        int             parked;
+        /* chains of hashes, -1 is the end */
+        int             next_slot;
+        int             next_name;
+} apply_link_t;
+
+
+/* Planned operation, it's printed by -plan or sent */
+typedef struct {
+        int             line;
+        int             command;
+        int             link;
+        int             value;
+        apply_slot_t    slot;           /* IPE_CMD_SET_PARENT */
+        char            ifname[IFNAMSIZ];
+} apply_op_t;
+
+
+typedef struct {
+        const char     *path;
+        apply_link_t   *links;
+        int             count;
+        int             size;
+        /* slots and names of devices, heads of chains */
+        int            *slot_hash;
+        int            *name_hash;
+        unsigned int    mask;
+        /* slots of file, sorted: parking never takes them */
+        apply_slot_t   *finals;
+        int             nr_finals;
+        apply_op_t      ops[IPE_BATCH_MAX];
+        int             nr_ops;
+        int             tmp_names;
+} apply_ctx_t;
+
+
+
+static void apply_error(const apply_ctx_t *ctx, const int line, const char *fmt, ...)
+                __attribute__((format(printf, 3, 4)));
+
+static void apply_error(const apply_ctx_t *ctx, const int line, const char *fmt, ...)
+{
+        va_list ap;
+
+        if (line)
+                fprintf(stderr, "%s:%d: ", ctx->path, line);
+        else
+                fprintf(stderr, "%s: ", ctx->path);
+
+        va_start(ap, fmt);
+        vfprintf(stderr, fmt, ap);
+        va_end(ap);
+
+        fprintf(stderr, "\n");
+}
+
+
+
+static unsigned int hash_slot(const apply_slot_t *slot) {
+        unsigned int h = slot->ns * 31 + slot->parent;
+
+        h = h * 31 + slot->proto;
+        h = h * 31 + slot->vid;
+
+        return h * 2654435761U;
+}
+
+
+static unsigned int hash_name(const int ns, const char *name) {
+        unsigned int h = ns;
+
+        while (*name)
+                h = h * 31 + (unsigned char)*name++;
+
+        return h * 2654435761U;
+}
+
+
+static int cmp_slot(const void *a, const void *b) {
+        return memcmp(a, b, sizeof(apply_slot_t));
+}
+
+
+/* Device that holds @slot now, -1 if it's free */
+static int slot_owner(const apply_ctx_t *ctx, const apply_slot_t *slot) {
+        int i = ctx->slot_hash[hash_slot(slot) & ctx->mask];
+
+        for (; i >= 0; i = ctx->links[i].next_slot) {
+                if (!cmp_slot(&ctx->links[i].slot, slot))
+                        return i;
+        }
+
+        return -1;
+}
+
+
+static int name_owner(const apply_ctx_t *ctx, const int ns, const char *name) {
+        int i = ctx->name_hash[hash_name(ns, name) & ctx->mask];
+
+        for (; i >= 0; i = ctx->links[i].next_name) {
+                if (ctx->links[i].ns == ns && !strcmp(ctx->links[i].ifname, name))
+                        return i;
+        }
+
+        return -1;
+}
+
+
+static void slot_insert(apply_ctx_t *ctx, const int i) {
+        int *head = &ctx->slot_hash[hash_slot(&ctx->links[i].slot) & ctx->mask];
+
+        ctx->links[i].next_slot = *head;
+        *head = i;
+}
+
+
+static void slot_remove(apply_ctx_t *ctx, const int i) {
+        int *p = &ctx->slot_hash[hash_slot(&ctx->links[i].slot) & ctx->mask];
+
+        while (*p != i)
+                p = &ctx->links[*p].next_slot;
+        *p = ctx->links[i].next_slot;
+}
+
+
+static void name_insert(apply_ctx_t *ctx, const int i) {
+        apply_link_t *link = &ctx->links[i];
+        int *head = &ctx->name_hash[hash_name(link->ns, link->ifname) & ctx->mask];
+
+        link->next_name = *head;
+        *head = i;
+}
+
+
+static void name_remove(apply_ctx_t *ctx, const int i) {
+        apply_link_t *link = &ctx->links[i];
+        int *p = &ctx->name_hash[hash_name(link->ns, link->ifname) & ctx->mask];
+
+        while (*p != i)
+                p = &ctx->links[*p].next_name;
+        *p = link->next_name;
+}
+
+
+static int is_final(const apply_ctx_t *ctx, const apply_slot_t *slot) {
+        return bsearch(slot, ctx->finals, ctx->nr_finals, sizeof(apply_slot_t),
+                                                          cmp_slot) != NULL;
+}
+
+
+
+/* Each VLAN device of dump, netnsid is -1 for netns of ipe */
+static int collect_link(void *data, const ipe_link_t *link) {
+        apply_ctx_t *ctx = data;
+        apply_link_t *new_links;
+        apply_link_t *dst;
+
+        if (!IPE_LINK_HAS(link, IPE_LINK_ATTR_IFINDEX) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_IFNAME) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_VID) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_PROTO) ||
+            !IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT))
+                return 0;
+
+        if (ctx->count == ctx->size) {
+                new_links = realloc(ctx->links, (ctx->size * 2 + 64) *
+                                                sizeof(apply_link_t));
+                if (!new_links)
+                        return IPE_BAD_ALLOC;
+
+                ctx->links = new_links;
+                ctx->size  = ctx->size * 2 + 64;
+        }
+
+        dst = &ctx->links[ctx->count++];
+        memset(dst, 0, sizeof(apply_link_t));
+
+        dst->ifindex     = link->ifindex;
+        dst->ns          = IPE_LINK_HAS(link, IPE_LINK_ATTR_NETNSID) ?
+                                        link->netnsid : APPLY_NO_NS;
+        dst->slot.ns     = IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NETNSID) ?
+                                        link->parent_netnsid : APPLY_NO_NS;
+        dst->slot.parent = link->parent;
+        dst->slot.proto  = link->proto;
+        dst->slot.vid    = link->vid;
+        snprintf(dst->ifname, IFNAMSIZ, "%s", link->ifname);
+        if (IPE_LINK_HAS(link, IPE_LINK_ATTR_PARENT_NAME))
+                snprintf(dst->parent_name, IFNAMSIZ, "%s", link->parent_name);
+
+        return 0;
+}
+
+
+static int build_hashes(apply_ctx_t *ctx) {
+        unsigned int size = 64;
+        int i;
+
+        while (size < 2 * (unsigned int)ctx->count)
+                size <<= 1;
+
+        ctx->mask      = size - 1;
+        ctx->slot_hash = malloc(size * sizeof(int));
+        ctx->name_hash = malloc(size * sizeof(int));
+        if (!ctx->slot_hash || !ctx->name_hash)
+                return IPE_BAD_ALLOC;
+
+        memset(ctx->slot_hash, 0xff, size * sizeof(int));
+        memset(ctx->name_hash, 0xff, size * sizeof(int));
+
+        for (i = 0; i < ctx->count; ++i) {
+                ctx->links[i].want = ctx->links[i].slot;
+                strcpy(ctx->links[i].want_name, ctx->links[i].ifname);
+                slot_insert(ctx, i);
+                name_insert(ctx, i);
+        }
+
+        return IPE_OK;
+}
+
+
+
+/* Ifindex of parent by name into @ns: VLAN devices and parents of dump */
+static int find_parent(const apply_ctx_t *ctx, const int ns, const char *name) {
+        int i;
+
+        if (ns == APPLY_NO_NS && if_nametoindex(name))
+                return if_nametoindex(name);
+
+        for (i = 0; i < ctx->count; ++i) {
+                if (ctx->links[i].ns == ns && !strcmp(ctx->links[i].ifname, name))
+                        return ctx->links[i].ifindex;
+                if (ctx->links[i].slot.ns == ns &&
+                    !strcmp(ctx->links[i].parent_name, name))
+                        return ctx->links[i].slot.parent;
+        }
+
+        return 0;
+}
+
+
+static int find_link(const apply_ctx_t *ctx, const int ns, const int ifindex,
+                                                           const char *name)
+{
+        int i;
+
+        if (!ifindex)
+                return name_owner(ctx, ns, name);
+
+        for (i = 0; i < ctx->count; ++i) {
+                if (ctx->links[i].ns == ns && ctx->links[i].ifindex == ifindex)
+                        return i;
+        }
+
+        return -1;
+}
+
+
+/*
+ * Device @i is parent of @to or lower of it by chain of parents: of desired
+ * state if @want, else of current one. Move to @to makes a loop then.
+ */
+static int is_loop(const apply_ctx_t *ctx, const int i, const apply_slot_t *to,
+                                                        const int want)
+{
+        const apply_slot_t *slot = to;
+        int hops;
+        int j;
+
+        for (hops = 0; hops < ctx->count && slot->parent; ++hops) {
+                j = find_link(ctx, slot->ns, slot->parent, NULL);
+                if (j < 0)
+                        return 0;
+                if (j == i)
+                        return 1;
+                slot = want ? &ctx->links[j].want : &ctx->links[j].slot;
+        }
+
+        return 0;
+}
+
+
+static int parse_int(const char *str, int *value) {
+        char *end;
+
+        *value = strtol(str, &end, 0);
+        return *end != '\0' || end == str;
+}
+
+
+
+/* One line of file: desired state of device that is found by dump */
+static int parse_line(apply_ctx_t *ctx, const int line, char *str) {
+        char *argv[APPLY_MAX_ARGS];
+        char *name = NULL;
+        char *parent_name = NULL;
+        char *save;
+        apply_link_t *link;
+        apply_slot_t want;
+        int has_parent = 0;
+        int has_pns = 0;
+        int ifindex = 0;
+        int ns = APPLY_NO_NS;
+        int args = 0;
+        int value;
+        int i;
+
+        want.ns     = APPLY_NO_NS;
+        want.parent = 0;
+        want.proto  = 0;
+        want.vid    = 0;
+
+        for (str = strtok_r(str, " \t\r\n", &save); str && args < APPLY_MAX_ARGS;
+             str = strtok_r(NULL, " \t\r\n", &save))
+                argv[args++] = str;
+
+        if (!args || argv[0][0] == '#')
+                return IPE_OK;
+
+        for (i = 0; i < args; i += 2) {
+                if (i + 1 == args) {
+                        apply_error(ctx, line, "\"%s\" without value", argv[i]);
+                        return IPE_FEW_ARG;
+                }
+
+                if (!strcmp(argv[i], "name")) {
+                        name = argv[i + 1];
+                        if (strlen(name) >= IFNAMSIZ) {
+                                apply_error(ctx, line, "too long name %s", name);
+                                return IPE_BAD_ARG;
+                        }
+                        continue;
+                }
+                if (!strcmp(argv[i], "parent_name")) {
+                        parent_name = argv[i + 1];
+                        continue;
+                }
+
+                if (parse_int(argv[i + 1], &value)) {
+                        apply_error(ctx, line, "bad value %s of %s",
+                                                argv[i + 1], argv[i]);
+                        return IPE_BAD_ARG;
+                }
+
+                if (!strcmp(argv[i], "ifindex")) {
+                        ifindex = value;
+                } else if (!strcmp(argv[i], "vid")) {
+                        want.vid = value;
+                } else if (!strcmp(argv[i], "proto")) {
+                        want.proto = value;
+                } else if (!strcmp(argv[i], "parent")) {
+                        want.parent = value;
+                        has_parent = 1;
+                } else if (!strcmp(argv[i], "netnsid") || !strcmp(argv[i], "nsid")) {
+                        ns = value;
+                } else if (!strcmp(argv[i], "parent_netnsid")) {
+                        want.ns = value;
+                        has_pns = 1;
+                } else if (strcmp(argv[i], "nest")) {
+                        apply_error(ctx, line, "unknown key %s", argv[i]);
+                        return IPE_BAD_ARG;
+                }
+        }
+
+        if (!ifindex && !name) {
+                apply_error(ctx, line, "device without ifindex and name");
+                return IPE_FEW_ARG;
+        }
+
+        i = find_link(ctx, ns, ifindex, name);
+        if (i < 0) {
+                if (ifindex)
+                        apply_error(ctx, line, "VLAN device %d isn't found", ifindex);
+                else
+                        apply_error(ctx, line, "VLAN device %s isn't found", name);
+                return IPE_BAD_DEV;
+        }
+
+        link = &ctx->links[i];
+        if (link->line) {
+                apply_error(ctx, line, "%s is already at line %d",
+                                        link->ifname, link->line);
+                return IPE_BAD_ARG;
+        }
+        link->line = line;
+
+        if (ifindex && name)
+                strcpy(link->want_name, name);
+
+        if (!has_parent && !has_pns && !parent_name) {
+                want.ns     = link->slot.ns;
+                want.parent = link->slot.parent;
+        } else if (!has_parent) {
+                want.parent = parent_name ? find_parent(ctx, want.ns, parent_name) :
+                                            link->slot.parent;
+                if (!want.parent) {
+                        apply_error(ctx, line, "parent %s isn't found", parent_name);
+                        return IPE_BAD_DEV;
+                }
+        }
+
+        link->want.ns     = want.ns;
+        link->want.parent = want.parent;
+        link->want.proto  = want.proto ? want.proto : link->slot.proto;
+        link->want.vid    = want.vid   ? want.vid   : link->slot.vid;
+
+        if (link->want.vid < 1 || link->want.vid > MAX_VID) {
+                apply_error(ctx, line, "bad vid %d", link->want.vid);
+                return IPE_BAD_VID;
+        }
+
+        return IPE_OK;
+}
+
+
+
+/*
+ * Desired slots and names are unique, and they aren't held by devices
+ * out of file: otherwise there is no order for them.
+ */
+static int check_finals(apply_ctx_t *ctx) {
+        apply_link_t *link;
+        int owner;
+        int i;
+
+        ctx->finals = malloc((ctx->count + 1) * sizeof(apply_slot_t));
+        if (!ctx->finals)
+                return IPE_BAD_ALLOC;
+
+        for (i = 0; i < ctx->count; ++i) {
+                link = &ctx->links[i];
+                if (!link->line)
+                        continue;
+
+                ctx->finals[ctx->nr_finals++] = link->want;
+
+                if (is_loop(ctx, i, &link->want, 1)) {
+                        apply_error(ctx, link->line, "parent %d of %s is the "
+                                    "device itself or its upper", link->want.parent,
+                                    link->ifname);
+                        return IPE_BAD_DEV;
+                }
+
+                owner = slot_owner(ctx, &link->want);
+                if (owner >= 0 && !ctx->links[owner].line) {
+                        apply_error(ctx, link->line, "vid %d proto 0x%04x of parent "
+                                    "%d is held by %s, it isn't in file",
+                                    link->want.vid, link->want.proto,
+                                    link->want.parent, ctx->links[owner].ifname);
+                        return IPE_BAD_VID;
+                }
+
+                owner = name_owner(ctx, link->ns, link->want_name);
+                if (owner >= 0 && !ctx->links[owner].line) {
+                        apply_error(ctx, link->line, "name %s is held by ifindex "
+                                    "%d, it isn't in file", link->want_name,
+                                    ctx->links[owner].ifindex);
+                        return IPE_BAD_ARG;
+                }
+        }
+
+        qsort(ctx->finals, ctx->nr_finals, sizeof(apply_slot_t), cmp_slot);
+        for (i = 1; i < ctx->nr_finals; ++i) {
+                if (!cmp_slot(&ctx->finals[i - 1], &ctx->finals[i])) {
+                        apply_error(ctx, 0, "vid %d proto 0x%04x of parent %d "
+                                    "is wanted twice", ctx->finals[i].vid,
+                                    ctx->finals[i].proto, ctx->finals[i].parent);
+                        return IPE_BAD_VID;
+                }
+        }
+
+        for (i = 0; i < ctx->count; ++i) {
+                link = &ctx->links[i];
+                if (!link->line)
+                        continue;
+
+                for (owner = i + 1; owner < ctx->count; ++owner) {
+                        if (ctx->links[owner].line &&
+                            ctx->links[owner].ns == link->ns &&
+                            !strcmp(ctx->links[owner].want_name, link->want_name)) {
+                                apply_error(ctx, ctx->links[owner].line,
+                                            "name %s is wanted at line %d too",
+                                            link->want_name, link->line);
+                                return IPE_BAD_ARG;
+                        }
+                }
+        }
+
+        return IPE_OK;
+}
+
+
+
+/* Operation of plan, model is changed by it */
+static int emit(apply_ctx_t *ctx, const int i, const int command,
+                                  const apply_slot_t *slot, const char *ifname)
+{
+        apply_link_t *link = &ctx->links[i];
+        apply_op_t *op;
+
+        if (ctx->nr_ops == IPE_BATCH_MAX) {
+                apply_error(ctx, 0, "more than %d changes", IPE_BATCH_MAX);
+                return IPE_BAD_ARG;
+        }
+
+        op = &ctx->ops[ctx->nr_ops++];
+        memset(op, 0, sizeof(apply_op_t));
+        op->line    = link->line;
+        op->command = command;
+        op->link    = i;
+
+        if (command == IPE_CMD_SET_NAME) {
+                strcpy(op->ifname, ifname);
+                name_remove(ctx, i);
+                strcpy(link->ifname, ifname);
+                name_insert(ctx, i);
+                return IPE_OK;
+        }
+
+        op->slot  = *slot;
+        op->value = command == IPE_CMD_SET_VID ? slot->vid : slot->proto;
+
+        slot_remove(ctx, i);
+        link->slot = *slot;
+        slot_insert(ctx, i);
+
+        return IPE_OK;
+}
+
+
+/* Slot after change of one field: 'p'arent, 'e'thertype or 'v'id */
+static void step_slot(apply_slot_t *slot, const apply_slot_t *to, const char field) {
+        switch (field) {
+        case 'p':
+                slot->ns     = to->ns;
+                slot->parent = to->parent;
+                break;
+        case 'e':
+                slot->proto  = to->proto;
+                break;
+        case 'v':
+                slot->vid    = to->vid;
+                break;
+        }
+}
+
+
+static int step_command(const char field) {
+        return field == 'p' ? IPE_CMD_SET_PARENT :
+               field == 'e' ? IPE_CMD_SET_ETH : IPE_CMD_SET_VID;
+}
+
+
+static int step_needed(const apply_slot_t *from, const apply_slot_t *to,
+                                                 const char field)
+{
+        switch (field) {
+        case 'p':
+                return from->ns != to->ns || from->parent != to->parent;
+        case 'e':
+                return from->proto != to->proto;
+        }
+        return from->vid != to->vid;
+}
+
+
+/*
+ * Device is moved to @to if some order of its changes goes by free slots
+ * only, and parent is changed when it makes no loop. 1 if it's moved, 0 if it's blocked, or negative IPE_* code.
+ */
+static int try_move(apply_ctx_t *ctx, const int i, const apply_slot_t *to) {
+        static const char *orders[] = { "pev", "epv", "pve", "vpe", "evp", "vep" };
+        apply_slot_t slot;
+        const char *f;
+        int owner;
+        int res;
+        int k;
+
+        for (k = 0; k < 6; ++k) {
+                slot = ctx->links[i].slot;
+                for (f = orders[k]; *f; ++f) {
+                        if (!step_needed(&slot, to, *f))
+                                continue;
+
+                        step_slot(&slot, to, *f);
+                        owner = slot_owner(ctx, &slot);
+                        if (owner >= 0 && owner != i)
+                                break;
+                        /* new parent is still upper of device */
+                        if (*f == 'p' && is_loop(ctx, i, &slot, 0))
+                                break;
+                }
+                if (*f)
+                        continue;
+
+                for (f = orders[k]; *f; ++f) {
+                        if (!step_needed(&ctx->links[i].slot, to, *f))
+                                continue;
+
+                        slot = ctx->links[i].slot;
+                        step_slot(&slot, to, *f);
+                        res = emit(ctx, i, step_command(*f), &slot, NULL);
+                        if (res)
+                                return -res;
+                }
+                return 1;
+        }
+
+        return 0;
+}
+
+
+/*
+ * Free VID for parking of device: its slot is free for old and new parent
+ * and ethertype, and no device of file wants it.
+ */
+static int park_vid(const apply_ctx_t *ctx, const int i) {
+        const apply_link_t *link = &ctx->links[i];
+        apply_slot_t slot;
+        int vid;
+        int k;
+
+        for (vid = 1; vid <= MAX_VID; ++vid) {
+                for (k = 0; k < 4; ++k) {
+                        slot       = k & 1 ? link->want : link->slot;
+                        slot.proto = k & 2 ? link->want.proto : link->slot.proto;
+                        slot.vid   = vid;
+                        if (slot_owner(ctx, &slot) >= 0 || is_final(ctx, &slot))
+                                break;
+                }
+                if (k == 4)
+                        return vid;
+        }
+
+        return 0;
+}
+
+
+/* Device goes to a free VID and gets its parent and ethertype there */
+static int park(apply_ctx_t *ctx, const int i) {
+        apply_link_t *link = &ctx->links[i];
+        apply_slot_t to = link->want;
+        int res;
+
+        to.vid = park_vid(ctx, i);
+        if (!to.vid) {
+                apply_error(ctx, link->line, "no free VID for %s", link->ifname);
+                return IPE_BAD_VID;
+        }
+
+        link->parked = 1;
+        res = try_move(ctx, i, &to);
+
+        return res < 0 ? -res : IPE_OK;
+}
+
+
+/*
+ * Slots: each pass moves devices whose path is free. If none is moved,
+ * holder of wanted slot is parked, or blocked device itself.
+ */
+static int plan_slots(apply_ctx_t *ctx) {
+        apply_link_t *link;
+        int pending;
+        int moved;
+        int owner;
+        int res;
+        int i;
+
+        for (;;) {
+                pending = -1;
+                moved   = 0;
+
+                for (i = 0; i < ctx->count; ++i) {
+                        link = &ctx->links[i];
+                        if (!link->line || !cmp_slot(&link->slot, &link->want))
+                                continue;
+
+                        res = try_move(ctx, i, &link->want);
+                        if (res < 0)
+                                return -res;
+                        if (res)
+                                moved++;
+                        else if (pending < 0)
+                                pending = i;
+                }
+
+                if (pending < 0)
+                        return IPE_OK;
+                if (moved)
+                        continue;
+
+                owner = slot_owner(ctx, &ctx->links[pending].want);
+                if (owner >= 0 && !ctx->links[owner].parked) {
+                        res = park(ctx, owner);
+                } else {
+                        for (i = 0; i < ctx->count; ++i) {
+                                link = &ctx->links[i];
+                                if (link->line && !link->parked &&
+                                    cmp_slot(&link->slot, &link->want))
+                                        break;
+                        }
+                        if (i == ctx->count) {
+                                apply_error(ctx, ctx->links[pending].line,
+                                            "no order of changes for %s",
+                                            ctx->links[pending].ifname);
+                                return IPE_DEFAULT_FAIL;
+                        }
+                        res = park(ctx, i);
+                }
+                if (res)
+                        return res;
+        }
+}
+
+
+/* Names: like slots, holder of wanted name gets temporary one */
+static int plan_names(apply_ctx_t *ctx) {
+        char tmp[IFNAMSIZ];
+        apply_link_t *link;
+        int pending;
+        int moved;
+        int owner;
+        int res;
+        int i;
+
+        for (;;) {
+                pending = -1;
+                moved   = 0;
+
+                for (i = 0; i < ctx->count; ++i) {
+                        link = &ctx->links[i];
+                        if (!link->line || !strcmp(link->ifname, link->want_name))
+                                continue;
+
+                        owner = name_owner(ctx, link->ns, link->want_name);
+                        if (owner >= 0) {
+                                pending = i;
+                                continue;
+                        }
+
+                        res = emit(ctx, i, IPE_CMD_SET_NAME, NULL, link->want_name);
+                        if (res)
+                                return res;
+                        moved++;
+                }
+
+                if (pending < 0)
+                        return IPE_OK;
+                if (moved)
+                        continue;
+
+                link  = &ctx->links[pending];
+                owner = name_owner(ctx, link->ns, link->want_name);
+                do {
+                        snprintf(tmp, sizeof(tmp), APPLY_TMP_NAME, ctx->tmp_names++);
+                } while (name_owner(ctx, ctx->links[owner].ns, tmp) >= 0);
+
+                res = emit(ctx, owner, IPE_CMD_SET_NAME, NULL, tmp);
+                if (res)
+                        return res;
+        }
+}
+
+
+
+/* Plan is printed in syntax of -batch */
+static void print_plan(const apply_ctx_t *ctx) {
+        const apply_op_t *op;
+        const apply_link_t *link;
+        int i;
+
+        for (i = 0; i < ctx->nr_ops; ++i) {
+                op   = &ctx->ops[i];
+                link = &ctx->links[op->link];
+
+                printf("dev %d", link->ifindex);
+                if (link->ns != APPLY_NO_NS)
+                        printf(" nsid %d", link->ns);
+
+                switch (op->command) {
+                case IPE_CMD_SET_VID:
+                        printf(" id %d", op->value);
+                        break;
+                case IPE_CMD_SET_ETH:
+                        printf(" eth %d", op->value);
+                        break;
+                case IPE_CMD_SET_NAME:
+                        printf(" name %s", op->ifname);
+                        break;
+                case IPE_CMD_SET_PARENT:
+                        printf(" dst %d", op->slot.parent);
+                        if (op->slot.ns != APPLY_NO_NS)
+                                printf(" dstnsid %d", op->slot.ns);
+                        printf(" prev");
+                        break;
+                }
+                printf("\n");
+        }
+}
+
+
+static void apply_report(void *data, const int tag, const int code,
+                                                    const char *errmsg)
+{
+        const apply_ctx_t *ctx = data;
+
+        if (code == IPE_SKIPPED || code == IPE_ROLLED_BACK)
+                return;
+
+        apply_error(ctx, ctx->ops[tag].line, "%s (%d)%s%s", ipe_code_name(code),
+                    code, errmsg ? ": " : "", errmsg ? errmsg : "");
+}
+
+
+/* Applied changes by IPE_ATTR_STATUS: old values are taken by kernel */
+static void print_status(const apply_ctx_t *ctx,
+                         const struct ipe_op_status *status)
+{
+        const apply_op_t *op;
+        int i;
+
+        for (i = 0; i < ctx->nr_ops; ++i) {
+                op = &ctx->ops[status[i].index];
+
+                printf("dev %u", status[i].ifindex);
+                switch (op->command) {
+                case IPE_CMD_SET_VID:
+                        printf(" id %u -> %u", status[i].old_value,
+                                               status[i].new_value);
+                        break;
+                case IPE_CMD_SET_ETH:
+                        printf(" eth 0x%04x -> 0x%04x", status[i].old_value,
+                                                        status[i].new_value);
+                        break;
+                case IPE_CMD_SET_NAME:
+                        printf(" name %s", op->ifname);
+                        break;
+                case IPE_CMD_SET_PARENT:
+                        printf(" parent %u -> %u", status[i].old_value,
+                                                   status[i].new_value);
+                        break;
+                }
+                printf("\n");
+        }
+}
+
+
+static int send_plan(ipe_handle_t *h, apply_ctx_t *ctx) {
+        struct ipe_op_status *status = NULL;
+        ipe_nlmsg_t *msgs;
+        ipe_dev_t dev;
+        ipe_dev_t parent;
+        const apply_op_t *op;
+        int res = IPE_OK;
+        int i;
+
+        msgs = calloc(ctx->nr_ops, sizeof(ipe_nlmsg_t));
+        if (!msgs)
+                return IPE_BAD_ALLOC;
+
+        for (i = 0; i < ctx->nr_ops && !res; ++i) {
+                op = &ctx->ops[i];
+
+                dev.ifindex = ctx->links[op->link].ifindex;
+                dev.name    = NULL;
+                dev.nsfd    = -1;
+                dev.nsid    = ctx->links[op->link].ns;
+
+                switch (op->command) {
+                case IPE_CMD_SET_VID:
+                        res = ipe_op_set_vid(&msgs[i], &dev, op->value);
+                        break;
+                case IPE_CMD_SET_ETH:
+                        res = ipe_op_set_eth(&msgs[i], &dev, op->value);
+                        break;
+                case IPE_CMD_SET_NAME:
+                        res = ipe_op_set_name(&msgs[i], &dev, op->ifname);
+                        break;
+                case IPE_CMD_SET_PARENT:
+                        parent.ifindex = op->slot.parent;
+                        parent.name    = NULL;
+                        parent.nsfd    = -1;
+                        parent.nsid    = op->slot.ns;
+                        res = ipe_op_set_parent(&msgs[i], &dev, &parent);
+                        break;
+                }
+        }
+
+        status = calloc(ctx->nr_ops, sizeof(struct ipe_op_status));
+        if (!status)
+                res = IPE_BAD_ALLOC;
+
+        if (!res)
+                res = ipe_exec_atomic(h, msgs, ctx->nr_ops, status,
+                                                     apply_report, ctx);
+        if (!res)
+                print_status(ctx, status);
+
+        free(status);
+        free(msgs);
+
+        return res;
+}
+
+
+
+/*
+ * apply mode: @plan only prints operations (they are a file of -batch),
+ * without it they are sent by one atomic request
+ */
+int apply_mode(ipe_handle_t *h, const char *path, const int plan) {
+        apply_ctx_t *ctx;
+        ipe_filter_t filter = {
+                .nsfd = -1,
+                .nsid = -1,
+        };
+        FILE *in;
+        char *line = NULL;
+        size_t size = 0;
+        int lineno = 0;
+        int res;
+
+        ctx = calloc(1, sizeof(apply_ctx_t));
+        if (!ctx)
+                return IPE_BAD_ALLOC;
+        ctx->path = path;
+
+        in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+        if (!in) {
+                perror(path);
+                res = IPE_BAD_ARG;
+                goto free_ctx;
+        }
+
+        res = ipe_dump(h, &filter, collect_link, ctx);
+        if (!res)
+                res = build_hashes(ctx);
+
+        while (!res && getline(&line, &size, in) != -1)
+                res = parse_line(ctx, ++lineno, line);
+
+        if (!res)
+                res = check_finals(ctx);
+        if (!res)
+                res = plan_slots(ctx);
+        if (!res)
+                res = plan_names(ctx);
+        if (res)
+                goto close_in;
+
+        if (plan)
+                print_plan(ctx);
+        else if (ctx->nr_ops)
+                res = send_plan(h, ctx);
+
+        if (!res)
+                fprintf(plan ? stderr : stdout, "%d changes%s\n", ctx->nr_ops,
+                                                plan ? " planned" : " applied");
+
+close_in:
+        free(line);
+        if (in != stdin)
+                fclose(in);
+free_ctx:
+        free(ctx->links);
+        free(ctx->slot_hash);
+        free(ctx->name_hash);
+        free(ctx->finals);
+        free(ctx);
+
+        return res;
+}
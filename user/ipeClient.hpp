@@ -0,0 +1,857 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Header-only C++20 client of ipe for event loops. One non-blocking
+* socket carries many requests at once: each co_await sends its message
+* and suspends until the reply with the same nlmsg_seq is read by
+* on_readable(). Up to window() messages are in flight, the rest wait in
+* queue, so replies never overrun the socket. Batch is serialized into one
+* buffer while ops are added and this buffer is sent as is.
+*
+*     Usage with epoll (level- or edge-triggered):
+*
+*       ipe::Detached change(ipe::Client &c, int ifindex, int vid) {
+*               ipe::Result r = co_await c.set_vid({ .ifindex = ifindex }, vid);
+*               if (!r)
+*                       log(r.code, r.message);
+*       }
+*
+*       ipe::Client c;
+*       epoll_event ev = { .events = EPOLLIN, .data = { .fd = c.fd() } };
+*       epoll_ctl(ep, EPOLL_CTL_ADD, c.fd(), &ev);
+*       for (auto &[ifindex, vid] : changes)
+*               change(c, ifindex, vid);
+*       ... on EPOLLIN of c.fd(): c.on_readable();
+*
+*     Coroutines are resumed by on_readable() (or by co_await itself if the
+* message can't be sent). Client isn't thread-safe and must outlive all of
+* its requests.
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#ifndef __IPE_CLIENT_HPP
+#define __IPE_CLIENT_HPP        1
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/if.h> // IFNAMSIZ
+
+#include <algorithm>
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "../include/ipeNetlink.h"
+
+namespace ipe {
+
+
+/* Device of operation: @name is used instead of @ifindex if it isn't empty */
+struct Dev {
+        int              ifindex = 0;
+        std::string_view name;
+        int              nsfd    = -1;  /* -1 for netns of caller */
+        int              nsid    = -1;  /* -1 if it isn't given, preferred */
+};
+
+
+struct Result {
+        int              code  = IPE_OK;
+        std::uint32_t    count = 0;     /* IPE_ATTR_COUNT of renumber, compact */
+        std::string      message;       /* extended ACK of kernel */
+
+        explicit operator bool() const { return code == IPE_OK; }
+};
+
+
+struct BatchResult {
+        int              code = IPE_OK; /* of whole message */
+        std::vector<int> results;       /* IPE_* of each op, in order */
+        std::string      message;
+
+        explicit operator bool() const {
+                return code == IPE_OK &&
+                       std::all_of(results.begin(), results.end(),
+                                   [](const int res) { return res == IPE_OK; });
+        }
+};
+
+
+/* Fire-and-forget coroutine: it runs at once and frees itself at the end */
+struct Detached {
+        struct promise_type {
+                Detached get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept { std::terminate(); }
+        };
+};
+
+
+
+/* Owner of descriptor: move-only, it's closed by destructor */
+class Socket {
+public:
+        Socket() = default;
+        explicit Socket(const int fd) : fd_(fd) {}
+        ~Socket() { reset(); }
+
+        Socket(const Socket &) = delete;
+        Socket &operator=(const Socket &) = delete;
+
+        Socket(Socket &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+        Socket &operator=(Socket &&other) noexcept {
+                if (this != &other) {
+                        reset();
+                        fd_ = std::exchange(other.fd_, -1);
+                }
+                return *this;
+        }
+
+        int  get() const { return fd_; }
+        int  release() { return std::exchange(fd_, -1); }
+        explicit operator bool() const { return fd_ >= 0; }
+
+        void reset() {
+                if (fd_ >= 0)
+                        ::close(fd_);
+                fd_ = -1;
+        }
+
+private:
+        int fd_ = -1;
+};
+
+
+
+namespace detail {
+
+/* Message of one operation: it's kept into awaitable, without heap */
+class InlineBuf {
+public:
+        static constexpr std::size_t capacity = 256;
+
+        char        *data() { return data_; }
+        std::size_t  size() const { return size_; }
+
+        std::size_t grow(const std::size_t len) {
+                const std::size_t off = size_;
+
+                if (size_ + len > capacity)
+                        throw std::length_error("ipe: operation exceeds message");
+                std::memset(data_ + off, 0, len);
+                size_ += len;
+                return off;
+        }
+
+private:
+        alignas(NLMSG_ALIGNTO) char data_[capacity];
+        std::size_t size_ = 0;
+};
+
+
+class VectorBuf {
+public:
+        char        *data() { return buf_.data(); }
+        std::size_t  size() const { return buf_.size(); }
+        void         reserve(const std::size_t len) { buf_.reserve(len); }
+
+        std::size_t grow(const std::size_t len) {
+                const std::size_t off = buf_.size();
+
+                buf_.resize(off + len);
+                return off;
+        }
+
+private:
+        std::vector<char> buf_;
+};
+
+
+/* Attributes are appended in place, nests are referred by offset */
+template <typename Buf>
+class Writer {
+public:
+        explicit Writer(Buf &buf) : buf_(buf) {}
+
+        /* nlmsg_type, nlmsg_len and nlmsg_seq are filled by Client::send */
+        void begin(const std::uint8_t cmd, const std::uint16_t flags) {
+                const std::size_t off = buf_.grow(NLMSG_HDRLEN + GENL_HDRLEN);
+                nlmsghdr n{};
+                genlmsghdr g{};
+
+                n.nlmsg_flags = NLM_F_REQUEST | flags;
+                g.cmd         = cmd;
+                g.version     = IPE_GENL_VERSION;
+                std::memcpy(buf_.data() + off, &n, sizeof(n));
+                std::memcpy(buf_.data() + off + NLMSG_HDRLEN, &g, sizeof(g));
+        }
+
+        void put(const std::uint16_t type, const void *data, const std::size_t len) {
+                const std::size_t off = buf_.grow(NLA_ALIGN(NLA_HDRLEN + len));
+                nlattr nla{};
+
+                nla.nla_len  = NLA_HDRLEN + len;
+                nla.nla_type = type;
+                std::memcpy(buf_.data() + off, &nla, sizeof(nla));
+                if (data && len)
+                        std::memcpy(buf_.data() + off + NLA_HDRLEN, data, len);
+        }
+
+        void u8 (const std::uint16_t type, const std::uint8_t  v) { put(type, &v, sizeof(v)); }
+        void u16(const std::uint16_t type, const std::uint16_t v) { put(type, &v, sizeof(v)); }
+        void u32(const std::uint16_t type, const std::uint32_t v) { put(type, &v, sizeof(v)); }
+
+        /* NUL is written by grow() */
+        void str(const std::uint16_t type, const std::string_view s) {
+                if (s.size() >= IFNAMSIZ)
+                        throw std::invalid_argument("ipe: name is too long");
+
+                const std::size_t off = buf_.size();
+
+                put(type, nullptr, s.size() + 1);
+                std::memcpy(buf_.data() + off + NLA_HDRLEN, s.data(), s.size());
+        }
+
+        std::size_t nest(const std::uint16_t type) {
+                const std::size_t off = buf_.size();
+
+                put(type, nullptr, 0);
+                return off;
+        }
+
+        void nest_end(const std::size_t off) {
+                const std::uint16_t len = buf_.size() - off;
+
+                std::memcpy(buf_.data() + off, &len, sizeof(len));
+        }
+
+        /* IPE_ATTR_SRC or IPE_ATTR_DST, the same as put_dev of libipe */
+        void dev(const std::uint16_t type, const Dev &dev) {
+                const std::size_t off = nest(type);
+
+                if (!dev.name.empty())
+                        str(IPE_DEV_ATTR_IFNAME, dev.name);
+                else
+                        u32(IPE_DEV_ATTR_IFINDEX, dev.ifindex);
+
+                if (dev.nsid >= 0)
+                        u32(IPE_DEV_ATTR_NSID, dev.nsid);
+                else if (dev.nsfd >= 0)
+                        u32(IPE_DEV_ATTR_NSFD, dev.nsfd);
+
+                nest_end(off);
+        }
+
+private:
+        Buf &buf_;
+};
+
+
+/* Request between co_await and its reply */
+struct Pending {
+        std::coroutine_handle<> waiter;
+        char                   *msg   = nullptr;
+        std::size_t             len   = 0;
+        std::uint32_t           seq   = 0;      /* 0 while it isn't sent */
+        bool                    async = false;  /* ACK of queued batch */
+        int                     code  = IPE_OK;
+        std::uint32_t           count = 0;
+        std::vector<int>        results;
+        std::string             message;
+};
+
+} // namespace detail
+
+
+
+/*
+ * Operations of IPE_CMD_BATCH, serialized while they are added. At most
+ * IPE_BATCH_MAX operations, then std::length_error is thrown.
+ */
+class Batch {
+public:
+        /* average size of op into attributes, for reserve */
+        static constexpr std::size_t op_space = 64;
+
+        explicit Batch(const int flags = 0, const std::size_t reserve = 64) {
+                detail::Writer w(buf_);
+
+                buf_.reserve(NLMSG_HDRLEN + GENL_HDRLEN + 16 + reserve * op_space);
+                w.begin(IPE_CMD_BATCH, (flags & IPE_BATCH_ASYNC) ? NLM_F_ACK : 0);
+                if (flags)
+                        w.u32(IPE_ATTR_FLAGS, flags);
+                ops_   = w.nest(IPE_ATTR_OPS);
+                async_ = flags & IPE_BATCH_ASYNC;
+        }
+
+        Batch(Batch &&) = default;
+        Batch &operator=(Batch &&) = default;
+
+        Batch &set_vid(const Dev &dev, const int vid) {
+                return op(IPE_CMD_SET_VID, dev, [&](auto &w) {
+                        w.u32(IPE_ATTR_VALUE, vid);
+                });
+        }
+
+        Batch &set_eth(const Dev &dev, const int proto) {
+                return op(IPE_CMD_SET_ETH, dev, [&](auto &w) {
+                        w.u32(IPE_ATTR_VALUE, proto);
+                });
+        }
+
+        Batch &set_name(const Dev &dev, const std::string_view ifname) {
+                return op(IPE_CMD_SET_NAME, dev, [&](auto &w) {
+                        w.str(IPE_ATTR_IFNAME, ifname);
+                });
+        }
+
+        Batch &set_parent(const Dev &dev, const Dev &parent) {
+                return op(IPE_CMD_SET_PARENT, dev, [&](auto &w) {
+                        w.dev(IPE_ATTR_DST, parent);
+                });
+        }
+
+        std::size_t size()  const { return count_; }
+        bool        empty() const { return !count_; }
+        bool        full()  const { return count_ == IPE_BATCH_MAX; }
+
+private:
+        friend class Client;
+
+        template <typename F>
+        Batch &op(const std::uint8_t cmd, const Dev &dev, F &&value) {
+                detail::Writer w(buf_);
+
+                if (full())
+                        throw std::length_error("ipe: batch is full");
+
+                const std::size_t off = w.nest(IPE_ATTR_OP);
+                w.u8(IPE_ATTR_CMD, cmd);
+                w.dev(IPE_ATTR_SRC, dev);
+                value(w);
+                w.nest_end(off);
+
+                ++count_;
+                return *this;
+        }
+
+        detail::VectorBuf buf_;
+        std::size_t       ops_   = 0;   /* offset of IPE_ATTR_OPS */
+        std::size_t       count_ = 0;
+        bool              async_ = false;
+};
+
+
+
+class Client;
+
+/* Awaitable of one message: @Buf keeps message, @R is result of co_await */
+template <typename Buf, typename R>
+class [[nodiscard]] Request {
+public:
+        Request(Client &client, Buf &&buf, const bool async = false)
+                : client_(client), buf_(std::move(buf))
+        {
+                p_.async = async;
+        }
+
+        Request(const Request &) = delete;
+        Request &operator=(const Request &) = delete;
+
+        ~Request();
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> waiter);
+        R    await_resume();
+
+private:
+        Client          &client_;
+        Buf              buf_;
+        detail::Pending  p_;
+        bool             submitted_ = false;
+};
+
+using OpRequest    = Request<detail::InlineBuf, Result>;
+using MapRequest   = Request<detail::VectorBuf, Result>;
+using BatchRequest = Request<detail::VectorBuf, BatchResult>;
+
+
+
+class Client {
+public:
+        static constexpr std::size_t default_window = 256;
+        static constexpr int         sock_rcvbuf    = 1024 * 1024;
+        static constexpr std::size_t rcvbuf         = 64 * 1024;
+
+        /* Family is resolved at once (blocking), std::system_error on failure */
+        explicit Client(const std::size_t window = default_window)
+                : window_(window ? window : 1), rbuf_(rcvbuf)
+        {
+                const int one = 1;
+                sockaddr_nl addr{};
+
+                sock_ = Socket(::socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC,
+                                        NETLINK_GENERIC));
+                if (!sock_)
+                        throw std::system_error(errno, std::generic_category(), "ipe: socket");
+
+                ::setsockopt(fd(), SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof(one));
+                ::setsockopt(fd(), SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+                ::setsockopt(fd(), SOL_SOCKET, SO_RCVBUF, &sock_rcvbuf, sizeof(sock_rcvbuf));
+
+                addr.nl_family = AF_NETLINK;
+                if (::bind(fd(), reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+                        throw std::system_error(errno, std::generic_category(), "ipe: bind");
+
+                resolve_family();
+
+                if (::fcntl(fd(), F_SETFL, ::fcntl(fd(), F_GETFL) | O_NONBLOCK) < 0)
+                        throw std::system_error(errno, std::generic_category(), "ipe: fcntl");
+        }
+
+        Client(const Client &) = delete;
+        Client &operator=(const Client &) = delete;
+
+        /* for epoll: EPOLLIN means that on_readable() must be called */
+        int          fd()      const { return sock_.get(); }
+        std::size_t  window()  const { return window_; }
+        std::size_t  pending() const { return sent_.size() + queue_.size(); }
+
+
+        OpRequest set_vid(const Dev &dev, const int vid) {
+                return op(IPE_CMD_SET_VID, dev, [&](auto &w) {
+                        w.u32(IPE_ATTR_VALUE, vid);
+                });
+        }
+
+        OpRequest set_eth(const Dev &dev, const int proto) {
+                return op(IPE_CMD_SET_ETH, dev, [&](auto &w) {
+                        w.u32(IPE_ATTR_VALUE, proto);
+                });
+        }
+
+        OpRequest set_name(const Dev &dev, const std::string_view ifname) {
+                return op(IPE_CMD_SET_NAME, dev, [&](auto &w) {
+                        w.str(IPE_ATTR_IFNAME, ifname);
+                });
+        }
+
+        OpRequest set_parent(const Dev &dev, const Dev &parent) {
+                return op(IPE_CMD_SET_PARENT, dev, [&](auto &w) {
+                        w.dev(IPE_ATTR_DST, parent);
+                });
+        }
+
+        /* Result::count is number of freed parts */
+        OpRequest compact(const Dev &parent) {
+                return op(IPE_CMD_COMPACT, parent, [](auto &) {});
+        }
+
+        /* Result::count is number of renumbered devices */
+        MapRequest renumber(const Dev &parent, const std::span<const ipe_vid_pair> map) {
+                detail::VectorBuf buf;
+                detail::Writer w(buf);
+
+                buf.reserve(NLMSG_HDRLEN + GENL_HDRLEN + 64 + map.size_bytes());
+                w.begin(IPE_CMD_RENUMBER, NLM_F_ACK);
+                w.dev(IPE_ATTR_SRC, parent);
+                w.put(IPE_ATTR_VID_MAP, map.data(), map.size_bytes());
+
+                return MapRequest(*this, std::move(buf));
+        }
+
+        /* Buffer of batch is moved into request and is sent without copy */
+        BatchRequest submit(Batch &&batch) {
+                detail::Writer w(batch.buf_);
+
+                w.nest_end(batch.ops_);
+                return BatchRequest(*this, std::move(batch.buf_), batch.async_);
+        }
+
+
+        /*
+         * Reads all replies that are ready, sends queued messages and resumes
+         * coroutines of completed requests. Doesn't block.
+         */
+        void on_readable() {
+                std::vector<std::coroutine_handle<>> ready;
+
+                for (;;) {
+                        const ssize_t len = ::recv(fd(), rbuf_.data(), rbuf_.size(),
+                                                   MSG_DONTWAIT);
+                        if (len < 0) {
+                                if (errno == EINTR)
+                                        continue;
+                                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                                        break;
+                                /* replies are lost (ENOBUFS), nothing can be matched */
+                                fail_sent(errno);
+                                if (errno != ENOBUFS)
+                                        break;
+                                continue;
+                        }
+
+                        parse(len);
+                }
+
+                pump();
+
+                ready.swap(ready_);
+                for (auto waiter : ready)
+                        waiter.resume();
+        }
+
+
+        /* Simple loop without epoll: until all requests are completed */
+        void wait_all() {
+                pollfd pfd = { fd(), POLLIN, 0 };
+
+                while (pending()) {
+                        if (::poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                                throw std::system_error(errno, std::generic_category(),
+                                                        "ipe: poll");
+                        on_readable();
+                }
+        }
+
+private:
+        template <typename, typename> friend class Request;
+
+        template <typename F>
+        OpRequest op(const std::uint8_t cmd, const Dev &dev, F &&value) {
+                detail::InlineBuf buf;
+                detail::Writer w(buf);
+
+                w.begin(cmd, NLM_F_ACK);
+                w.dev(IPE_ATTR_SRC, dev);
+                value(w);
+
+                return OpRequest(*this, std::move(buf));
+        }
+
+
+        void resolve_family() {
+                detail::InlineBuf buf;
+                detail::Writer w(buf);
+                nlmsghdr n;
+                ssize_t len;
+
+                w.begin(CTRL_CMD_GETFAMILY, 0);
+                w.put(CTRL_ATTR_FAMILY_NAME, IPE_GENL_NAME, sizeof(IPE_GENL_NAME));
+                finish(buf.data(), buf.size(), GENL_ID_CTRL, 1);
+
+                if (::send(fd(), buf.data(), buf.size(), 0) < 0)
+                        throw std::system_error(errno, std::generic_category(), "ipe: send");
+
+                do {
+                        len = ::recv(fd(), rbuf_.data(), rbuf_.size(), 0);
+                } while (len < 0 && errno == EINTR);
+
+                if (len < (ssize_t)NLMSG_HDRLEN)
+                        throw std::system_error(len < 0 ? errno : EPROTO,
+                                                std::generic_category(), "ipe: recv");
+
+                std::memcpy(&n, rbuf_.data(), sizeof(n));
+                if (n.nlmsg_type == NLMSG_ERROR) {
+                        nlmsgerr err;
+
+                        std::memcpy(&err, rbuf_.data() + NLMSG_HDRLEN, sizeof(err));
+                        throw std::system_error(-err.error, std::generic_category(),
+                                                "ipe: family \"" IPE_GENL_NAME "\" isn't found");
+                }
+
+                for_attrs(rbuf_.data() + NLMSG_HDRLEN + GENL_HDRLEN,
+                          (int)n.nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN,
+                          [&](const nlattr &nla, const char *data) {
+                                  if (nla.nla_type == CTRL_ATTR_FAMILY_ID)
+                                          std::memcpy(&family_, data, sizeof(family_));
+                          });
+
+                if (!family_)
+                        throw std::system_error(EPROTO, std::generic_category(),
+                                                "ipe: reply without family id");
+        }
+
+
+        std::uint32_t next_seq() {
+                if (!++seq_)
+                        ++seq_;
+                return seq_;
+        }
+
+
+        static void finish(char *msg, const std::size_t len, const std::uint16_t type,
+                           const std::uint32_t seq)
+        {
+                nlmsghdr n;
+
+                std::memcpy(&n, msg, sizeof(n));
+                n.nlmsg_len  = len;
+                n.nlmsg_type = type;
+                n.nlmsg_seq  = seq;
+                std::memcpy(msg, &n, sizeof(n));
+        }
+
+
+        /* @fn(nla, payload) for each attribute of [@data, @data + @len) */
+        template <typename F>
+        static void for_attrs(const char *data, int len, F &&fn) {
+                nlattr nla;
+
+                while (len >= (int)NLA_HDRLEN) {
+                        std::memcpy(&nla, data, sizeof(nla));
+                        if (nla.nla_len < NLA_HDRLEN || nla.nla_len > len)
+                                break;
+
+                        fn(nla, data + NLA_HDRLEN);
+
+                        len  -= NLA_ALIGN(nla.nla_len);
+                        data += NLA_ALIGN(nla.nla_len);
+                }
+        }
+
+
+        /* false if message isn't sent: @p is completed with IPE_BAD_SOC */
+        bool send(detail::Pending *p) {
+                sockaddr_nl kernel{};
+                const std::uint32_t seq = next_seq();
+
+                kernel.nl_family = AF_NETLINK;
+                finish(p->msg, p->len, family_, seq);
+
+                if (::sendto(fd(), p->msg, p->len, 0,
+                             reinterpret_cast<sockaddr *>(&kernel), sizeof(kernel)) < 0) {
+                        p->code    = IPE_BAD_SOC;
+                        p->message = std::strerror(errno);
+                        return false;
+                }
+
+                p->seq = seq;
+                sent_.emplace(seq, p);
+                return true;
+        }
+
+
+        /* From await_suspend: false if coroutine must be resumed at once */
+        bool enqueue(detail::Pending *p) {
+                if (sent_.size() < window_ && queue_.empty())
+                        return send(p);
+
+                queue_.push_back(p);
+                return true;
+        }
+
+
+        void pump() {
+                while (!queue_.empty() && sent_.size() < window_) {
+                        detail::Pending *p = queue_.front();
+
+                        queue_.pop_front();
+                        if (!send(p))
+                                ready_.push_back(p->waiter);
+                }
+        }
+
+
+        /* Awaitable is destroyed before its reply: reply will be dropped */
+        void forget(detail::Pending *p) {
+                if (p->seq) {
+                        auto it = sent_.find(p->seq);
+                        if (it != sent_.end() && it->second == p)
+                                sent_.erase(it);
+                        return;
+                }
+
+                queue_.erase(std::remove(queue_.begin(), queue_.end(), p), queue_.end());
+                ready_.erase(std::remove(ready_.begin(), ready_.end(), p->waiter),
+                             ready_.end());
+        }
+
+
+        void complete(detail::Pending *p) {
+                sent_.erase(p->seq);
+                p->seq = 0;
+                ready_.push_back(p->waiter);
+        }
+
+
+        void fail_sent(const int err) {
+                for (auto &[seq, p] : sent_) {
+                        p->code    = IPE_BAD_SOC;
+                        p->message = std::strerror(err);
+                        p->seq     = 0;
+                        ready_.push_back(p->waiter);
+                }
+                sent_.clear();
+        }
+
+
+        /* Extended ACK, the same as nlmsg_ext_ack of libipe */
+        static std::string ext_ack(const nlmsghdr &n, const char *data) {
+                nlmsgerr err;
+                std::string message;
+                int offset = sizeof(nlmsgerr);
+
+                if (!(n.nlmsg_flags & NLM_F_ACK_TLVS))
+                        return message;
+
+                std::memcpy(&err, data, sizeof(err));
+                if (!(n.nlmsg_flags & NLM_F_CAPPED))
+                        offset += err.msg.nlmsg_len - sizeof(nlmsghdr);
+
+                for_attrs(data + offset, (int)n.nlmsg_len - NLMSG_HDRLEN - offset,
+                          [&](const nlattr &nla, const char *payload) {
+                                  if (nla.nla_type == NLMSGERR_ATTR_MSG)
+                                          message = payload;
+                          });
+
+                return message;
+        }
+
+
+        void parse(ssize_t len) {
+                const char *buf = rbuf_.data();
+                nlmsghdr n;
+
+                while (len >= (ssize_t)NLMSG_HDRLEN) {
+                        std::memcpy(&n, buf, sizeof(n));
+                        if (n.nlmsg_len < NLMSG_HDRLEN || n.nlmsg_len > len)
+                                break;
+
+                        auto it = sent_.find(n.nlmsg_seq);
+                        if (it != sent_.end())
+                                reply(it->second, n, buf + NLMSG_HDRLEN);
+
+                        len -= NLMSG_ALIGN(n.nlmsg_len);
+                        buf += NLMSG_ALIGN(n.nlmsg_len);
+                }
+        }
+
+
+        void reply(detail::Pending *p, const nlmsghdr &n, const char *data) {
+                if (n.nlmsg_type == NLMSG_ERROR) {
+                        nlmsgerr err;
+
+                        std::memcpy(&err, data, sizeof(err));
+
+                        /* batch is queued by module: results come later */
+                        if (!err.error && p->async) {
+                                p->async = false;
+                                return;
+                        }
+
+                        if (err.error) {
+                                p->code    = ipe_errno_to_code(-err.error);
+                                p->message = ext_ack(n, data);
+                        }
+                        complete(p);
+                        return;
+                }
+
+                if (n.nlmsg_type != family_)
+                        return;
+
+                genlmsghdr g;
+                std::memcpy(&g, data, sizeof(g));
+
+                for_attrs(data + GENL_HDRLEN, (int)n.nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN,
+                          [&](const nlattr &nla, const char *payload) {
+                                  if (nla.nla_type == IPE_ATTR_COUNT)
+                                          std::memcpy(&p->count, payload, sizeof(p->count));
+                                  else if (nla.nla_type == IPE_ATTR_RESULTS)
+                                          results(p, nla, payload);
+                          });
+
+                /* RENUMBER and COMPACT: ACK follows */
+                if (g.cmd == IPE_CMD_BATCH)
+                        complete(p);
+        }
+
+
+        static void results(detail::Pending *p, const nlattr &nest, const char *data) {
+                p->results.clear();
+                for_attrs(data, nest.nla_len - NLA_HDRLEN,
+                          [&](const nlattr &, const char *payload) {
+                                  std::uint32_t code;
+
+                                  std::memcpy(&code, payload, sizeof(code));
+                                  p->results.push_back(code);
+                          });
+        }
+
+
+        Socket                                          sock_;
+        std::uint16_t                                   family_ = 0;
+        std::uint32_t                                   seq_    = 0;
+        std::size_t                                     window_;
+        std::unordered_map<std::uint32_t, detail::Pending *> sent_;
+        std::deque<detail::Pending *>                   queue_;
+        std::vector<std::coroutine_handle<>>            ready_;
+        std::vector<char>                               rbuf_;
+};
+
+
+
+template <typename Buf, typename R>
+Request<Buf, R>::~Request() {
+        if (submitted_)
+                client_.forget(&p_);
+}
+
+
+template <typename Buf, typename R>
+bool Request<Buf, R>::await_suspend(std::coroutine_handle<> waiter) {
+        p_.waiter  = waiter;
+        p_.msg     = buf_.data();
+        p_.len     = buf_.size();
+        submitted_ = true;
+
+        return client_.enqueue(&p_);
+}
+
+
+template <typename Buf, typename R>
+R Request<Buf, R>::await_resume() {
+        submitted_ = false;
+
+        if constexpr (std::is_same_v<R, BatchResult>)
+                return BatchResult{ p_.code, std::move(p_.results), std::move(p_.message) };
+        else
+                return Result{ p_.code, p_.count, std::move(p_.message) };
+}
+
+} // namespace ipe
+
+#endif // __IPE_CLIENT_HPP
@@ -0,0 +1,1723 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Protocol of ipe: generic netlink family "ipe" (../include/ipeNetlink.h).
+* Buffers are allocated by ipe_open() (slots of batch by the first
+* ipe_batch_begin()) and are reused by each call of the same handle.
+*
+******************************************************************************/
+
+
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "libipe.h"
+
+#define MAX_VID              4094
+#define MAX_PATH_LEN         256
+#define NETNS_RUN_DIR        "/var/run/netns"
+#define NETNS_CACHE_SIZE     64
+#define ERRMSG_LEN           256
+
+/* Upper bound of one operation into attributes: */
+#define OP_SPACE             128
+#define VID_MAP_SPACE        (MAX_VID * sizeof(ipe_vid_pair_t) + 64)
+#define REQ_SPACE            (NLMSG_SPACE(GENL_HDRLEN) + \
+                              (VID_MAP_SPACE > OP_SPACE ? VID_MAP_SPACE : OP_SPACE))
+#define RCVBUF               (64 * 1024)
+
+/* Batch: */
+#define BATCH_CHUNK          256  /* operations into one batched message */
+#define BATCH_WINDOW         32   /* messages in flight */
+#define ASYNC_SOCK_RCVBUF    (1024 * 1024) /* results of whole window */
+#define SLOT_SPACE           (NLMSG_SPACE(GENL_HDRLEN) + \
+                              (BATCH_CHUNK * OP_SPACE > VID_MAP_SPACE ? \
+                                        BATCH_CHUNK * OP_SPACE : VID_MAP_SPACE))
+
+/* Attributes, like RTA_* of iproute2 */
+#define NLA_DATA(nla)        ((void *)((char *)(nla) + NLA_HDRLEN))
+#define NLA_PAYLOAD(nla)     ((int)(nla)->nla_len - NLA_HDRLEN)
+#define NLA_OK(nla, len)     ((len) >= (int)sizeof(struct nlattr) && \
+                              (nla)->nla_len >= sizeof(struct nlattr) && \
+                              (nla)->nla_len <= (len))
+#define NLA_NEXT(nla, len)   ((len) -= NLA_ALIGN((nla)->nla_len), \
+                              (struct nlattr *)((char *)(nla) + NLA_ALIGN((nla)->nla_len)))
+#define NLMSG_TAIL(nmsg)     ((struct nlattr *)(((char *)(nmsg)) + \
+                                                NLMSG_ALIGN((nmsg)->nlmsg_len)))
+#define GENLMSG_ATTRS(nmsg)  ((struct nlattr *)((char *)NLMSG_DATA(nmsg) + GENL_HDRLEN))
+#define GENLMSG_ATTRLEN(nmsg) ((int)(nmsg)->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN))
+
+
+typedef struct nlmsghdr nmsgh_t;
+
+
+/* One message of batch in flight */
+typedef struct {
+        unsigned int  seq;      /* 0 for free slot */
+        int           count;
+        int           tag [BATCH_CHUNK];
+        ipe_nlmsg_t   ops [BATCH_CHUNK]; /* are kept to send skipped again */
+        nmsgh_t      *nlh;
+} ipe_slot_t;
+
+typedef struct {
+        int              flags;    /* IPE_BATCH_* */
+        int              stop;     /* don't send next operations */
+        int              res;      /* first failure */
+        int              in_flight;
+        ipe_result_cb_t  cb;
+        void            *data;
+        ipe_slot_t      *cur;      /* batched message that is being filled */
+        ipe_slot_t       slots[BATCH_WINDOW];
+} ipe_batch_ctx_t;
+
+typedef struct {
+        char name[MAX_PATH_LEN];
+        int  fd;
+} ipe_netns_t;
+
+struct ipe_handle {
+        int                 fd;
+        int                 family;     /* id of "ipe" family, by nlctrl */
+        int                 mcgrp;      /* id of "events", 0 if module hasn't it */
+        unsigned int        version;
+        unsigned int        seq;
+        struct sockaddr_nl  dest;
+        nmsgh_t            *req;        /* REQ_SPACE */
+        char               *rcvbuf;     /* RCVBUF */
+        char                errmsg[ERRMSG_LEN];
+        ipe_netns_t        *netns;
+        int                 netns_cached;
+        ipe_batch_ctx_t    *batch;
+        /* IPE_ATTR_STATUS of reply is copied here, if it's set */
+        struct ipe_op_status *status;
+        int                 status_count;
+};
+
+
+static const char *code_names[IPE_ERR_COUNT] = {
+        [IPE_OK]                = "IPE_OK",
+        [IPE_BAD_ARG]           = "IPE_BAD_ARG",
+        [IPE_BAD_VID]           = "IPE_BAD_VID",
+        [IPE_BAD_PTR]           = "IPE_BAD_PTR",
+        [IPE_BAD_DEV]           = "IPE_BAD_DEV",
+        [IPE_BAD_IF_IDX]        = "IPE_BAD_IF_IDX",
+        [IPE_UNKNOWN_COMMAND]   = "IPE_UNKNOWN_COMMAND",
+        [IPE_FAIL_NS]           = "IPE_FAIL_NS",
+        [IPE_FAIL_CR_SOC]       = "IPE_FAIL_CR_SOC",
+        [IPE_FEW_ARG]           = "IPE_FEW_ARG",
+        [IPE_NULLPTR]           = "IPE_NULLPTR",
+        [IPE_BAD_SOC]           = "IPE_BAD_SOC",
+        [IPE_BAD_ALLOC]         = "IPE_BAD_ALLOC",
+        [IPE_DEFAULT_FAIL]      = "IPE_DEFAULT_FAIL",
+        [IPE_SKIPPED]           = "IPE_SKIPPED",
+        [IPE_ROLLED_BACK]       = "IPE_ROLLED_BACK",
+};
+
+
+const char *ipe_code_name(const int code) {
+        if (code >= 0 && code < IPE_ERR_COUNT)
+                return code_names[code];
+        return "unknown";
+}
+
+
+const char *ipe_errmsg(const ipe_handle_t *h) {
+        return h->errmsg[0] ? h->errmsg : NULL;
+}
+
+
+unsigned int ipe_module_version(const ipe_handle_t *h) {
+        return h->version;
+}
+
+
+static int sock_error(ipe_handle_t *h, const char *call) {
+        snprintf(h->errmsg, ERRMSG_LEN, "%s: %s", call, strerror(errno));
+        return IPE_BAD_SOC;
+}
+
+
+
+/* Functions below are paste from iproute2 (libnetlink.c) */
+static int addattr_l(nmsgh_t *n, int maxlen, int type, const void *data, int alen) {
+        int len = NLA_HDRLEN + alen;
+        struct nlattr *nla;
+
+        if (NLMSG_ALIGN(n->nlmsg_len) + NLA_ALIGN(len) > maxlen)
+                return -1;
+
+        nla = NLMSG_TAIL(n);
+        nla->nla_type = type;
+        nla->nla_len  = len;
+        if (alen)
+                memcpy(NLA_DATA(nla), data, alen);
+        n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + NLA_ALIGN(len);
+
+        return 0;
+}
+
+static int addattr8(nmsgh_t *n, int maxlen, int type, __u8 data) {
+        return addattr_l(n, maxlen, type, &data, sizeof(__u8));
+}
+
+static int addattr16(nmsgh_t *n, int maxlen, int type, __u16 data) {
+        return addattr_l(n, maxlen, type, &data, sizeof(__u16));
+}
+
+static int addattr32(nmsgh_t *n, int maxlen, int type, __u32 data) {
+        return addattr_l(n, maxlen, type, &data, sizeof(__u32));
+}
+
+static struct nlattr *addattr_nest(nmsgh_t *n, int maxlen, int type) {
+        struct nlattr *nest = NLMSG_TAIL(n);
+
+        if (addattr_l(n, maxlen, type, NULL, 0))
+                return NULL;
+        return nest;
+}
+
+static int addattr_nest_end(nmsgh_t *n, struct nlattr *nest) {
+        nest->nla_len = (char *)NLMSG_TAIL(n) - (char *)nest;
+        return n->nlmsg_len;
+}
+
+static void parse_attrs(struct nlattr **tb, int max, struct nlattr *nla, int len) {
+        memset(tb, 0, sizeof(struct nlattr *) * (max + 1));
+
+        for (; NLA_OK(nla, len); nla = NLA_NEXT(nla, len)) {
+                int type = nla->nla_type & NLA_TYPE_MASK;
+                if (type <= max && !tb[type])
+                        tb[type] = nla;
+        }
+}
+
+static __u16 nla_getattr_u16(const struct nlattr *nla) {
+        return *(__u16 *)NLA_DATA(nla);
+}
+
+static __u32 nla_getattr_u32(const struct nlattr *nla) {
+        return *(__u32 *)NLA_DATA(nla);
+}
+
+
+
+static void genl_init(nmsgh_t *n, const int family, const int cmd,
+                                                    const int version)
+{
+        struct genlmsghdr *g = NLMSG_DATA(n);
+
+        memset(n, 0, NLMSG_SPACE(GENL_HDRLEN));
+        n->nlmsg_len   = NLMSG_LENGTH(GENL_HDRLEN);
+        n->nlmsg_type  = family;
+        n->nlmsg_flags = NLM_F_REQUEST;
+        n->nlmsg_pid   = getpid();
+        g->cmd         = cmd;
+        g->version     = version;
+}
+
+
+static unsigned int next_seq(ipe_handle_t *h) {
+        if (!++h->seq)
+                ++h->seq;
+        return h->seq;
+}
+
+
+static int send_msg(ipe_handle_t *h, nmsgh_t *nlh) {
+        if (sendto(h->fd, nlh, nlh->nlmsg_len, 0,
+                   (struct sockaddr *)&h->dest, sizeof(h->dest)) < 0)
+                return sock_error(h, "sendto");
+        return IPE_OK;
+}
+
+
+/* Interrupted recv is repeated, -1 is real failure */
+static int recv_msgs(ipe_handle_t *h) {
+        int len;
+
+        do {
+                len = recv(h->fd, h->rcvbuf, RCVBUF, 0);
+        } while (len < 0 && errno == EINTR);
+
+        return len;
+}
+
+
+
+/* Extended ACK message of kernel, NULL if it's absent */
+static const char *nlmsg_ext_ack(const nmsgh_t *h) {
+        const struct nlmsgerr *err = NLMSG_DATA(h);
+        struct nlattr *tb[NLMSGERR_ATTR_MAX + 1];
+        int offset = sizeof(struct nlmsgerr);
+
+        if (!(h->nlmsg_flags & NLM_F_ACK_TLVS))
+                return NULL;
+
+        if (!(h->nlmsg_flags & NLM_F_CAPPED))
+                offset += err->msg.nlmsg_len - sizeof(nmsgh_t);
+
+        parse_attrs(tb, NLMSGERR_ATTR_MAX,
+                    (struct nlattr *)((char *)err + offset),
+                    (int)h->nlmsg_len - NLMSG_HDRLEN - offset);
+
+        return tb[NLMSGERR_ATTR_MSG] ? NLA_DATA(tb[NLMSGERR_ATTR_MSG]) : NULL;
+}
+
+
+/* IPE_* code of NLMSG_ERROR (0 for ACK), message of kernel is kept */
+static int nlmsg_error_code(ipe_handle_t *h, const nmsgh_t *n) {
+        const struct nlmsgerr *err = NLMSG_DATA(n);
+        const char *ext_ack;
+
+        if (!err->error)
+                return IPE_OK;
+
+        ext_ack = nlmsg_ext_ack(n);
+        if (ext_ack)
+                snprintf(h->errmsg, ERRMSG_LEN, "%s", ext_ack);
+
+        #ifdef IPE_DEBUG
+                printf("%s: errno %d: %s\n", __FUNCTION__,
+                                        -err->error, strerror(-err->error));
+        #endif
+
+        return ipe_errno_to_code(-err->error);
+}
+
+
+
+/* @groups is CTRL_ATTR_MCAST_GROUPS: nested array of groups */
+static int find_mcgrp(const struct nlattr *groups, const char *name) {
+        struct nlattr *tb[CTRL_ATTR_MCAST_GRP_MAX + 1];
+        struct nlattr *grp = NLA_DATA(groups);
+        int len = NLA_PAYLOAD(groups);
+
+        for (; NLA_OK(grp, len); grp = NLA_NEXT(grp, len)) {
+                parse_attrs(tb, CTRL_ATTR_MCAST_GRP_MAX,
+                            NLA_DATA(grp), NLA_PAYLOAD(grp));
+                if (tb[CTRL_ATTR_MCAST_GRP_NAME] && tb[CTRL_ATTR_MCAST_GRP_ID] &&
+                    !strcmp(NLA_DATA(tb[CTRL_ATTR_MCAST_GRP_NAME]), name))
+                        return nla_getattr_u32(tb[CTRL_ATTR_MCAST_GRP_ID]);
+        }
+
+        return 0;
+}
+
+
+/* Id of "ipe" family by CTRL_CMD_GETFAMILY of nlctrl, errno on failure */
+static int resolve_family(ipe_handle_t *h) {
+        struct nlattr *tb[CTRL_ATTR_MAX + 1];
+        nmsgh_t *n = h->req;
+        int len;
+
+        genl_init(n, GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1);
+        addattr_l(n, REQ_SPACE, CTRL_ATTR_FAMILY_NAME,
+                  IPE_GENL_NAME, sizeof(IPE_GENL_NAME));
+
+        if (send(h->fd, n, n->nlmsg_len, 0) < 0)
+                return -1;
+
+        len = recv_msgs(h);
+        if (len < 0)
+                return -1;
+
+        n = (nmsgh_t *)h->rcvbuf;
+        if (!NLMSG_OK(n, len)) {
+                errno = EPROTO;
+                return -1;
+        }
+
+        if (n->nlmsg_type == NLMSG_ERROR) {
+                errno = -((struct nlmsgerr *)NLMSG_DATA(n))->error;
+                return -1;
+        }
+
+        parse_attrs(tb, CTRL_ATTR_MAX, GENLMSG_ATTRS(n), GENLMSG_ATTRLEN(n));
+        if (!tb[CTRL_ATTR_FAMILY_ID]) {
+                errno = EPROTO;
+                return -1;
+        }
+
+        h->family = nla_getattr_u16(tb[CTRL_ATTR_FAMILY_ID]);
+        if (tb[CTRL_ATTR_MCAST_GROUPS])
+                h->mcgrp = find_mcgrp(tb[CTRL_ATTR_MCAST_GROUPS],
+                                      IPE_GENL_MCGRP_EVENTS);
+        if (tb[CTRL_ATTR_VERSION])
+                h->version = nla_getattr_u32(tb[CTRL_ATTR_VERSION]);
+
+        #ifdef IPE_DEBUG
+                printf("%s: family %s id %d\n",
+                                __FUNCTION__, IPE_GENL_NAME, h->family);
+        #endif
+
+        return 0;
+}
+
+
+
+ipe_handle_t *ipe_open(void) {
+        struct sockaddr_nl src_addr;
+        ipe_handle_t *h;
+        int one = 1;
+        int err;
+
+        h = calloc(1, sizeof(ipe_handle_t));
+        if (!h)
+                return NULL;
+
+        h->req    = calloc(1, REQ_SPACE);
+        h->rcvbuf = malloc(RCVBUF);
+        if (!h->req || !h->rcvbuf) {
+                errno = ENOMEM;
+                goto free_handle;
+        }
+
+        h->fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+        if (h->fd < 0)
+                goto free_handle;
+
+        /* error message of kernel instead of copy of request into ACK */
+        setsockopt(h->fd, SOL_NETLINK, NETLINK_EXT_ACK, &one, sizeof(one));
+        setsockopt(h->fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+
+        memset(&src_addr, 0, sizeof(src_addr));
+        src_addr.nl_family = AF_NETLINK;
+        if (bind(h->fd, (struct sockaddr *)&src_addr, sizeof(src_addr)) < 0)
+                goto close_sock;
+
+        h->dest.nl_family = AF_NETLINK;
+        h->dest.nl_pid    = 0; /* For Linux Kernel */
+        h->dest.nl_groups = 0; /* unicast */
+
+        if (resolve_family(h))
+                goto close_sock;
+
+        return h;
+
+close_sock:
+        err = errno;
+        close(h->fd);
+        errno = err;
+free_handle:
+        err = errno;
+        free(h->rcvbuf);
+        free(h->req);
+        free(h);
+        errno = err;
+
+        return NULL;
+}
+
+
+void ipe_close(ipe_handle_t *h) {
+        int i;
+
+        if (!h)
+                return;
+
+        for (i = 0; i < h->netns_cached; ++i) {
+                if (h->netns[i].fd >= 0)
+                        close(h->netns[i].fd);
+        }
+        free(h->netns);
+
+        if (h->batch) {
+                for (i = 0; i < BATCH_WINDOW; ++i)
+                        free(h->batch->slots[i].nlh);
+                free(h->batch);
+        }
+
+        close(h->fd);
+        free(h->rcvbuf);
+        free(h->req);
+        free(h);
+}
+
+
+
+/* This function is paste from iproute2 */
+static int open_netns_fd(const char *name)
+{
+        char pathbuf[MAX_PATH_LEN];
+        const char *path, *ptr;
+
+        path = name;
+        ptr = strchr(name, '/');
+        if (!ptr) {
+                snprintf(pathbuf, sizeof(pathbuf), "%s/%s",
+                        NETNS_RUN_DIR, name );
+                path = pathbuf;
+        }
+        return open(path, O_RDONLY);
+}
+
+
+/*
+ * Descriptors of netns are opened once: batch refers the same netns many
+ * times. All of them are closed by ipe_close.
+ */
+int ipe_netns_fd(ipe_handle_t *h, const char *name) {
+        void *cache;
+        int i;
+
+        for (i = 0; i < h->netns_cached; ++i) {
+                if (!strcmp(h->netns[i].name, name))
+                        return h->netns[i].fd;
+        }
+
+        if (!(h->netns_cached % NETNS_CACHE_SIZE)) {
+                cache = realloc(h->netns, (h->netns_cached + NETNS_CACHE_SIZE) *
+                                          sizeof(ipe_netns_t));
+                if (!cache)
+                        return -1;
+                h->netns = cache;
+        }
+
+        snprintf(h->netns[h->netns_cached].name, MAX_PATH_LEN, "%s", name);
+        h->netns[h->netns_cached].fd = open_netns_fd(name);
+
+        return h->netns[h->netns_cached++].fd;
+}
+
+
+
+static int op_dev(ipe_nlmsg_t *op, const int id, const ipe_dev_t *dev) {
+        op->ifindex[id] = dev->ifindex;
+        op->nsfd[id]    = dev->nsfd;
+        op->nsid[id]    = dev->nsid;
+
+        if (!dev->name)
+                return IPE_OK;
+
+        if (strlen(dev->name) >= IFNAMSIZ)
+                return IPE_BAD_ARG;
+        strcpy(op->devname[id], dev->name);
+
+        return IPE_OK;
+}
+
+
+int ipe_op_init(ipe_nlmsg_t *op, const int command, const ipe_dev_t *dev) {
+        int i;
+
+        memset(op, 0, sizeof(ipe_nlmsg_t));
+        for (i = 0; i < IPE_DEV_COUNT; ++i) {
+                op->nsfd[i] = -1;
+                op->nsid[i] = -1;
+        }
+        op->command = command;
+
+        return op_dev(op, IPE_SRC, dev);
+}
+
+
+int ipe_op_set_vid(ipe_nlmsg_t *op, const ipe_dev_t *dev, const int vid) {
+        int res = ipe_op_init(op, IPE_CMD_SET_VID, dev);
+
+        op->value = vid;
+        return res;
+}
+
+
+int ipe_op_set_eth(ipe_nlmsg_t *op, const ipe_dev_t *dev, const int proto) {
+        int res = ipe_op_init(op, IPE_CMD_SET_ETH, dev);
+
+        op->value = proto;
+        return res;
+}
+
+
+int ipe_op_set_name(ipe_nlmsg_t *op, const ipe_dev_t *dev, const char *ifname) {
+        int res = ipe_op_init(op, IPE_CMD_SET_NAME, dev);
+
+        if (strlen(ifname) >= IFNAMSIZ)
+                return IPE_BAD_ARG;
+        strcpy(op->ifname, ifname);
+
+        return res;
+}
+
+
+int ipe_op_set_parent(ipe_nlmsg_t *op, const ipe_dev_t *dev,
+                                       const ipe_dev_t *parent)
+{
+        int res = ipe_op_init(op, IPE_CMD_SET_PARENT, dev);
+
+        return res ? res : op_dev(op, IPE_DST, parent);
+}
+
+
+int ipe_op_compact(ipe_nlmsg_t *op, const ipe_dev_t *parent) {
+        return ipe_op_init(op, IPE_CMD_COMPACT, parent);
+}
+
+
+
+/*
+ * IPE_ATTR_SRC or IPE_ATTR_DST: ifindex or name of device, netns only
+ * if it's given (netnsid is preferred)
+ */
+static int put_dev(nmsgh_t *n, int maxlen, int type, const ipe_nlmsg_t *msg,
+                                                     const int id)
+{
+        struct nlattr *nest = addattr_nest(n, maxlen, type);
+        const char *name = msg->devname[id];
+
+        if (!nest)
+                return -1;
+        if (name[0]) {
+                if (addattr_l(n, maxlen, IPE_DEV_ATTR_IFNAME, name, strlen(name) + 1))
+                        return -1;
+        } else if (addattr32(n, maxlen, IPE_DEV_ATTR_IFINDEX, msg->ifindex[id])) {
+                return -1;
+        }
+
+        if (msg->nsid[id] >= 0) {
+                if (addattr32(n, maxlen, IPE_DEV_ATTR_NSID, msg->nsid[id]))
+                        return -1;
+        } else if (msg->nsfd[id] >= 0 &&
+                   addattr32(n, maxlen, IPE_DEV_ATTR_NSFD, msg->nsfd[id])) {
+                return -1;
+        }
+
+        addattr_nest_end(n, nest);
+        return 0;
+}
+
+
+/* Attributes of operation: the same for single request and IPE_ATTR_OP */
+static int put_op(nmsgh_t *n, int maxlen, const ipe_nlmsg_t *msg) {
+        if (put_dev(n, maxlen, IPE_ATTR_SRC, msg, IPE_SRC))
+                return -1;
+
+        switch (msg->command) {
+        case IPE_CMD_SET_VID:
+        case IPE_CMD_SET_ETH:
+                return addattr32(n, maxlen, IPE_ATTR_VALUE, msg->value);
+        case IPE_CMD_SET_NAME:
+                return addattr_l(n, maxlen, IPE_ATTR_IFNAME,
+                                 msg->ifname, strlen(msg->ifname) + 1);
+        case IPE_CMD_SET_PARENT:
+        case IPE_CMD_FAILOVER:
+                return put_dev(n, maxlen, IPE_ATTR_DST, msg, IPE_DST);
+        }
+
+        return 0;
+}
+
+
+/* IPE_ATTR_OPS: IPE_ATTR_OP with IPE_ATTR_CMD for each of @count operations */
+static int put_ops(nmsgh_t *n, int maxlen, const ipe_nlmsg_t *ops,
+                                           const int count)
+{
+        struct nlattr *nest = addattr_nest(n, maxlen, IPE_ATTR_OPS);
+        struct nlattr *op;
+        int i;
+
+        if (!nest)
+                return -1;
+
+        for (i = 0; i < count; ++i) {
+                op = addattr_nest(n, maxlen, IPE_ATTR_OP);
+                if (!op ||
+                    addattr8(n, maxlen, IPE_ATTR_CMD, ops[i].command) ||
+                    put_op(n, maxlen, &ops[i]))
+                        return -1;
+
+                addattr_nest_end(n, op);
+        }
+
+        addattr_nest_end(n, nest);
+        return 0;
+}
+
+
+/* Message of IPE_CMD_RENUMBER into @n */
+static int put_vid_map(nmsgh_t *n, int maxlen, const int family,
+                       const ipe_dev_t *parent, const ipe_vid_pair_t *map,
+                       const int count)
+{
+        ipe_nlmsg_t op;
+
+        #ifdef IPE_DEBUG
+                printf("%s: %d pairs for parent %d\n",
+                                __FUNCTION__, count, parent->ifindex);
+        #endif
+
+        if (count < 1 || count > MAX_VID || ipe_op_init(&op, IPE_CMD_RENUMBER, parent))
+                return -1;
+
+        genl_init(n, family, IPE_CMD_RENUMBER, IPE_GENL_VERSION);
+        if (put_dev(n, maxlen, IPE_ATTR_SRC, &op, IPE_SRC))
+                return -1;
+
+        return addattr_l(n, maxlen, IPE_ATTR_VID_MAP, map,
+                         count * sizeof(ipe_vid_pair_t));
+}
+
+
+/* IPE_ATTR_FILTER of convert and rename: only proto and VIDs of @filter */
+static int put_match(nmsgh_t *n, int maxlen, const ipe_filter_t *filter) {
+        struct nlattr *nest;
+
+        if (!filter)
+                return 0;
+
+        nest = addattr_nest(n, maxlen, IPE_ATTR_FILTER);
+        if (!nest ||
+            (filter->proto &&
+             addattr16(n, maxlen, IPE_FILTER_ATTR_PROTO, filter->proto)) ||
+            (filter->vid_min &&
+             addattr16(n, maxlen, IPE_FILTER_ATTR_VID_MIN, filter->vid_min)) ||
+            (filter->vid_max &&
+             addattr16(n, maxlen, IPE_FILTER_ATTR_VID_MAX, filter->vid_max)))
+                return -1;
+        addattr_nest_end(n, nest);
+
+        return 0;
+}
+
+
+/* Message of IPE_CMD_CONVERT into @n */
+static int put_convert(nmsgh_t *n, int maxlen, const int family,
+                       const ipe_dev_t *parent, const int proto,
+                       const ipe_filter_t *filter)
+{
+        ipe_nlmsg_t op;
+
+        if (ipe_op_init(&op, IPE_CMD_CONVERT, parent))
+                return -1;
+
+        genl_init(n, family, IPE_CMD_CONVERT, IPE_GENL_VERSION);
+        if (put_dev(n, maxlen, IPE_ATTR_SRC, &op, IPE_SRC) ||
+            addattr32(n, maxlen, IPE_ATTR_VALUE, proto))
+                return -1;
+
+        return put_match(n, maxlen, filter);
+}
+
+
+/* Message of IPE_CMD_RENAME by pattern into @n */
+static int put_rename(nmsgh_t *n, int maxlen, const int family,
+                      const ipe_dev_t *parent, const char *pattern,
+                      const ipe_filter_t *filter)
+{
+        ipe_nlmsg_t op;
+
+        if (strlen(pattern) >= IFNAMSIZ || ipe_op_init(&op, IPE_CMD_RENAME, parent))
+                return -1;
+
+        genl_init(n, family, IPE_CMD_RENAME, IPE_GENL_VERSION);
+        if (put_dev(n, maxlen, IPE_ATTR_SRC, &op, IPE_SRC) ||
+            addattr_l(n, maxlen, IPE_ATTR_IFNAME, pattern, strlen(pattern) + 1))
+                return -1;
+
+        return put_match(n, maxlen, filter);
+}
+
+
+
+/* Each IPE_ATTR_OP of IPE_ATTR_FAILED: ifindex of child is tag for @cb */
+static void parse_failed(const struct nlattr *failed, ipe_result_cb_t cb,
+                                                      void *data)
+{
+        struct nlattr *tb[IPE_ATTR_MAX + 1];
+        struct nlattr *dev[IPE_DEV_ATTR_MAX + 1];
+        struct nlattr *op = NLA_DATA(failed);
+        int len = NLA_PAYLOAD(failed);
+
+        for (; NLA_OK(op, len); op = NLA_NEXT(op, len)) {
+                parse_attrs(tb, IPE_ATTR_MAX, NLA_DATA(op), NLA_PAYLOAD(op));
+                if (!tb[IPE_ATTR_SRC] || !tb[IPE_ATTR_RETCODE])
+                        continue;
+
+                parse_attrs(dev, IPE_DEV_ATTR_MAX, NLA_DATA(tb[IPE_ATTR_SRC]),
+                                                   NLA_PAYLOAD(tb[IPE_ATTR_SRC]));
+                if (dev[IPE_DEV_ATTR_IFINDEX])
+                        cb(data, nla_getattr_u32(dev[IPE_DEV_ATTR_IFINDEX]),
+                                 nla_getattr_u32(tb[IPE_ATTR_RETCODE]), NULL);
+        }
+}
+
+
+/* Each IPE_ATTR_RETCODE of IPE_ATTR_RESULTS that isn't IPE_OK: index is tag */
+static void parse_results(const struct nlattr *results, ipe_result_cb_t cb,
+                                                        void *data)
+{
+        struct nlattr *nla = NLA_DATA(results);
+        int len = NLA_PAYLOAD(results);
+        int i;
+
+        for (i = 0; NLA_OK(nla, len); ++i, nla = NLA_NEXT(nla, len)) {
+                int code = nla_getattr_u32(nla);
+
+                if (code != IPE_OK)
+                        cb(data, i, code, NULL);
+        }
+}
+
+
+/* IPE_ATTR_STATUS: failed operations go to @cb, all are copied for caller */
+static void parse_status(ipe_handle_t *h, const struct nlattr *nla,
+                         ipe_result_cb_t cb, void *data)
+{
+        const struct ipe_op_status *status = NLA_DATA(nla);
+        int count = NLA_PAYLOAD(nla) / sizeof(struct ipe_op_status);
+        int i;
+
+        for (i = 0; i < count; ++i) {
+                if (status[i].code != IPE_OK && cb)
+                        cb(data, status[i].index, status[i].code, NULL);
+                if (h->status && status[i].index < h->status_count)
+                        h->status[status[i].index] = status[i];
+        }
+}
+
+
+/*
+ * Request @nlh with NLM_F_ACK, exit code is taken from ACK. @count is
+ * IPE_ATTR_COUNT of reply (renumber, compact, failover, convert and
+ * rename), it may be NULL.
+ * @cb is called for each child of IPE_ATTR_FAILED (failover) and for each
+ * failed operation of IPE_ATTR_RESULTS or IPE_ATTR_STATUS (batch), if it's
+ * given.
+ */
+static int exec_msg(ipe_handle_t *h, nmsgh_t *nlh, int *count,
+                    ipe_result_cb_t cb, void *data)
+{
+        nmsgh_t *n;
+        int res = IPE_DEFAULT_FAIL;
+        int done = 0;
+        int len;
+
+        nlh->nlmsg_flags |= NLM_F_ACK;
+        nlh->nlmsg_seq    = next_seq(h);
+
+        if (send_msg(h, nlh))
+                return IPE_BAD_SOC;
+
+        while (!done) {
+                len = recv_msgs(h);
+                if (len < 0)
+                        return sock_error(h, "recv");
+
+                for (n = (nmsgh_t *)h->rcvbuf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+                        if (n->nlmsg_seq != nlh->nlmsg_seq)
+                                continue;
+
+                        if (n->nlmsg_type == NLMSG_ERROR) {
+                                res  = nlmsg_error_code(h, n);
+                                done = 1;
+                                break;
+                        }
+
+                        /* reply with COUNT, FAILED or results, ACK follows */
+                        if (n->nlmsg_type == h->family && (count || cb || h->status)) {
+                                struct nlattr *tb[IPE_ATTR_MAX + 1];
+
+                                parse_attrs(tb, IPE_ATTR_MAX,
+                                            GENLMSG_ATTRS(n), GENLMSG_ATTRLEN(n));
+                                if (tb[IPE_ATTR_COUNT] && count)
+                                        *count = nla_getattr_u32(tb[IPE_ATTR_COUNT]);
+                                if (tb[IPE_ATTR_FAILED] && cb)
+                                        parse_failed(tb[IPE_ATTR_FAILED], cb, data);
+                                if (tb[IPE_ATTR_RESULTS] && cb)
+                                        parse_results(tb[IPE_ATTR_RESULTS], cb, data);
+                                if (tb[IPE_ATTR_STATUS])
+                                        parse_status(h, tb[IPE_ATTR_STATUS], cb, data);
+                        }
+                }
+        }
+
+        #ifdef IPE_DEBUG
+                printf("%s: result is %s\n", __FUNCTION__, ipe_code_name(res));
+        #endif
+
+        return res;
+}
+
+
+/* Request of h->req, it's enough for all but list of rename */
+static int exec_req(ipe_handle_t *h, int *count, ipe_result_cb_t cb,
+                                                 void *data)
+{
+        return exec_msg(h, h->req, count, cb, data);
+}
+
+
+static int exec_op(ipe_handle_t *h, const ipe_nlmsg_t *op, int *count) {
+        h->errmsg[0] = '\0';
+
+        genl_init(h->req, h->family, op->command, IPE_GENL_VERSION);
+        if (put_op(h->req, REQ_SPACE, op))
+                return IPE_BAD_ARG;
+
+        return exec_req(h, count, NULL, NULL);
+}
+
+
+int ipe_exec(ipe_handle_t *h, const ipe_nlmsg_t *op) {
+        return exec_op(h, op, NULL);
+}
+
+
+
+int ipe_set_vid(ipe_handle_t *h, const ipe_dev_t *dev, const int vid) {
+        ipe_nlmsg_t op;
+        int res = ipe_op_set_vid(&op, dev, vid);
+
+        return res ? res : ipe_exec(h, &op);
+}
+
+
+int ipe_set_eth(ipe_handle_t *h, const ipe_dev_t *dev, const int proto) {
+        ipe_nlmsg_t op;
+        int res = ipe_op_set_eth(&op, dev, proto);
+
+        return res ? res : ipe_exec(h, &op);
+}
+
+
+int ipe_set_name(ipe_handle_t *h, const ipe_dev_t *dev, const char *ifname) {
+        ipe_nlmsg_t op;
+        int res = ipe_op_set_name(&op, dev, ifname);
+
+        return res ? res : ipe_exec(h, &op);
+}
+
+
+int ipe_set_parent(ipe_handle_t *h, const ipe_dev_t *dev,
+                                    const ipe_dev_t *parent)
+{
+        ipe_nlmsg_t op;
+        int res = ipe_op_set_parent(&op, dev, parent);
+
+        return res ? res : ipe_exec(h, &op);
+}
+
+
+int ipe_renumber(ipe_handle_t *h, const ipe_dev_t *parent,
+                 const ipe_vid_pair_t *map, const int count, int *moved)
+{
+        h->errmsg[0] = '\0';
+
+        if (put_vid_map(h->req, REQ_SPACE, h->family, parent, map, count))
+                return IPE_BAD_ARG;
+
+        return exec_req(h, moved, NULL, NULL);
+}
+
+
+int ipe_compact(ipe_handle_t *h, const ipe_dev_t *parent, int *freed) {
+        ipe_nlmsg_t op;
+        int res = ipe_op_compact(&op, parent);
+
+        return res ? res : exec_op(h, &op, freed);
+}
+
+
+int ipe_failover(ipe_handle_t *h, const ipe_dev_t *parent,
+                 const ipe_dev_t *new_parent, int *moved,
+                 ipe_result_cb_t cb, void *data)
+{
+        ipe_nlmsg_t op;
+        int res = ipe_op_init(&op, IPE_CMD_FAILOVER, parent);
+
+        if (!res)
+                res = op_dev(&op, IPE_DST, new_parent);
+        if (res)
+                return res;
+
+        h->errmsg[0] = '\0';
+
+        genl_init(h->req, h->family, IPE_CMD_FAILOVER, IPE_GENL_VERSION);
+        if (put_op(h->req, REQ_SPACE, &op))
+                return IPE_BAD_ARG;
+
+        return exec_req(h, moved, cb, data);
+}
+
+
+int ipe_convert(ipe_handle_t *h, const ipe_dev_t *parent, const int proto,
+                const ipe_filter_t *filter, int *converted)
+{
+        h->errmsg[0] = '\0';
+
+        if (put_convert(h->req, REQ_SPACE, h->family, parent, proto, filter))
+                return IPE_BAD_ARG;
+
+        return exec_req(h, converted, NULL, NULL);
+}
+
+
+
+int ipe_rename(ipe_handle_t *h, const ipe_dev_t *parent, const char *pattern,
+               const ipe_filter_t *filter, int *renamed)
+{
+        h->errmsg[0] = '\0';
+
+        if (put_rename(h->req, REQ_SPACE, h->family, parent, pattern, filter))
+                return IPE_BAD_ARG;
+
+        return exec_req(h, renamed, NULL, NULL);
+}
+
+
+/* Buffer of message for @count operations, send buffer of socket is grown for it */
+static nmsgh_t *alloc_ops_msg(ipe_handle_t *h, const int count, int *size) {
+        *size = NLMSG_SPACE(GENL_HDRLEN) + (count + 1) * OP_SPACE;
+
+        setsockopt(h->fd, SOL_SOCKET, SO_SNDBUF, size, sizeof(*size));
+        return calloc(1, *size);
+}
+
+
+/* One message of @count IPE_CMD_SET_NAME operations, it's built into own buffer */
+int ipe_rename_list(ipe_handle_t *h, const ipe_nlmsg_t *ops, const int count,
+                                     int *renamed)
+{
+        int res = IPE_BAD_ARG;
+        nmsgh_t *nlh;
+        int size;
+        int i;
+
+        if (count < 1 || count > IPE_BATCH_MAX)
+                return IPE_BAD_ARG;
+
+        for (i = 0; i < count; ++i) {
+                if (ops[i].command != IPE_CMD_SET_NAME)
+                        return IPE_BAD_ARG;
+        }
+
+        nlh = alloc_ops_msg(h, count, &size);
+        if (!nlh)
+                return IPE_BAD_ALLOC;
+
+        h->errmsg[0] = '\0';
+
+        genl_init(nlh, h->family, IPE_CMD_RENAME, IPE_GENL_VERSION);
+        if (!put_ops(nlh, size, ops, count))
+                res = exec_msg(h, nlh, renamed, NULL, NULL);
+
+        free(nlh);
+
+        return res;
+}
+
+
+/* The first failed operation of atomic batch, the rest go to callback of caller */
+typedef struct {
+        int                 res;
+        ipe_result_cb_t     cb;
+        void               *data;
+} ipe_atomic_ctx_t;
+
+static void atomic_result(void *data, const int tag, const int code,
+                                                     const char *errmsg)
+{
+        ipe_atomic_ctx_t *ctx = data;
+
+        if (!ctx->res && code != IPE_ROLLED_BACK && code != IPE_SKIPPED)
+                ctx->res = code;
+        if (ctx->cb)
+                ctx->cb(ctx->data, tag, code, errmsg);
+}
+
+
+/*
+ * All @ops by one IPE_CMD_BATCH message with IPE_BATCH_ATOMIC, in order.
+ * @cb (may be NULL) gets index of each operation that isn't applied. With
+ * @status (may be NULL) reply is IPE_ATTR_STATUS, it's copied there.
+ */
+int ipe_exec_atomic(ipe_handle_t *h, const ipe_nlmsg_t *ops, const int count,
+                    struct ipe_op_status *status, ipe_result_cb_t cb, void *data)
+{
+        ipe_atomic_ctx_t ctx = { IPE_OK, cb, data };
+        int flags = IPE_BATCH_ATOMIC;
+        int res = IPE_BAD_ARG;
+        nmsgh_t *nlh;
+        int size;
+
+        if (count < 1 || count > IPE_BATCH_MAX)
+                return IPE_BAD_ARG;
+
+        nlh = alloc_ops_msg(h, count, &size);
+        if (!nlh)
+                return IPE_BAD_ALLOC;
+
+        h->errmsg[0] = '\0';
+
+        if (status) {
+                memset(status, 0, count * sizeof(struct ipe_op_status));
+                h->status       = status;
+                h->status_count = count;
+                flags          |= IPE_BATCH_STATUS;
+        }
+
+        genl_init(nlh, h->family, IPE_CMD_BATCH, IPE_GENL_VERSION);
+        if (!addattr32(nlh, size, IPE_ATTR_FLAGS, flags) &&
+            !put_ops(nlh, size, ops, count))
+                res = exec_msg(h, nlh, NULL, atomic_result, &ctx);
+
+        h->status = NULL;
+        free(nlh);
+
+        return res ? res : ctx.res;
+}
+
+
+
+/* IPE_LINK_ATTR_* of dump or event */
+static void parse_link(ipe_link_t *link, const nmsgh_t *n) {
+        struct nlattr *tb[IPE_LINK_ATTR_MAX + 1];
+        int i;
+
+        parse_attrs(tb, IPE_LINK_ATTR_MAX, GENLMSG_ATTRS(n), GENLMSG_ATTRLEN(n));
+
+        memset(link, 0, sizeof(ipe_link_t));
+        for (i = 0; i <= IPE_LINK_ATTR_MAX; ++i) {
+                if (tb[i])
+                        link->has |= 1U << i;
+        }
+
+        if (tb[IPE_LINK_ATTR_IFINDEX])
+                link->ifindex = nla_getattr_u32(tb[IPE_LINK_ATTR_IFINDEX]);
+        if (tb[IPE_LINK_ATTR_IFNAME])
+                snprintf(link->ifname, IFNAMSIZ, "%s",
+                         (char *)NLA_DATA(tb[IPE_LINK_ATTR_IFNAME]));
+        if (tb[IPE_LINK_ATTR_VID])
+                link->vid = nla_getattr_u16(tb[IPE_LINK_ATTR_VID]);
+        if (tb[IPE_LINK_ATTR_PROTO])
+                link->proto = nla_getattr_u16(tb[IPE_LINK_ATTR_PROTO]);
+        if (tb[IPE_LINK_ATTR_PARENT])
+                link->parent = nla_getattr_u32(tb[IPE_LINK_ATTR_PARENT]);
+        if (tb[IPE_LINK_ATTR_PARENT_NAME])
+                snprintf(link->parent_name, IFNAMSIZ, "%s",
+                         (char *)NLA_DATA(tb[IPE_LINK_ATTR_PARENT_NAME]));
+        if (tb[IPE_LINK_ATTR_NETNSID])
+                link->netnsid = (int)nla_getattr_u32(tb[IPE_LINK_ATTR_NETNSID]);
+        if (tb[IPE_LINK_ATTR_PARENT_NETNSID])
+                link->parent_netnsid =
+                        (int)nla_getattr_u32(tb[IPE_LINK_ATTR_PARENT_NETNSID]);
+        if (tb[IPE_LINK_ATTR_NEST_LEVEL])
+                link->nest_level = nla_getattr_u32(tb[IPE_LINK_ATTR_NEST_LEVEL]);
+
+        if (tb[IPE_LINK_ATTR_CHANGE])
+                link->change = *(__u8 *)NLA_DATA(tb[IPE_LINK_ATTR_CHANGE]);
+        if (tb[IPE_LINK_ATTR_GENERATION])
+                link->generation = nla_getattr_u32(tb[IPE_LINK_ATTR_GENERATION]);
+        if (tb[IPE_LINK_ATTR_OLD_VID])
+                link->old_vid = nla_getattr_u16(tb[IPE_LINK_ATTR_OLD_VID]);
+        if (tb[IPE_LINK_ATTR_OLD_PROTO])
+                link->old_proto = nla_getattr_u16(tb[IPE_LINK_ATTR_OLD_PROTO]);
+        if (tb[IPE_LINK_ATTR_OLD_PARENT])
+                link->old_parent = nla_getattr_u32(tb[IPE_LINK_ATTR_OLD_PARENT]);
+        if (tb[IPE_LINK_ATTR_OLD_IFNAME])
+                snprintf(link->old_ifname, IFNAMSIZ, "%s",
+                         (char *)NLA_DATA(tb[IPE_LINK_ATTR_OLD_IFNAME]));
+
+        if (tb[IPE_LINK_ATTR_SLOT])
+                link->slot = *(__u8 *)NLA_DATA(tb[IPE_LINK_ATTR_SLOT]);
+}
+
+
+
+/* IPE_CMD_DUMP with NLM_F_DUMP: filter is evaluated by kernel */
+int ipe_dump(ipe_handle_t *h, const ipe_filter_t *filter,
+             ipe_link_cb_t cb, void *data)
+{
+        nmsgh_t *nlh = h->req;
+        struct nlattr *nest;
+        ipe_link_t link;
+        nmsgh_t *n;
+        int res = IPE_OK;
+        int stop = 0;
+        int done = 0;
+        int len;
+
+        h->errmsg[0] = '\0';
+
+        genl_init(nlh, h->family, IPE_CMD_DUMP, IPE_GENL_VERSION);
+        nlh->nlmsg_flags |= NLM_F_DUMP;
+        nlh->nlmsg_seq    = next_seq(h);
+
+        nest = addattr_nest(nlh, REQ_SPACE, IPE_ATTR_FILTER);
+        if (filter && filter->parent)
+                addattr32(nlh, REQ_SPACE, IPE_FILTER_ATTR_PARENT, filter->parent);
+        if (filter && filter->proto)
+                addattr16(nlh, REQ_SPACE, IPE_FILTER_ATTR_PROTO, filter->proto);
+        if (filter && filter->vid_min)
+                addattr16(nlh, REQ_SPACE, IPE_FILTER_ATTR_VID_MIN, filter->vid_min);
+        if (filter && filter->vid_max)
+                addattr16(nlh, REQ_SPACE, IPE_FILTER_ATTR_VID_MAX, filter->vid_max);
+        if (filter && filter->nsfd >= 0)
+                addattr32(nlh, REQ_SPACE, IPE_FILTER_ATTR_NSFD, filter->nsfd);
+        else if (filter && filter->nsid >= 0)
+                addattr32(nlh, REQ_SPACE, IPE_FILTER_ATTR_NSID, filter->nsid);
+        addattr_nest_end(nlh, nest);
+
+        if (send_msg(h, nlh))
+                return IPE_BAD_SOC;
+
+        while (!done) {
+                len = recv_msgs(h);
+                if (len < 0)
+                        return sock_error(h, "recv");
+
+                for (n = (nmsgh_t *)h->rcvbuf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+                        if (n->nlmsg_seq != nlh->nlmsg_seq)
+                                continue;
+
+                        if (n->nlmsg_type == NLMSG_DONE) {
+                                int err = *(int *)NLMSG_DATA(n);
+                                if (err < 0)
+                                        res = ipe_errno_to_code(-err);
+                                done = 1;
+                                break;
+                        }
+
+                        if (n->nlmsg_type == NLMSG_ERROR) {
+                                res  = nlmsg_error_code(h, n);
+                                done = 1;
+                                break;
+                        }
+
+                        if (n->nlmsg_type == h->family && !stop) {
+                                parse_link(&link, n);
+                                stop = cb(data, &link);
+                        }
+                }
+        }
+
+        return res;
+}
+
+
+
+/* IPE_CMD_GET: reply is parsed into @link, exit code is taken from ACK */
+int ipe_get(ipe_handle_t *h, const ipe_dev_t *dev, ipe_link_t *link) {
+        nmsgh_t *nlh = h->req;
+        ipe_nlmsg_t op;
+        nmsgh_t *n;
+        int res = IPE_DEFAULT_FAIL;
+        int done = 0;
+        int len;
+
+        h->errmsg[0] = '\0';
+        memset(link, 0, sizeof(ipe_link_t));
+
+        if (ipe_op_init(&op, IPE_CMD_GET, dev))
+                return IPE_BAD_ARG;
+
+        genl_init(nlh, h->family, IPE_CMD_GET, IPE_GENL_VERSION);
+        if (put_op(nlh, REQ_SPACE, &op))
+                return IPE_BAD_ARG;
+
+        nlh->nlmsg_flags |= NLM_F_ACK;
+        nlh->nlmsg_seq    = next_seq(h);
+
+        if (send_msg(h, nlh))
+                return IPE_BAD_SOC;
+
+        while (!done) {
+                len = recv_msgs(h);
+                if (len < 0)
+                        return sock_error(h, "recv");
+
+                for (n = (nmsgh_t *)h->rcvbuf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+                        if (n->nlmsg_seq != nlh->nlmsg_seq)
+                                continue;
+
+                        if (n->nlmsg_type == NLMSG_ERROR) {
+                                res  = nlmsg_error_code(h, n);
+                                done = 1;
+                                break;
+                        }
+
+                        if (n->nlmsg_type == h->family)
+                                parse_link(link, n);
+                }
+        }
+
+        return res;
+}
+
+
+
+/* Stream IPE_CMD_EVENT of multicast group until callback stops it */
+int ipe_monitor(ipe_handle_t *h, ipe_link_cb_t cb, void *data) {
+        ipe_link_t link;
+        nmsgh_t *n;
+        int len;
+
+        h->errmsg[0] = '\0';
+
+        if (!h->mcgrp) {
+                snprintf(h->errmsg, ERRMSG_LEN, "module has no group \"%s\"",
+                                                IPE_GENL_MCGRP_EVENTS);
+                return IPE_BAD_SOC;
+        }
+
+        if (setsockopt(h->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP,
+                       &h->mcgrp, sizeof(h->mcgrp)) < 0)
+                return sock_error(h, "NETLINK_ADD_MEMBERSHIP");
+
+        for (;;) {
+                len = recv_msgs(h);
+                if (len < 0) {
+                        /* receive queue was overrun: gap of generation */
+                        if (errno == ENOBUFS) {
+                                if (cb(data, NULL))
+                                        break;
+                                continue;
+                        }
+                        return sock_error(h, "recv");
+                }
+
+                for (n = (nmsgh_t *)h->rcvbuf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+                        const struct genlmsghdr *g = NLMSG_DATA(n);
+
+                        if (n->nlmsg_type != h->family || g->cmd != IPE_CMD_EVENT)
+                                continue;
+
+                        parse_link(&link, n);
+                        if (cb(data, &link))
+                                goto drop;
+                }
+        }
+
+drop:
+        setsockopt(h->fd, SOL_NETLINK, NETLINK_DROP_MEMBERSHIP,
+                   &h->mcgrp, sizeof(h->mcgrp));
+
+        return IPE_OK;
+}
+
+
+
+/*
+ * Batch: operations are packed into IPE_CMD_BATCH messages and sent through
+ * the socket of handle. Up to BATCH_WINDOW messages are in flight, replies
+ * are matched by nlmsg_seq and errors are reported for each operation. With
+ * IPE_BATCH_ASYNC module queues messages and acknowledges them at once,
+ * results come later.
+ */
+static void batch_report(ipe_batch_ctx_t *ctx, const int tag, const int code,
+                                               const char *errmsg)
+{
+        if (ctx->cb)
+                ctx->cb(ctx->data, tag, code, errmsg);
+
+        if (!ctx->res)
+                ctx->res = code;
+        if (!(ctx->flags & IPE_BATCH_FORCE))
+                ctx->stop = 1;
+}
+
+
+static void batch_report_slot(ipe_batch_ctx_t *ctx, ipe_slot_t *slot,
+                              const int code, const char *errmsg)
+{
+        int i;
+        for (i = 0; i < slot->count; ++i)
+                batch_report(ctx, slot->tag[i], code, errmsg);
+}
+
+
+
+static void batch_send(ipe_handle_t *h, ipe_slot_t *slot) {
+        ipe_batch_ctx_t *ctx = h->batch;
+
+        slot->seq = next_seq(h);
+        slot->nlh->nlmsg_seq = slot->seq;
+
+        if (send_msg(h, slot->nlh)) {
+                batch_report_slot(ctx, slot, IPE_BAD_SOC, h->errmsg);
+                slot->seq = 0;
+                return;
+        }
+
+        ctx->in_flight++;
+}
+
+
+static void batch_send_ops(ipe_handle_t *h, ipe_slot_t *slot) {
+        ipe_batch_ctx_t *ctx = h->batch;
+        int flags = ctx->flags & (IPE_BATCH_ATOMIC | IPE_BATCH_ASYNC);
+
+        genl_init(slot->nlh, h->family, IPE_CMD_BATCH, IPE_GENL_VERSION);
+
+        if (flags & IPE_BATCH_ASYNC)
+                slot->nlh->nlmsg_flags |= NLM_F_ACK;
+        if (flags && addattr32(slot->nlh, SLOT_SPACE, IPE_ATTR_FLAGS, flags))
+                goto bad_msg;
+
+        if (put_ops(slot->nlh, SLOT_SPACE, slot->ops, slot->count))
+                goto bad_msg;
+
+        batch_send(h, slot);
+        return;
+
+bad_msg:
+        batch_report_slot(ctx, slot, IPE_BAD_ARG, NULL);
+}
+
+
+static void batch_flush(ipe_handle_t *h) {
+        ipe_batch_ctx_t *ctx = h->batch;
+
+        if (ctx->cur && ctx->cur->count)
+                batch_send_ops(h, ctx->cur);
+        ctx->cur = NULL;
+}
+
+
+
+/*
+ * @results is IPE_ATTR_RESULTS: IPE_ATTR_RETCODE of each operation in order.
+ * Operations that were skipped because of other bad operation into the
+ * same message are sent again with IPE_BATCH_FORCE, before the next
+ * message (see batch_window)
+ */
+static void batch_complete_ops(ipe_handle_t *h, ipe_slot_t *slot,
+                                        const struct nlattr *results)
+{
+        ipe_batch_ctx_t *ctx = h->batch;
+        struct nlattr *nla = NLA_DATA(results);
+        int len = NLA_PAYLOAD(results);
+        int retry = 0;
+        int i;
+
+        for (i = 0; i < slot->count && NLA_OK(nla, len);
+             ++i, nla = NLA_NEXT(nla, len)) {
+                int code = nla_getattr_u32(nla);
+
+                if (code == IPE_OK)
+                        continue;
+
+                if (code == IPE_SKIPPED && (ctx->flags & IPE_BATCH_FORCE)) {
+                        slot->ops[retry] = slot->ops[i];
+                        slot->tag[retry] = slot->tag[i];
+                        retry++;
+                        continue;
+                }
+
+                batch_report(ctx, slot->tag[i], code, NULL);
+        }
+
+        if (retry) {
+                slot->count = retry;
+                batch_send_ops(h, slot);
+        }
+}
+
+
+static void batch_complete(ipe_handle_t *h, ipe_slot_t *slot, const nmsgh_t *n) {
+        ipe_batch_ctx_t *ctx = h->batch;
+        struct nlattr *tb[IPE_ATTR_MAX + 1];
+        const struct genlmsghdr *g = NLMSG_DATA(n);
+        int code = IPE_OK;
+
+        if (n->nlmsg_type == NLMSG_ERROR) {
+                h->errmsg[0] = '\0';
+                code = nlmsg_error_code(h, n);
+        }
+
+        /* batch is queued: slot is busy until results */
+        if (n->nlmsg_type == NLMSG_ERROR && !code && (ctx->flags & IPE_BATCH_ASYNC))
+                return;
+
+        ctx->in_flight--;
+        slot->seq = 0;
+
+        if (n->nlmsg_type == NLMSG_ERROR) {
+                if (code)
+                        batch_report_slot(ctx, slot, code, ipe_errmsg(h));
+                return;
+        }
+
+        if (n->nlmsg_type != h->family) {
+                batch_report_slot(ctx, slot, IPE_DEFAULT_FAIL, NULL);
+                return;
+        }
+
+        /* IPE_CMD_RENUMBER, COMPACT and CONVERT are replied only on success */
+        if (g->cmd != IPE_CMD_BATCH)
+                return;
+
+        parse_attrs(tb, IPE_ATTR_MAX, GENLMSG_ATTRS(n), GENLMSG_ATTRLEN(n));
+        if (tb[IPE_ATTR_RESULTS])
+                batch_complete_ops(h, slot, tb[IPE_ATTR_RESULTS]);
+        else
+                batch_report_slot(ctx, slot, IPE_DEFAULT_FAIL, NULL);
+}
+
+
+static void batch_recv(ipe_handle_t *h) {
+        ipe_batch_ctx_t *ctx = h->batch;
+        nmsgh_t *n;
+        int len;
+        int i;
+
+        len = recv_msgs(h);
+        if (len < 0) {
+                /* Replies are lost, nothing can be matched */
+                sock_error(h, "recv");
+                for (i = 0; i < BATCH_WINDOW; ++i) {
+                        if (ctx->slots[i].seq)
+                                batch_report_slot(ctx, &ctx->slots[i],
+                                                  IPE_BAD_SOC, h->errmsg);
+                        ctx->slots[i].seq = 0;
+                }
+                ctx->in_flight = 0;
+                ctx->stop = 1;
+                return;
+        }
+
+        for (n = (nmsgh_t *)h->rcvbuf; NLMSG_OK(n, len); n = NLMSG_NEXT(n, len)) {
+                for (i = 0; i < BATCH_WINDOW; ++i) {
+                        if (ctx->slots[i].seq == n->nlmsg_seq) {
+                                batch_complete(h, &ctx->slots[i], n);
+                                break;
+                        }
+                }
+        }
+}
+
+
+/*
+ * With IPE_BATCH_FORCE skipped operations of a message are sent again: the
+ * next message waits for its reply, else it's applied before them and
+ * order of lines is broken
+ */
+static int batch_window(const ipe_batch_ctx_t *ctx) {
+        return ctx->flags & IPE_BATCH_FORCE ? 1 : BATCH_WINDOW;
+}
+
+
+static ipe_slot_t *batch_get_slot(ipe_handle_t *h) {
+        ipe_batch_ctx_t *ctx = h->batch;
+        int i;
+
+        while (ctx->in_flight >= batch_window(ctx))
+                batch_recv(h);
+
+        for (i = 0; i < BATCH_WINDOW; ++i) {
+                if (!ctx->slots[i].seq && &ctx->slots[i] != ctx->cur) {
+                        ctx->slots[i].count = 0;
+                        return &ctx->slots[i];
+                }
+        }
+
+        return NULL;
+}
+
+
+
+int ipe_batch_begin(ipe_handle_t *h, const int flags,
+                    ipe_result_cb_t cb, void *data)
+{
+        ipe_batch_ctx_t *ctx = h->batch;
+        int i;
+
+        /* slots are kept by handle for the next batches */
+        if (!ctx) {
+                ctx = calloc(1, sizeof(ipe_batch_ctx_t));
+                if (!ctx)
+                        return IPE_BAD_ALLOC;
+
+                for (i = 0; i < BATCH_WINDOW; ++i) {
+                        ctx->slots[i].nlh = calloc(1, SLOT_SPACE);
+                        if (!ctx->slots[i].nlh)
+                                goto free_slots;
+                }
+                h->batch = ctx;
+        }
+
+        if (flags & IPE_BATCH_ASYNC) {
+                int rcvbuf = ASYNC_SOCK_RCVBUF;
+                setsockopt(h->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        }
+
+        ctx->flags     = flags;
+        ctx->stop      = 0;
+        ctx->res       = IPE_OK;
+        ctx->in_flight = 0;
+        ctx->cb        = cb;
+        ctx->data      = data;
+        ctx->cur       = NULL;
+        for (i = 0; i < BATCH_WINDOW; ++i)
+                ctx->slots[i].seq = 0;
+
+        return IPE_OK;
+
+free_slots:
+        for (i = 0; i < BATCH_WINDOW; ++i)
+                free(ctx->slots[i].nlh);
+        free(ctx);
+
+        return IPE_BAD_ALLOC;
+}
+
+
+int ipe_batch_fail(ipe_handle_t *h, const int tag, const int code) {
+        batch_report(h->batch, tag, code, NULL);
+        return h->batch->stop ? h->batch->res : IPE_OK;
+}
+
+
+/*
+ * Renumber, compact, convert and rename aren't batched: own message for
+ * each of them
+ */
+static ipe_slot_t *batch_single_slot(ipe_handle_t *h, const int tag) {
+        ipe_slot_t *slot;
+
+        batch_flush(h);
+        slot = batch_get_slot(h);
+
+        slot->count  = 1;
+        slot->tag[0] = tag;
+
+        return slot;
+}
+
+
+int ipe_batch_add(ipe_handle_t *h, const ipe_nlmsg_t *op, const int tag) {
+        ipe_batch_ctx_t *ctx = h->batch;
+        ipe_slot_t *slot;
+
+        if (ctx->stop)
+                return ctx->res;
+
+        switch (op->command) {
+        case IPE_CMD_SET_VID:
+        case IPE_CMD_SET_ETH:
+        case IPE_CMD_SET_NAME:
+        case IPE_CMD_SET_PARENT:
+                break;
+        case IPE_CMD_COMPACT:
+                slot = batch_single_slot(h, tag);
+                slot->ops[0] = *op;
+                genl_init(slot->nlh, h->family, IPE_CMD_COMPACT, IPE_GENL_VERSION);
+                if (put_op(slot->nlh, SLOT_SPACE, op))
+                        return ipe_batch_fail(h, tag, IPE_BAD_ARG);
+
+                batch_send(h, slot);
+                goto out;
+        default:
+                return ipe_batch_fail(h, tag, IPE_UNKNOWN_COMMAND);
+        }
+
+        if (!ctx->cur)
+                ctx->cur = batch_get_slot(h);
+
+        ctx->cur->ops[ctx->cur->count] = *op;
+        ctx->cur->tag[ctx->cur->count++] = tag;
+
+        if (ctx->cur->count == BATCH_CHUNK)
+                batch_flush(h);
+
+out:
+        return ctx->stop ? ctx->res : IPE_OK;
+}
+
+
+int ipe_batch_add_renumber(ipe_handle_t *h, const ipe_dev_t *parent,
+                           const ipe_vid_pair_t *map, const int count,
+                           const int tag)
+{
+        ipe_batch_ctx_t *ctx = h->batch;
+        ipe_slot_t *slot;
+
+        if (ctx->stop)
+                return ctx->res;
+
+        if (count < 1 || count > MAX_VID)
+                return ipe_batch_fail(h, tag, IPE_BAD_ARG);
+
+        slot = batch_single_slot(h, tag);
+        if (put_vid_map(slot->nlh, SLOT_SPACE, h->family, parent, map, count))
+                return ipe_batch_fail(h, tag, IPE_BAD_ARG);
+
+        batch_send(h, slot);
+
+        return ctx->stop ? ctx->res : IPE_OK;
+}
+
+
+int ipe_batch_add_convert(ipe_handle_t *h, const ipe_dev_t *parent,
+                          const int proto, const ipe_filter_t *filter,
+                          const int tag)
+{
+        ipe_batch_ctx_t *ctx = h->batch;
+        ipe_slot_t *slot;
+
+        if (ctx->stop)
+                return ctx->res;
+
+        slot = batch_single_slot(h, tag);
+        if (put_convert(slot->nlh, SLOT_SPACE, h->family, parent, proto, filter))
+                return ipe_batch_fail(h, tag, IPE_BAD_ARG);
+
+        batch_send(h, slot);
+
+        return ctx->stop ? ctx->res : IPE_OK;
+}
+
+
+int ipe_batch_add_rename(ipe_handle_t *h, const ipe_dev_t *parent,
+                         const char *pattern, const ipe_filter_t *filter,
+                         const int tag)
+{
+        ipe_batch_ctx_t *ctx = h->batch;
+        ipe_slot_t *slot;
+
+        if (ctx->stop)
+                return ctx->res;
+
+        slot = batch_single_slot(h, tag);
+        if (put_rename(slot->nlh, SLOT_SPACE, h->family, parent, pattern, filter))
+                return ipe_batch_fail(h, tag, IPE_BAD_ARG);
+
+        batch_send(h, slot);
+
+        return ctx->stop ? ctx->res : IPE_OK;
+}
+
+
+int ipe_batch_end(ipe_handle_t *h) {
+        ipe_batch_ctx_t *ctx = h->batch;
+
+        if (!ctx->stop)
+                batch_flush(h);
+
+        while (ctx->in_flight)
+                batch_recv(h);
+
+        return ctx->res;
+}
@@ -0,0 +1,219 @@
+/******************************************************************************
+*
+*                       GNU GENERAL PUBLIC LICENSE
+*       Copyright © 2018 Free Software Foundation, Inc. <https://fsf.org/>
+*
+* Everyone is permitted to copy and distribute verbatim copies of this license
+* document, but changing it is not allowed.
+*
+*
+*
+*
+* Author:
+*   March, 2018        Daniel Wolkow
+*
+*
+* Description:
+*     Client library of ipe: one handle keeps socket, id of family and
+* buffers, so each operation is a send and a recv without fork, exec and
+* nlctrl lookup. Calls return IPE_* code, message of kernel (extended ACK)
+* of the last failure is ipe_errmsg(). Handle isn't thread-safe: one handle
+* for each thread, and a separate one for ipe_monitor().
+*
+*                               FOR USERSPACE
+******************************************************************************/
+
+#ifndef __IPE_LIBIPE_H
+#define __IPE_LIBIPE_H           1
+
+
+#include <linux/if.h> // IFNAMSIZ
+
+#include "../include/ipeNetlink.h"
+
+enum {
+        IPE_SRC,
+        IPE_DST,
+        IPE_DEV_COUNT,
+};
+
+
+/*
+ * One operation before it is packed into attributes of message:
+ * @command is IPE_CMD_*, @nsfd and @nsid are -1 for netns of ipe itself
+ */
+typedef struct nl_message {
+        int   ifindex [IPE_DEV_COUNT];
+        int   nsfd    [IPE_DEV_COUNT];
+        int   nsid    [IPE_DEV_COUNT];  /* -1 if it isn't given */
+        char  devname [IPE_DEV_COUNT][IFNAMSIZ]; /* if ifindex is 0 */
+        char  ifname  [IFNAMSIZ];
+        int   value;
+        char  command;
+} ipe_nlmsg_t;
+
+
+/* Element of IPE_ATTR_VID_MAP */
+typedef struct ipe_vid_pair ipe_vid_pair_t;
+
+
+/* Device of operation: @name is used instead of @ifindex if it isn't NULL */
+typedef struct {
+        int         ifindex;
+        const char *name;
+        int         nsfd;       /* -1 for netns of caller */
+        int         nsid;       /* -1 if it isn't given, preferred to nsfd */
+} ipe_dev_t;
+
+
+/*
+ * Filter of ipe_dump(), 0 and -1 match all. ipe_convert() and ipe_rename()
+ * use proto and VIDs
+ */
+typedef struct {
+        int   parent;           /* ifindex of real_dev */
+        int   proto;
+        int   vid_min;
+        int   vid_max;
+        int   nsfd;             /* -1 for all netns */
+        int   nsid;             /* -1 */
+} ipe_filter_t;
+
+
+/*
+ * VLAN device of dump or event, fields are valid only if their attribute
+ * was present: IPE_LINK_HAS(link, IPE_LINK_ATTR_*)
+ */
+typedef struct {
+        __u32 has;
+        int   ifindex;
+        char  ifname     [IFNAMSIZ];
+        int   vid;
+        int   proto;
+        int   parent;
+        char  parent_name[IFNAMSIZ];
+        int   netnsid;
+        int   parent_netnsid;
+        int   nest_level;
+        /* IPE_CMD_EVENT only: */
+        int   change;           /* IPE_CMD_* that made change */
+        __u32 generation;
+        int   old_vid;
+        int   old_proto;
+        int   old_parent;
+        char  old_ifname [IFNAMSIZ];
+        /* IPE_CMD_GET only: */
+        int   slot;             /* device is into its slot of group */
+} ipe_link_t;
+
+#define IPE_LINK_HAS(link, attr) ((link)->has & (1U << (attr)))
+
+
+typedef struct ipe_handle ipe_handle_t;
+
+/* Non-zero return of callback stops dump (the rest is drained) or monitor */
+typedef int  (*ipe_link_cb_t)   (void *data, const ipe_link_t *link);
+/* Failed operation of batch: @errmsg is message of kernel or NULL */
+typedef void (*ipe_result_cb_t) (void *data, const int tag, const int code,
+                                 const char *errmsg);
+
+/* Flag of ipe_batch_begin() only, it isn't sent: IPE_SKIPPED are sent again */
+#define IPE_BATCH_FORCE         0x100
+
+
+
+/* NULL and errno on failure, ENOENT if module isn't loaded */
+ipe_handle_t *ipe_open  (void);
+void          ipe_close (ipe_handle_t *h);
+
+unsigned int  ipe_module_version (const ipe_handle_t *h);
+const char   *ipe_errmsg         (const ipe_handle_t *h);
+const char   *ipe_code_name      (const int code);
+
+/* Descriptor of netns by name or path, it's owned by handle */
+int ipe_netns_fd        (ipe_handle_t *h, const char *name);
+
+
+/* Builders of operation for ipe_exec() and ipe_batch_add() */
+int ipe_op_init         (ipe_nlmsg_t *op, const int command, const ipe_dev_t *dev);
+int ipe_op_set_vid      (ipe_nlmsg_t *op, const ipe_dev_t *dev, const int vid);
+int ipe_op_set_eth      (ipe_nlmsg_t *op, const ipe_dev_t *dev, const int proto);
+int ipe_op_set_name     (ipe_nlmsg_t *op, const ipe_dev_t *dev, const char *ifname);
+int ipe_op_set_parent   (ipe_nlmsg_t *op, const ipe_dev_t *dev,
+                                          const ipe_dev_t *parent);
+int ipe_op_compact      (ipe_nlmsg_t *op, const ipe_dev_t *parent);
+
+int ipe_exec            (ipe_handle_t *h, const ipe_nlmsg_t *op);
+/*
+ * Up to IPE_BATCH_MAX operations by one request, applied in order, all or
+ * nothing. @cb (may be NULL) gets index of each operation as @tag. @status
+ * (may be NULL) gets code, old and new value of each of @count operations.
+ */
+int ipe_exec_atomic     (ipe_handle_t *h, const ipe_nlmsg_t *ops, const int count,
+                         struct ipe_op_status *status,
+                         ipe_result_cb_t cb, void *data);
+
+
+int ipe_set_vid         (ipe_handle_t *h, const ipe_dev_t *dev, const int vid);
+int ipe_set_eth         (ipe_handle_t *h, const ipe_dev_t *dev, const int proto);
+int ipe_set_name        (ipe_handle_t *h, const ipe_dev_t *dev, const char *ifname);
+int ipe_set_parent      (ipe_handle_t *h, const ipe_dev_t *dev,
+                                          const ipe_dev_t *parent);
+/* @moved and @freed may be NULL */
+int ipe_renumber        (ipe_handle_t *h, const ipe_dev_t *parent,
+                         const ipe_vid_pair_t *map, const int count, int *moved);
+int ipe_compact         (ipe_handle_t *h, const ipe_dev_t *parent, int *freed);
+/*
+ * All VLAN children of @parent are moved to @new_parent by one request.
+ * Children that stay are given to @cb (may be NULL): @tag is their ifindex.
+ */
+int ipe_failover        (ipe_handle_t *h, const ipe_dev_t *parent,
+                         const ipe_dev_t *new_parent, int *moved,
+                         ipe_result_cb_t cb, void *data);
+/* New @proto for all VLAN children of @parent that match @filter (may be NULL) */
+int ipe_convert         (ipe_handle_t *h, const ipe_dev_t *parent, const int proto,
+                         const ipe_filter_t *filter, int *converted);
+/*
+ * Renames are applied by one request, all or nothing: "%d" of @pattern is
+ * VID of each child of @parent that matches @filter (may be NULL), or
+ * @ops are ipe_op_set_name() of any devices (names can be swapped).
+ */
+int ipe_rename          (ipe_handle_t *h, const ipe_dev_t *parent,
+                         const char *pattern, const ipe_filter_t *filter,
+                         int *renamed);
+int ipe_rename_list     (ipe_handle_t *h, const ipe_nlmsg_t *ops, const int count,
+                         int *renamed);
+
+int ipe_dump            (ipe_handle_t *h, const ipe_filter_t *filter,
+                         ipe_link_cb_t cb, void *data);
+/* One VLAN device, module reads it under RCU without rtnl_lock */
+int ipe_get             (ipe_handle_t *h, const ipe_dev_t *dev, ipe_link_t *link);
+/* @link is NULL if events were lost (receive queue was overrun) */
+int ipe_monitor         (ipe_handle_t *h, ipe_link_cb_t cb, void *data);
+
+
+/*
+ * Batch builder: operations are packed into IPE_CMD_BATCH messages and up to
+ * a window of them is in flight. @tag of operation is given back to @cb if
+ * it fails. Without IPE_BATCH_FORCE the first failure stops batch: add
+ * returns its code and the rest isn't sent. With it one message is in
+ * flight, so retried operations keep order of adds. ipe_batch_end() waits
+ * for all replies and returns the first failure.
+ */
+int ipe_batch_begin     (ipe_handle_t *h, const int flags,
+                         ipe_result_cb_t cb, void *data);
+int ipe_batch_add       (ipe_handle_t *h, const ipe_nlmsg_t *op, const int tag);
+int ipe_batch_add_renumber(ipe_handle_t *h, const ipe_dev_t *parent,
+                           const ipe_vid_pair_t *map, const int count,
+                           const int tag);
+int ipe_batch_add_convert(ipe_handle_t *h, const ipe_dev_t *parent,
+                          const int proto, const ipe_filter_t *filter,
+                          const int tag);
+int ipe_batch_add_rename(ipe_handle_t *h, const ipe_dev_t *parent,
+                         const char *pattern, const ipe_filter_t *filter,
+                         const int tag);
+/* Failure of caller (e.g. bad line), it's reported like failure of module */
+int ipe_batch_fail      (ipe_handle_t *h, const int tag, const int code);
+int ipe_batch_end       (ipe_handle_t *h);
+
+#endif // __IPE_LIBIPE_H